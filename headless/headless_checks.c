@@ -0,0 +1,581 @@
+#include "headless_checks.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "raylib.h"
+#include "stb_ds.h"
+
+#include "path.h"
+#include "scene.h"
+#include "terrain.h"
+#include "terrain_edit.h"
+#include "terrain_heightmap.h"
+
+#define HEADLESS_CHECK_GENERATIONS 0xFFFF // removals until a slot is back at its first generation, entity_remove skips 0xFFFF
+#define HEADLESS_CHECK_REGION_MAP 96       // samples a side of the map the region check edits
+#define HEADLESS_CHECK_REGION_EDITS 2000
+#define HEADLESS_CHECK_EDIT_MAP 300 // samples a side, not a whole number of leaf patches so the padding is edited too
+#define HEADLESS_CHECK_HEIGHTMAP_WIDTH 37 // not square and not a whole number of tiles
+#define HEADLESS_CHECK_HEIGHTMAP_HEIGHT 23
+
+static uint32_t check_rng_state = 0x2545F491u;
+
+static int headless_check_random(int min, int max)
+{
+  check_rng_state ^= check_rng_state << 13;
+  check_rng_state ^= check_rng_state >> 17;
+  check_rng_state ^= check_rng_state << 5;
+  return min + (int)(check_rng_state % (uint32_t)(max - min + 1));
+}
+
+// removes and re-adds an entity on one slot until its generation wraps, every handle issued on the way has to go stale
+// once its entity is gone. then fills every slot and expects the one past the last to be refused
+static bool headless_check_handles(void)
+{
+  game_entity_store_t entities = {0};
+  game_entity_create_t create = {
+      .scale = (Vector3){1.0f, 1.0f, 1.0f},
+      .dimensions = (Vector3){3, 6, 3},
+      .dimensions_offset = (Vector3){0, 3, 0},
+      .model_path = "../resources/robot.glb",
+      .model_anims_path = "../resources/robot.glb",
+      .hit_points = 100.f,
+      .type = GAME_ENT_TYPE_ACTOR};
+  bool is_ok = true;
+  // keeps the dense arrays from emptying, so the cycled entity always lands at index 1
+  game_entity_handle_t anchor = entity_add(&entities, &create);
+  game_entity_handle_t first = entity_add(&entities, &create);
+  game_entity_handle_t handle = first;
+  for (uint32_t i = 0; i < HEADLESS_CHECK_GENERATIONS && is_ok; i++)
+  {
+    game_entity_handle_t stale = handle;
+    entity_remove(&entities, stale);
+    handle = entity_add(&entities, &create);
+    if (GAME_ENTITY_HANDLE_SLOT(handle) != GAME_ENTITY_HANDLE_SLOT(first) || entity_resolve(&entities, handle) != 1)
+    {
+      TraceLog(LOG_ERROR, "CHECK: Re-added entity did not reuse slot %u at generation %u", GAME_ENTITY_HANDLE_SLOT(first),
+               GAME_ENTITY_HANDLE_GENERATION(handle));
+      is_ok = false;
+    }
+    // first comes back to life only once the generation wrapped all the way around
+    if (entity_resolve(&entities, stale) >= 0 || (handle != first && entity_resolve(&entities, first) >= 0))
+    {
+      TraceLog(LOG_ERROR, "CHECK: Stale handle %08x resolves at generation %u", stale, GAME_ENTITY_HANDLE_GENERATION(handle));
+      is_ok = false;
+    }
+    if (handle == GAME_ENTITY_HANDLE_NONE)
+    {
+      TraceLog(LOG_ERROR, "CHECK: Entity add returned GAME_ENTITY_HANDLE_NONE with free slots left");
+      is_ok = false;
+    }
+  }
+  if (is_ok && handle != first)
+  {
+    TraceLog(LOG_ERROR, "CHECK: Generation did not wrap back to %08x after %d removals, got %08x", first, HEADLESS_CHECK_GENERATIONS,
+             handle);
+    is_ok = false;
+  }
+  if (is_ok && entity_resolve(&entities, anchor) != 0)
+  {
+    TraceLog(LOG_ERROR, "CHECK: Anchor entity lost its handle");
+    is_ok = false;
+  }
+
+  while (is_ok && arrlenu(entities.slot_dense) < GAME_ENTITY_MAX_SLOTS)
+  {
+    if (entity_add(&entities, &create) == GAME_ENTITY_HANDLE_NONE)
+    {
+      TraceLog(LOG_ERROR, "CHECK: Entity add failed with %u of %d slots taken", (uint32_t)arrlenu(entities.slot_dense),
+               GAME_ENTITY_MAX_SLOTS);
+      is_ok = false;
+    }
+  }
+  if (is_ok)
+  {
+    // the refusal warns, which is what is being checked here
+    SetTraceLogLevel(LOG_ERROR);
+    game_entity_handle_t refused = entity_add(&entities, &create);
+    SetTraceLogLevel(LOG_WARNING);
+    if (refused != GAME_ENTITY_HANDLE_NONE || entities.count != GAME_ENTITY_MAX_SLOTS)
+    {
+      TraceLog(LOG_ERROR, "CHECK: Entity add past the last slot returned %08x", refused);
+      is_ok = false;
+    }
+  }
+  entity_unload_all(&entities);
+  return is_ok;
+}
+
+// equal costs, and regions that split the cells the same way, the ids themselves may differ
+static bool headless_check_same_grid(const game_path_grid_t *grid, const game_path_grid_t *expected)
+{
+  int cell_count = grid->cells_x * grid->cells_z;
+  if (grid->cells_x != expected->cells_x || grid->cells_z != expected->cells_z ||
+      memcmp(grid->cost, expected->cost, sizeof(*grid->cost) * cell_count) != 0)
+  {
+    TraceLog(LOG_ERROR, "CHECK: Path grid costs differ from a full build");
+    return false;
+  }
+  // region ids of each grid mapped to the other's, a mismatch either way is a merge or split the update got wrong
+  uint32_t *to_expected = RL_MALLOC(sizeof(*to_expected) * arrlenu(grid->region_parent));
+  uint32_t *from_expected = RL_MALLOC(sizeof(*from_expected) * arrlenu(expected->region_parent));
+  memset(to_expected, 0xFF, sizeof(*to_expected) * arrlenu(grid->region_parent));
+  memset(from_expected, 0xFF, sizeof(*from_expected) * arrlenu(expected->region_parent));
+  bool is_ok = true;
+  for (int cell = 0; cell < cell_count && is_ok; cell++)
+  {
+    uint32_t region = path_grid_region(grid, (uint32_t)cell);
+    uint32_t expected_region = path_grid_region(expected, (uint32_t)cell);
+    if (to_expected[region] == UINT32_MAX && from_expected[expected_region] == UINT32_MAX)
+    {
+      to_expected[region] = expected_region;
+      from_expected[expected_region] = region;
+    }
+    if (to_expected[region] != expected_region || from_expected[expected_region] != region)
+    {
+      TraceLog(LOG_ERROR, "CHECK: Region of cell (%d, %d) is %u, a full build puts it with the cells of region %u", cell % grid->cells_x,
+               cell / grid->cells_x, region, expected_region);
+      is_ok = false;
+    }
+  }
+  RL_FREE(from_expected);
+  RL_FREE(to_expected);
+  return is_ok;
+}
+
+// raises and lowers random blocks of a flat map so walls close off plateaus and open them up again, and compares the
+// regions path_grid_update keeps with a full build after every edit
+static bool headless_check_regions(void)
+{
+  game_terrain_map_t terrain_map;
+  if (!terrain_map_init(&terrain_map, HEADLESS_CHECK_REGION_MAP, HEADLESS_CHECK_REGION_MAP, GAME_TERRAIN_STORAGE_FLOAT32, 0.0f, 0.0f))
+  {
+    return false;
+  }
+  game_path_grid_t grid = {0};
+  game_path_grid_t expected = {0};
+  bool is_ok = path_grid_build(&grid, &terrain_map);
+  for (int edit = 0; edit < HEADLESS_CHECK_REGION_EDITS && is_ok; edit++)
+  {
+    // thin walls as often as blocks, and a level that is sometimes low enough to walk onto
+    game_terrain_rect_t rect;
+    rect.x0 = headless_check_random(0, HEADLESS_CHECK_REGION_MAP - 1);
+    rect.z0 = headless_check_random(0, HEADLESS_CHECK_REGION_MAP - 1);
+    bool is_thin = headless_check_random(0, 1) == 0;
+    rect.x1 = rect.x0 + headless_check_random(0, is_thin ? 0 : 12);
+    rect.z1 = rect.z0 + headless_check_random(0, is_thin ? 24 : 12);
+    if (headless_check_random(0, 1) == 0)
+    {
+      int swap = rect.x1 - rect.x0;
+      rect.x1 = rect.x0 + rect.z1 - rect.z0;
+      rect.z1 = rect.z0 + swap;
+    }
+    rect.x1 = rect.x1 < HEADLESS_CHECK_REGION_MAP - 1 ? rect.x1 : HEADLESS_CHECK_REGION_MAP - 1;
+    rect.z1 = rect.z1 < HEADLESS_CHECK_REGION_MAP - 1 ? rect.z1 : HEADLESS_CHECK_REGION_MAP - 1;
+    float height = (float)headless_check_random(0, 4) * 0.75f;
+    for (int z = rect.z0; z <= rect.z1; z++)
+    {
+      for (int x = rect.x0; x <= rect.x1; x++)
+      {
+        terrain_set_height(&terrain_map, x, z, height);
+      }
+    }
+    path_grid_update(&grid, &terrain_map, rect);
+    is_ok = path_grid_build(&expected, &terrain_map) && headless_check_same_grid(&grid, &expected);
+    if (!is_ok)
+    {
+      TraceLog(LOG_ERROR, "CHECK: After edit %d of samples (%d, %d) to (%d, %d)", edit, rect.x0, rect.z0, rect.x1, rect.z1);
+    }
+  }
+  path_grid_free(&expected);
+  path_grid_free(&grid);
+  terrain_map_unload(&terrain_map);
+  return is_ok;
+}
+
+// same node count, cells, borders and costs in every cluster
+static bool headless_check_same_clusters(const game_path_hpa_t *hpa, const game_path_hpa_t *expected)
+{
+  if (hpa->clusters_x != expected->clusters_x || hpa->clusters_z != expected->clusters_z)
+  {
+    TraceLog(LOG_ERROR, "CHECK: Cluster graph is %dx%d, a full build has %dx%d", hpa->clusters_x, hpa->clusters_z, expected->clusters_x,
+             expected->clusters_z);
+    return false;
+  }
+  for (int c = 0; c < hpa->clusters_x * hpa->clusters_z; c++)
+  {
+    const game_path_cluster_t *cluster = &hpa->clusters[c];
+    const game_path_cluster_t *expected_cluster = &expected->clusters[c];
+    int node_count = cluster->node_count;
+    // clusters without nodes have no costs array at all
+    if (node_count != expected_cluster->node_count ||
+        memcmp(cluster->nodes, expected_cluster->nodes, sizeof(*cluster->nodes) * node_count) != 0 ||
+        memcmp(cluster->sides, expected_cluster->sides, sizeof(*cluster->sides) * node_count) != 0 ||
+        (node_count > 0 && memcmp(cluster->costs, expected_cluster->costs, sizeof(*cluster->costs) * node_count * node_count) != 0))
+    {
+      TraceLog(LOG_ERROR, "CHECK: Cluster (%d, %d) differs from a full build", c % hpa->clusters_x, c / hpa->clusters_x);
+      return false;
+    }
+  }
+  return true;
+}
+
+// rolling hills steep enough that every edit changes normals, heights are a function of the sample so no two runs
+// differ
+static bool headless_check_hills(game_terrain_map_t *terrain_map, int size)
+{
+  if (!terrain_map_init(terrain_map, size, size, GAME_TERRAIN_STORAGE_FLOAT32, 0.0f, 0.0f))
+  {
+    return false;
+  }
+  for (int z = 0; z < size; z++)
+  {
+    for (int x = 0; x < size; x++)
+    {
+      float height = 20.0f + 12.0f * sinf((float)x * 0.07f) * cosf((float)z * 0.05f) + 6.0f * sinf((float)(x + z) * 0.13f);
+      terrain_set_height(terrain_map, x, z, height);
+    }
+  }
+  terrain_build_pyramid(terrain_map);
+  return true;
+}
+
+// edits a hilly map in the middle, into a corner, across the edges and on top of earlier edits, then lets the mesh,
+// pyramid, path grid and clusters catch up the way the game does and compares each with one built from scratch. node
+// errors only ever grow on an update, they have to cover the full build's instead of matching it
+static bool headless_check_terrain_edit(void)
+{
+  game_terrain_map_t terrain_map;
+  if (!headless_check_hills(&terrain_map, HEADLESS_CHECK_EDIT_MAP))
+  {
+    return false;
+  }
+  game_terrain_mesh_t terrain_mesh = {0};
+  uint32_t *indices = terrain_build_mesh(&terrain_mesh, &terrain_map);
+  arrfree(indices);
+  game_path_grid_t grid = {0};
+  game_path_hpa_t hpa = {0};
+  bool is_ok = path_grid_build(&grid, &terrain_map) && path_hpa_build(&hpa, &grid);
+
+  float half = HEADLESS_CHECK_EDIT_MAP / 2.0f;
+  terrain_edit_crater(&terrain_map, (Vector3){0.0f, 0.0f, 0.0f}, 10.0f, 4.0f);
+  terrain_edit_crater(&terrain_map, (Vector3){-half + 2.0f, 0.0f, -half + 2.0f}, 12.0f, 5.0f);
+  terrain_edit_flatten(&terrain_map, (Vector3){half - 3.0f, 0.0f, 20.0f}, 15.0f, 0.0f, 0.8f);
+  terrain_edit_pad(&terrain_map, (Vector3){-40.0f, 0.0f, half - 10.0f}, (Vector3){-10.0f, 0.0f, half + 5.0f}, 2.0f, 6.0f);
+  terrain_edit_crater(&terrain_map, (Vector3){3.0f, 0.0f, 2.0f}, 14.0f, 3.0f);
+  terrain_edit_crater(&terrain_map, (Vector3){half, 0.0f, half}, 30.0f, 40.0f);
+  // no margin, the walls of the block change the normals just outside the rect
+  terrain_edit_pad(&terrain_map, (Vector3){30.0f, 0.0f, -60.0f}, (Vector3){55.0f, 0.0f, -35.0f}, 12.0f, 0.0f);
+  terrain_edit_pad(&terrain_map, (Vector3){-half, 0.0f, 60.0f}, (Vector3){-half + 8.0f, 0.0f, 90.0f}, -6.0f, 0.0f);
+  for (ptrdiff_t i = 0; i < arrlen(terrain_map.dirty_rects); i++)
+  {
+    path_grid_update(&grid, &terrain_map, terrain_map.dirty_rects[i]);
+    path_hpa_update(&hpa, &grid, terrain_map.dirty_rects[i]);
+  }
+  terrain_update_mesh(&terrain_mesh, &terrain_map);
+
+  game_terrain_mesh_t full_mesh = {0};
+  indices = terrain_build_mesh(&full_mesh, &terrain_map);
+  arrfree(indices);
+  size_t vertex_size = sizeof(float) * 3 * terrain_mesh.mesh.vertexCount;
+  if (is_ok && (memcmp(terrain_mesh.mesh.vertices, full_mesh.mesh.vertices, vertex_size) != 0 ||
+                memcmp(terrain_mesh.mesh.normals, full_mesh.mesh.normals, vertex_size) != 0))
+  {
+    TraceLog(LOG_ERROR, "CHECK: Updated vertices differ from a full build");
+    is_ok = false;
+  }
+  for (int node = 0; node < terrain_mesh.node_count && is_ok; node++)
+  {
+    if (memcmp(&terrain_mesh.nodes[node].bounds, &full_mesh.nodes[node].bounds, sizeof(BoundingBox)) != 0 ||
+        terrain_mesh.nodes[node].error < full_mesh.nodes[node].error)
+    {
+      TraceLog(LOG_ERROR, "CHECK: Updated node %d has other bounds or a smaller error than a full build", node);
+      is_ok = false;
+    }
+  }
+
+  // the pyramid terrain_edit_* kept up to date, against one built from the edited samples
+  game_terrain_height_range_t *pyramid[TERRAIN_PYRAMID_MAX_LEVELS] = {0};
+  int levels = terrain_map.pyramid_levels;
+  for (int level = 0; level < levels; level++)
+  {
+    size_t size = sizeof(*pyramid[level]) * terrain_map.pyramid_width[level] * terrain_map.pyramid_height[level];
+    pyramid[level] = RL_MALLOC(size);
+    memcpy(pyramid[level], terrain_map.pyramid[level], size);
+  }
+  terrain_build_pyramid(&terrain_map);
+  for (int level = 0; level < levels; level++)
+  {
+    size_t size = sizeof(*pyramid[level]) * terrain_map.pyramid_width[level] * terrain_map.pyramid_height[level];
+    if (is_ok && (levels != terrain_map.pyramid_levels || memcmp(pyramid[level], terrain_map.pyramid[level], size) != 0))
+    {
+      TraceLog(LOG_ERROR, "CHECK: Updated pyramid level %d differs from a full build", level);
+      is_ok = false;
+    }
+    RL_FREE(pyramid[level]);
+  }
+
+  game_path_grid_t expected_grid = {0};
+  game_path_hpa_t expected_hpa = {0};
+  is_ok = is_ok && path_grid_build(&expected_grid, &terrain_map) && headless_check_same_grid(&grid, &expected_grid) &&
+          path_hpa_build(&expected_hpa, &expected_grid) && headless_check_same_clusters(&hpa, &expected_hpa);
+  path_hpa_free(&expected_hpa);
+  path_grid_free(&expected_grid);
+  path_hpa_free(&hpa);
+  path_grid_free(&grid);
+  terrain_unload(&full_mesh);
+  terrain_unload(&terrain_mesh);
+  terrain_map_unload(&terrain_map);
+  return is_ok;
+}
+
+static void headless_check_put(uint8_t **bytes, const void *data, size_t size)
+{
+  memcpy(arraddnptr(*bytes, size), data, size);
+}
+
+static void headless_check_put_be32(uint8_t **bytes, uint32_t value)
+{
+  uint8_t be[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+  headless_check_put(bytes, be, sizeof(be));
+}
+
+static uint32_t headless_check_crc32(const uint8_t *data, size_t size)
+{
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; i++)
+  {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = crc >> 1 ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
+
+static void headless_check_png_chunk(uint8_t **png, const char *type, const uint8_t *data, size_t size)
+{
+  headless_check_put_be32(png, (uint32_t)size);
+  size_t start = arrlenu(*png);
+  headless_check_put(png, type, 4);
+  if (size > 0)
+  {
+    headless_check_put(png, data, size);
+  }
+  headless_check_put_be32(png, headless_check_crc32(*png + start, size + 4));
+}
+
+// byte of row z as a 16 bit png stores it, samples are big endian
+static int headless_check_png_byte(const uint16_t *samples, int width, size_t byte, int z)
+{
+  uint16_t sample = samples[(size_t)z * width + byte / 2];
+  return byte % 2 == 0 ? sample >> 8 : sample & 0xFF;
+}
+
+// 16 bit greyscale png of samples with the same filter on every row. the zlib stream holds stored blocks and is split
+// over two IDAT chunks, so the loader has to join them before inflating
+static uint8_t *headless_check_png16(const uint16_t *samples, int width, int height, uint8_t filter)
+{
+  size_t row_size = (size_t)width * 2;
+  uint8_t *filtered = NULL;
+  for (int z = 0; z < height; z++)
+  {
+    arrput(filtered, filter);
+    for (size_t i = 0; i < row_size; i++)
+    {
+      // bytes outside the image are 0
+      int byte = headless_check_png_byte(samples, width, i, z);
+      int left = i >= 2 ? headless_check_png_byte(samples, width, i - 2, z) : 0;
+      int up = z > 0 ? headless_check_png_byte(samples, width, i, z - 1) : 0;
+      int up_left = i >= 2 && z > 0 ? headless_check_png_byte(samples, width, i - 2, z - 1) : 0;
+      int p = left + up - up_left;
+      int pa = abs(p - left), pb = abs(p - up), pc = abs(p - up_left);
+      int predictions[5] = {0, left, up, (left + up) / 2, pa <= pb && pa <= pc ? left : (pb <= pc ? up : up_left)};
+      arrput(filtered, (uint8_t)(byte - predictions[filter]));
+    }
+  }
+
+  uint8_t *zlib = NULL;
+  headless_check_put(&zlib, (uint8_t[]){0x78, 0x01}, 2);
+  size_t filtered_size = arrlenu(filtered);
+  for (size_t offset = 0; offset < filtered_size; offset += 0xFFFF)
+  {
+    size_t size = filtered_size - offset < 0xFFFF ? filtered_size - offset : 0xFFFF;
+    uint8_t block[5] = {offset + size == filtered_size, (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)~size, (uint8_t)(~size >> 8)};
+    headless_check_put(&zlib, block, sizeof(block));
+    headless_check_put(&zlib, filtered + offset, size);
+  }
+  uint32_t a = 1, b = 0;
+  for (size_t i = 0; i < filtered_size; i++)
+  {
+    a = (a + filtered[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  headless_check_put_be32(&zlib, b << 16 | a);
+  arrfree(filtered);
+
+  uint8_t *png = NULL;
+  headless_check_put(&png, (uint8_t[]){0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'}, 8);
+  uint8_t ihdr[13] = {0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0};
+  for (int i = 0; i < 4; i++)
+  {
+    ihdr[i] = (uint8_t)((uint32_t)width >> (24 - i * 8));
+    ihdr[4 + i] = (uint8_t)((uint32_t)height >> (24 - i * 8));
+  }
+  headless_check_png_chunk(&png, "IHDR", ihdr, sizeof(ihdr));
+  size_t half = arrlenu(zlib) / 2;
+  headless_check_png_chunk(&png, "IDAT", zlib, half);
+  headless_check_png_chunk(&png, "IDAT", zlib + half, arrlenu(zlib) - half);
+  headless_check_png_chunk(&png, "IEND", NULL, 0);
+  arrfree(zlib);
+  return png;
+}
+
+// saves a heightmap file, loads it back and compares every sample with the one it was written from, shifted down to
+// the file's depth. uint16 storage keeps 16 bit samples exactly, float storage the loader's height for each
+static bool headless_check_heightmap_file(const char *path, const uint8_t *bytes, const uint16_t *samples, int shift,
+                                          game_terrain_storage storage)
+{
+  game_terrain_map_t terrain_map;
+  game_terrain_heightmap_format format = terrain_heightmap_format(path);
+  bool is_raw = format == GAME_TERRAIN_HEIGHTMAP_RAW16 || format == GAME_TERRAIN_HEIGHTMAP_RAW32;
+  if (!SaveFileData(path, (void *)bytes, (int)arrlen(bytes)) ||
+      !(is_raw ? terrain_load_raw_heightmap(path, HEADLESS_CHECK_HEIGHTMAP_WIDTH, HEADLESS_CHECK_HEIGHTMAP_HEIGHT, format,
+                                            &terrain_map, storage)
+               : terrain_load_heightmap(path, &terrain_map, storage)))
+  {
+    TraceLog(LOG_ERROR, "CHECK: Failed to load %s", path);
+    return false;
+  }
+  bool is_ok = terrain_map.max_width == HEADLESS_CHECK_HEIGHTMAP_WIDTH && terrain_map.max_height == HEADLESS_CHECK_HEIGHTMAP_HEIGHT;
+  uint32_t max_value = UINT16_MAX >> shift;
+  for (int z = 0; z < HEADLESS_CHECK_HEIGHTMAP_HEIGHT && is_ok; z++)
+  {
+    for (int x = 0; x < HEADLESS_CHECK_HEIGHTMAP_WIDTH && is_ok; x++)
+    {
+      uint32_t value = (uint32_t)samples[z * HEADLESS_CHECK_HEIGHTMAP_WIDTH + x] >> shift;
+      is_ok = storage == GAME_TERRAIN_STORAGE_UINT16
+                ? terrain_map.value16[terrain_sample_index(&terrain_map, x, z)] == value
+                : terrain_get_height(&terrain_map, x, z) == (float)value * (TERRAIN_HEIGHT_RANGE / (float)max_value);
+      if (!is_ok)
+      {
+        TraceLog(LOG_ERROR, "CHECK: Sample (%d, %d) of %s differs from the one written", x, z, path);
+      }
+    }
+  }
+  terrain_map_unload(&terrain_map);
+  remove(path);
+  return is_ok;
+}
+
+// writes a map in every format terrain_load_heightmap reads, the png once with each row filter, and checks it comes
+// back sample for sample. a png raylib could not inflate in one go has to be refused from its header
+static bool headless_check_heightmap(void)
+{
+  enum
+  {
+    sample_count = HEADLESS_CHECK_HEIGHTMAP_WIDTH * HEADLESS_CHECK_HEIGHTMAP_HEIGHT
+  };
+  uint16_t samples[sample_count];
+  for (int i = 0; i < sample_count; i++)
+  {
+    samples[i] = (uint16_t)headless_check_random(0, UINT16_MAX);
+  }
+  samples[0] = 0;
+  samples[1] = UINT16_MAX;
+
+  game_terrain_storage f32 = GAME_TERRAIN_STORAGE_FLOAT32, u16 = GAME_TERRAIN_STORAGE_UINT16;
+  // none, sub, up, average and paeth
+  bool is_ok = true;
+  for (uint8_t filter = 0; filter < 5 && is_ok; filter++)
+  {
+    uint8_t *png = headless_check_png16(samples, HEADLESS_CHECK_HEIGHTMAP_WIDTH, HEADLESS_CHECK_HEIGHTMAP_HEIGHT, filter);
+    is_ok = headless_check_heightmap_file("check_heightmap.png", png, samples, 0, f32) &&
+            headless_check_heightmap_file("check_heightmap.png", png, samples, 0, u16);
+    arrfree(png);
+  }
+
+  uint8_t *pgm8 = NULL, *pgm16 = NULL, *r16 = NULL, *r32 = NULL;
+  char header[64];
+  int header_size = snprintf(header, sizeof(header), "P5\n# check\n%d %d\n255\n", HEADLESS_CHECK_HEIGHTMAP_WIDTH,
+                             HEADLESS_CHECK_HEIGHTMAP_HEIGHT);
+  headless_check_put(&pgm8, header, (size_t)header_size);
+  header_size = snprintf(header, sizeof(header), "P5 %d %d 65535\n", HEADLESS_CHECK_HEIGHTMAP_WIDTH, HEADLESS_CHECK_HEIGHTMAP_HEIGHT);
+  headless_check_put(&pgm16, header, (size_t)header_size);
+  for (int i = 0; i < sample_count; i++)
+  {
+    arrput(pgm8, (uint8_t)(samples[i] >> 8));
+    headless_check_put(&pgm16, (uint8_t[]){(uint8_t)(samples[i] >> 8), (uint8_t)samples[i]}, 2);
+    headless_check_put(&r16, (uint8_t[]){(uint8_t)samples[i], (uint8_t)(samples[i] >> 8)}, 2);
+    float height = (float)samples[i] * (TERRAIN_HEIGHT_RANGE / (float)UINT16_MAX);
+    uint32_t bits;
+    memcpy(&bits, &height, sizeof(bits));
+    headless_check_put(&r32, (uint8_t[]){(uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24)}, 4);
+  }
+  is_ok = is_ok && headless_check_heightmap_file("check_heightmap.pgm", pgm8, samples, 8, f32) &&
+          headless_check_heightmap_file("check_heightmap.pgm", pgm16, samples, 0, f32) &&
+          headless_check_heightmap_file("check_heightmap.pgm", pgm16, samples, 0, u16) &&
+          headless_check_heightmap_file("check_heightmap.r16", r16, samples, 0, f32) &&
+          headless_check_heightmap_file("check_heightmap.r16", r16, samples, 0, u16) &&
+          headless_check_heightmap_file("check_heightmap.r32", r32, samples, 0, f32);
+  arrfree(pgm8);
+  arrfree(pgm16);
+  arrfree(r16);
+  arrfree(r32);
+
+  // one sample more a side than the largest square png that fits the inflate buffer, only the header has to be valid
+  int side = 5793;
+  uint8_t *png = headless_check_png16(samples, HEADLESS_CHECK_HEIGHTMAP_WIDTH, HEADLESS_CHECK_HEIGHTMAP_HEIGHT, 0);
+  for (int i = 0; i < 4; i++)
+  {
+    png[16 + i] = png[20 + i] = (uint8_t)((uint32_t)side >> (24 - i * 8));
+  }
+  uint32_t crc = headless_check_crc32(png + 12, 17);
+  for (int i = 0; i < 4; i++)
+  {
+    png[29 + i] = (uint8_t)(crc >> (24 - i * 8));
+  }
+  game_terrain_map_t terrain_map;
+  if (is_ok && SaveFileData("check_heightmap.png", png, (int)arrlen(png)) &&
+      terrain_load_heightmap("check_heightmap.png", &terrain_map, GAME_TERRAIN_STORAGE_FLOAT32))
+  {
+    TraceLog(LOG_ERROR, "CHECK: A %dx%d png was loaded from a truncated stream", side, side);
+    terrain_map_unload(&terrain_map);
+    is_ok = false;
+  }
+  remove("check_heightmap.png");
+  arrfree(png);
+  return is_ok;
+}
+
+bool headless_check(const char *name)
+{
+  bool is_ok;
+  if (strcmp(name, "handles") == 0)
+  {
+    is_ok = headless_check_handles();
+  }
+  else if (strcmp(name, "regions") == 0)
+  {
+    is_ok = headless_check_regions();
+  }
+  else if (strcmp(name, "terrain_edit") == 0)
+  {
+    is_ok = headless_check_terrain_edit();
+  }
+  else if (strcmp(name, "heightmap") == 0)
+  {
+    is_ok = headless_check_heightmap();
+  }
+  else
+  {
+    TraceLog(LOG_ERROR, "CHECK: Unknown check %s", name);
+    return false;
+  }
+  printf("check %s: %s\n", name, is_ok ? "passed" : "FAILED");
+  return is_ok;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdbool.h>
+
+// self checks for my_demo_headless check <name>, run from the headless directory. each one logs what it found wrong and
+// returns false
+bool headless_check(const char *name);
@@ -0,0 +1,433 @@
+// Runs the simulation without a window or GL context for benchmarking and soak tests.
+// usage: my_demo_headless [ticks] [units] [workers] [f32|u16|stream|edit|burst] [map size] [seed] [fbm|ridged]
+//        my_demo_headless check handles|regions|terrain_edit|heightmap
+// a map size replaces discmap.BMP with a generated map of that many samples a side. edit digs a crater where every
+// order lands and reports a checksum of the terrain, its mesh and path grid after the last tick. burst sends every unit
+// on its own to a far corner of the map on the first tick and reports how many ticks the queued path requests take
+// reports ticks per second and average time spent in each phase of the tick
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "raylib.h"
+
+#include "assets.h"
+#include "camera.h"
+#include "headless_checks.h"
+#include "jobs.h"
+#include "path.h"
+#include "scene.h"
+#include "terrain.h"
+#include "terrain_edit.h"
+#include "terrain_heightmap.h"
+#include "terrain_noise.h"
+#include "terrain_stream.h"
+
+#define HEADLESS_SIM_DT (1.f / 60.f)
+#define HEADLESS_AI_DT 1.f           // matches the ai rate of the windowed game
+#define HEADLESS_ORDER_INTERVAL 30   // ticks between synthetic player orders
+#define HEADLESS_SPAWN_EXTENT 200.f  // units spawn in a square of this size around the map center
+#define HEADLESS_TILES_PATH "headless_terrain.tiles"
+#define HEADLESS_CRATER_RADIUS 6.f
+#define HEADLESS_CRATER_DEPTH 2.f
+#define HEADLESS_BURST_GOALS 8      // goals a burst picks from, neighbours sent to the same one can share a search
+#define HEADLESS_BURST_MARGIN 32.f  // burst goals keep this far from the map edge
+
+typedef enum
+{
+  PHASE_AI = 0,
+  PHASE_INPUT,
+  PHASE_UPDATE,
+  PHASE_EDIT,
+  PHASE_COUNT
+} headless_phase;
+
+static const char *phase_names[PHASE_COUNT] = {"ai", "input", "update", "edit"};
+
+static double headless_now(void)
+{
+  // GetTime needs a window, timespec_get is plain C11
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// own generator so runs are reproducible regardless of what raylib does with rand()
+static uint32_t rng_state = 0x9E3779B9u;
+
+static float headless_random(float min, float max)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return min + (max - min) * (float)(rng_state & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+// selects up to GAME_MAX_SELECTED living player units and queues a right click, alternating between open ground
+// and an enemy so both move and attack orders go through scene_process_input. returns where the click lands
+static Vector3 headless_queue_order(game_camera_t *camera, game_entity_store_t *entities, game_entity_handle_t selected[GAME_MAX_SELECTED], uint32_t order)
+{
+  if (entities->count == 0)
+  {
+    return (Vector3){0};
+  }
+  scene_remove_selected_all(selected);
+  uint32_t start = (uint32_t)headless_random(0.f, (float)entities->count);
+  for (uint32_t n = 0; n < entities->count; n++)
+  {
+    uint32_t i = (start + n) % entities->count;
+    if (entities->team[i] == GAME_TEAM_PLAYER && !(entities->state[i] & GAME_ENT_STATE_DEAD))
+    {
+      scene_add_selected(entities->handle[i], selected, true);
+    }
+  }
+
+  Vector3 target = (Vector3){headless_random(-HEADLESS_SPAWN_EXTENT, HEADLESS_SPAWN_EXTENT) / 2.f, 0.f,
+                             headless_random(-HEADLESS_SPAWN_EXTENT, HEADLESS_SPAWN_EXTENT) / 2.f};
+  if (order % 2 == 1)
+  {
+    for (uint32_t n = 0; n < entities->count; n++)
+    {
+      uint32_t i = (start + n) % entities->count;
+      if (entities->team[i] == GAME_TEAM_AI)
+      {
+        target = entities->position[i];
+        break;
+      }
+    }
+  }
+  // straight down from above the target, same path a mouse click takes
+  game_input_event_t event = {.event_type = RIGHT_CLICK,
+                              .mouse_ray = (Ray){.position = (Vector3){target.x, 100.f, target.z}, .direction = (Vector3){0.f, -1.f, 0.f}}};
+  arrput(camera->input_events, event);
+  return target;
+}
+
+// moves every unit one by one, the way single clicks would, to goals spread over the whole map. most are further than
+// PATH_HPA_MIN_DISTANCE and come back as cluster routes. returns the number of orders
+static uint32_t headless_order_burst(game_entity_store_t *entities, const game_terrain_map_t *terrain_map)
+{
+  Vector2 goals[HEADLESS_BURST_GOALS];
+  float half_x = terrain_map->max_width / 2.f - HEADLESS_BURST_MARGIN;
+  float half_z = terrain_map->max_height / 2.f - HEADLESS_BURST_MARGIN;
+  for (int i = 0; i < HEADLESS_BURST_GOALS; i++)
+  {
+    goals[i] = (Vector2){headless_random(-half_x, half_x), headless_random(-half_z, half_z)};
+  }
+  for (uint32_t i = 0; i < entities->count; i++)
+  {
+    int goal = (int)headless_random(0.f, HEADLESS_BURST_GOALS - 0.001f);
+    entity_set_moving(goals[goal], entities->handle[i], entities);
+  }
+  return entities->count;
+}
+
+static uint64_t headless_hash_bytes(uint64_t hash, const void *value, size_t size)
+{
+  const unsigned char *bytes = value;
+  for (size_t b = 0; b < size; b++)
+  {
+    hash = (hash ^ bytes[b]) * 1099511628211ull; // FNV-1a
+  }
+  return hash;
+}
+
+// waypoint arrays are hashed by what they hold, their addresses change from run to run
+static uint64_t headless_hash_waypoints(uint64_t hash, const void *value, size_t size)
+{
+  (void)size;
+  Vector2 *const *waypoints = value;
+  uint64_t count = arrlenu(*waypoints);
+  hash = headless_hash_bytes(hash, &count, sizeof count);
+  return count > 0 ? headless_hash_bytes(hash, *waypoints, sizeof(Vector2) * count) : hash;
+}
+
+// hashes every hot and warm field, equal checksums mean two runs ended in the same state
+static uint64_t headless_checksum(game_entity_store_t *entities)
+{
+  uint64_t hash = 14695981039346656037ull;
+#define HEADLESS_HASH_FIELD(type, name)                                                                      \
+  for (uint32_t i = 0; i < entities->count; i++)                                                             \
+  {                                                                                                          \
+    hash = _Generic(&entities->name[i], Vector2 **: headless_hash_waypoints, default: headless_hash_bytes)( \
+        hash, &entities->name[i], sizeof(type));                                                             \
+  }
+  GAME_ENTITY_HOT_FIELDS(HEADLESS_HASH_FIELD)
+  GAME_ENTITY_WARM_FIELDS(HEADLESS_HASH_FIELD)
+#undef HEADLESS_HASH_FIELD
+  return hash;
+}
+
+// hashes the heights, the mesh built from them and the costs and regions of the path grid
+static uint64_t headless_terrain_checksum(game_terrain_map_t *terrain_map, const game_terrain_mesh_t *terrain_mesh, const game_path_grid_t *path_grid)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (int z = 0; z < terrain_map->max_height; z++)
+  {
+    for (int x = 0; x < terrain_map->max_width; x++)
+    {
+      float height = terrain_get_height(terrain_map, x, z);
+      hash = headless_hash_bytes(hash, &height, sizeof height);
+    }
+  }
+  hash = headless_hash_bytes(hash, terrain_mesh->mesh.vertices, sizeof(float) * 3 * terrain_mesh->mesh.vertexCount);
+  hash = headless_hash_bytes(hash, terrain_mesh->mesh.normals, sizeof(float) * 3 * terrain_mesh->mesh.vertexCount);
+  hash = headless_hash_bytes(hash, terrain_mesh->nodes, sizeof(*terrain_mesh->nodes) * terrain_mesh->node_count);
+  for (uint32_t cell = 0; cell < (uint32_t)(path_grid->cells_x * path_grid->cells_z); cell++)
+  {
+    uint32_t region = path_grid_region(path_grid, cell);
+    hash = headless_hash_bytes(hash, &path_grid->cost[cell], sizeof(*path_grid->cost));
+    hash = headless_hash_bytes(hash, &region, sizeof region);
+  }
+  return hash;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t tick_count = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 10000;
+  uint32_t unit_count = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 400;
+  uint32_t worker_count = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 0;
+  game_terrain_storage storage = argc > 4 && strcmp(argv[4], "u16") == 0 ? GAME_TERRAIN_STORAGE_UINT16 : GAME_TERRAIN_STORAGE_FLOAT32;
+  unit_count = unit_count > UINT16_MAX ? UINT16_MAX : unit_count;
+
+  SetTraceLogLevel(LOG_WARNING);
+  SetRandomSeed(1);
+  jobs_init(worker_count);
+  asset_set_headless(true);
+  if (argc > 2 && strcmp(argv[1], "check") == 0)
+  {
+    bool is_ok = headless_check(argv[2]);
+    jobs_shutdown();
+    return is_ok ? 0 : 1;
+  }
+
+  int map_size = argc > 5 ? atoi(argv[5]) : 0;
+  game_terrain_map_t terrain_map = {0};
+  if (map_size > 0)
+  {
+    game_terrain_noise_kind kind = argc > 7 && strcmp(argv[7], "ridged") == 0 ? GAME_TERRAIN_NOISE_RIDGED : GAME_TERRAIN_NOISE_FBM;
+    game_terrain_noise_t noise = terrain_noise_default(kind, argc > 6 ? (uint32_t)strtoul(argv[6], NULL, 10) : 1);
+    double generate_start = headless_now();
+    if (!terrain_generate_heights(&terrain_map, map_size, map_size, storage, &noise))
+    {
+      TraceLog(LOG_ERROR, "HEADLESS: Failed to generate a %dx%d heightmap", map_size, map_size);
+      return 1;
+    }
+    printf("terrain: %dx%d generated in %.1f ms\n", map_size, map_size, (headless_now() - generate_start) * 1000.0);
+  }
+  else if (!terrain_load_heightmap("../resources/discmap.BMP", &terrain_map, storage))
+  {
+    TraceLog(LOG_ERROR, "HEADLESS: Failed to load heightmap, run from the build directory");
+    return 1;
+  }
+  // built before streaming replaces the heights, move orders path over it from the first tick
+  game_path_grid_t path_grid = {0};
+  double path_grid_start = headless_now();
+  if (!path_grid_build(&path_grid, &terrain_map))
+  {
+    return 1;
+  }
+  printf("path grid: %dx%d cells built in %.1f ms\n", path_grid.cells_x, path_grid.cells_z, (headless_now() - path_grid_start) * 1000.0);
+  game_path_hpa_t path_hpa = {0};
+  double path_hpa_start = headless_now();
+  path_hpa_build(&path_hpa, &path_grid);
+  printf("path clusters: %dx%d built in %.1f ms\n", path_hpa.clusters_x, path_hpa.clusters_z, (headless_now() - path_hpa_start) * 1000.0);
+  scene_set_path_grid(&path_grid, &path_hpa);
+  // edit runs keep the mesh on the cpu, terrain_update_mesh rewrites its arrays instead of gpu buffers
+  bool is_edited = argc > 4 && strcmp(argv[4], "edit") == 0;
+  game_terrain_mesh_t terrain_mesh = {0};
+  if (is_edited)
+  {
+    uint32_t *indices = terrain_build_mesh(&terrain_mesh, &terrain_map);
+    arrfree(indices);
+  }
+  // stream runs page tiles around the map center once and then hold still, so results match between runs
+  bool is_streamed = argc > 4 && strcmp(argv[4], "stream") == 0;
+  bool is_burst = argc > 4 && strcmp(argv[4], "burst") == 0;
+  game_terrain_map_t streamed_map = {0};
+  if (is_streamed)
+  {
+    uint64_t terrain_hash = terrain_stream_hash(&terrain_map);
+    if (!terrain_stream_open(HEADLESS_TILES_PATH, terrain_hash, TERRAIN_STREAM_RADIUS, &streamed_map) &&
+        !(terrain_stream_write(&terrain_map, HEADLESS_TILES_PATH) &&
+          terrain_stream_open(HEADLESS_TILES_PATH, terrain_hash, TERRAIN_STREAM_RADIUS, &streamed_map)))
+    {
+      TraceLog(LOG_ERROR, "HEADLESS: Failed to stream terrain from %s", HEADLESS_TILES_PATH);
+      return 1;
+    }
+    terrain_map_unload(&terrain_map);
+    terrain_map = streamed_map;
+    terrain_stream_update(&terrain_map, (Vector3){0});
+    terrain_stream_flush(&terrain_map);
+  }
+
+  game_entity_store_t entities = {0};
+  game_entity_create_t new_ent = (game_entity_create_t){
+      .scale = (Vector3){1.0f, 1.0f, 1.0f},
+      .offset_y = 0.0f,
+      .dimensions = (Vector3){3, 6, 3},
+      .dimensions_offset = (Vector3){0, 3, 0},
+      .model_path = "../resources/robot.glb",
+      .model_anims_path = "../resources/robot.glb",
+      .move_speed = 0.1f,
+      .attack_radius = 5.f,
+      .attack_damage = 25.f,
+      .attack_cooldown_max = 1.75f,
+      .hit_points = 100.f,
+      .type = GAME_ENT_TYPE_ACTOR};
+  for (uint32_t i = 0; i < unit_count; i++)
+  {
+    new_ent.team = (i % 2 == 0) ? GAME_TEAM_PLAYER : GAME_TEAM_AI;
+    new_ent.position = (Vector2){headless_random(-HEADLESS_SPAWN_EXTENT, HEADLESS_SPAWN_EXTENT) / 2.f,
+                                 headless_random(-HEADLESS_SPAWN_EXTENT, HEADLESS_SPAWN_EXTENT) / 2.f};
+    entity_add(&entities, &new_ent);
+  }
+  if (entities.count > 0 && (entities.asset[0] == NULL || entities.asset[0]->anims_count == 0))
+  {
+    TraceLog(LOG_ERROR, "HEADLESS: Failed to load animations for %s", new_ent.model_anims_path);
+    entity_unload_all(&entities);
+    path_hpa_free(&path_hpa);
+    path_grid_free(&path_grid);
+    return 1;
+  }
+
+  game_entity_handle_t selected[GAME_MAX_SELECTED];
+  memset(selected, -1, sizeof selected); // all bits set is GAME_ENTITY_HANDLE_NONE
+  game_camera_t camera = {0};
+  camera.near_plane = 0.1;
+  camera.far_plane = 1000.0;
+
+  double phase_time[PHASE_COUNT] = {0};
+  game_scene_stats_t stat_totals = {0};
+  uint32_t ai_runs = 0;
+  float ai_accumulator = 0.f;
+  double worst_tick_time = 0.0;
+  uint32_t worst_tick = 0;
+  uint32_t burst_orders = 0, burst_ticks = 0;
+  game_scene_stats_t burst_stats = {0};
+  double start_time = headless_now();
+  for (uint32_t tick = 0; tick < tick_count; tick++)
+  {
+    double t0 = headless_now();
+    ai_accumulator += HEADLESS_SIM_DT;
+    if (ai_accumulator >= HEADLESS_AI_DT)
+    {
+      scene_process_ai(&entities, &terrain_map);
+      ai_accumulator -= HEADLESS_AI_DT;
+      ai_runs++;
+    }
+    double t1 = headless_now();
+    if (tick % HEADLESS_ORDER_INTERVAL == 0)
+    {
+      Vector3 target = headless_queue_order(&camera, &entities, selected, tick / HEADLESS_ORDER_INTERVAL);
+      if (is_edited)
+      {
+        terrain_edit_crater(&terrain_map, target, HEADLESS_CRATER_RADIUS, HEADLESS_CRATER_DEPTH);
+      }
+    }
+    scene_process_input(&camera, &entities, &terrain_map, selected);
+    if (is_burst && tick == 0)
+    {
+      burst_orders = headless_order_burst(&entities, &terrain_map);
+    }
+    double t2 = headless_now();
+    scene_update_entities(&camera, &entities, &terrain_map, selected, HEADLESS_SIM_DT);
+    double t3 = headless_now();
+    // where the windowed game does it, before drawing. the grid and clusters read the dirty rects before the mesh
+    // clears them
+    for (ptrdiff_t i = 0; i < arrlen(terrain_map.dirty_rects); i++)
+    {
+      path_grid_update(&path_grid, &terrain_map, terrain_map.dirty_rects[i]);
+      path_hpa_update(&path_hpa, &path_grid, terrain_map.dirty_rects[i]);
+    }
+    terrain_update_mesh(&terrain_mesh, &terrain_map);
+    double t4 = headless_now();
+    phase_time[PHASE_AI] += t1 - t0;
+    phase_time[PHASE_INPUT] += t2 - t1;
+    phase_time[PHASE_UPDATE] += t3 - t2;
+    phase_time[PHASE_EDIT] += t4 - t3;
+    if (t4 - t0 > worst_tick_time)
+    {
+      worst_tick_time = t4 - t0;
+      worst_tick = tick;
+    }
+    const game_scene_stats_t *stats = scene_get_stats();
+    // the burst is answered once nothing is left waiting after a service
+    if (burst_orders > 0 && burst_ticks == 0)
+    {
+      burst_stats.path_requests += stats->path_requests;
+      burst_stats.path_requests_shared += stats->path_requests_shared;
+      burst_stats.path_routes += stats->path_routes;
+      burst_ticks = stats->path_requests_queued == 0 ? tick + 1 : 0;
+    }
+    stat_totals.avoid_queries += stats->avoid_queries;
+    stat_totals.avoid_neighbors += stats->avoid_neighbors;
+    stat_totals.avoid_overlaps += stats->avoid_overlaps;
+    stat_totals.avoid_crowded += stats->avoid_crowded;
+    stat_totals.path_queries += stats->path_queries;
+    stat_totals.path_cache_hits += stats->path_cache_hits;
+    stat_totals.path_nodes_expanded += stats->path_nodes_expanded;
+    stat_totals.flow_fields += stats->flow_fields;
+    stat_totals.flow_shared += stats->flow_shared;
+    stat_totals.flow_cells += stats->flow_cells;
+    stat_totals.path_requests += stats->path_requests;
+    stat_totals.path_requests_shared += stats->path_requests_shared;
+    stat_totals.path_requests_queued = stats->path_requests_queued > stat_totals.path_requests_queued ? stats->path_requests_queued
+                                                                                                     : stat_totals.path_requests_queued;
+    stat_totals.path_routes += stats->path_routes;
+    stat_totals.path_route_nodes += stats->path_route_nodes;
+    stat_totals.path_refined += stats->path_refined;
+  }
+  double total_time = headless_now() - start_time;
+
+  printf("ticks: %u, units: %u -> %u, workers: %u\n", tick_count, unit_count, entities.count, jobs_get_worker_count());
+  printf("total: %.3f s, %.1f ticks/s\n", total_time, total_time > 0.0 ? tick_count / total_time : 0.0);
+  printf("worst tick: %.3f ms (tick %u)\n", worst_tick_time * 1000.0, worst_tick);
+  printf("checksum: %016llx\n", (unsigned long long)headless_checksum(&entities));
+  if (is_edited)
+  {
+    printf("terrain checksum: %016llx\n", (unsigned long long)headless_terrain_checksum(&terrain_map, &terrain_mesh, &path_grid));
+  }
+  for (int phase = 0; phase < (is_edited ? PHASE_COUNT : PHASE_EDIT); phase++)
+  {
+    uint32_t runs = phase == PHASE_AI ? ai_runs : tick_count;
+    printf("%-6s: %10.3f ms total, %8.4f ms per run (%u runs)\n", phase_names[phase], phase_time[phase] * 1000.0,
+           runs > 0 ? phase_time[phase] * 1000.0 / runs : 0.0, runs);
+  }
+  printf("avoid : %u solves, %.1f neighbours per solve, %u overlapping, %u too crowded\n", stat_totals.avoid_queries,
+         stat_totals.avoid_queries > 0 ? (double)stat_totals.avoid_neighbors / stat_totals.avoid_queries : 0.0,
+         stat_totals.avoid_overlaps, stat_totals.avoid_crowded);
+  printf("paths : %u queries, %u cache hits, %.1f nodes expanded per search\n", stat_totals.path_queries, stat_totals.path_cache_hits,
+         stat_totals.path_queries > stat_totals.path_cache_hits
+             ? (double)stat_totals.path_nodes_expanded / (stat_totals.path_queries - stat_totals.path_cache_hits)
+             : 0.0);
+  printf("flows : %u built, %u shared, %.1f cells per field\n", stat_totals.flow_fields, stat_totals.flow_shared,
+         stat_totals.flow_fields > 0 ? (double)stat_totals.flow_cells / stat_totals.flow_fields : 0.0);
+  printf("requests: %u queued, %u shared, at most %u waiting after a tick\n", stat_totals.path_requests,
+         stat_totals.path_requests_shared, stat_totals.path_requests_queued);
+  printf("routes: %u searched, %.1f cluster nodes expanded per search, %u legs refined\n", stat_totals.path_routes,
+         stat_totals.path_routes > 0 ? (double)stat_totals.path_route_nodes / stat_totals.path_routes : 0.0,
+         stat_totals.path_refined);
+  if (is_burst)
+  {
+    printf("burst : %u orders, %u requests queued, %u shared, %u answered as routes, all answered %s %u ticks\n", burst_orders,
+           burst_stats.path_requests, burst_stats.path_requests_shared, burst_stats.path_routes, burst_ticks > 0 ? "after" : "not within",
+           burst_ticks > 0 ? burst_ticks : tick_count);
+  }
+
+  arrfree(camera.input_events);
+  entity_unload_all(&entities);
+  path_hpa_free(&path_hpa);
+  path_grid_free(&path_grid);
+  if (is_edited)
+  {
+    terrain_unload(&terrain_mesh);
+  }
+  terrain_map_unload(&terrain_map);
+  jobs_shutdown();
+  return 0;
+}
@@ -9,7 +9,7 @@ in vec3 fragNormal;
 
 // Input uniform values
 uniform sampler2D texture0; //diffuse
-uniform sampler2D texture1; // shadow map (baked)
+uniform sampler2D texture1; // baked lightmap, r is sun visibility and a is sky visibility
 uniform sampler2D texture2; // shadow map (dynamic)
 
 uniform vec3 viewPos; // camera position
@@ -44,13 +44,13 @@ void main()
 {
     // Texel color fetching from texture sampler
     vec3 texelColor = texture(texture0, fragTexCoord).rgb;
-    vec3 shadowColor = texture(texture1, fragTexCoord).rgb;
+    vec4 baked = texture(texture1, fragTexCoord);
 
     //const float shadow = 1.0;
     vec3 normal = normalize(fragNormal);
     vec3 lightColor = vec3(0.3);
     // ambient
-    vec3 ambient = 0.3 * lightColor;
+    vec3 ambient = 0.3 * lightColor * baked.a;
     // diffuse
     vec3 lightDir = normalize(lightPos - fragPosition);
     float diff = max(dot(lightDir, normal), 0.0);
@@ -63,8 +63,9 @@ void main()
     spec = pow(max(dot(normal, halfwayDir), 0.0), 22.0);
     vec3 specular = spec * lightColor;    
     // calculate shadow
-    float shadow = ShadowCalculation(fragPositionLightSpace, lightDir, normal);
-    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * texelColor;// * shadowColor;
+    // units cast into the dynamic map, the terrain itself into the baked one
+    float shadow = max(ShadowCalculation(fragPositionLightSpace, lightDir, normal), 1.0 - baked.r);
+    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * texelColor;
     
     finalColor = vec4(lighting, 1.0);
 }
@@ -0,0 +1,89 @@
+#include "assets.h"
+
+#include <string.h>
+#include "stb_ds.h"
+
+#include "models.h"
+
+// keyed by model path, values are heap allocated so pointers held by entities stay valid when the map grows
+static struct
+{
+  char *key;
+  game_asset_t *value;
+} *asset_cache = NULL;
+
+// without a GL context only animations are loaded, the simulation needs their frame counts but never draws
+static bool asset_is_headless = false;
+
+void asset_set_headless(bool is_headless)
+{
+  asset_is_headless = is_headless;
+}
+
+game_asset_t *asset_acquire(const char *model_path, const char *anims_path)
+{
+  if (asset_cache == NULL)
+  {
+    sh_new_strdup(asset_cache);
+  }
+  game_asset_t *asset = shget(asset_cache, model_path);
+  if (asset)
+  {
+    asset->ref_count++;
+    return asset;
+  }
+
+  asset = RL_CALLOC(1, sizeof(*asset));
+  if (!asset)
+  {
+    TraceLog(LOG_ERROR, "ASSET: [%s] Failed to allocate asset memory", model_path);
+    return NULL;
+  }
+  if (!asset_is_headless)
+  {
+    asset->model = entity_load_model(model_path);
+  }
+  asset->anims = LoadModelAnimations(anims_path, &asset->anims_count);
+  asset->ref_count = 1;
+  shput(asset_cache, model_path, asset);
+  TraceLog(LOG_INFO, "ASSET: [%s] Loaded into cache with %i animations", model_path, asset->anims_count);
+  return asset;
+}
+
+void asset_release(game_asset_t *asset)
+{
+  if (!asset || --asset->ref_count > 0)
+  {
+    return;
+  }
+  for (int i = 0; i < shlen(asset_cache); i++)
+  {
+    if (asset_cache[i].value == asset)
+    {
+      TraceLog(LOG_INFO, "ASSET: [%s] Unloaded from cache", asset_cache[i].key);
+      shdel(asset_cache, asset_cache[i].key);
+      break;
+    }
+  }
+  if (!asset_is_headless)
+  {
+    UnloadModel(asset->model);
+  }
+  UnloadModelAnimations(asset->anims, asset->anims_count);
+  RL_FREE(asset);
+  if (shlen(asset_cache) == 0)
+  {
+    shfree(asset_cache);
+  }
+}
+
+Model asset_pose(game_asset_t *asset, uint8_t anim_index, uint32_t anim_frame, Matrix transform)
+{
+  Model model = asset->model;
+  if (anim_index < asset->anims_count)
+  {
+    UpdateModelAnimation(model, asset->anims[anim_index], anim_frame);
+  }
+  model.transform = transform;
+  return model;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "raylib.h"
+
+// shared model + animation set, loaded once per model path and handed out to every entity using it
+typedef struct game_asset_t
+{
+  Model model;
+  ModelAnimation *anims;
+  int32_t anims_count;
+  int32_t ref_count;
+} game_asset_t;
+
+// skips loading models for every following asset_acquire, call before any entity is added when running without a window
+void asset_set_headless(bool is_headless);
+
+// returns the cached asset for model_path, loading the model and animations on first use
+game_asset_t *asset_acquire(const char *model_path, const char *anims_path);
+
+// drops one reference, the asset is unloaded once nothing refers to it anymore
+void asset_release(game_asset_t *asset);
+
+// poses the shared meshes for a single entity, must be called right before drawing since every user shares the same buffers
+Model asset_pose(game_asset_t *asset, uint8_t anim_index, uint32_t anim_frame, Matrix transform);
@@ -0,0 +1,207 @@
+#include "avoid.h"
+
+#include <math.h>
+
+#include "raymath.h"
+
+#define AVOID_EPSILON 0.00001f
+
+static float avoid_det(Vector2 a, Vector2 b)
+{
+  return a.x * b.y - a.y * b.x;
+}
+
+game_avoid_line_t avoid_line(Vector2 relative_position, Vector2 velocity, Vector2 other_velocity, float combined_radius, float horizon,
+                             float responsibility, Vector2 apart)
+{
+  Vector2 relative_velocity = Vector2Subtract(velocity, other_velocity);
+  float dist_sq = Vector2LengthSqr(relative_position);
+  float combined_radius_sq = combined_radius * combined_radius;
+  game_avoid_line_t line;
+  Vector2 u;
+  if (dist_sq > combined_radius_sq)
+  {
+    // the cone of velocities that collide within horizon, cut off by a disc around relative_position / horizon.
+    // w points from the center of that disc to the current relative velocity
+    float inv_horizon = 1.0f / horizon;
+    Vector2 w = Vector2Subtract(relative_velocity, Vector2Scale(relative_position, inv_horizon));
+    float w_length_sq = Vector2LengthSqr(w);
+    float dot = Vector2DotProduct(w, relative_position);
+    if (dot < 0.0f && dot * dot > combined_radius_sq * w_length_sq)
+    {
+      // closest to the cut off disc
+      float w_length = sqrtf(w_length_sq);
+      Vector2 unit_w = Vector2Scale(w, 1.0f / w_length);
+      line.direction = (Vector2){unit_w.y, -unit_w.x};
+      u = Vector2Scale(unit_w, combined_radius * inv_horizon - w_length);
+    }
+    else
+    {
+      // closest to one of the legs of the cone
+      float leg = sqrtf(dist_sq - combined_radius_sq);
+      if (avoid_det(relative_position, w) > 0.0f)
+      {
+        line.direction = Vector2Scale((Vector2){relative_position.x * leg - relative_position.y * combined_radius,
+                                                relative_position.x * combined_radius + relative_position.y * leg},
+                                      1.0f / dist_sq);
+      }
+      else
+      {
+        line.direction = Vector2Scale((Vector2){relative_position.x * leg + relative_position.y * combined_radius,
+                                                -relative_position.x * combined_radius + relative_position.y * leg},
+                                      -1.0f / dist_sq);
+      }
+      u = Vector2Subtract(Vector2Scale(line.direction, Vector2DotProduct(relative_velocity, line.direction)), relative_velocity);
+    }
+  }
+  else
+  {
+    // already overlapping, the cut off disc is the overlap itself and has to be left within the next tick
+    Vector2 w = Vector2Subtract(relative_velocity, relative_position);
+    float w_length = Vector2Length(w);
+    Vector2 unit_w = w_length > AVOID_EPSILON ? Vector2Scale(w, 1.0f / w_length) : apart;
+    line.direction = (Vector2){unit_w.y, -unit_w.x};
+    u = Vector2Scale(unit_w, combined_radius - w_length);
+  }
+  line.point = Vector2Add(velocity, Vector2Scale(u, responsibility));
+  return line;
+}
+
+// optimizes along line line_index within the speed disc and every line before it. with is_direction the result is
+// the point furthest along target, otherwise the one closest to it
+static bool avoid_solve_line(const game_avoid_line_t *lines, int line_index, float max_speed, Vector2 target, bool is_direction,
+                             Vector2 *result)
+{
+  const game_avoid_line_t *line = &lines[line_index];
+  float dot = Vector2DotProduct(line->point, line->direction);
+  float discriminant = dot * dot + max_speed * max_speed - Vector2LengthSqr(line->point);
+  if (discriminant < 0.0f)
+  {
+    // the speed disc misses the line entirely
+    return false;
+  }
+  float sqrt_discriminant = sqrtf(discriminant);
+  float t_left = -dot - sqrt_discriminant;
+  float t_right = -dot + sqrt_discriminant;
+  for (int i = 0; i < line_index; i++)
+  {
+    float denominator = avoid_det(line->direction, lines[i].direction);
+    float numerator = avoid_det(lines[i].direction, Vector2Subtract(line->point, lines[i].point));
+    if (fabsf(denominator) <= AVOID_EPSILON)
+    {
+      // parallel, either all of this line is allowed by the other one or none of it
+      if (numerator < 0.0f)
+      {
+        return false;
+      }
+      continue;
+    }
+    float t = numerator / denominator;
+    if (denominator >= 0.0f)
+    {
+      t_right = fminf(t_right, t);
+    }
+    else
+    {
+      t_left = fmaxf(t_left, t);
+    }
+    if (t_left > t_right)
+    {
+      return false;
+    }
+  }
+  float t;
+  if (is_direction)
+  {
+    t = Vector2DotProduct(target, line->direction) > 0.0f ? t_right : t_left;
+  }
+  else
+  {
+    t = Clamp(Vector2DotProduct(line->direction, Vector2Subtract(target, line->point)), t_left, t_right);
+  }
+  *result = Vector2Add(line->point, Vector2Scale(line->direction, t));
+  return true;
+}
+
+// incremental 2D linear program, returns the index of the first line it could not satisfy or line_count
+static int avoid_solve_lines(const game_avoid_line_t *lines, int line_count, float max_speed, Vector2 target, bool is_direction,
+                             Vector2 *result)
+{
+  if (is_direction)
+  {
+    *result = Vector2Scale(target, max_speed);
+  }
+  else if (Vector2LengthSqr(target) > max_speed * max_speed)
+  {
+    *result = Vector2Scale(Vector2Normalize(target), max_speed);
+  }
+  else
+  {
+    *result = target;
+  }
+  for (int i = 0; i < line_count; i++)
+  {
+    if (avoid_det(lines[i].direction, Vector2Subtract(lines[i].point, *result)) > 0.0f)
+    {
+      // the result so far is on the wrong side, the new one lies on this line
+      Vector2 previous = *result;
+      if (!avoid_solve_line(lines, i, max_speed, target, is_direction, result))
+      {
+        *result = previous;
+        return i;
+      }
+    }
+  }
+  return line_count;
+}
+
+bool avoid_solve(const game_avoid_line_t *lines, int line_count, float max_speed, Vector2 preferred, Vector2 *out_velocity)
+{
+  int failed = avoid_solve_lines(lines, line_count, max_speed, preferred, false, out_velocity);
+  if (failed == line_count)
+  {
+    return true;
+  }
+  // too crowded to keep every neighbour clear, minimize the largest violation instead: a 3D program projected on each
+  // line that is violated more than the ones before it
+  float distance = 0.0f;
+  game_avoid_line_t projected[AVOID_MAX_NEIGHBORS];
+  for (int i = failed; i < line_count; i++)
+  {
+    if (avoid_det(lines[i].direction, Vector2Subtract(lines[i].point, *out_velocity)) <= distance)
+    {
+      continue;
+    }
+    int projected_count = 0;
+    for (int j = 0; j < i && projected_count < AVOID_MAX_NEIGHBORS; j++)
+    {
+      game_avoid_line_t line;
+      float determinant = avoid_det(lines[i].direction, lines[j].direction);
+      if (fabsf(determinant) <= AVOID_EPSILON)
+      {
+        if (Vector2DotProduct(lines[i].direction, lines[j].direction) > 0.0f)
+        {
+          // same direction, line j never binds more than line i
+          continue;
+        }
+        line.point = Vector2Scale(Vector2Add(lines[i].point, lines[j].point), 0.5f);
+      }
+      else
+      {
+        float t = avoid_det(lines[j].direction, Vector2Subtract(lines[i].point, lines[j].point)) / determinant;
+        line.point = Vector2Add(lines[i].point, Vector2Scale(lines[i].direction, t));
+      }
+      line.direction = Vector2Normalize(Vector2Subtract(lines[j].direction, lines[i].direction));
+      projected[projected_count++] = line;
+    }
+    Vector2 previous = *out_velocity;
+    if (avoid_solve_lines(projected, projected_count, max_speed, (Vector2){-lines[i].direction.y, lines[i].direction.x}, true,
+                          out_velocity) < projected_count)
+    {
+      // can only fail from rounding, the previous result is the best there is
+      *out_velocity = previous;
+    }
+    distance = avoid_det(lines[i].direction, Vector2Subtract(lines[i].point, *out_velocity));
+  }
+  return false;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "raylib.h"
+
+// optimal reciprocal collision avoidance on the XZ plane. every neighbour turns into a half plane of velocities that
+// keep both discs apart for a while, a unit takes the allowed velocity closest to the one it wants. velocities are in
+// world units per tick, the same as move_speed
+#define AVOID_MAX_NEIGHBORS 10 // closest neighbours a unit avoids, the cost of a solve never depends on the crowd beyond them
+
+// velocities on the left of direction, seen from point, are allowed. direction is unit length
+typedef struct game_avoid_line_t
+{
+  Vector2 point;
+  Vector2 direction;
+} game_avoid_line_t;
+
+// half plane keeping a disc at the origin moving at velocity clear of one at relative_position moving at
+// other_velocity for horizon ticks. responsibility is the share of the avoidance this side takes, 0.5 when the
+// other one avoids too and 1 when it holds still. discs that already overlap are pushed apart within one tick, along
+// apart when they sit exactly on top of each other
+game_avoid_line_t avoid_line(Vector2 relative_position, Vector2 velocity, Vector2 other_velocity, float combined_radius, float horizon,
+                             float responsibility, Vector2 apart);
+
+// closest velocity to preferred no faster than max_speed that every line allows. when the lines leave no such
+// velocity the one violating them least is taken. returns false in that case
+bool avoid_solve(const game_avoid_line_t *lines, int line_count, float max_speed, Vector2 preferred, Vector2 *out_velocity);
@@ -0,0 +1,234 @@
+#include "bvh.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "stb_ds.h"
+
+#include "raymath.h"
+
+#define BVH_LEAF_SIZE 4
+#define BVH_MAX_DEPTH 64
+// rebuild once refitted nodes cover this much more area than the freshly built tree did
+#define BVH_REBUILD_AREA_RATIO 2.0f
+
+static float bvh_box_area(BoundingBox box)
+{
+  Vector3 size = Vector3Subtract(box.max, box.min);
+  return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static BoundingBox bvh_box_merge(BoundingBox a, BoundingBox b)
+{
+  return (BoundingBox){Vector3Min(a.min, b.min), Vector3Max(a.max, b.max)};
+}
+
+static float bvh_box_centroid(BoundingBox box, int axis)
+{
+  switch (axis)
+  {
+    case 0: return box.min.x + box.max.x;
+    case 1: return box.min.y + box.max.y;
+    default: return box.min.z + box.max.z;
+  }
+}
+
+// quickselect so items[first + count / 2] holds the median centroid along axis
+static void bvh_partition_median(uint32_t *items, uint32_t count, const BoundingBox *boxes, int axis)
+{
+  uint32_t left = 0, right = count - 1, nth = count / 2;
+  while (left < right)
+  {
+    float pivot = bvh_box_centroid(boxes[items[(left + right) / 2]], axis);
+    uint32_t i = left, j = right;
+    while (i <= j)
+    {
+      while (bvh_box_centroid(boxes[items[i]], axis) < pivot) i++;
+      while (bvh_box_centroid(boxes[items[j]], axis) > pivot) j--;
+      if (i <= j)
+      {
+        uint32_t temp = items[i];
+        items[i] = items[j];
+        items[j] = temp;
+        i++;
+        if (j == 0) break;
+        j--;
+      }
+    }
+    if (nth <= j) right = j;
+    else if (nth >= i) left = i;
+    else break;
+  }
+}
+
+static void bvh_build_node(game_bvh_t *bvh, uint32_t node_index, uint32_t first, uint32_t count, const BoundingBox *boxes)
+{
+  BoundingBox bounds = boxes[bvh->items[first]];
+  Vector3 centroid_min = Vector3Scale(Vector3Add(bounds.min, bounds.max), 0.5f);
+  Vector3 centroid_max = centroid_min;
+  for (uint32_t i = first + 1; i < first + count; i++)
+  {
+    BoundingBox box = boxes[bvh->items[i]];
+    Vector3 centroid = Vector3Scale(Vector3Add(box.min, box.max), 0.5f);
+    bounds = bvh_box_merge(bounds, box);
+    centroid_min = Vector3Min(centroid_min, centroid);
+    centroid_max = Vector3Max(centroid_max, centroid);
+  }
+  bvh->nodes[node_index].bounds = bounds;
+  bvh->built_area += bvh_box_area(bounds);
+
+  Vector3 extent = Vector3Subtract(centroid_max, centroid_min);
+  if (count <= BVH_LEAF_SIZE || (extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f))
+  {
+    bvh->nodes[node_index].first = first;
+    bvh->nodes[node_index].count = count;
+    return;
+  }
+
+  int axis = 0;
+  if (extent.y > extent.x) axis = 1;
+  if (extent.z > (axis == 0 ? extent.x : extent.y)) axis = 2;
+  bvh_partition_median(&bvh->items[first], count, boxes, axis);
+
+  uint32_t left = bvh->node_count;
+  bvh->node_count += 2;
+  bvh->nodes[node_index].first = left;
+  bvh->nodes[node_index].count = 0;
+  uint32_t left_count = count / 2;
+  bvh_build_node(bvh, left, first, left_count, boxes);
+  bvh_build_node(bvh, left + 1, first + left_count, count - left_count, boxes);
+}
+
+void bvh_build(game_bvh_t *bvh, const BoundingBox *boxes, uint32_t count)
+{
+  bvh->item_count = count;
+  bvh->node_count = 0;
+  bvh->built_area = 0.0f;
+  bvh->refit_area = 0.0f;
+  if (count == 0)
+  {
+    return;
+  }
+  arrsetlen(bvh->items, count);
+  arrsetlen(bvh->nodes, count * 2); // a binary tree with at most count leaves
+  for (uint32_t i = 0; i < count; i++)
+  {
+    bvh->items[i] = i;
+  }
+  bvh->node_count = 1;
+  bvh_build_node(bvh, 0, 0, count, boxes);
+  bvh->refit_area = bvh->built_area;
+}
+
+void bvh_refit(game_bvh_t *bvh, const BoundingBox *boxes)
+{
+  bvh->refit_area = 0.0f;
+  for (uint32_t n = bvh->node_count; n-- > 0;)
+  {
+    game_bvh_node_t *node = &bvh->nodes[n];
+    if (node->count > 0)
+    {
+      BoundingBox bounds = boxes[bvh->items[node->first]];
+      for (uint32_t i = node->first + 1; i < node->first + node->count; i++)
+      {
+        bounds = bvh_box_merge(bounds, boxes[bvh->items[i]]);
+      }
+      node->bounds = bounds;
+    }
+    else
+    {
+      node->bounds = bvh_box_merge(bvh->nodes[node->first].bounds, bvh->nodes[node->first + 1].bounds);
+    }
+    bvh->refit_area += bvh_box_area(node->bounds);
+  }
+}
+
+bool bvh_needs_rebuild(const game_bvh_t *bvh, uint32_t count)
+{
+  return bvh->item_count != count || bvh->refit_area > bvh->built_area * BVH_REBUILD_AREA_RATIO;
+}
+
+void bvh_free(game_bvh_t *bvh)
+{
+  arrfree(bvh->nodes);
+  arrfree(bvh->items);
+  memset(bvh, 0, sizeof *bvh);
+}
+
+// slab test, returns the entry distance or FLT_MAX on a miss. rays starting inside the box hit at 0
+static float bvh_ray_box(Vector3 origin, Vector3 inv_dir, BoundingBox box, float max_distance)
+{
+  float t1 = (box.min.x - origin.x) * inv_dir.x;
+  float t2 = (box.max.x - origin.x) * inv_dir.x;
+  float t_min = fminf(t1, t2), t_max = fmaxf(t1, t2);
+  t1 = (box.min.y - origin.y) * inv_dir.y;
+  t2 = (box.max.y - origin.y) * inv_dir.y;
+  t_min = fmaxf(t_min, fminf(t1, t2));
+  t_max = fminf(t_max, fmaxf(t1, t2));
+  t1 = (box.min.z - origin.z) * inv_dir.z;
+  t2 = (box.max.z - origin.z) * inv_dir.z;
+  t_min = fmaxf(t_min, fminf(t1, t2));
+  t_max = fminf(t_max, fmaxf(t1, t2));
+  t_min = fmaxf(t_min, 0.0f);
+  return (t_max >= t_min && t_min < max_distance) ? t_min : FLT_MAX;
+}
+
+game_bvh_hit_t bvh_raycast(const game_bvh_t *bvh, const BoundingBox *boxes, Ray ray)
+{
+  game_bvh_hit_t result = {.hit = false, .item = 0, .distance = FLT_MAX};
+  if (bvh->node_count == 0)
+  {
+    return result;
+  }
+  // distances are along the normalized direction, matching GetRayCollisionBox
+  Vector3 dir = Vector3Normalize(ray.direction);
+  Vector3 inv_dir = (Vector3){1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z};
+
+  uint32_t stack[BVH_MAX_DEPTH * 2];
+  int stack_size = 0;
+  if (bvh_ray_box(ray.position, inv_dir, bvh->nodes[0].bounds, FLT_MAX) == FLT_MAX)
+  {
+    return result;
+  }
+  stack[stack_size++] = 0;
+  while (stack_size > 0)
+  {
+    const game_bvh_node_t *node = &bvh->nodes[stack[--stack_size]];
+    if (node->count > 0)
+    {
+      for (uint32_t i = node->first; i < node->first + node->count; i++)
+      {
+        float t = bvh_ray_box(ray.position, inv_dir, boxes[bvh->items[i]], result.distance);
+        if (t < result.distance)
+        {
+          result = (game_bvh_hit_t){.hit = true, .item = bvh->items[i], .distance = t};
+        }
+      }
+      continue;
+    }
+    uint32_t near = node->first, far = node->first + 1;
+    float t_near = bvh_ray_box(ray.position, inv_dir, bvh->nodes[near].bounds, result.distance);
+    float t_far = bvh_ray_box(ray.position, inv_dir, bvh->nodes[far].bounds, result.distance);
+    if (t_far < t_near)
+    {
+      uint32_t temp = near;
+      near = far;
+      far = temp;
+      float temp_t = t_near;
+      t_near = t_far;
+      t_far = temp_t;
+    }
+    // push the far child first so the near one is popped next, misses were already culled against the best hit
+    if (t_far != FLT_MAX && stack_size < BVH_MAX_DEPTH * 2) stack[stack_size++] = far;
+    if (t_near != FLT_MAX && stack_size < BVH_MAX_DEPTH * 2) stack[stack_size++] = near;
+  }
+  return result;
+}
+
+void bvh_raycast_batch(const game_bvh_t *bvh, const BoundingBox *boxes, const Ray *rays, uint32_t ray_count, game_bvh_hit_t *out_hits)
+{
+  for (uint32_t i = 0; i < ray_count; i++)
+  {
+    out_hits[i] = bvh_raycast(bvh, boxes, rays[i]);
+  }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "raylib.h"
+
+// bounding volume hierarchy over an array of boxes, items are indices into that array.
+// built once, then refit every tick while the number of boxes stays the same
+typedef struct game_bvh_node_t
+{
+  BoundingBox bounds;
+  uint32_t first;  // leaf: first slot in bvh->items, internal: index of the left child (right child is first + 1)
+  uint32_t count;  // number of items in a leaf, 0 for internal nodes
+} game_bvh_node_t;
+
+typedef struct game_bvh_t
+{
+  game_bvh_node_t *nodes; // children always come after their parent, so refitting walks the array backwards
+  uint32_t *items;
+  uint32_t node_count;
+  uint32_t item_count;
+  float built_area;       // summed node surface area right after the last build, used to detect a degraded tree
+  float refit_area;
+} game_bvh_t;
+
+typedef struct game_bvh_hit_t
+{
+  bool hit;
+  uint32_t item;
+  float distance;
+} game_bvh_hit_t;
+
+// median split on the longest centroid axis
+void bvh_build(game_bvh_t *bvh, const BoundingBox *boxes, uint32_t count);
+
+// updates node bounds bottom up for moved boxes, topology is kept
+void bvh_refit(game_bvh_t *bvh, const BoundingBox *boxes);
+
+// true once refitting has loosened the tree enough that a rebuild is cheaper than traversing it
+bool bvh_needs_rebuild(const game_bvh_t *bvh, uint32_t count);
+
+void bvh_free(game_bvh_t *bvh);
+
+// closest box hit along the ray, children are visited near first and skipped once they start past the best hit
+game_bvh_hit_t bvh_raycast(const game_bvh_t *bvh, const BoundingBox *boxes, Ray ray);
+
+// same as bvh_raycast for several rays against the same tree
+void bvh_raycast_batch(const game_bvh_t *bvh, const BoundingBox *boxes, const Ray *rays, uint32_t ray_count, game_bvh_hit_t *out_hits);
@@ -344,6 +344,23 @@ void game_camera_update(game_camera_t *camera, game_terrain_map_t *terrain_map)
   camera->click_timer -= dt;
 }
 
+// same projection rlFrustum/rlOrtho would build, kept in one place so culling sees exactly what gets drawn
+static Matrix game_camera_get_projection(game_camera_t *camera, float aspect)
+{
+  if (camera->ray_view_cam.projection == CAMERA_ORTHOGRAPHIC)
+  {
+    double top = camera->ray_view_cam.fovy / 2.0;
+    double right = top * aspect;
+
+    return MatrixOrtho(-right, right, -top, top, camera->near_plane, camera->far_plane);
+  }
+  double top =
+      RL_CULL_DISTANCE_NEAR * tan(camera->ray_view_cam.fovy * 0.5 * DEG2RAD);
+  double right = top * aspect;
+
+  return MatrixFrustum(-right, right, -top, top, camera->near_plane, camera->far_plane);
+}
+
 static void game_camera_setup(game_camera_t *camera, float aspect)
 {
   rlDrawRenderBatchActive();
@@ -351,21 +368,7 @@ static void game_camera_setup(game_camera_t *camera, float aspect)
   rlPushMatrix();
   rlLoadIdentity();
 
-  if (camera->ray_view_cam.projection == CAMERA_PERSPECTIVE)
-  {
-    double top =
-        RL_CULL_DISTANCE_NEAR * tan(camera->ray_view_cam.fovy * 0.5 * DEG2RAD);
-    double right = top * aspect;
-
-    rlFrustum(-right, right, -top, top, camera->near_plane, camera->far_plane);
-  }
-  else if (camera->ray_view_cam.projection == CAMERA_ORTHOGRAPHIC)
-  {
-    double top = camera->ray_view_cam.fovy / 2.0;
-    double right = top * aspect;
-
-    rlOrtho(-right, right, -top, top, camera->near_plane, camera->far_plane);
-  }
+  rlMultMatrixf(MatrixToFloatV(game_camera_get_projection(camera, aspect)).v);
 
   rlMatrixMode(RL_MODELVIEW);
   rlLoadIdentity();
@@ -379,6 +382,30 @@ static void game_camera_setup(game_camera_t *camera, float aspect)
   rlEnableDepthTest();
 }
 
+game_frustum_t game_camera_get_frustum(game_camera_t *camera)
+{
+  float aspect = (float)GetScreenWidth() / (float)GetScreenHeight();
+  Matrix view = MatrixLookAt(camera->ray_view_cam.position, camera->ray_view_cam.target, camera->ray_view_cam.up);
+  return frustum_from_matrix(MatrixMultiply(view, game_camera_get_projection(camera, aspect)));
+}
+
+game_terrain_view_t game_camera_get_terrain_view(game_camera_t *camera)
+{
+  game_terrain_view_t view = {.frustum = game_camera_get_frustum(camera), .eye = camera->ray_view_cam.position};
+  if (camera->ray_view_cam.projection == CAMERA_ORTHOGRAPHIC)
+  {
+    view.orthographic = true;
+    view.pixels_per_unit = (float)GetScreenHeight() / camera->ray_view_cam.fovy;
+  }
+  else
+  {
+    // near plane height from the same values game_camera_get_projection uses
+    double top = RL_CULL_DISTANCE_NEAR * tan(camera->ray_view_cam.fovy * 0.5 * DEG2RAD);
+    view.pixels_per_unit = (float)(GetScreenHeight() * camera->near_plane / (2.0 * top));
+  }
+  return view;
+}
+
 void game_camera_begin_mode_3d(game_camera_t *camera)
 {
   if (!camera)
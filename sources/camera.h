@@ -2,6 +2,8 @@
 
 #include "raylib.h"
 #include "stdint.h"
+#include "frustum.h"
+#include "terrain.h"
 // Based on Jeff M's Raylib extras camera, modified following methods from Game Engine Architecture
 // https://github.com/raylib-extras/extras-c/tree/main/cameras
 
@@ -82,8 +84,6 @@ typedef struct game_camera_t
 
 } game_camera_t;
 
-typedef struct game_terrain_map_t game_terrain_map_t;
-
 void game_camera_init(game_camera_t *camera, float fov_y, Vector3 position, game_terrain_map_t *terrain_map);
 
 Vector3 game_camera_get_world_pos(game_camera_t *camera);
@@ -100,6 +100,12 @@ void game_camera_update(game_camera_t *camera, game_terrain_map_t *terrain_map);
 
 void game_camera_begin_mode_3d(game_camera_t *camera);
 
+// world space view volume of what game_camera_begin_mode_3d sets up for the current screen size
+game_frustum_t game_camera_get_frustum(game_camera_t *camera);
+
+// frustum plus what the terrain needs to turn its geometric error into screen pixels
+game_terrain_view_t game_camera_get_terrain_view(game_camera_t *camera);
+
 void game_camera_end_mode_3d(void);
 
 void game_camera_input_clear(game_camera_t *camera);
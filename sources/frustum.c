@@ -0,0 +1,52 @@
+#include "frustum.h"
+
+#include <math.h>
+
+static Vector4 frustum_plane_normalize(Vector4 plane)
+{
+  float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+  if (length <= 0.0f)
+  {
+    return plane;
+  }
+  return (Vector4){plane.x / length, plane.y / length, plane.z / length, plane.w / length};
+}
+
+game_frustum_t frustum_from_matrix(Matrix m)
+{
+  // raylib matrices transform as x' = m0 * x + m4 * y + m8 * z + m12, so row i of the math matrix is (m[i], m[i + 4], m[i + 8], m[i + 12])
+  Vector4 row0 = (Vector4){m.m0, m.m4, m.m8, m.m12};
+  Vector4 row1 = (Vector4){m.m1, m.m5, m.m9, m.m13};
+  Vector4 row2 = (Vector4){m.m2, m.m6, m.m10, m.m14};
+  Vector4 row3 = (Vector4){m.m3, m.m7, m.m11, m.m15};
+
+  game_frustum_t frustum;
+  frustum.planes[0] = (Vector4){row3.x + row0.x, row3.y + row0.y, row3.z + row0.z, row3.w + row0.w};
+  frustum.planes[1] = (Vector4){row3.x - row0.x, row3.y - row0.y, row3.z - row0.z, row3.w - row0.w};
+  frustum.planes[2] = (Vector4){row3.x + row1.x, row3.y + row1.y, row3.z + row1.z, row3.w + row1.w};
+  frustum.planes[3] = (Vector4){row3.x - row1.x, row3.y - row1.y, row3.z - row1.z, row3.w - row1.w};
+  frustum.planes[4] = (Vector4){row3.x + row2.x, row3.y + row2.y, row3.z + row2.z, row3.w + row2.w};
+  frustum.planes[5] = (Vector4){row3.x - row2.x, row3.y - row2.y, row3.z - row2.z, row3.w - row2.w};
+  for (int i = 0; i < 6; i++)
+  {
+    frustum.planes[i] = frustum_plane_normalize(frustum.planes[i]);
+  }
+  return frustum;
+}
+
+bool frustum_check_box(const game_frustum_t *frustum, BoundingBox box)
+{
+  for (int i = 0; i < 6; i++)
+  {
+    Vector4 plane = frustum->planes[i];
+    // corner furthest along the plane normal, if even that one is behind the plane the whole box is
+    float x = plane.x >= 0.0f ? box.max.x : box.min.x;
+    float y = plane.y >= 0.0f ? box.max.y : box.min.y;
+    float z = plane.z >= 0.0f ? box.max.z : box.min.z;
+    if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdbool.h>
+#include "raylib.h"
+
+// six planes as (normal, distance) pointing into the view volume, a point p is inside when dot(n, p) + d >= 0 for all of them
+typedef struct game_frustum_t
+{
+  Vector4 planes[6]; // left, right, bottom, top, near, far
+} game_frustum_t;
+
+// extracts the planes of MatrixMultiply(view, projection), the same order rlgl combines them in
+game_frustum_t frustum_from_matrix(Matrix view_projection);
+
+// conservative, boxes straddling a corner outside the volume may still pass
+bool frustum_check_box(const game_frustum_t *frustum, BoundingBox box);
@@ -0,0 +1,405 @@
+#include "jobs.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// raylib.h is left out on purpose, its names clash with windows.h
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#define NOUSER
+#include <windows.h>
+typedef HANDLE jobs_thread_t;
+typedef SRWLOCK jobs_mutex_t;
+typedef CONDITION_VARIABLE jobs_cond_t;
+#define JOBS_THREAD_RETURN DWORD WINAPI
+#else
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+typedef pthread_t jobs_thread_t;
+typedef pthread_mutex_t jobs_mutex_t;
+typedef pthread_cond_t jobs_cond_t;
+#define JOBS_THREAD_RETURN void *
+#endif
+
+// fixed pool, every worker sleeps until a batch is published and then pulls job indices off a shared counter
+static struct
+{
+  jobs_thread_t threads[JOBS_MAX_WORKERS];
+  uint32_t worker_count;
+  jobs_mutex_t mutex;
+  jobs_cond_t wake;       // signalled when a batch is published or the pool shuts down
+  jobs_cond_t done;       // signalled when the last helper thread leaves a batch
+  uint64_t batch_id;
+  uint32_t active_count;  // helper threads that have not finished the current batch yet
+  bool is_quitting;
+
+  game_job_fn fn;
+  void *data;
+  uint32_t job_count;
+#if defined(_WIN32)
+  volatile LONG next_job;
+#else
+  atomic_uint next_job;
+#endif
+} jobs_pool = {0};
+
+static uint32_t jobs_get_core_count(void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (uint32_t)info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+static void jobs_lock(jobs_mutex_t *mutex)
+{
+#if defined(_WIN32)
+  AcquireSRWLockExclusive(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+static void jobs_unlock(jobs_mutex_t *mutex)
+{
+#if defined(_WIN32)
+  ReleaseSRWLockExclusive(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+static void jobs_wait(jobs_cond_t *cond, jobs_mutex_t *mutex)
+{
+#if defined(_WIN32)
+  SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+#else
+  pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static void jobs_broadcast(jobs_cond_t *cond)
+{
+#if defined(_WIN32)
+  WakeAllConditionVariable(cond);
+#else
+  pthread_cond_broadcast(cond);
+#endif
+}
+
+static uint32_t jobs_fetch_next(void)
+{
+#if defined(_WIN32)
+  return (uint32_t)InterlockedExchangeAdd(&jobs_pool.next_job, 1);
+#else
+  return atomic_fetch_add(&jobs_pool.next_job, 1);
+#endif
+}
+
+static void jobs_run_batch(uint32_t worker_index)
+{
+  for (uint32_t job = jobs_fetch_next(); job < jobs_pool.job_count; job = jobs_fetch_next())
+  {
+    jobs_pool.fn(jobs_pool.data, job, worker_index);
+  }
+}
+
+static JOBS_THREAD_RETURN jobs_worker_main(void *arg)
+{
+  uint32_t worker_index = (uint32_t)(uintptr_t)arg;
+  uint64_t seen_batch = 0;
+  for (;;)
+  {
+    jobs_lock(&jobs_pool.mutex);
+    while (jobs_pool.batch_id == seen_batch && !jobs_pool.is_quitting)
+    {
+      jobs_wait(&jobs_pool.wake, &jobs_pool.mutex);
+    }
+    if (jobs_pool.is_quitting)
+    {
+      jobs_unlock(&jobs_pool.mutex);
+      break;
+    }
+    seen_batch = jobs_pool.batch_id;
+    jobs_unlock(&jobs_pool.mutex);
+
+    jobs_run_batch(worker_index);
+
+    jobs_lock(&jobs_pool.mutex);
+    if (--jobs_pool.active_count == 0)
+    {
+      jobs_broadcast(&jobs_pool.done);
+    }
+    jobs_unlock(&jobs_pool.mutex);
+  }
+  return 0;
+}
+
+void jobs_init(uint32_t worker_count)
+{
+  if (worker_count == 0)
+  {
+    worker_count = jobs_get_core_count();
+  }
+  worker_count = worker_count > JOBS_MAX_WORKERS ? JOBS_MAX_WORKERS : worker_count;
+#if defined(_WIN32)
+  InitializeSRWLock(&jobs_pool.mutex);
+  InitializeConditionVariable(&jobs_pool.wake);
+  InitializeConditionVariable(&jobs_pool.done);
+#else
+  pthread_mutex_init(&jobs_pool.mutex, NULL);
+  pthread_cond_init(&jobs_pool.wake, NULL);
+  pthread_cond_init(&jobs_pool.done, NULL);
+#endif
+  jobs_pool.is_quitting = false;
+  jobs_pool.batch_id = 0;
+  jobs_pool.worker_count = 1;
+  for (uint32_t i = 1; i < worker_count; i++)
+  {
+#if defined(_WIN32)
+    jobs_pool.threads[i] = CreateThread(NULL, 0, jobs_worker_main, (void *)(uintptr_t)i, 0, NULL);
+    bool is_started = jobs_pool.threads[i] != NULL;
+#else
+    bool is_started = pthread_create(&jobs_pool.threads[i], NULL, jobs_worker_main, (void *)(uintptr_t)i) == 0;
+#endif
+    if (!is_started)
+    {
+      fprintf(stderr, "JOBS: Failed to start worker %u, continuing with %u workers\n", i, jobs_pool.worker_count);
+      break;
+    }
+    jobs_pool.worker_count++;
+  }
+}
+
+void jobs_shutdown(void)
+{
+  if (jobs_pool.worker_count == 0)
+  {
+    return;
+  }
+  jobs_lock(&jobs_pool.mutex);
+  jobs_pool.is_quitting = true;
+  jobs_broadcast(&jobs_pool.wake);
+  jobs_unlock(&jobs_pool.mutex);
+  for (uint32_t i = 1; i < jobs_pool.worker_count; i++)
+  {
+#if defined(_WIN32)
+    WaitForSingleObject(jobs_pool.threads[i], INFINITE);
+    CloseHandle(jobs_pool.threads[i]);
+#else
+    pthread_join(jobs_pool.threads[i], NULL);
+#endif
+  }
+#if !defined(_WIN32)
+  pthread_cond_destroy(&jobs_pool.done);
+  pthread_cond_destroy(&jobs_pool.wake);
+  pthread_mutex_destroy(&jobs_pool.mutex);
+#endif
+  jobs_pool.worker_count = 0;
+}
+
+uint32_t jobs_get_worker_count(void)
+{
+  return jobs_pool.worker_count > 0 ? jobs_pool.worker_count : 1;
+}
+
+void jobs_parallel_for(uint32_t job_count, game_job_fn fn, void *data)
+{
+  if (jobs_pool.worker_count <= 1 || job_count <= 1)
+  {
+    for (uint32_t job = 0; job < job_count; job++)
+    {
+      fn(data, job, 0);
+    }
+    return;
+  }
+  jobs_lock(&jobs_pool.mutex);
+  jobs_pool.fn = fn;
+  jobs_pool.data = data;
+  jobs_pool.job_count = job_count;
+  jobs_pool.next_job = 0;
+  jobs_pool.active_count = jobs_pool.worker_count - 1;
+  jobs_pool.batch_id++;
+  jobs_broadcast(&jobs_pool.wake);
+  jobs_unlock(&jobs_pool.mutex);
+
+  jobs_run_batch(0);
+
+  // helpers may still be inside their last job even though the counter ran out
+  jobs_lock(&jobs_pool.mutex);
+  while (jobs_pool.active_count > 0)
+  {
+    jobs_wait(&jobs_pool.done, &jobs_pool.mutex);
+  }
+  jobs_unlock(&jobs_pool.mutex);
+}
+
+// items live in plain byte arrays of item_size strides, pending is consumed from pending_first onwards
+struct game_job_queue_t
+{
+  jobs_thread_t thread;
+  bool is_started;
+  jobs_mutex_t mutex;
+  jobs_cond_t wake; // signalled when an item is pushed or the queue shuts down
+  jobs_cond_t done; // signalled whenever an item finishes
+  bool is_quitting;
+  bool is_busy;     // the thread is inside fn with an item taken off pending
+
+  game_job_item_fn fn;
+  void *data;
+  uint32_t item_size;
+  uint8_t *current;
+  uint8_t *pending;
+  uint32_t pending_first, pending_count, pending_capacity;
+  uint8_t *finished;
+  uint32_t finished_count, finished_capacity;
+};
+
+static void jobs_queue_append(uint8_t **items, uint32_t *count, uint32_t *capacity, const void *item, uint32_t item_size)
+{
+  if (*count == *capacity)
+  {
+    *capacity = *capacity ? *capacity * 2 : 16;
+    *items = realloc(*items, (size_t)*capacity * item_size);
+  }
+  memcpy(*items + (size_t)*count * item_size, item, item_size);
+  (*count)++;
+}
+
+static JOBS_THREAD_RETURN jobs_queue_main(void *arg)
+{
+  game_job_queue_t *queue = arg;
+  jobs_lock(&queue->mutex);
+  for (;;)
+  {
+    while (queue->pending_first == queue->pending_count && !queue->is_quitting)
+    {
+      jobs_wait(&queue->wake, &queue->mutex);
+    }
+    if (queue->is_quitting)
+    {
+      break;
+    }
+    memcpy(queue->current, queue->pending + (size_t)queue->pending_first * queue->item_size, queue->item_size);
+    if (++queue->pending_first == queue->pending_count)
+    {
+      queue->pending_first = queue->pending_count = 0;
+    }
+    queue->is_busy = true;
+    jobs_unlock(&queue->mutex);
+
+    queue->fn(queue->data, queue->current);
+
+    jobs_lock(&queue->mutex);
+    jobs_queue_append(&queue->finished, &queue->finished_count, &queue->finished_capacity, queue->current, queue->item_size);
+    queue->is_busy = false;
+    jobs_broadcast(&queue->done);
+  }
+  jobs_unlock(&queue->mutex);
+  return 0;
+}
+
+game_job_queue_t *jobs_queue_create(game_job_item_fn fn, void *data, uint32_t item_size)
+{
+  game_job_queue_t *queue = calloc(1, sizeof(*queue));
+  queue->fn = fn;
+  queue->data = data;
+  queue->item_size = item_size;
+  queue->current = malloc(item_size);
+#if defined(_WIN32)
+  InitializeSRWLock(&queue->mutex);
+  InitializeConditionVariable(&queue->wake);
+  InitializeConditionVariable(&queue->done);
+  queue->thread = CreateThread(NULL, 0, jobs_queue_main, queue, 0, NULL);
+  queue->is_started = queue->thread != NULL;
+#else
+  pthread_mutex_init(&queue->mutex, NULL);
+  pthread_cond_init(&queue->wake, NULL);
+  pthread_cond_init(&queue->done, NULL);
+  queue->is_started = pthread_create(&queue->thread, NULL, jobs_queue_main, queue) == 0;
+#endif
+  if (!queue->is_started)
+  {
+    fprintf(stderr, "JOBS: Failed to start queue thread, items run on push instead\n");
+  }
+  return queue;
+}
+
+void jobs_queue_push(game_job_queue_t *queue, const void *item)
+{
+  if (!queue->is_started)
+  {
+    memcpy(queue->current, item, queue->item_size);
+    queue->fn(queue->data, queue->current);
+    jobs_queue_append(&queue->finished, &queue->finished_count, &queue->finished_capacity, queue->current, queue->item_size);
+    return;
+  }
+  jobs_lock(&queue->mutex);
+  jobs_queue_append(&queue->pending, &queue->pending_count, &queue->pending_capacity, item, queue->item_size);
+  jobs_broadcast(&queue->wake);
+  jobs_unlock(&queue->mutex);
+}
+
+uint32_t jobs_queue_poll(game_job_queue_t *queue, void *out_items, uint32_t max_items)
+{
+  jobs_lock(&queue->mutex);
+  uint32_t count = queue->finished_count < max_items ? queue->finished_count : max_items;
+  if (count == 0)
+  {
+    jobs_unlock(&queue->mutex);
+    return 0;
+  }
+  memcpy(out_items, queue->finished, (size_t)count * queue->item_size);
+  memmove(queue->finished, queue->finished + (size_t)count * queue->item_size, (size_t)(queue->finished_count - count) * queue->item_size);
+  queue->finished_count -= count;
+  jobs_unlock(&queue->mutex);
+  return count;
+}
+
+void jobs_queue_wait(game_job_queue_t *queue)
+{
+  jobs_lock(&queue->mutex);
+  while (queue->pending_first < queue->pending_count || queue->is_busy)
+  {
+    jobs_wait(&queue->done, &queue->mutex);
+  }
+  jobs_unlock(&queue->mutex);
+}
+
+void jobs_queue_destroy(game_job_queue_t *queue)
+{
+  if (queue == NULL)
+  {
+    return;
+  }
+  if (queue->is_started)
+  {
+    jobs_lock(&queue->mutex);
+    queue->is_quitting = true;
+    jobs_broadcast(&queue->wake);
+    jobs_unlock(&queue->mutex);
+#if defined(_WIN32)
+    WaitForSingleObject(queue->thread, INFINITE);
+    CloseHandle(queue->thread);
+#else
+    pthread_join(queue->thread, NULL);
+#endif
+  }
+#if !defined(_WIN32)
+  pthread_cond_destroy(&queue->done);
+  pthread_cond_destroy(&queue->wake);
+  pthread_mutex_destroy(&queue->mutex);
+#endif
+  free(queue->current);
+  free(queue->pending);
+  free(queue->finished);
+  free(queue);
+}
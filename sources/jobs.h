@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#define JOBS_MAX_WORKERS 64
+
+// called once per job, worker_index is < jobs_get_worker_count() and can index per worker scratch memory.
+// which worker runs which job is not deterministic, anything written per job should be keyed by job_index
+typedef void (*game_job_fn)(void *data, uint32_t job_index, uint32_t worker_index);
+
+// starts a fixed pool of worker threads, 0 picks one worker per core. the calling thread counts as worker 0
+void jobs_init(uint32_t worker_count);
+
+void jobs_shutdown(void);
+
+uint32_t jobs_get_worker_count(void);
+
+// runs fn for every job index in [0, job_count) across the pool and returns once all of them finished.
+// the calling thread takes jobs too, runs inline when the pool was never started
+void jobs_parallel_for(uint32_t job_count, game_job_fn fn, void *data);
+
+// a single background thread that works through items in the order they were pushed, for work that may take
+// longer than a frame. items are copied in and out, item_size bytes each
+typedef struct game_job_queue_t game_job_queue_t;
+typedef void (*game_job_item_fn)(void *data, void *item);
+
+game_job_queue_t *jobs_queue_create(game_job_item_fn fn, void *data, uint32_t item_size);
+
+void jobs_queue_push(game_job_queue_t *queue, const void *item);
+
+// moves up to max_items finished items into out_items in the order they finished, returns how many
+uint32_t jobs_queue_poll(game_job_queue_t *queue, void *out_items, uint32_t max_items);
+
+// blocks until everything pushed so far has finished
+void jobs_queue_wait(game_job_queue_t *queue);
+
+// stops after the item in progress, anything still pending is dropped
+void jobs_queue_destroy(game_job_queue_t *queue);
@@ -1,6 +1,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define STB_DS_IMPLEMENTATION
 #include "stb_ds.h"
@@ -13,17 +14,35 @@
 #include "scene.h"
 #include "skybox.h"
 #include "terrain.h"
+#include "terrain_cooked.h"
+#include "terrain_edit.h"
+#include "terrain_lightmap.h"
+#include "terrain_noise.h"
+#include "terrain_stream.h"
 #include "models.h"
+#include "jobs.h"
+#include "path.h"
 
 #define screenWidth 1280
 #define screenHeight 720
+#define TERRAIN_IMAGE_PATH "../resources/discmap.BMP"
+#define TERRAIN_COOKED_PATH "../resources/discmap.cooked"     // recooked whenever discmap.BMP changes
+#define TERRAIN_TILES_PATH "../resources/discmap.tiles"       // rewritten whenever discmap.BMP changes
+#define TERRAIN_LIGHTMAP_PATH "../resources/discmap.lightmap" // rebaked whenever discmap.BMP or the sun changes
+#define TERRAIN_GENERATED_TILES_PATH "../resources/generated.tiles"       // the same two for --generate maps
+#define TERRAIN_GENERATED_LIGHTMAP_PATH "../resources/generated.lightmap"
+#define TERRAIN_EDIT_RADIUS 8.0f // of the --edit debug keys, in world units
+#define TERRAIN_EDIT_DEPTH 3.0f
 
 // convenient global for rectangle selection
 bool is_select_visible;
 
 // NOTE: need to add input event system, two event buffers
 
-int main(void)
+// usage: my_demo [--generate size [seed] [fbm|ridged]] [--edit], --generate replaces discmap.BMP with a size x size noise
+// map. --edit keeps every height in memory instead of streaming them, so F2 digs a crater, F3 flattens and F4 levels a
+// pad under the cursor
+int main(int argc, char **argv)
 {
   //--------------------------------------------------------------------------
   // Initialization
@@ -96,10 +115,8 @@ int main(void)
 
 
   // terrain
-  Image disc_map = LoadImage("../resources/discmap.BMP");
   Texture2D color_map = LoadTexture("../resources/colormap.BMP");
-  Texture2D shadow_map = LoadTexture("../resources/shadowmap.BMP");
-  game_terrain_map_t terrain_map = (game_terrain_map_t){.max_width = disc_map.width, .max_height = disc_map.height};
+  game_terrain_map_t terrain_map = {0};
   Shader terrain_shadow = LoadShader("../shaders/terrain_shadow.vs", "../shaders/terrain_shadow.fs");
   terrain_shadow.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(terrain_shadow, "viewPos");
   int light_matrix = GetShaderLocation(terrain_shadow, "lightSpaceMatrix");
@@ -113,13 +130,58 @@ int main(void)
   SetShaderValue(mesh_phong, sun_loc[0], Vector3ToFloat(sun_dir), SHADER_UNIFORM_VEC3);
   SetShaderValue(terrain_shadow, sun_loc[1], Vector3ToFloat(sun_dir), SHADER_UNIFORM_VEC3);
   
-  terrain_map.value = RL_MALLOC(sizeof(*terrain_map.value) * disc_map.width * disc_map.height);
-  if (!terrain_map.value)
+  // terrain generation, the lightmap bake and simulation ticks fan out over one worker per core
+  jobs_init(0);
+  // generated maps are built from scratch, discmap's heights, mesh and node bounds come straight out of the cooked file
+  // unless discmap.BMP changed since it was cooked
+  game_terrain_mesh_t terrain_mesh = {0};
+  uint64_t terrain_hash = 0;
+  // --edit comes last, the --generate arguments are read as if it was not there
+  bool is_editable = argc > 1 && strcmp(argv[argc - 1], "--edit") == 0;
+  argc -= is_editable ? 1 : 0;
+  bool is_generated = argc > 2 && strcmp(argv[1], "--generate") == 0;
+  const char *tiles_path = is_generated ? TERRAIN_GENERATED_TILES_PATH : TERRAIN_TILES_PATH;
+  const char *lightmap_path = is_generated ? TERRAIN_GENERATED_LIGHTMAP_PATH : TERRAIN_LIGHTMAP_PATH;
+  if (is_generated)
   {
-    TraceLog(LOG_ERROR, "Failed to allocate heightmap memory.");
+    int size = atoi(argv[2]);
+    game_terrain_noise_kind kind = argc > 4 && strcmp(argv[4], "ridged") == 0 ? GAME_TERRAIN_NOISE_RIDGED : GAME_TERRAIN_NOISE_FBM;
+    game_terrain_noise_t noise = terrain_noise_default(kind, argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 1);
+    if (!terrain_generate_heights(&terrain_map, size, size, GAME_TERRAIN_STORAGE_FLOAT32, &noise))
+    {
+      TraceLog(LOG_ERROR, "Failed to generate a %dx%d terrain.", size, size);
+      return EXIT_FAILURE;
+    }
+    terrain_mesh = terrain_init(&terrain_map);
+    terrain_hash = terrain_stream_hash(&terrain_map);
+  }
+  else if (!terrain_cooked_load_or_cook(TERRAIN_COOKED_PATH, TERRAIN_IMAGE_PATH, GAME_TERRAIN_STORAGE_FLOAT32, &terrain_map,
+                                        &terrain_mesh, &terrain_hash))
+  {
+    TraceLog(LOG_ERROR, "Failed to load the terrain.");
     return EXIT_FAILURE;
   }
-  Mesh terrain_mesh = terrain_init(disc_map, &terrain_map);
+  // sun shadows and ambient occlusion of the terrain never change, so they are baked instead of rendered
+  Image lightmap = terrain_lightmap_load(lightmap_path, &terrain_map, terrain_hash, sun_dir);
+  Texture2D shadow_map = LoadTextureFromImage(lightmap);
+  UnloadImage(lightmap);
+  // move orders path around slopes, built while every height is still in memory
+  game_path_grid_t path_grid = {0};
+  game_path_hpa_t path_hpa = {0};
+  if (path_grid_build(&path_grid, &terrain_map))
+  {
+    scene_set_path_grid(&path_grid, path_hpa_build(&path_hpa, &path_grid) ? &path_hpa : NULL);
+  }
+  // the mesh keeps its own copy of the heights, gameplay reads them from the tile file paged in around the camera.
+  // streamed maps are read only, edits need the one in memory
+  game_terrain_map_t streamed_map = {0};
+  if (!is_editable && (terrain_stream_open(tiles_path, terrain_hash, TERRAIN_STREAM_RADIUS, &streamed_map) ||
+                       (terrain_stream_write(&terrain_map, tiles_path) &&
+                        terrain_stream_open(tiles_path, terrain_hash, TERRAIN_STREAM_RADIUS, &streamed_map))))
+  {
+    terrain_map_unload(&terrain_map);
+    terrain_map = streamed_map;
+  }
   Material terrain_material = LoadMaterialDefault();
   terrain_material.shader = terrain_shadow;
   terrain_material.maps[MATERIAL_MAP_DIFFUSE].texture = color_map;
@@ -137,19 +199,17 @@ int main(void)
   SetTextureFilter(color_map, TEXTURE_FILTER_ANISOTROPIC_16X);
 
   GenTextureMipmaps(&shadow_map);
-  SetTextureWrap(shadow_map, TEXTURE_WRAP_REPEAT);
+  SetTextureWrap(shadow_map, TEXTURE_WRAP_CLAMP);
   SetTextureFilter(shadow_map, TEXTURE_FILTER_TRILINEAR);
   SetTextureFilter(shadow_map, TEXTURE_FILTER_ANISOTROPIC_16X);
   
 
-  UnloadImage(disc_map);
-
   // Terrain Matrix;
   Matrix terrain_matrix = MatrixTranslate(-(terrain_map.max_width / 2.0f), 0.0f, -(terrain_map.max_height / 2.0f));
 
   // Entity List
 
-  game_entity_t *entities = NULL;
+  game_entity_store_t entities = {0};
   game_entity_create_t new_ent = (game_entity_create_t){
       .scale = (Vector3){1.0f, 1.0f, 1.0f},
       .position = (Vector2){.x = 0, .y = 0.f},
@@ -165,43 +225,45 @@ int main(void)
       .hit_points = 100.f,
       .team = GAME_TEAM_PLAYER,
       .type = GAME_ENT_TYPE_ACTOR};
-  entities = entity_add(entities, &new_ent);
+  entity_add(&entities, &new_ent);
   new_ent.position.x = 0;
   new_ent.position.y = 10;
   
 
-  entities = entity_add(entities, &new_ent);
+  entity_add(&entities, &new_ent);
 
   new_ent.position.x = 20;
-  entities = entity_add(entities, &new_ent);
+  entity_add(&entities, &new_ent);
 
   new_ent.position.y = 5;
-  entities = entity_add(entities, &new_ent);
+  entity_add(&entities, &new_ent);
 
   new_ent.position.x = 10;
-  entities = entity_add(entities, &new_ent);
+  entity_add(&entities, &new_ent);
 
   new_ent.position.x = -5;
   new_ent.position.y = 5;
   new_ent.team = GAME_TEAM_AI;
-  entities = entity_add(entities, &new_ent);
+  entity_add(&entities, &new_ent);
 
   new_ent.position.y = -10;
-  entities = entity_add(entities, &new_ent);
+  entity_add(&entities, &new_ent);
 
   new_ent.position.x = 7;
   new_ent.position.y = 9;
-  entities = entity_add(entities, &new_ent);
+  entity_add(&entities, &new_ent);
 
   
-  short selected[GAME_MAX_SELECTED]; // storing capacity, or maintining a free list might be better, but this works for now
-  memset(selected, -1, sizeof selected);
+  game_entity_handle_t selected[GAME_MAX_SELECTED]; // storing capacity, or maintining a free list might be better, but this works for now
+  memset(selected, -1, sizeof selected); // all bits set is GAME_ENTITY_HANDLE_NONE
 
 
   SetTargetFPS(200);
 
   game_camera_t camera = {0};
   game_camera_init(&camera, 45.0f, (Vector3){0, 0, 0}, &terrain_map);
+  terrain_stream_update(&terrain_map, camera.camera_pos);
+  terrain_stream_flush(&terrain_map);
 
 
 
@@ -210,11 +272,11 @@ int main(void)
 
   #if 0
   // assign phong shader + shadow map to all entities
-  for (int i = 0; i < arrlen(entities); i++)
+  for (uint32_t i = 0; i < entities.count; i++)
   {
-    for (int j = 0; j < entities[i].model.materialCount; j++)
+    for (int j = 0; j < entities.asset[i]->model.materialCount; j++)
     {
-      entities[i].model.materials[j].shader = mesh_phong;
+      entities.asset[i]->model.materials[j].shader = mesh_phong;
     }
   }
   #endif
@@ -222,6 +284,8 @@ int main(void)
 
   
 
+  bool is_stats_visible = false; // F1 toggles simulation counters
+
   float sim_accumulator = 0;
   float sim_ai_accumulator = 0;
   float sim_ai_dt = 1.f; // how often ai calculations should be made
@@ -237,6 +301,33 @@ int main(void)
     // Update
     //----------------------------------------------------------------------
     game_camera_update(&camera, &terrain_map);
+    terrain_stream_update(&terrain_map, camera.camera_pos);
+    if (IsKeyPressed(KEY_F1))
+    {
+      is_stats_visible = !is_stats_visible;
+    }
+    // the edits queue dirty rects, everything built from the heights picks them up before the terrain is drawn. the
+    // baked lightmap keeps the old shading
+    if (is_editable && (IsKeyPressed(KEY_F2) || IsKeyPressed(KEY_F3) || IsKeyPressed(KEY_F4)))
+    {
+      Ray ray = GetMouseRay(GetMousePosition(), camera.ray_view_cam);
+      game_terrain_hit_t hit;
+      terrain_get_ray_batch(&ray, 1, &terrain_map, camera.near_plane, camera.far_plane, &hit);
+      Vector3 half_pad = {TERRAIN_EDIT_RADIUS, 0.0f, TERRAIN_EDIT_RADIUS};
+      if (hit.hit && IsKeyPressed(KEY_F2))
+      {
+        terrain_edit_crater(&terrain_map, hit.position, TERRAIN_EDIT_RADIUS, TERRAIN_EDIT_DEPTH);
+      }
+      else if (hit.hit && IsKeyPressed(KEY_F3))
+      {
+        terrain_edit_flatten(&terrain_map, hit.position, TERRAIN_EDIT_RADIUS * 2.0f, hit.position.y, 1.0f);
+      }
+      else if (hit.hit)
+      {
+        terrain_edit_pad(&terrain_map, Vector3Subtract(hit.position, half_pad), Vector3Add(hit.position, half_pad), hit.position.y,
+                         TERRAIN_EDIT_RADIUS / 2.0f);
+      }
+    }
     SetShaderValue(mesh_phong, mesh_phong.locs[SHADER_LOC_VECTOR_VIEW], &camera.ray_view_cam.position, SHADER_UNIFORM_VEC3);
     SetShaderValue(terrain_shadow, terrain_shadow.locs[SHADER_LOC_VECTOR_VIEW], &camera.ray_view_cam.position, SHADER_UNIFORM_VEC3);
     SetShaderValue(terrain_shadow, sun_pos, &shadow_cam.ray_view_cam.position, SHADER_UNIFORM_VEC3);
@@ -246,13 +337,13 @@ int main(void)
     sim_ai_accumulator += dt;
     while (sim_ai_accumulator >= sim_ai_dt)
     {
-      scene_process_ai(entities);
+      scene_process_ai(&entities, &terrain_map);
       sim_ai_accumulator -= sim_ai_dt;
     }
     while (sim_accumulator >= sim_dt)
     {
-      scene_process_input(&camera, entities, &terrain_map, selected);
-      scene_update_entities(&camera, entities, &terrain_map, selected, sim_dt);
+      scene_process_input(&camera, &entities, &terrain_map, selected);
+      scene_update_entities(&camera, &entities, &terrain_map, selected, sim_dt);
       sim_accumulator -= sim_dt;
     }
 
@@ -270,17 +361,17 @@ int main(void)
     //rlEnableBackfaceCulling();
     rlEnableDepthTest();
     rlEnableDepthMask();
-      for (size_t i = 0; i < arrlen(entities); i++)
+      for (uint32_t i = 0; i < entities.count; i++)
       {
-        game_entity_t *ent = &entities[i];
-        if (ent->type == GAME_ENT_TYPE_ACTOR)
+        if (entities.type[i] == GAME_ENT_TYPE_ACTOR)
         {
-          for (int i = 0; i < ent->model.meshCount; i++)
+          Model *model = &entities.asset[i]->model;
+          for (int j = 0; j < model->meshCount; j++)
           {
-            Mesh *mesh = &ent->model.meshes[i];
+            Mesh *mesh = &model->meshes[j];
             rlEnableShader(depth_shader.id);
             rlEnableVertexArray(mesh->vaoId);
-            rlSetUniformMatrix(depth_shader.locs[SHADER_LOC_MATRIX_MODEL], ent->model.transform);
+            rlSetUniformMatrix(depth_shader.locs[SHADER_LOC_MATRIX_MODEL], entities.transform[i]);
             rlSetUniformMatrix(depth_loc, lightSpaceMatrix);
             rlDrawVertexArrayElements(0, mesh->triangleCount*3, 0);
 
@@ -301,23 +392,20 @@ int main(void)
     rlDisableBackfaceCulling();
     //rlSetCullFace(RL_CULL_FACE_FRONT);
     SetShaderValueMatrix(depth_shader, depth_loc, MatrixMultiply(shadow_cam.view, shadow_cam.projection));
-    for (size_t i = 0; i < arrlen(entities); i++)
+    for (uint32_t i = 0; i < entities.count; i++)
     {
-      game_entity_t *ent = &entities[i];
-      for (int j = 0; j < ent->model.materialCount; j++)
+      Model *model = &entities.asset[i]->model; // materials are shared, swapping the shader affects every entity using this asset
+      for (int j = 0; j < model->materialCount; j++)
       {
-        ent->model.materials[j].shader = depth_shader;
+        model->materials[j].shader = depth_shader;
       }
-      if (ent->type == GAME_ENT_TYPE_ACTOR)
+      if (entities.type[i] == GAME_ENT_TYPE_ACTOR)
       {
-        for (int i = 0; i < ent->model.meshCount; i++)
-        {
-          DrawModel(ent->model, (Vector3){0}, 1.0f, WHITE);
-        }
+        DrawModel(entity_get_posed_model(i, &entities), (Vector3){0}, 1.0f, WHITE);
       }
-      for (int j = 0; j < ent->model.materialCount; j++)
+      for (int j = 0; j < model->materialCount; j++)
       {
-        ent->model.materials[j].shader = mesh_phong;
+        model->materials[j].shader = mesh_phong;
       }
     }
     //rlSetCullFace(RL_CULL_FACE_BACK);
@@ -339,44 +427,51 @@ int main(void)
     // Draw Terrain
     //SetShaderValueTexture(terrain_shadow, shadow_loc, shadow_text.depth);
     SetShaderValueMatrix(terrain_shadow, light_matrix, MatrixMultiply(shadow_cam.view, shadow_cam.projection));
-    DrawMesh(terrain_mesh, terrain_material, terrain_matrix);
+    game_terrain_view_t terrain_view = game_camera_get_terrain_view(&camera);
+    // rows touched by terrain edits since the last frame
+    for (int i = 0; i < arrlen(terrain_map.dirty_rects); i++)
+    {
+      path_grid_update(&path_grid, &terrain_map, terrain_map.dirty_rects[i]);
+      path_hpa_update(&path_hpa, &path_grid, terrain_map.dirty_rects[i]);
+    }
+    terrain_update_mesh(&terrain_mesh, &terrain_map);
+    terrain_draw(&terrain_mesh, terrain_material, terrain_matrix, &terrain_view);
 
     // draw entities
-    for (size_t i = 0; i < arrlen(entities); i++)
+    for (uint32_t i = 0; i < entities.count; i++)
     {
-      game_entity_t *ent = &entities[i];
-      if (ent->type == GAME_ENT_TYPE_ACTOR)
+      if (entities.type[i] == GAME_ENT_TYPE_ACTOR)
       {
         Color color_tint = WHITE;
-        if (ent->team == GAME_TEAM_PLAYER)
+        if (entities.team[i] == GAME_TEAM_PLAYER)
         {
             color_tint = GREEN;
         }
-        else if (ent->team == GAME_TEAM_AI)
+        else if (entities.team[i] == GAME_TEAM_AI)
         {
             color_tint = RED;
         }
-        DrawModel(ent->model, (Vector3){0}, 1.0f, color_tint);
-        //DrawCubeWires(Vector3Add(ent->dimensions_offset, Vector3Transform(Vector3Zero(), ent->model.transform)), ent->dimensions.x, ent->dimensions.y, ent->dimensions.z, RED);
-        //entity_draw_actor(&ent->model, ent->team);
+        DrawModel(entity_get_posed_model(i, &entities), (Vector3){0}, 1.0f, color_tint);
+        //DrawCubeWires(Vector3Add(entities.dimensions_offset[i], Vector3Transform(Vector3Zero(), entities.transform[i])), entities.dimensions[i].x, entities.dimensions[i].y, entities.dimensions[i].z, RED);
+        //entity_draw_actor(&entities.asset[i]->model, entities.team[i]);
       }
     }
     // draw selection boxes
     #if 1
     for (size_t i = 0; i < GAME_MAX_SELECTED; i++)
     {
-      if (selected[i] >= 0)
+      if (selected[i] != GAME_ENTITY_HANDLE_NONE)
       {
-        short selected_id = selected[i];
-        game_entity_t *ent = &entities[selected_id]; // only works right now, will not work if deleting entities is added since selectedId may not necessarily map to an index
-        if (ent->state & GAME_ENT_STATE_DEAD)
+        int32_t selected_id = entity_resolve(&entities, selected[i]);
+        if (selected_id < 0 || entities.state[selected_id] & GAME_ENT_STATE_DEAD)
         {
-          selected[i] = -1; // deselect
+          selected[i] = GAME_ENTITY_HANDLE_NONE; // deselect
           continue;
         }
-        DrawCubeWires(Vector3Add(ent->dimensions_offset, Vector3Transform(Vector3Zero(), ent->model.transform)), ent->dimensions.x, ent->dimensions.y, ent->dimensions.z, MAGENTA);
+        Vector3 dimensions = entities.dimensions[selected_id];
+        DrawCubeWires(Vector3Add(entities.dimensions_offset[selected_id], Vector3Transform(Vector3Zero(), entities.transform[selected_id])), dimensions.x, dimensions.y, dimensions.z, MAGENTA);
         #if 0
-        DrawCircle3D(ent->position, ent->attack_radius, (Vector3){1, 0, 0}, 90, RED);
+        DrawCircle3D(entities.position[selected_id], entities.attack_radius[selected_id], (Vector3){1, 0, 0}, 90, RED);
         #endif
       }
     }
@@ -399,12 +494,12 @@ int main(void)
     // draw health for selected
     for (size_t i = 0; i < GAME_MAX_SELECTED; i++)
     {
-      if (selected[i] >= 0)
+      int32_t selected_id = entity_resolve(&entities, selected[i]);
+      if (selected_id >= 0)
       {
-        short selected_id = selected[i];
-        game_entity_t *ent = &entities[selected_id];
-        Vector2 pos = GetWorldToScreen((Vector3){ent->bbox.min.x, ent->bbox.max.y, ent->bbox.min.z}, camera.ray_view_cam);
-        DrawText(TextFormat("%.0f/%.0f", ent->hit_points, ent->hit_points_max), (int)pos.x, (int)pos.y, 20, BLUE);
+        BoundingBox bbox = entities.bbox[selected_id];
+        Vector2 pos = GetWorldToScreen((Vector3){bbox.min.x, bbox.max.y, bbox.min.z}, camera.ray_view_cam);
+        DrawText(TextFormat("%.0f/%.0f", entities.hit_points[selected_id], entities.hit_points_max[selected_id]), (int)pos.x, (int)pos.y, 20, BLUE);
       }
     }
 
@@ -416,6 +511,28 @@ int main(void)
       DrawRectangleLines(box.x, box.y, box.width, box.height, GREEN);
     }
 
+    if (is_stats_visible)
+    {
+      const game_scene_stats_t *stats = scene_get_stats();
+      DrawFPS(10, 10);
+      const game_terrain_draw_stats_t *terrain_stats = &terrain_mesh.stats;
+      game_terrain_stream_stats_t stream_stats = terrain_map.stream != NULL ? terrain_map.stream->stats : (game_terrain_stream_stats_t){0};
+      DrawText(TextFormat("units: %u\nworkers: %u\navoidance: %u units, %u neighbours\noverlaps: %u, crowded: %u\n"
+                          "path queries: %u (%u cached, %u nodes)\nflow fields: %u (%u shared, %u cells)\n"
+                          "path requests: %u (%u shared, %u queued)\nroutes: %u (%u cluster nodes, %u legs)\n"
+                          "terrain patches: %u (full detail %u)\nterrain triangles: %u (full detail %u)\n"
+                          "terrain tiles: %u resident, %u loading",
+                          entities.count, jobs_get_worker_count(), stats->avoid_queries, stats->avoid_neighbors, stats->avoid_overlaps,
+                          stats->avoid_crowded,
+                          stats->path_queries, stats->path_cache_hits, stats->path_nodes_expanded,
+                          stats->flow_fields, stats->flow_shared, stats->flow_cells,
+                          stats->path_requests, stats->path_requests_shared, stats->path_requests_queued,
+                          stats->path_routes, stats->path_route_nodes, stats->path_refined,
+                          terrain_stats->patches, terrain_stats->patches_full, terrain_stats->triangles, terrain_stats->triangles_full,
+                          stream_stats.resident, stream_stats.loading),
+               10, 30, 20, WHITE);
+    }
+
     #if 0
     DrawFPS(10, 10);
     DrawText(TextFormat("%.4f\n%.4f\n%05.4f",
@@ -438,13 +555,16 @@ int main(void)
 
   // arrfree(meshes);
   // arrfree(mats);
-  UnloadMesh(terrain_mesh);
+  terrain_unload(&terrain_mesh);
   UnloadTexture(terrain_material.maps[MATERIAL_MAP_DIFFUSE].texture);
   UnloadMaterial(terrain_material);
-  MemFree(terrain_map.value);
+  terrain_map_unload(&terrain_map);
 
   // Free entities here
-  entity_unload_all(entities);
+  entity_unload_all(&entities);
+  path_hpa_free(&path_hpa);
+  path_grid_free(&path_grid);
+  jobs_shutdown();
   UnloadShader(mesh_phong);
   
   CloseWindow();
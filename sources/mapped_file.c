@@ -0,0 +1,144 @@
+// madvise and its MADV_ flags are gnu/bsd extensions, a strict -std=c11 build hides them without this. posix_madvise
+// is no replacement, glibc ignores POSIX_MADV_DONTNEED
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+#include "mapped_file.h"
+
+#include <stdio.h>
+
+// raylib.h is left out on purpose, its names clash with windows.h
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#define NOUSER
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool mapped_file_open(const char *path, game_mapped_file_t *file)
+{
+  *file = (game_mapped_file_t){0};
+#if defined(_WIN32)
+  HANDLE file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file_handle == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_handle, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(file_handle);
+    return false;
+  }
+  HANDLE mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  const void *data = mapping_handle != NULL ? MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0) : NULL;
+  if (data == NULL)
+  {
+    fprintf(stderr, "MAPPED_FILE: Failed to map %s\n", path);
+    if (mapping_handle != NULL)
+    {
+      CloseHandle(mapping_handle);
+    }
+    CloseHandle(file_handle);
+    return false;
+  }
+  file->file_handle = file_handle;
+  file->mapping_handle = mapping_handle;
+  file->size = (size_t)size.QuadPart;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    close(fd);
+    return false;
+  }
+  // the mapping keeps its own reference to the file
+  void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    fprintf(stderr, "MAPPED_FILE: Failed to map %s\n", path);
+    return false;
+  }
+  file->size = (size_t)info.st_size;
+#endif
+  file->data = data;
+  return true;
+}
+
+void mapped_file_close(game_mapped_file_t *file)
+{
+  if (file->data == NULL)
+  {
+    return;
+  }
+#if defined(_WIN32)
+  UnmapViewOfFile(file->data);
+  CloseHandle(file->mapping_handle);
+  CloseHandle(file->file_handle);
+#else
+  munmap((void *)file->data, file->size);
+#endif
+  *file = (game_mapped_file_t){0};
+}
+
+#if !defined(_WIN32)
+static size_t mapped_file_page_size(void)
+{
+  long size = sysconf(_SC_PAGESIZE);
+  return size > 0 ? (size_t)size : 4096;
+}
+#endif
+
+void mapped_file_will_need(const game_mapped_file_t *file, size_t offset, size_t size)
+{
+#if defined(_WIN32)
+  // PrefetchVirtualMemory needs windows 8 headers, the first access reads the pages in anyway
+  (void)file;
+  (void)offset;
+  (void)size;
+#else
+  // widened to whole pages, reading a little extra is harmless
+  size_t page = mapped_file_page_size();
+  size_t first = offset / page * page;
+  size_t end = offset + size < file->size ? offset + size : file->size;
+  if (end > first)
+  {
+    madvise((void *)(file->data + first), end - first, MADV_WILLNEED);
+  }
+#endif
+}
+
+void mapped_file_dont_need(const game_mapped_file_t *file, size_t offset, size_t size)
+{
+  // narrowed to whole pages, a page shared with a neighbouring range stays put
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  size_t page = info.dwPageSize;
+#else
+  size_t page = mapped_file_page_size();
+#endif
+  size_t first = (offset + page - 1) / page * page;
+  size_t end = (offset + size < file->size ? offset + size : file->size) / page * page;
+  if (end <= first)
+  {
+    return;
+  }
+#if defined(_WIN32)
+  // unlocking pages that were never locked trims them from the working set
+  VirtualUnlock((void *)(file->data + first), end - first);
+#else
+  madvise((void *)(file->data + first), end - first, MADV_DONTNEED);
+#endif
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// read only view of a whole file, pages are faulted in on first access and may be dropped again by the os
+typedef struct game_mapped_file_t
+{
+  const uint8_t *data;
+  size_t size;
+  void *file_handle;    // windows only
+  void *mapping_handle; // windows only
+} game_mapped_file_t;
+
+bool mapped_file_open(const char *path, game_mapped_file_t *file);
+
+void mapped_file_close(game_mapped_file_t *file);
+
+// hints for [offset, offset + size), the range stays readable either way. will_need starts reading it in the
+// background, dont_need hands the pages back so the next access reads them from disk again
+void mapped_file_will_need(const game_mapped_file_t *file, size_t offset, size_t size);
+void mapped_file_dont_need(const game_mapped_file_t *file, size_t offset, size_t size);
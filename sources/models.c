@@ -79,7 +79,9 @@ void entity_draw_actor(Model *model, int team)
     }
 }
 
-void entity_draw_mesh(Mesh mesh, Material material, Matrix transform)
+// with ranges, binds everything once and draws each range of the element buffer in mesh.vboId[6].
+// is_index32 reads that buffer as 32 bit indices, raylib's Mesh can only describe 16 bit ones
+static void entity_draw_mesh_ex(Mesh mesh, const game_draw_range_t *ranges, int range_count, bool is_index32, Material material, Matrix transform)
 {
     #ifndef MAX_MATERIAL_MAPS
     #define MAX_MATERIAL_MAPS              12       // Maximum number of shader maps supported
@@ -226,14 +228,24 @@ void entity_draw_mesh(Mesh mesh, Material material, Matrix transform)
             rlEnableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_TEXCOORD02]);
         }
 
-        if (mesh.indices != NULL) rlEnableVertexBufferElement(mesh.vboId[6]);
+        if (mesh.indices != NULL || is_index32) rlEnableVertexBufferElement(mesh.vboId[6]);
     }
 
     // WARNING: Disable vertex attribute color input if mesh can not provide that data (despite location being enabled in shader)
     if (mesh.vboId[3] == 0) rlDisableVertexAttribute(material.shader.locs[SHADER_LOC_VERTEX_COLOR]);
 
     // Draw mesh
-    if (mesh.indices != NULL) rlDrawVertexArrayElements(0, mesh.triangleCount*3, 0);
+    if (ranges != NULL)
+    {
+        GLenum index_type = is_index32 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        size_t index_size = is_index32 ? sizeof(uint32_t) : sizeof(unsigned short);
+        for (int r = 0; r < range_count; r++)
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)ranges[r].count, index_type,
+                                     (void *)(uintptr_t)(ranges[r].first * index_size), ranges[r].base_vertex);
+        }
+    }
+    else if (mesh.indices != NULL) rlDrawVertexArrayElements(0, mesh.triangleCount*3, 0);
     else rlDrawVertexArray(0, mesh.vertexCount);
 
 
@@ -270,6 +282,16 @@ void entity_draw_mesh(Mesh mesh, Material material, Matrix transform)
 }
 
 
+void entity_draw_mesh(Mesh mesh, Material material, Matrix transform)
+{
+    entity_draw_mesh_ex(mesh, NULL, 0, false, material, transform);
+}
+
+void entity_draw_mesh_ranges(Mesh mesh, const game_draw_range_t *ranges, int range_count, bool is_index32, Material material, Matrix transform)
+{
+    if (range_count > 0) entity_draw_mesh_ex(mesh, ranges, range_count, is_index32, material, transform);
+}
+
 // Upload vertex data into a VAO (if supported) and VBO
 void entity_upload_mesh(Mesh *mesh, bool dynamic)
 {
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
 #include "raylib.h"
 
 typedef struct Model Model;
@@ -12,6 +13,18 @@ void entity_draw_actor(Model *model, int team);
 
 void entity_draw_mesh(Mesh mesh, Material material, Matrix transform);
 
+// contiguous run of indices in a mesh's element buffer, base_vertex is added to every index of the run
+typedef struct game_draw_range_t
+{
+  uint32_t first;
+  uint32_t count;
+  int32_t base_vertex;
+} game_draw_range_t;
+
+// binds mesh and material once and issues one draw per range. is_index32 means mesh.vboId[6] holds 32 bit indices
+// while mesh.indices stays NULL, otherwise the ranges index the regular 16 bit buffer
+void entity_draw_mesh_ranges(Mesh mesh, const game_draw_range_t *ranges, int range_count, bool is_index32, Material material, Matrix transform);
+
 Model entity_load_model(const char *fileName);
 
 void entity_upload_mesh(Mesh *mesh, bool dynamic);
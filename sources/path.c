@@ -0,0 +1,1795 @@
+#include "path.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stb_ds.h"
+
+#include "jobs.h"
+#include "util.h"
+
+#define PATH_DIAGONAL 1.41421356f
+#define PATH_FLOW_GOAL 4    // direction of the goal cell, the (0, 0) step
+#define PATH_FLOW_NONE 0xFF // cells the field never reached
+
+static const int path_neighbour_dx[8] = {1, -1, 0, 0, 1, -1, 1, -1};
+static const int path_neighbour_dz[8] = {0, 0, 1, -1, 1, 1, -1, -1};
+
+struct game_path_flow_t
+{
+  int cell_count; // of the grid the field was built on
+  uint32_t version;
+  uint32_t goal_cell;
+  Vector2 goal;
+  atomic_uint refs;
+  uint8_t *direction; // per cell, (dz + 1) * 3 + (dx + 1) of the step toward the goal, or PATH_FLOW_NONE
+};
+
+// a box of the grid small enough to stay in cache and to give every worker one, cells are indexed within the box.
+// the arrays grow to the largest box asked for
+struct game_path_window_t
+{
+  int x0; // grid cells it covers, inclusive
+  int z0;
+  int x1;
+  int z1;
+  int capacity; // cells the arrays hold
+  float *g;
+  uint32_t *parent;
+  uint64_t *opened;
+  uint64_t *closed;
+  uint64_t *stops; // cells a Dijkstra pass is after, it ends once it settled all of them
+  int stop_count;
+  game_path_open_t *heap; // stb_ds array
+  uint32_t *cells;        // stb_ds array, grid cells of the last path from start to goal
+};
+
+typedef struct game_path_hpa_job_t
+{
+  const game_path_grid_t *grid;
+  game_path_hpa_t *hpa;
+  const uint32_t *clusters; // indices to rebuild, NULL for all of them
+} game_path_hpa_job_t;
+
+// from the steepest height difference between the corners of quad (x, z)
+static uint8_t path_cell_cost(const game_terrain_map_t *terrain_map, int x, int z)
+{
+  float h00 = terrain_get_height(terrain_map, x, z);
+  float h10 = terrain_get_height(terrain_map, x + 1, z);
+  float h01 = terrain_get_height(terrain_map, x, z + 1);
+  float h11 = terrain_get_height(terrain_map, x + 1, z + 1);
+  float low = fminf(fminf(h00, h10), fminf(h01, h11));
+  float high = fmaxf(fmaxf(h00, h10), fmaxf(h01, h11));
+  float slope = high - low;
+  if (slope > PATH_MAX_SLOPE)
+  {
+    return 0;
+  }
+  float cost = PATH_COST_SCALE * (1.0f + PATH_SLOPE_COST * fmaxf(slope - PATH_FLAT_SLOPE, 0.0f));
+  return (uint8_t)clamp_int((int)lroundf(cost), 1, 255);
+}
+
+// flood fills 4-connected open cells, diagonal moves need both orthogonal cells open so they never join two regions
+static void path_grid_label_regions(game_path_grid_t *grid)
+{
+  int cell_count = grid->cells_x * grid->cells_z;
+  memset(grid->region, 0, sizeof(*grid->region) * cell_count);
+  uint32_t *stack = RL_MALLOC(sizeof(*stack) * cell_count);
+  uint32_t next_region = 1;
+  for (int seed = 0; seed < cell_count; seed++)
+  {
+    if (grid->cost[seed] == 0 || grid->region[seed] != 0)
+    {
+      continue;
+    }
+    int top = 0;
+    stack[top++] = (uint32_t)seed;
+    grid->region[seed] = next_region;
+    while (top > 0)
+    {
+      uint32_t cell = stack[--top];
+      int x = (int)(cell % grid->cells_x), z = (int)(cell / grid->cells_x);
+      for (int n = 0; n < 4; n++)
+      {
+        int nx = x + path_neighbour_dx[n], nz = z + path_neighbour_dz[n];
+        if (nx < 0 || nz < 0 || nx >= grid->cells_x || nz >= grid->cells_z)
+        {
+          continue;
+        }
+        uint32_t neighbour = (uint32_t)(nz * grid->cells_x + nx);
+        if (grid->cost[neighbour] != 0 && grid->region[neighbour] == 0)
+        {
+          grid->region[neighbour] = next_region;
+          stack[top++] = neighbour;
+        }
+      }
+    }
+    next_region++;
+  }
+  RL_FREE(stack);
+  // every region starts out as its own root, 0 included so blocked cells resolve to it
+  arrsetlen(grid->region_parent, next_region);
+  arrsetlen(grid->region_rank, next_region);
+  for (uint32_t region = 0; region < next_region; region++)
+  {
+    grid->region_parent[region] = region;
+    grid->region_rank[region] = 0;
+  }
+}
+
+uint32_t path_grid_region(const game_path_grid_t *grid, uint32_t cell)
+{
+  uint32_t region = grid->region[cell];
+  while (grid->region_parent[region] != region)
+  {
+    region = grid->region_parent[region];
+  }
+  return region;
+}
+
+// path_grid_region for a region id that also halves the path, for path_grid_update only since workers read the grid
+static uint32_t path_region_find(game_path_grid_t *grid, uint32_t region)
+{
+  while (grid->region_parent[region] != region)
+  {
+    grid->region_parent[region] = grid->region_parent[grid->region_parent[region]];
+    region = grid->region_parent[region];
+  }
+  return region;
+}
+
+// joins two regions by rank, returns the root of the result
+static uint32_t path_region_union(game_path_grid_t *grid, uint32_t a, uint32_t b)
+{
+  a = path_region_find(grid, a);
+  b = path_region_find(grid, b);
+  if (a == b)
+  {
+    return a;
+  }
+  if (grid->region_rank[a] < grid->region_rank[b])
+  {
+    uint32_t swap = a;
+    a = b;
+    b = swap;
+  }
+  grid->region_parent[b] = a;
+  if (grid->region_rank[a] == grid->region_rank[b])
+  {
+    grid->region_rank[a]++;
+  }
+  return a;
+}
+
+static uint32_t path_region_new(game_path_grid_t *grid)
+{
+  uint32_t region = (uint32_t)arrlenu(grid->region_parent);
+  arrput(grid->region_parent, region);
+  arrput(grid->region_rank, 0);
+  return region;
+}
+
+// union-find over the pieces of a relabel, no ranks, they are few and short lived
+static uint32_t path_piece_find(uint32_t *parent, uint32_t piece)
+{
+  while (parent[piece] != piece)
+  {
+    parent[piece] = parent[parent[piece]];
+    piece = parent[piece];
+  }
+  return piece;
+}
+
+static int path_compare_keys(const void *a, const void *b)
+{
+  uint64_t key_a = *(const uint64_t *)a, key_b = *(const uint64_t *)b;
+  return (key_a > key_b) - (key_a < key_b);
+}
+
+// the cells of region outside the box that the ports of each group reach. the floods take one cell each in turn and
+// join when they meet, so one left on its own is done after about as many cells as the smallest piece has. every group
+// that ends up cut off from the rest gets a new region for its cells and out_labels of it, the last one keeps region
+static void path_grid_split_region(game_path_grid_t *grid, int x0, int z0, int x1, int z1, uint32_t region, const uint32_t *seeds,
+                                   const uint32_t *seed_groups, uint32_t seed_count, uint32_t group_count, uint32_t *out_labels)
+{
+  // marks are mark_base + flood, the base moves past the floods of every split so the marks never need clearing
+  if (grid->region_mark == NULL || grid->region_mark_base > UINT32_MAX - group_count)
+  {
+    RL_FREE(grid->region_mark);
+    grid->region_mark = RL_CALLOC(grid->cells_x * grid->cells_z, sizeof(*grid->region_mark));
+    grid->region_mark_base = 1;
+  }
+  uint32_t base = grid->region_mark_base;
+  grid->region_mark_base += group_count;
+  uint32_t **queues = RL_CALLOC(group_count, sizeof(*queues)); // stb_ds arrays, every cell the flood took stays in it
+  uint32_t *heads = RL_CALLOC(group_count * 2, sizeof(*heads));
+  uint32_t *joined = heads + group_count; // union-find over the floods
+  for (uint32_t group = 0; group < group_count; group++)
+  {
+    joined[group] = group;
+    out_labels[group] = region;
+  }
+  for (uint32_t i = 0; i < seed_count; i++)
+  {
+    grid->region_mark[seeds[i]] = base + seed_groups[i];
+    arrput(queues[seed_groups[i]], seeds[i]);
+  }
+  uint32_t unresolved = group_count;
+  while (unresolved > 1)
+  {
+    for (uint32_t flood = 0; flood < group_count && unresolved > 1; flood++)
+    {
+      if (heads[flood] == arrlenu(queues[flood]))
+      {
+        continue;
+      }
+      uint32_t cell = queues[flood][heads[flood]++];
+      int x = (int)(cell % grid->cells_x), z = (int)(cell / grid->cells_x);
+      for (int n = 0; n < 4 && unresolved > 1; n++)
+      {
+        int nx = x + path_neighbour_dx[n], nz = z + path_neighbour_dz[n];
+        if (nx < 0 || nz < 0 || nx >= grid->cells_x || nz >= grid->cells_z || (nx >= x0 && nx <= x1 && nz >= z0 && nz <= z1))
+        {
+          continue;
+        }
+        uint32_t neighbour = (uint32_t)(nz * grid->cells_x + nx);
+        if (grid->cost[neighbour] == 0 || path_region_find(grid, grid->region[neighbour]) != region)
+        {
+          continue;
+        }
+        uint32_t mark = grid->region_mark[neighbour];
+        if (mark < base || mark - base >= group_count)
+        {
+          grid->region_mark[neighbour] = base + flood;
+          arrput(queues[flood], neighbour);
+          continue;
+        }
+        uint32_t a = path_piece_find(joined, flood), b = path_piece_find(joined, mark - base);
+        if (a != b)
+        {
+          joined[b] = a;
+          unresolved--;
+        }
+      }
+    }
+    // joined floods with nothing left to take are a piece of their own
+    for (uint32_t root = 0; root < group_count && unresolved > 1; root++)
+    {
+      if (path_piece_find(joined, root) != root || out_labels[root] != region)
+      {
+        continue;
+      }
+      bool is_exhausted = true;
+      for (uint32_t flood = 0; flood < group_count && is_exhausted; flood++)
+      {
+        is_exhausted = path_piece_find(joined, flood) != root || heads[flood] == arrlenu(queues[flood]);
+      }
+      if (!is_exhausted)
+      {
+        continue;
+      }
+      uint32_t label = path_region_new(grid);
+      for (uint32_t flood = 0; flood < group_count; flood++)
+      {
+        if (path_piece_find(joined, flood) != root)
+        {
+          continue;
+        }
+        for (size_t i = 0; i < arrlenu(queues[flood]); i++)
+        {
+          grid->region[queues[flood][i]] = label;
+        }
+      }
+      out_labels[root] = label;
+      unresolved--;
+    }
+  }
+  for (uint32_t group = 0; group < group_count; group++)
+  {
+    out_labels[group] = out_labels[path_piece_find(joined, group)];
+    arrfree(queues[group]);
+  }
+  RL_FREE(heads);
+  RL_FREE(queues);
+}
+
+// relabels the open cells of the box whose costs changed. the pieces are the components inside the box and the open
+// cells just around it, the ports. components touching ports of different regions merge them, ports of one region that
+// only the outside connected may have been cut apart, which a flood from each side tells. everything else keeps its label
+static void path_grid_relabel(game_path_grid_t *grid, int x0, int z0, int x1, int z1)
+{
+  // the box with a ring of ports around it, holds piece + 1 of every open cell and 0 for blocked ones
+  int ring_x = x1 - x0 + 3, ring_z = z1 - z0 + 3;
+  uint32_t *local = RL_CALLOC(ring_x * ring_z, sizeof(*local));
+  uint32_t *pieces = NULL;
+  uint32_t *stack = NULL;
+  uint32_t component_count = 0;
+  for (int z = z0; z <= z1; z++)
+  {
+    for (int x = x0; x <= x1; x++)
+    {
+      uint32_t cell = (uint32_t)(z * grid->cells_x + x);
+      int seed = (z - z0 + 1) * ring_x + x - x0 + 1;
+      if (grid->cost[cell] == 0)
+      {
+        grid->region[cell] = 0;
+        continue;
+      }
+      if (local[seed] != 0)
+      {
+        continue;
+      }
+      arrput(pieces, component_count);
+      local[seed] = ++component_count;
+      arrput(stack, (uint32_t)seed);
+      while (arrlenu(stack) > 0)
+      {
+        uint32_t ring_cell = arrpop(stack);
+        int lx = (int)(ring_cell % ring_x), lz = (int)(ring_cell / ring_x);
+        for (int n = 0; n < 4; n++)
+        {
+          int nx = lx + path_neighbour_dx[n], nz = lz + path_neighbour_dz[n];
+          if (nx < 1 || nz < 1 || nx >= ring_x - 1 || nz >= ring_z - 1)
+          {
+            continue;
+          }
+          int neighbour = nz * ring_x + nx;
+          if (local[neighbour] == 0 && grid->cost[(z0 + nz - 1) * grid->cells_x + x0 + nx - 1] != 0)
+          {
+            local[neighbour] = component_count;
+            arrput(stack, (uint32_t)neighbour);
+          }
+        }
+      }
+    }
+  }
+
+  // ports join the components they touch and the ports next to them, those were already connected
+  uint32_t *port_cells = NULL;
+  uint64_t *port_keys = NULL; // region << 32 | port, sorted to walk the ports one region at a time
+  for (int lz = 0; lz < ring_z; lz++)
+  {
+    for (int lx = 0; lx < ring_x; lx++)
+    {
+      int x = x0 + lx - 1, z = z0 + lz - 1;
+      bool is_ring = lx == 0 || lz == 0 || lx == ring_x - 1 || lz == ring_z - 1;
+      if (!is_ring || x < 0 || z < 0 || x >= grid->cells_x || z >= grid->cells_z || grid->cost[z * grid->cells_x + x] == 0)
+      {
+        continue;
+      }
+      uint32_t cell = (uint32_t)(z * grid->cells_x + x);
+      uint32_t piece = (uint32_t)arrlenu(pieces);
+      uint32_t port = (uint32_t)arrlenu(port_cells);
+      arrput(pieces, piece);
+      arrput(port_cells, cell);
+      arrput(port_keys, (uint64_t)path_region_find(grid, grid->region[cell]) << 32 | port);
+      local[lz * ring_x + lx] = piece + 1;
+      // the neighbours before this one in the walk, the others join it when their turn comes
+      for (int n = 0; n < 4; n++)
+      {
+        int nx = lx + path_neighbour_dx[n], nz = lz + path_neighbour_dz[n];
+        if (nx < 0 || nz < 0 || nx >= ring_x || nz >= ring_z || local[nz * ring_x + nx] == 0)
+        {
+          continue;
+        }
+        uint32_t other = local[nz * ring_x + nx] - 1;
+        pieces[path_piece_find(pieces, piece)] = path_piece_find(pieces, other);
+      }
+    }
+  }
+
+  // a region whose ports fall in more than one piece may have been split by the edit
+  uint32_t port_count = (uint32_t)arrlenu(port_cells);
+  uint32_t *port_labels = RL_CALLOC(port_count * 4 + 1, sizeof(*port_labels));
+  uint32_t *seeds = port_labels + port_count;
+  uint32_t *seed_groups = seeds + port_count;
+  uint32_t *group_pieces = seed_groups + port_count;
+  if (port_count > 0)
+  {
+    qsort(port_keys, port_count, sizeof(*port_keys), path_compare_keys);
+  }
+  for (uint32_t first = 0, last; first < port_count; first = last)
+  {
+    uint32_t region = (uint32_t)(port_keys[first] >> 32);
+    uint32_t group_count = 0;
+    for (last = first; last < port_count && (uint32_t)(port_keys[last] >> 32) == region; last++)
+    {
+      uint32_t port = (uint32_t)port_keys[last];
+      uint32_t root = path_piece_find(pieces, component_count + port);
+      uint32_t group = 0;
+      while (group < group_count && group_pieces[group] != root)
+      {
+        group++;
+      }
+      group_pieces[group] = root;
+      group_count = group == group_count ? group_count + 1 : group_count;
+      seeds[last - first] = port_cells[port];
+      seed_groups[last - first] = group;
+      port_labels[port] = region;
+    }
+    if (group_count > 1)
+    {
+      // the labels of the groups land in group_pieces, the pieces are not needed any more
+      path_grid_split_region(grid, x0, z0, x1, z1, region, seeds, seed_groups, last - first, group_count, group_pieces);
+      for (uint32_t i = first; i < last; i++)
+      {
+        port_labels[(uint32_t)port_keys[i]] = group_pieces[seed_groups[i - first]];
+      }
+    }
+  }
+
+  // each piece takes the labels of its ports, merged into one, or a new one when it has none
+  uint32_t *piece_labels = RL_CALLOC(arrlenu(pieces), sizeof(*piece_labels));
+  for (uint32_t port = 0; port < port_count; port++)
+  {
+    uint32_t root = path_piece_find(pieces, component_count + port);
+    piece_labels[root] = piece_labels[root] == 0 ? port_labels[port] : path_region_union(grid, piece_labels[root], port_labels[port]);
+  }
+  for (int z = z0; z <= z1; z++)
+  {
+    for (int x = x0; x <= x1; x++)
+    {
+      uint32_t piece = local[(z - z0 + 1) * ring_x + x - x0 + 1];
+      if (piece == 0)
+      {
+        continue;
+      }
+      uint32_t root = path_piece_find(pieces, piece - 1);
+      if (piece_labels[root] == 0)
+      {
+        piece_labels[root] = path_region_new(grid);
+      }
+      grid->region[z * grid->cells_x + x] = piece_labels[root];
+    }
+  }
+  RL_FREE(piece_labels);
+  RL_FREE(port_labels);
+  arrfree(port_keys);
+  arrfree(port_cells);
+  arrfree(stack);
+  arrfree(pieces);
+  RL_FREE(local);
+}
+
+bool path_grid_build(game_path_grid_t *grid, const game_terrain_map_t *terrain_map)
+{
+  if (terrain_map->max_width < 2 || terrain_map->max_height < 2)
+  {
+    TraceLog(LOG_ERROR, "PATH: terrain map of %dx%d samples has no quads", terrain_map->max_width, terrain_map->max_height);
+    return false;
+  }
+  path_grid_free(grid);
+  grid->cells_x = terrain_map->max_width - 1;
+  grid->cells_z = terrain_map->max_height - 1;
+  grid->origin = (Vector2){-terrain_map->max_width / 2.0f, -terrain_map->max_height / 2.0f};
+  grid->cost = RL_MALLOC(sizeof(*grid->cost) * grid->cells_x * grid->cells_z);
+  grid->region = RL_MALLOC(sizeof(*grid->region) * grid->cells_x * grid->cells_z);
+  for (int z = 0; z < grid->cells_z; z++)
+  {
+    for (int x = 0; x < grid->cells_x; x++)
+    {
+      grid->cost[z * grid->cells_x + x] = path_cell_cost(terrain_map, x, z);
+    }
+  }
+  path_grid_label_regions(grid);
+  // empty cache slots hold version 0, so they never match a grid
+  grid->version = 1;
+  return true;
+}
+
+void path_grid_update(game_path_grid_t *grid, const game_terrain_map_t *terrain_map, game_terrain_rect_t rect)
+{
+  if (grid->cost == NULL || rect.x0 > rect.x1 || rect.z0 > rect.z1)
+  {
+    return;
+  }
+  // a sample is a corner of the quads on both sides of it
+  int x0 = clamp_int(rect.x0 - 1, 0, grid->cells_x - 1), x1 = clamp_int(rect.x1, 0, grid->cells_x - 1);
+  int z0 = clamp_int(rect.z0 - 1, 0, grid->cells_z - 1), z1 = clamp_int(rect.z1, 0, grid->cells_z - 1);
+  bool is_flipped = false;
+  for (int z = z0; z <= z1; z++)
+  {
+    for (int x = x0; x <= x1; x++)
+    {
+      uint8_t cost = path_cell_cost(terrain_map, x, z);
+      uint8_t *old_cost = &grid->cost[z * grid->cells_x + x];
+      is_flipped |= (cost == 0) != (*old_cost == 0);
+      *old_cost = cost;
+    }
+  }
+  // regions only change when a cell opened or closed
+  if (is_flipped)
+  {
+    path_grid_relabel(grid, x0, z0, x1, z1);
+  }
+  grid->version++;
+}
+
+void path_grid_free(game_path_grid_t *grid)
+{
+  RL_FREE(grid->cost);
+  RL_FREE(grid->region);
+  arrfree(grid->region_parent);
+  arrfree(grid->region_rank);
+  RL_FREE(grid->region_mark);
+  memset(grid, 0, sizeof *grid);
+}
+
+void path_grid_get_cell(const game_path_grid_t *grid, Vector2 position, int *cell_x, int *cell_z)
+{
+  *cell_x = clamp_int((int)floorf(position.x - grid->origin.x), 0, grid->cells_x - 1);
+  *cell_z = clamp_int((int)floorf(position.y - grid->origin.y), 0, grid->cells_z - 1);
+}
+
+Vector2 path_grid_cell_center(const game_path_grid_t *grid, int cell_x, int cell_z)
+{
+  return (Vector2){grid->origin.x + cell_x + 0.5f, grid->origin.y + cell_z + 0.5f};
+}
+
+// closest open cell to (cell_x, cell_z) within PATH_GOAL_SEARCH_RADIUS, in region unless it is 0. -1 when there is none
+static int64_t path_grid_nearest_open(const game_path_grid_t *grid, int cell_x, int cell_z, uint32_t region)
+{
+  int64_t best = -1;
+  int best_dist_sq = INT32_MAX;
+  int x0 = clamp_int(cell_x - PATH_GOAL_SEARCH_RADIUS, 0, grid->cells_x - 1);
+  int x1 = clamp_int(cell_x + PATH_GOAL_SEARCH_RADIUS, 0, grid->cells_x - 1);
+  int z0 = clamp_int(cell_z - PATH_GOAL_SEARCH_RADIUS, 0, grid->cells_z - 1);
+  int z1 = clamp_int(cell_z + PATH_GOAL_SEARCH_RADIUS, 0, grid->cells_z - 1);
+  for (int z = z0; z <= z1; z++)
+  {
+    for (int x = x0; x <= x1; x++)
+    {
+      int cell = z * grid->cells_x + x;
+      int dist_sq = (x - cell_x) * (x - cell_x) + (z - cell_z) * (z - cell_z);
+      if (grid->cost[cell] != 0 && (region == 0 || path_grid_region(grid, (uint32_t)cell) == region) && dist_sq < best_dist_sq)
+      {
+        best = cell;
+        best_dist_sq = dist_sq;
+      }
+    }
+  }
+  return best;
+}
+
+// octile distance, never overestimates since open cells cost at least as much as flat ground
+static float path_heuristic(int x, int z, int goal_x, int goal_z)
+{
+  int dx = abs(x - goal_x), dz = abs(z - goal_z);
+  int low = dx < dz ? dx : dz, high = dx < dz ? dz : dx;
+  return (float)(high - low) + PATH_DIAGONAL * (float)low;
+}
+
+static bool path_open_less(game_path_open_t a, game_path_open_t b)
+{
+  return a.f < b.f || (a.f == b.f && a.h < b.h);
+}
+
+// heap is an stb_ds array
+static void path_heap_push(game_path_open_t **heap, game_path_open_t node)
+{
+  arrput(*heap, node);
+  size_t i = arrlenu(*heap) - 1;
+  while (i > 0)
+  {
+    size_t parent = (i - 1) / 2;
+    if (!path_open_less(node, (*heap)[parent]))
+    {
+      break;
+    }
+    (*heap)[i] = (*heap)[parent];
+    i = parent;
+  }
+  (*heap)[i] = node;
+}
+
+static game_path_open_t path_heap_pop(game_path_open_t *heap)
+{
+  game_path_open_t top = heap[0];
+  game_path_open_t last = arrpop(heap);
+  size_t count = arrlenu(heap);
+  if (count == 0)
+  {
+    return top;
+  }
+  size_t i = 0;
+  for (;;)
+  {
+    size_t child = 2 * i + 1;
+    if (child >= count)
+    {
+      break;
+    }
+    if (child + 1 < count && path_open_less(heap[child + 1], heap[child]))
+    {
+      child++;
+    }
+    if (!path_open_less(heap[child], last))
+    {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+  return top;
+}
+
+static bool path_bit_test(const uint64_t *bits, uint32_t cell)
+{
+  return (bits[cell >> 6] >> (cell & 63)) & 1;
+}
+
+static void path_search_reserve(game_path_search_t *search, int cell_count)
+{
+  if (search->cell_count == cell_count)
+  {
+    return;
+  }
+  path_search_free(search);
+  int word_count = (cell_count + 63) / 64;
+  search->cell_count = cell_count;
+  search->g = RL_MALLOC(sizeof(*search->g) * cell_count);
+  search->parent = RL_MALLOC(sizeof(*search->parent) * cell_count);
+  search->opened = RL_CALLOC(word_count, sizeof(*search->opened));
+  search->closed = RL_CALLOC(word_count, sizeof(*search->closed));
+}
+
+// clears only the words the last search wrote, closed cells are always opened first so one list covers both
+static void path_search_reset(game_path_search_t *search)
+{
+  for (size_t i = 0; i < arrlenu(search->touched_words); i++)
+  {
+    search->opened[search->touched_words[i]] = 0;
+    search->closed[search->touched_words[i]] = 0;
+  }
+  arrsetlen(search->touched_words, 0);
+  arrsetlen(search->heap, 0);
+  arrsetlen(search->cells, 0);
+  search->expanded = 0;
+}
+
+static void path_search_open(game_path_search_t *search, uint32_t cell, uint32_t parent, float g, float h)
+{
+  uint32_t word = cell >> 6;
+  if (search->opened[word] == 0)
+  {
+    arrput(search->touched_words, word);
+  }
+  search->opened[word] |= 1ull << (cell & 63);
+  search->g[cell] = g;
+  search->parent[cell] = parent;
+  path_heap_push(&search->heap, (game_path_open_t){g + h, h, cell});
+}
+
+// opens or improves the neighbours of a closed cell, with octile moves that never cut past a blocked corner. a weight
+// of 0 turns the search into Dijkstra
+static void path_search_expand(const game_path_grid_t *grid, game_path_search_t *search, uint32_t cell, int goal_x, int goal_z,
+                               float heuristic_weight)
+{
+  int x = (int)(cell % grid->cells_x), z = (int)(cell / grid->cells_x);
+  float g = search->g[cell];
+  for (int n = 0; n < 8; n++)
+  {
+    int nx = x + path_neighbour_dx[n], nz = z + path_neighbour_dz[n];
+    if (nx < search->bounds_x0 || nz < search->bounds_z0 || nx > search->bounds_x1 || nz > search->bounds_z1)
+    {
+      continue;
+    }
+    uint32_t neighbour = (uint32_t)(nz * grid->cells_x + nx);
+    uint8_t cost = grid->cost[neighbour];
+    if (cost == 0 || path_bit_test(search->closed, neighbour))
+    {
+      continue;
+    }
+    if (n >= 4 && (grid->cost[z * grid->cells_x + nx] == 0 || grid->cost[nz * grid->cells_x + x] == 0))
+    {
+      continue;
+    }
+    float step = (n >= 4 ? PATH_DIAGONAL : 1.0f) * (float)cost * (1.0f / PATH_COST_SCALE);
+    float neighbour_g = g + step;
+    if (path_bit_test(search->opened, neighbour) && search->g[neighbour] <= neighbour_g)
+    {
+      continue;
+    }
+    float h = heuristic_weight > 0.0f ? heuristic_weight * path_heuristic(nx, nz, goal_x, goal_z) : 0.0f;
+    path_search_open(search, neighbour, cell, neighbour_g, h);
+  }
+}
+
+// A* between two open cells of the same region, leaves the path in search->cells
+static bool path_search_cells(const game_path_grid_t *grid, game_path_search_t *search, uint32_t start, uint32_t goal)
+{
+  path_search_reserve(search, grid->cells_x * grid->cells_z);
+  path_search_reset(search);
+  search->bounds_x0 = 0;
+  search->bounds_z0 = 0;
+  search->bounds_x1 = grid->cells_x - 1;
+  search->bounds_z1 = grid->cells_z - 1;
+  int goal_x = (int)(goal % grid->cells_x), goal_z = (int)(goal / grid->cells_x);
+  float start_h = PATH_HEURISTIC_WEIGHT * path_heuristic((int)(start % grid->cells_x), (int)(start / grid->cells_x), goal_x, goal_z);
+  path_search_open(search, start, start, 0.0f, start_h);
+  while (arrlenu(search->heap) > 0)
+  {
+    game_path_open_t node = path_heap_pop(search->heap);
+    // stale duplicate of a cell that was reopened with a lower g and already closed
+    if (path_bit_test(search->closed, node.cell))
+    {
+      continue;
+    }
+    search->closed[node.cell >> 6] |= 1ull << (node.cell & 63);
+    search->expanded++;
+    if (node.cell == goal)
+    {
+      for (uint32_t cell = goal; cell != start; cell = search->parent[cell])
+      {
+        arrput(search->cells, cell);
+      }
+      arrput(search->cells, start);
+      // walked back from the goal, flip to start first
+      size_t count = arrlenu(search->cells);
+      for (size_t i = 0; i < count / 2; i++)
+      {
+        uint32_t swap = search->cells[i];
+        search->cells[i] = search->cells[count - 1 - i];
+        search->cells[count - 1 - i] = swap;
+      }
+      return true;
+    }
+    path_search_expand(grid, search, node.cell, goal_x, goal_z, PATH_HEURISTIC_WEIGHT);
+  }
+  return false;
+}
+
+// start snaps to the closest open cell, goal to the closest one start can reach. false when either has none
+static bool path_resolve_cells(const game_path_grid_t *grid, Vector2 start, Vector2 goal, uint32_t *out_start, uint32_t *out_goal)
+{
+  int start_x, start_z, goal_x, goal_z;
+  path_grid_get_cell(grid, start, &start_x, &start_z);
+  path_grid_get_cell(grid, goal, &goal_x, &goal_z);
+  int64_t start_cell = path_grid_nearest_open(grid, start_x, start_z, 0);
+  if (start_cell < 0)
+  {
+    return false;
+  }
+  int64_t goal_cell = path_grid_nearest_open(grid, goal_x, goal_z, path_grid_region(grid, (uint32_t)start_cell));
+  if (goal_cell < 0)
+  {
+    return false;
+  }
+  *out_start = (uint32_t)start_cell;
+  *out_goal = (uint32_t)goal_cell;
+  return true;
+}
+
+bool path_search(const game_path_grid_t *grid, game_path_search_t *search, Vector2 start, Vector2 goal)
+{
+  uint32_t start_cell, goal_cell;
+  if (!path_resolve_cells(grid, start, goal, &start_cell, &goal_cell))
+  {
+    path_search_reserve(search, grid->cells_x * grid->cells_z);
+    path_search_reset(search);
+    return false;
+  }
+  return path_search_cells(grid, search, start_cell, goal_cell);
+}
+
+void path_search_free(game_path_search_t *search)
+{
+  RL_FREE(search->g);
+  RL_FREE(search->parent);
+  RL_FREE(search->opened);
+  RL_FREE(search->closed);
+  arrfree(search->touched_words);
+  arrfree(search->heap);
+  arrfree(search->cells);
+  memset(search, 0, sizeof *search);
+}
+
+// walks the cells under the line between the centers of a and b, true when every one is open and no worse than
+// max_cost. where the line passes exactly through a corner both cells beside it are checked
+static bool path_line_of_sight(const game_path_grid_t *grid, uint32_t a, uint32_t b, uint8_t max_cost)
+{
+  int x = (int)(a % grid->cells_x), z = (int)(a / grid->cells_x);
+  int end_x = (int)(b % grid->cells_x), end_z = (int)(b / grid->cells_x);
+  int dx = abs(end_x - x), dz = abs(end_z - z);
+  int step_x = end_x > x ? 1 : -1, step_z = end_z > z ? 1 : -1;
+  // integer DDA: error compares how far the line is through the current cell along x and along z
+  int error = dx - dz;
+  dx *= 2;
+  dz *= 2;
+  for (int remaining = abs(end_x - x) + abs(end_z - z); remaining > 0;)
+  {
+    if (error > 0)
+    {
+      x += step_x;
+      error -= dz;
+      remaining--;
+    }
+    else if (error < 0)
+    {
+      z += step_z;
+      error += dx;
+      remaining--;
+    }
+    else
+    {
+      uint8_t side_x = grid->cost[z * grid->cells_x + x + step_x];
+      uint8_t side_z = grid->cost[(z + step_z) * grid->cells_x + x];
+      if (side_x == 0 || side_x > max_cost || side_z == 0 || side_z > max_cost)
+      {
+        return false;
+      }
+      x += step_x;
+      z += step_z;
+      error += dx - dz;
+      remaining -= 2;
+    }
+    uint8_t cost = grid->cost[z * grid->cells_x + x];
+    if (cost == 0 || cost > max_cost)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// keeps the cells where the path turns that the straight line from the last kept cell can not skip
+static void path_smooth(const game_path_grid_t *grid, const uint32_t *cells, size_t count, Vector2 goal, Vector2 **out_waypoints)
+{
+  arrsetlen(*out_waypoints, 0);
+  size_t anchor = 0;
+  while (anchor + 1 < count)
+  {
+    size_t reached = anchor + 1;
+    uint8_t max_cost = grid->cost[cells[anchor]];
+    for (size_t i = anchor + 1; i < count; i++)
+    {
+      max_cost = grid->cost[cells[i]] > max_cost ? grid->cost[cells[i]] : max_cost;
+      // only turns and the last cell can end a straight run
+      bool turn = i + 1 == count || cells[i] - cells[i - 1] != cells[i + 1] - cells[i];
+      if (!turn)
+      {
+        continue;
+      }
+      if (!path_line_of_sight(grid, cells[anchor], cells[i], max_cost))
+      {
+        break;
+      }
+      reached = i;
+    }
+    anchor = reached;
+    if (anchor + 1 < count)
+    {
+      uint32_t cell = cells[anchor];
+      arrput(*out_waypoints, path_grid_cell_center(grid, (int)(cell % grid->cells_x), (int)(cell / grid->cells_x)));
+    }
+  }
+  arrput(*out_waypoints, goal);
+}
+
+// fibonacci hashing of both cells, neighbouring starts and goals land in different slots
+static size_t path_cache_slot(uint64_t key)
+{
+  return (size_t)((key * 0x9e3779b97f4a7c15ull) >> 56) & (PATH_CACHE_SLOTS - 1);
+}
+
+bool path_find(const game_path_grid_t *grid, game_path_cache_t *cache, game_path_search_t *search, Vector2 start, Vector2 goal,
+               Vector2 **out_waypoints)
+{
+  cache->stats.queries++;
+  int start_x, start_z, goal_x, goal_z;
+  path_grid_get_cell(grid, start, &start_x, &start_z);
+  path_grid_get_cell(grid, goal, &goal_x, &goal_z);
+  uint32_t asked_goal = (uint32_t)(goal_z * grid->cells_x + goal_x);
+  uint64_t key = (uint64_t)(start_z * grid->cells_x + start_x) | (uint64_t)asked_goal << 32;
+  game_path_cache_entry_t *entry = &cache->entries[path_cache_slot(key)];
+  if (entry->key == key && entry->version == grid->version)
+  {
+    cache->stats.cache_hits++;
+    if (!entry->found)
+    {
+      cache->stats.failed++;
+      return false;
+    }
+    size_t count = arrlenu(entry->waypoints);
+    arrsetlen(*out_waypoints, count);
+    memcpy(*out_waypoints, entry->waypoints, sizeof(Vector2) * count);
+    // the cached path ends where its own query asked, this one may aim elsewhere in the same cell
+    if (entry->exact_goal)
+    {
+      (*out_waypoints)[count - 1] = goal;
+    }
+    return true;
+  }
+
+  uint32_t start_cell, goal_cell;
+  bool found = false;
+  if (path_resolve_cells(grid, start, goal, &start_cell, &goal_cell))
+  {
+    found = path_search_cells(grid, search, start_cell, goal_cell);
+    cache->stats.expanded += search->expanded;
+  }
+  entry->key = key;
+  entry->version = grid->version;
+  entry->found = found;
+  if (!found)
+  {
+    cache->stats.failed++;
+    arrsetlen(entry->waypoints, 0);
+    return false;
+  }
+  // a goal on blocked ground becomes the center of the closest cell the path could reach
+  entry->exact_goal = goal_cell == asked_goal;
+  Vector2 end = entry->exact_goal ? goal : path_grid_cell_center(grid, (int)(goal_cell % grid->cells_x), (int)(goal_cell / grid->cells_x));
+  path_smooth(grid, search->cells, arrlenu(search->cells), end, out_waypoints);
+  size_t count = arrlenu(*out_waypoints);
+  arrsetlen(entry->waypoints, count);
+  memcpy(entry->waypoints, *out_waypoints, sizeof(Vector2) * count);
+  return true;
+}
+
+void path_cache_free(game_path_cache_t *cache)
+{
+  for (int i = 0; i < PATH_CACHE_SLOTS; i++)
+  {
+    arrfree(cache->entries[i].waypoints);
+  }
+  memset(cache, 0, sizeof *cache);
+}
+
+static int path_compare_cells(const void *a, const void *b)
+{
+  uint32_t cell_a = *(const uint32_t *)a, cell_b = *(const uint32_t *)b;
+  return (cell_a > cell_b) - (cell_a < cell_b);
+}
+
+// Dijkstra out of the goal cell over the search bounds, the integration field is the search's g. stops PATH_FLOW_MARGIN
+// past the cost of the farthest start cell, so a field costs the area around the group and not the map
+static void path_flow_build(const game_path_grid_t *grid, game_path_search_t *search, game_path_flow_t *flow,
+                            const uint32_t *start_cells, uint32_t start_count)
+{
+  memset(flow->direction, PATH_FLOW_NONE, flow->cell_count);
+  path_search_open(search, flow->goal_cell, flow->goal_cell, 0.0f, 0.0f);
+  uint32_t pending = start_count;
+  float limit = INFINITY;
+  while (arrlenu(search->heap) > 0)
+  {
+    game_path_open_t node = path_heap_pop(search->heap);
+    if (path_bit_test(search->closed, node.cell))
+    {
+      continue;
+    }
+    if (node.f > limit)
+    {
+      break;
+    }
+    search->closed[node.cell >> 6] |= 1ull << (node.cell & 63);
+    search->expanded++;
+    // settled, its parent is its final step toward the goal
+    uint32_t parent = search->parent[node.cell];
+    int dx = (int)(parent % grid->cells_x) - (int)(node.cell % grid->cells_x);
+    int dz = (int)(parent / grid->cells_x) - (int)(node.cell / grid->cells_x);
+    flow->direction[node.cell] = (uint8_t)((dz + 1) * 3 + (dx + 1));
+    if (pending > 0 && bsearch(&node.cell, start_cells, start_count, sizeof(*start_cells), path_compare_cells) != NULL)
+    {
+      pending--;
+      if (pending == 0)
+      {
+        limit = node.f + PATH_FLOW_MARGIN;
+      }
+    }
+    path_search_expand(grid, search, node.cell, 0, 0, 0.0f);
+  }
+}
+
+uint16_t path_flow_acquire(const game_path_grid_t *grid, game_path_flows_t *flows, game_path_search_t *search, Vector2 goal,
+                           const Vector2 *starts, uint32_t count, bool *out_covered)
+{
+  memset(out_covered, 0, sizeof(*out_covered) * count);
+  int goal_x, goal_z;
+  path_grid_get_cell(grid, goal, &goal_x, &goal_z);
+  int64_t goal_cell = path_grid_nearest_open(grid, goal_x, goal_z, 0);
+  if (goal_cell < 0 || count == 0)
+  {
+    return 0;
+  }
+  // open cells of the starts that can get there, sorted and unique for the build. the box around them and the goal
+  // bounds the field
+  uint32_t *start_cells = RL_MALLOC(sizeof(*start_cells) * count * 2);
+  uint32_t *sorted_cells = start_cells + count;
+  uint32_t start_count = 0;
+  int x0 = (int)(goal_cell % grid->cells_x), x1 = x0;
+  int z0 = (int)(goal_cell / grid->cells_x), z1 = z0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    int start_x, start_z;
+    path_grid_get_cell(grid, starts[i], &start_x, &start_z);
+    int64_t start_cell = path_grid_nearest_open(grid, start_x, start_z, path_grid_region(grid, (uint32_t)goal_cell));
+    start_cells[i] = start_cell < 0 ? UINT32_MAX : (uint32_t)start_cell;
+    if (start_cell >= 0)
+    {
+      sorted_cells[start_count++] = (uint32_t)start_cell;
+      x0 = start_x < x0 ? start_x : x0;
+      x1 = start_x > x1 ? start_x : x1;
+      z0 = start_z < z0 ? start_z : z0;
+      z1 = start_z > z1 ? start_z : z1;
+    }
+  }
+  // a field over most of a big map costs more than searching the cluster graph once per unit
+  if ((int64_t)(x1 - x0 + 1 + 2 * PATH_FLOW_MARGIN) * (z1 - z0 + 1 + 2 * PATH_FLOW_MARGIN) > PATH_FLOW_MAX_CELLS)
+  {
+    RL_FREE(start_cells);
+    return 0;
+  }
+  qsort(sorted_cells, start_count, sizeof(*sorted_cells), path_compare_cells);
+  uint32_t unique_count = 0;
+  for (uint32_t i = 0; i < start_count; i++)
+  {
+    if (unique_count == 0 || sorted_cells[unique_count - 1] != sorted_cells[i])
+    {
+      sorted_cells[unique_count++] = sorted_cells[i];
+    }
+  }
+
+  int cell_count = grid->cells_x * grid->cells_z;
+  int slot = -1;
+  int free_slot = -1;
+  for (int s = 0; s < PATH_FLOW_SLOTS && slot < 0; s++)
+  {
+    game_path_flow_t *flow = flows->slots[s];
+    if (flow == NULL || atomic_load(&flow->refs) == 0)
+    {
+      free_slot = free_slot < 0 ? s : free_slot;
+    }
+    if (flow == NULL || flow->cell_count != cell_count || flow->version != grid->version || flow->goal_cell != (uint32_t)goal_cell)
+    {
+      continue;
+    }
+    bool covered = true;
+    for (uint32_t i = 0; i < unique_count && covered; i++)
+    {
+      covered = flow->direction[sorted_cells[i]] != PATH_FLOW_NONE;
+    }
+    slot = covered ? s : -1;
+  }
+  if (slot >= 0)
+  {
+    flows->reused++;
+  }
+  else if (free_slot >= 0)
+  {
+    slot = free_slot;
+    game_path_flow_t *flow = flows->slots[slot];
+    if (flow == NULL)
+    {
+      flow = RL_CALLOC(1, sizeof(*flow));
+      flows->slots[slot] = flow;
+    }
+    if (flow->cell_count != cell_count)
+    {
+      RL_FREE(flow->direction);
+      flow->direction = RL_MALLOC(cell_count);
+      flow->cell_count = cell_count;
+    }
+    flow->version = grid->version;
+    flow->goal_cell = (uint32_t)goal_cell;
+    flow->goal = goal;
+    if (goal_cell != goal_z * grid->cells_x + goal_x)
+    {
+      flow->goal = path_grid_cell_center(grid, (int)(goal_cell % grid->cells_x), (int)(goal_cell / grid->cells_x));
+    }
+    path_search_reserve(search, cell_count);
+    path_search_reset(search);
+    search->bounds_x0 = clamp_int(x0 - PATH_FLOW_MARGIN, 0, grid->cells_x - 1);
+    search->bounds_z0 = clamp_int(z0 - PATH_FLOW_MARGIN, 0, grid->cells_z - 1);
+    search->bounds_x1 = clamp_int(x1 + PATH_FLOW_MARGIN, 0, grid->cells_x - 1);
+    search->bounds_z1 = clamp_int(z1 + PATH_FLOW_MARGIN, 0, grid->cells_z - 1);
+    path_flow_build(grid, search, flow, sorted_cells, unique_count);
+    flows->built++;
+    flows->expanded += search->expanded;
+  }
+  uint32_t refs = 0;
+  if (slot >= 0)
+  {
+    game_path_flow_t *flow = flows->slots[slot];
+    for (uint32_t i = 0; i < count; i++)
+    {
+      out_covered[i] = start_cells[i] != UINT32_MAX && flow->direction[start_cells[i]] != PATH_FLOW_NONE;
+      refs += out_covered[i];
+    }
+    atomic_fetch_add(&flow->refs, refs);
+  }
+  RL_FREE(start_cells);
+  return refs > 0 ? (uint16_t)(slot + 1) : 0;
+}
+
+void path_flow_release(game_path_flows_t *flows, uint16_t flow)
+{
+  if (flow != 0)
+  {
+    atomic_fetch_sub(&flows->slots[flow - 1]->refs, 1);
+  }
+}
+
+bool path_flow_get_aim(const game_path_grid_t *grid, const game_path_flows_t *flows, uint16_t flow, Vector2 position,
+                       Vector2 *out_aim)
+{
+  const game_path_flow_t *field = flows->slots[flow - 1];
+  if (field->cell_count != grid->cells_x * grid->cells_z)
+  {
+    return false;
+  }
+  int cell_x, cell_z;
+  path_grid_get_cell(grid, position, &cell_x, &cell_z);
+  uint8_t direction = field->direction[cell_z * grid->cells_x + cell_x];
+  if (direction == PATH_FLOW_NONE)
+  {
+    return false;
+  }
+  *out_aim = direction == PATH_FLOW_GOAL ? field->goal
+                                         : path_grid_cell_center(grid, cell_x + direction % 3 - 1, cell_z + direction / 3 - 1);
+  return true;
+}
+
+Vector2 path_flow_get_goal(const game_path_flows_t *flows, uint16_t flow)
+{
+  return flows->slots[flow - 1]->goal;
+}
+
+void path_flow_evict(game_path_flows_t *flows)
+{
+  for (int slot = 0; slot < PATH_FLOW_SLOTS; slot++)
+  {
+    game_path_flow_t *flow = flows->slots[slot];
+    if (flow != NULL && atomic_load(&flow->refs) == 0)
+    {
+      RL_FREE(flow->direction);
+      RL_FREE(flow);
+      flows->slots[slot] = NULL;
+    }
+  }
+}
+
+void path_flows_free(game_path_flows_t *flows)
+{
+  for (int slot = 0; slot < PATH_FLOW_SLOTS; slot++)
+  {
+    if (flows->slots[slot] != NULL)
+    {
+      RL_FREE(flows->slots[slot]->direction);
+      RL_FREE(flows->slots[slot]);
+    }
+  }
+  memset(flows, 0, sizeof *flows);
+}
+
+static void path_window_free(game_path_window_t *window)
+{
+  RL_FREE(window->g);
+  RL_FREE(window->parent);
+  RL_FREE(window->opened);
+  RL_FREE(window->closed);
+  RL_FREE(window->stops);
+  arrfree(window->heap);
+  arrfree(window->cells);
+  memset(window, 0, sizeof *window);
+}
+
+static void path_window_begin(game_path_window_t *window, int x0, int z0, int x1, int z1)
+{
+  int cell_count = (x1 - x0 + 1) * (z1 - z0 + 1);
+  int word_count = (cell_count + 63) / 64;
+  if (cell_count > window->capacity)
+  {
+    game_path_open_t *heap = window->heap;
+    uint32_t *cells = window->cells;
+    window->heap = NULL;
+    window->cells = NULL;
+    path_window_free(window);
+    window->heap = heap;
+    window->cells = cells;
+    window->capacity = cell_count;
+    window->g = RL_MALLOC(sizeof(*window->g) * cell_count);
+    window->parent = RL_MALLOC(sizeof(*window->parent) * cell_count);
+    window->opened = RL_MALLOC(sizeof(*window->opened) * word_count);
+    window->closed = RL_MALLOC(sizeof(*window->closed) * word_count);
+    window->stops = RL_MALLOC(sizeof(*window->stops) * word_count);
+  }
+  window->x0 = x0;
+  window->z0 = z0;
+  window->x1 = x1;
+  window->z1 = z1;
+  memset(window->opened, 0, sizeof(*window->opened) * word_count);
+  memset(window->closed, 0, sizeof(*window->closed) * word_count);
+  memset(window->stops, 0, sizeof(*window->stops) * word_count);
+  window->stop_count = 0;
+  arrsetlen(window->heap, 0);
+}
+
+static bool path_window_contains(const game_path_window_t *window, int x, int z)
+{
+  return x >= window->x0 && z >= window->z0 && x <= window->x1 && z <= window->z1;
+}
+
+static uint32_t path_window_index(const game_path_window_t *window, int x, int z)
+{
+  return (uint32_t)((z - window->z0) * (window->x1 - window->x0 + 1) + (x - window->x0));
+}
+
+static void path_window_add_stop(game_path_window_t *window, const game_path_grid_t *grid, uint32_t cell)
+{
+  int x = (int)(cell % grid->cells_x), z = (int)(cell / grid->cells_x);
+  if (!path_window_contains(window, x, z))
+  {
+    return;
+  }
+  uint32_t index = path_window_index(window, x, z);
+  if (!path_bit_test(window->stops, index))
+  {
+    window->stops[index >> 6] |= 1ull << (index & 63);
+    window->stop_count++;
+  }
+}
+
+// grid g of a cell inside the window, INFINITY when the last search did not settle it
+static float path_window_cost(const game_path_window_t *window, const game_path_grid_t *grid, uint32_t cell)
+{
+  int x = (int)(cell % grid->cells_x), z = (int)(cell / grid->cells_x);
+  if (!path_window_contains(window, x, z))
+  {
+    return INFINITY;
+  }
+  uint32_t index = path_window_index(window, x, z);
+  return path_bit_test(window->closed, index) ? window->g[index] : INFINITY;
+}
+
+// A* from source to target without leaving the window, or Dijkstra until every stop is settled when target is
+// UINT32_MAX. source may be blocked, a unit shoved onto a steep cell still walks off it
+static bool path_window_search(const game_path_grid_t *grid, game_path_window_t *window, uint32_t source, uint32_t target)
+{
+  int width = window->x1 - window->x0 + 1;
+  int target_x = target == UINT32_MAX ? 0 : (int)(target % grid->cells_x);
+  int target_z = target == UINT32_MAX ? 0 : (int)(target / grid->cells_x);
+  uint32_t target_index = target == UINT32_MAX ? UINT32_MAX : path_window_index(window, target_x, target_z);
+  uint32_t source_index = path_window_index(window, (int)(source % grid->cells_x), (int)(source / grid->cells_x));
+  window->opened[source_index >> 6] |= 1ull << (source_index & 63);
+  window->g[source_index] = 0.0f;
+  window->parent[source_index] = source_index;
+  path_heap_push(&window->heap, (game_path_open_t){0.0f, 0.0f, source_index});
+  while (arrlenu(window->heap) > 0)
+  {
+    game_path_open_t node = path_heap_pop(window->heap);
+    if (path_bit_test(window->closed, node.cell))
+    {
+      continue;
+    }
+    window->closed[node.cell >> 6] |= 1ull << (node.cell & 63);
+    if (node.cell == target_index)
+    {
+      return true;
+    }
+    if (path_bit_test(window->stops, node.cell) && --window->stop_count == 0)
+    {
+      return target == UINT32_MAX;
+    }
+    int x = window->x0 + (int)node.cell % width, z = window->z0 + (int)node.cell / width;
+    float g = window->g[node.cell];
+    for (int n = 0; n < 8; n++)
+    {
+      int nx = x + path_neighbour_dx[n], nz = z + path_neighbour_dz[n];
+      if (!path_window_contains(window, nx, nz))
+      {
+        continue;
+      }
+      uint32_t neighbour = path_window_index(window, nx, nz);
+      uint8_t cost = grid->cost[nz * grid->cells_x + nx];
+      if (cost == 0 || path_bit_test(window->closed, neighbour))
+      {
+        continue;
+      }
+      if (n >= 4 && (grid->cost[z * grid->cells_x + nx] == 0 || grid->cost[nz * grid->cells_x + x] == 0))
+      {
+        continue;
+      }
+      float neighbour_g = g + (n >= 4 ? PATH_DIAGONAL : 1.0f) * (float)cost * (1.0f / PATH_COST_SCALE);
+      if (path_bit_test(window->opened, neighbour) && window->g[neighbour] <= neighbour_g)
+      {
+        continue;
+      }
+      float h = target == UINT32_MAX ? 0.0f : path_heuristic(nx, nz, target_x, target_z);
+      window->opened[neighbour >> 6] |= 1ull << (neighbour & 63);
+      window->g[neighbour] = neighbour_g;
+      window->parent[neighbour] = node.cell;
+      path_heap_push(&window->heap, (game_path_open_t){neighbour_g + h, h, neighbour});
+    }
+  }
+  return target == UINT32_MAX;
+}
+
+// grid cells of the path the last search found to target, start first
+static void path_window_collect(game_path_window_t *window, const game_path_grid_t *grid, uint32_t target)
+{
+  int width = window->x1 - window->x0 + 1;
+  arrsetlen(window->cells, 0);
+  uint32_t index = path_window_index(window, (int)(target % grid->cells_x), (int)(target / grid->cells_x));
+  for (;;)
+  {
+    arrput(window->cells, (uint32_t)((window->z0 + (int)index / width) * grid->cells_x + window->x0 + (int)index % width));
+    if (window->parent[index] == index)
+    {
+      break;
+    }
+    index = window->parent[index];
+  }
+  size_t count = arrlenu(window->cells);
+  for (size_t i = 0; i < count / 2; i++)
+  {
+    uint32_t swap = window->cells[i];
+    window->cells[i] = window->cells[count - 1 - i];
+    window->cells[count - 1 - i] = swap;
+  }
+}
+
+static void path_cluster_bounds(const game_path_grid_t *grid, int cluster_x, int cluster_z, int *x0, int *z0, int *x1, int *z1)
+{
+  *x0 = cluster_x * PATH_CLUSTER_SIZE;
+  *z0 = cluster_z * PATH_CLUSTER_SIZE;
+  *x1 = *x0 + PATH_CLUSTER_SIZE < grid->cells_x ? *x0 + PATH_CLUSTER_SIZE - 1 : grid->cells_x - 1;
+  *z1 = *z0 + PATH_CLUSTER_SIZE < grid->cells_z ? *z0 + PATH_CLUSTER_SIZE - 1 : grid->cells_z - 1;
+}
+
+static int path_hpa_cluster_of(const game_path_hpa_t *hpa, const game_path_grid_t *grid, uint32_t cell)
+{
+  return (int)(cell / grid->cells_x) / PATH_CLUSTER_SIZE * hpa->clusters_x + (int)(cell % grid->cells_x) / PATH_CLUSTER_SIZE;
+}
+
+static void path_cluster_add_node(game_path_cluster_t *cluster, uint32_t cell, int side)
+{
+  // a corner cell can lead across two borders
+  for (int i = 0; i < cluster->node_count; i++)
+  {
+    if (cluster->nodes[i] == cell)
+    {
+      cluster->sides[i] |= (uint8_t)(1 << side);
+      return;
+    }
+  }
+  if (cluster->node_count < PATH_CLUSTER_MAX_NODES)
+  {
+    cluster->nodes[cluster->node_count] = cell;
+    cluster->sides[cluster->node_count] = (uint8_t)(1 << side);
+    cluster->node_count++;
+  }
+}
+
+// the step across border side of a cluster, -x, +x, -z, +z
+static int path_side_offset(const game_path_grid_t *grid, int side)
+{
+  static const int dx[4] = {-1, 1, 0, 0};
+  static const int dz[4] = {0, 0, -1, 1};
+  return dz[side] * grid->cells_x + dx[side];
+}
+
+// entrances on one border of a cluster. both clusters walk their shared border in the same order and pick the same
+// cells of every open stretch, so the nodes on either side of it face each other
+static void path_cluster_find_entrances(const game_path_grid_t *grid, game_path_cluster_t *cluster, int x0, int z0, int x1,
+                                        int z1, int side)
+{
+  bool along_z = side < 2;
+  int edge = side == 0 ? x0 : side == 1 ? x1 : side == 2 ? z0 : z1;
+  int outside = edge + (side & 1 ? 1 : -1);
+  if (outside < 0 || outside >= (along_z ? grid->cells_x : grid->cells_z))
+  {
+    return;
+  }
+  int first = along_z ? z0 : x0, last = along_z ? z1 : x1;
+  int offset = path_side_offset(grid, side);
+  int run_start = -1;
+  for (int t = first; t <= last + 1; t++)
+  {
+    uint32_t cell = along_z ? (uint32_t)(t * grid->cells_x + edge) : (uint32_t)(edge * grid->cells_x + t);
+    bool open = t <= last && grid->cost[cell] != 0 && grid->cost[cell + offset] != 0;
+    if (open && run_start < 0)
+    {
+      run_start = t;
+    }
+    if (open || run_start < 0)
+    {
+      continue;
+    }
+    int run_end = t - 1;
+    int ends[2] = {run_start, run_end};
+    if (run_end - run_start + 1 < PATH_ENTRANCE_SPLIT)
+    {
+      ends[0] = ends[1] = (run_start + run_end) / 2;
+    }
+    for (int e = 0; e < (ends[0] == ends[1] ? 1 : 2); e++)
+    {
+      path_cluster_add_node(cluster, along_z ? (uint32_t)(ends[e] * grid->cells_x + edge) : (uint32_t)(edge * grid->cells_x + ends[e]),
+                            side);
+    }
+    run_start = -1;
+  }
+}
+
+// entrances and a Dijkstra pass inside the cluster out of every one of them
+static void path_hpa_build_cluster(const game_path_grid_t *grid, game_path_hpa_t *hpa, game_path_window_t *window, int index)
+{
+  game_path_cluster_t *cluster = &hpa->clusters[index];
+  int x0, z0, x1, z1;
+  path_cluster_bounds(grid, index % hpa->clusters_x, index / hpa->clusters_x, &x0, &z0, &x1, &z1);
+  cluster->node_count = 0;
+  for (int side = 0; side < 4; side++)
+  {
+    path_cluster_find_entrances(grid, cluster, x0, z0, x1, z1, side);
+  }
+  int count = cluster->node_count;
+  arrsetlen(cluster->costs, count * count);
+  // costs only differ between directions by the first and last step, so each pass only looks for the nodes after its own
+  for (int i = 0; i < count; i++)
+  {
+    cluster->costs[i * count + i] = 0.0f;
+    if (i + 1 == count)
+    {
+      break;
+    }
+    path_window_begin(window, x0, z0, x1, z1);
+    for (int j = i + 1; j < count; j++)
+    {
+      path_window_add_stop(window, grid, cluster->nodes[j]);
+    }
+    path_window_search(grid, window, cluster->nodes[i], UINT32_MAX);
+    for (int j = i + 1; j < count; j++)
+    {
+      cluster->costs[i * count + j] = cluster->costs[j * count + i] = path_window_cost(window, grid, cluster->nodes[j]);
+    }
+  }
+}
+
+static void path_hpa_build_clusters(void *data, uint32_t job_index, uint32_t worker_index)
+{
+  game_path_hpa_job_t *job = data;
+  int index = job->clusters != NULL ? (int)job->clusters[job_index] : (int)job_index;
+  path_hpa_build_cluster(job->grid, job->hpa, &job->hpa->windows[worker_index], index);
+}
+
+static void path_hpa_free_windows(game_path_hpa_t *hpa)
+{
+  for (uint32_t w = 0; w < hpa->window_count; w++)
+  {
+    path_window_free(&hpa->windows[w]);
+  }
+  RL_FREE(hpa->windows);
+  hpa->windows = NULL;
+  hpa->window_count = 0;
+}
+
+static void path_hpa_reserve_windows(game_path_hpa_t *hpa)
+{
+  uint32_t worker_count = jobs_get_worker_count();
+  if (hpa->window_count >= worker_count)
+  {
+    return;
+  }
+  path_hpa_free_windows(hpa);
+  hpa->windows = RL_CALLOC(worker_count, sizeof(*hpa->windows));
+  hpa->window_count = worker_count;
+}
+
+bool path_hpa_build(game_path_hpa_t *hpa, const game_path_grid_t *grid)
+{
+  if (grid->cost == NULL)
+  {
+    return false;
+  }
+  path_hpa_free(hpa);
+  hpa->clusters_x = (grid->cells_x + PATH_CLUSTER_SIZE - 1) / PATH_CLUSTER_SIZE;
+  hpa->clusters_z = (grid->cells_z + PATH_CLUSTER_SIZE - 1) / PATH_CLUSTER_SIZE;
+  hpa->clusters = RL_CALLOC(hpa->clusters_x * hpa->clusters_z, sizeof(*hpa->clusters));
+  path_hpa_reserve_windows(hpa);
+  hpa->version = 1;
+  game_path_hpa_job_t job = {grid, hpa, NULL};
+  jobs_parallel_for((uint32_t)(hpa->clusters_x * hpa->clusters_z), path_hpa_build_clusters, &job);
+  return true;
+}
+
+void path_hpa_update(game_path_hpa_t *hpa, const game_path_grid_t *grid, game_terrain_rect_t rect)
+{
+  if (hpa->clusters == NULL || rect.x0 > rect.x1 || rect.z0 > rect.z1)
+  {
+    return;
+  }
+  // the cells path_grid_update recomputed, then every cluster with a border on one of their clusters
+  int x0 = clamp_int(rect.x0 - 1, 0, grid->cells_x - 1) / PATH_CLUSTER_SIZE - 1;
+  int x1 = clamp_int(rect.x1, 0, grid->cells_x - 1) / PATH_CLUSTER_SIZE + 1;
+  int z0 = clamp_int(rect.z0 - 1, 0, grid->cells_z - 1) / PATH_CLUSTER_SIZE - 1;
+  int z1 = clamp_int(rect.z1, 0, grid->cells_z - 1) / PATH_CLUSTER_SIZE + 1;
+  x0 = clamp_int(x0, 0, hpa->clusters_x - 1);
+  x1 = clamp_int(x1, 0, hpa->clusters_x - 1);
+  z0 = clamp_int(z0, 0, hpa->clusters_z - 1);
+  z1 = clamp_int(z1, 0, hpa->clusters_z - 1);
+  uint32_t *clusters = NULL;
+  for (int z = z0; z <= z1; z++)
+  {
+    for (int x = x0; x <= x1; x++)
+    {
+      arrput(clusters, (uint32_t)(z * hpa->clusters_x + x));
+    }
+  }
+  path_hpa_reserve_windows(hpa);
+  hpa->version++;
+  game_path_hpa_job_t job = {grid, hpa, clusters};
+  jobs_parallel_for((uint32_t)arrlenu(clusters), path_hpa_build_clusters, &job);
+  hpa->rebuilt += (uint32_t)arrlenu(clusters);
+  arrfree(clusters);
+}
+
+void path_hpa_free(game_path_hpa_t *hpa)
+{
+  for (int c = 0; c < hpa->clusters_x * hpa->clusters_z; c++)
+  {
+    arrfree(hpa->clusters[c].costs);
+  }
+  RL_FREE(hpa->clusters);
+  path_hpa_free_windows(hpa);
+  memset(hpa, 0, sizeof *hpa);
+}
+
+static game_path_window_t *path_query_window(game_path_query_t *query)
+{
+  if (query->window == NULL)
+  {
+    query->window = RL_CALLOC(1, sizeof(*query->window));
+  }
+  return query->window;
+}
+
+void path_query_free(game_path_query_t *query)
+{
+  path_search_free(&query->abstract);
+  if (query->window != NULL)
+  {
+    path_window_free(query->window);
+    RL_FREE(query->window);
+  }
+  memset(query, 0, sizeof *query);
+}
+
+bool path_find_local(const game_path_grid_t *grid, game_path_query_t *query, Vector2 start, Vector2 goal, Vector2 **out_waypoints)
+{
+  uint32_t start_cell, goal_cell;
+  if (!path_resolve_cells(grid, start, goal, &start_cell, &goal_cell))
+  {
+    return false;
+  }
+  int start_x = (int)(start_cell % grid->cells_x), start_z = (int)(start_cell / grid->cells_x);
+  int goal_x = (int)(goal_cell % grid->cells_x), goal_z = (int)(goal_cell / grid->cells_x);
+  game_path_window_t *window = path_query_window(query);
+  path_window_begin(window, clamp_int((start_x < goal_x ? start_x : goal_x) - PATH_LOCAL_MARGIN, 0, grid->cells_x - 1),
+                    clamp_int((start_z < goal_z ? start_z : goal_z) - PATH_LOCAL_MARGIN, 0, grid->cells_z - 1),
+                    clamp_int((start_x > goal_x ? start_x : goal_x) + PATH_LOCAL_MARGIN, 0, grid->cells_x - 1),
+                    clamp_int((start_z > goal_z ? start_z : goal_z) + PATH_LOCAL_MARGIN, 0, grid->cells_z - 1));
+  if (!path_window_search(grid, window, start_cell, goal_cell))
+  {
+    return false;
+  }
+  path_window_collect(window, grid, goal_cell);
+  int asked_x, asked_z;
+  path_grid_get_cell(grid, goal, &asked_x, &asked_z);
+  Vector2 end = goal_cell == (uint32_t)(asked_z * grid->cells_x + asked_x) ? goal : path_grid_cell_center(grid, goal_x, goal_z);
+  path_smooth(grid, window->cells, arrlenu(window->cells), end, out_waypoints);
+  return true;
+}
+
+// costs from cell to the nodes of its cluster without leaving it, and the cost to other when it lies in the same one
+static float path_hpa_connect(const game_path_grid_t *grid, const game_path_hpa_t *hpa, game_path_window_t *window, int index,
+                              uint32_t cell, uint32_t other, float *out_costs)
+{
+  const game_path_cluster_t *cluster = &hpa->clusters[index];
+  int x0, z0, x1, z1;
+  path_cluster_bounds(grid, index % hpa->clusters_x, index / hpa->clusters_x, &x0, &z0, &x1, &z1);
+  path_window_begin(window, x0, z0, x1, z1);
+  for (int j = 0; j < cluster->node_count; j++)
+  {
+    path_window_add_stop(window, grid, cluster->nodes[j]);
+  }
+  if (other != UINT32_MAX)
+  {
+    path_window_add_stop(window, grid, other);
+  }
+  path_window_search(grid, window, cell, UINT32_MAX);
+  for (int j = 0; j < cluster->node_count; j++)
+  {
+    out_costs[j] = path_window_cost(window, grid, cluster->nodes[j]);
+  }
+  return other == UINT32_MAX ? INFINITY : path_window_cost(window, grid, other);
+}
+
+// opens or improves node id at cell, step past the node being expanded
+static void path_hpa_relax(const game_path_grid_t *grid, game_path_search_t *search, uint32_t from, uint32_t id, uint32_t cell,
+                           float step, uint32_t goal_cell)
+{
+  if (step == INFINITY || path_bit_test(search->closed, id))
+  {
+    return;
+  }
+  float g = search->g[from] + step;
+  if (path_bit_test(search->opened, id) && search->g[id] <= g)
+  {
+    return;
+  }
+  float h = PATH_HPA_HEURISTIC_WEIGHT * path_heuristic((int)(cell % grid->cells_x), (int)(cell / grid->cells_x),
+                                                       (int)(goal_cell % grid->cells_x), (int)(goal_cell / grid->cells_x));
+  path_search_open(search, id, from, g, h);
+}
+
+bool path_hpa_find(const game_path_grid_t *grid, const game_path_hpa_t *hpa, game_path_query_t *query, Vector2 start, Vector2 goal,
+                   Vector2 **out_route)
+{
+  query->routes++;
+  arrsetlen(*out_route, 0);
+  uint32_t start_cell, goal_cell;
+  if (hpa->clusters == NULL || !path_resolve_cells(grid, start, goal, &start_cell, &goal_cell))
+  {
+    query->failed++;
+    return false;
+  }
+  // start and goal join the graph for this query only, linked to the nodes of their clusters
+  int start_cluster = path_hpa_cluster_of(hpa, grid, start_cell), goal_cluster = path_hpa_cluster_of(hpa, grid, goal_cell);
+  float start_costs[PATH_CLUSTER_MAX_NODES];
+  game_path_window_t *window = path_query_window(query);
+  float direct = path_hpa_connect(grid, hpa, window, start_cluster, start_cell, goal_cell, start_costs);
+  if (query->goal_version != hpa->version || query->goal_cell != goal_cell)
+  {
+    path_hpa_connect(grid, hpa, window, goal_cluster, goal_cell, UINT32_MAX, query->goal_costs);
+    query->goal_version = hpa->version;
+    query->goal_cell = goal_cell;
+  }
+
+  // node ids are cluster * PATH_CLUSTER_MAX_NODES + node, start and goal come after the last cluster
+  uint32_t start_id = (uint32_t)(hpa->clusters_x * hpa->clusters_z) * PATH_CLUSTER_MAX_NODES, goal_id = start_id + 1;
+  game_path_search_t *search = &query->abstract;
+  path_search_reserve(search, (int)goal_id + 1);
+  path_search_reset(search);
+  float start_h = PATH_HPA_HEURISTIC_WEIGHT * path_heuristic((int)(start_cell % grid->cells_x), (int)(start_cell / grid->cells_x),
+                                                             (int)(goal_cell % grid->cells_x), (int)(goal_cell / grid->cells_x));
+  path_search_open(search, start_id, start_id, 0.0f, start_h);
+  bool found = false;
+  while (arrlenu(search->heap) > 0 && !found)
+  {
+    game_path_open_t node = path_heap_pop(search->heap);
+    if (path_bit_test(search->closed, node.cell))
+    {
+      continue;
+    }
+    search->closed[node.cell >> 6] |= 1ull << (node.cell & 63);
+    search->expanded++;
+    found = node.cell == goal_id;
+    if (found)
+    {
+      continue;
+    }
+    if (node.cell == start_id)
+    {
+      const game_path_cluster_t *cluster = &hpa->clusters[start_cluster];
+      for (int j = 0; j < cluster->node_count; j++)
+      {
+        path_hpa_relax(grid, search, start_id, (uint32_t)start_cluster * PATH_CLUSTER_MAX_NODES + j, cluster->nodes[j],
+                       start_costs[j], goal_cell);
+      }
+      path_hpa_relax(grid, search, start_id, goal_id, goal_cell, direct, goal_cell);
+      continue;
+    }
+    int index = (int)(node.cell / PATH_CLUSTER_MAX_NODES), i = (int)(node.cell % PATH_CLUSTER_MAX_NODES);
+    const game_path_cluster_t *cluster = &hpa->clusters[index];
+    for (int j = 0; j < cluster->node_count; j++)
+    {
+      if (j != i)
+      {
+        path_hpa_relax(grid, search, node.cell, (uint32_t)index * PATH_CLUSTER_MAX_NODES + j, cluster->nodes[j],
+                       cluster->costs[i * cluster->node_count + j], goal_cell);
+      }
+    }
+    if (index == goal_cluster)
+    {
+      path_hpa_relax(grid, search, node.cell, goal_id, goal_cell, query->goal_costs[i], goal_cell);
+    }
+    // the node facing this one across each border it sits on, one step onto the neighbour's cell
+    static const int cluster_dx[4] = {-1, 1, 0, 0};
+    static const int cluster_dz[4] = {0, 0, -1, 1};
+    for (int side = 0; side < 4; side++)
+    {
+      if ((cluster->sides[i] & (1 << side)) == 0)
+      {
+        continue;
+      }
+      uint32_t across = (uint32_t)((int)cluster->nodes[i] + path_side_offset(grid, side));
+      int neighbour_index = index + cluster_dz[side] * hpa->clusters_x + cluster_dx[side];
+      const game_path_cluster_t *neighbour = &hpa->clusters[neighbour_index];
+      for (int j = 0; j < neighbour->node_count; j++)
+      {
+        if (neighbour->nodes[j] == across)
+        {
+          path_hpa_relax(grid, search, node.cell, (uint32_t)neighbour_index * PATH_CLUSTER_MAX_NODES + j, across,
+                         (float)grid->cost[across] * (1.0f / PATH_COST_SCALE), goal_cell);
+          break;
+        }
+      }
+    }
+  }
+  query->expanded += search->expanded;
+  if (!found)
+  {
+    query->failed++;
+    return false;
+  }
+
+  // walked back from the goal, the route keeps the nodes entered from another cluster
+  for (uint32_t id = search->parent[goal_id]; id != start_id; id = search->parent[id])
+  {
+    arrput(search->cells, id);
+  }
+  for (size_t k = arrlenu(search->cells); k-- > 0;)
+  {
+    uint32_t id = search->cells[k];
+    uint32_t previous = k + 1 < arrlenu(search->cells) ? search->cells[k + 1] : start_id;
+    int previous_cluster = previous == start_id ? start_cluster : (int)(previous / PATH_CLUSTER_MAX_NODES);
+    if ((int)(id / PATH_CLUSTER_MAX_NODES) != previous_cluster)
+    {
+      uint32_t cell = hpa->clusters[id / PATH_CLUSTER_MAX_NODES].nodes[id % PATH_CLUSTER_MAX_NODES];
+      arrput(*out_route, path_grid_cell_center(grid, (int)(cell % grid->cells_x), (int)(cell / grid->cells_x)));
+    }
+  }
+  int goal_x, goal_z;
+  path_grid_get_cell(grid, goal, &goal_x, &goal_z);
+  arrput(*out_route, goal_cell == (uint32_t)(goal_z * grid->cells_x + goal_x)
+                         ? goal
+                         : path_grid_cell_center(grid, (int)(goal_cell % grid->cells_x), (int)(goal_cell / grid->cells_x)));
+  return true;
+}
+
+bool path_hpa_refine(const game_path_grid_t *grid, const game_path_hpa_t *hpa, game_path_query_t *query, Vector2 from, Vector2 to,
+                     Vector2 **out_waypoints)
+{
+  if (hpa->clusters == NULL)
+  {
+    return false;
+  }
+  int from_x, from_z, to_x, to_z;
+  path_grid_get_cell(grid, from, &from_x, &from_z);
+  path_grid_get_cell(grid, to, &to_x, &to_z);
+  if (grid->cost[to_z * grid->cells_x + to_x] == 0)
+  {
+    return false;
+  }
+  // the unit's own cluster first, then the ones around it for a unit shoved just across a border
+  game_path_window_t *window = path_query_window(query);
+  int cluster_x = from_x / PATH_CLUSTER_SIZE, cluster_z = from_z / PATH_CLUSTER_SIZE;
+  for (int n = -1; n < 8; n++)
+  {
+    int cx = cluster_x + (n < 0 ? 0 : path_neighbour_dx[n]), cz = cluster_z + (n < 0 ? 0 : path_neighbour_dz[n]);
+    if (cx < 0 || cz < 0 || cx >= hpa->clusters_x || cz >= hpa->clusters_z)
+    {
+      continue;
+    }
+    int x0, z0, x1, z1;
+    path_cluster_bounds(grid, cx, cz, &x0, &z0, &x1, &z1);
+    path_window_begin(window, clamp_int(x0 - 1, 0, grid->cells_x - 1), clamp_int(z0 - 1, 0, grid->cells_z - 1),
+                      clamp_int(x1 + 1, 0, grid->cells_x - 1), clamp_int(z1 + 1, 0, grid->cells_z - 1));
+    if (!path_window_contains(window, from_x, from_z) || !path_window_contains(window, to_x, to_z))
+    {
+      continue;
+    }
+    uint32_t to_cell = (uint32_t)(to_z * grid->cells_x + to_x);
+    if (!path_window_search(grid, window, (uint32_t)(from_z * grid->cells_x + from_x), to_cell))
+    {
+      return false;
+    }
+    path_window_collect(window, grid, to_cell);
+    path_smooth(grid, window->cells, arrlenu(window->cells), to, out_waypoints);
+    query->refined++;
+    return true;
+  }
+  return false;
+}
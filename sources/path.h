@@ -0,0 +1,225 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "raylib.h"
+
+#include "terrain.h"
+
+// grid pathfinding over the terrain, one cell per terrain quad. cells steeper than PATH_MAX_SLOPE are blocked, the
+// ones steeper than PATH_FLAT_SLOPE cost more the steeper they are so paths go around hills they could climb
+#define PATH_MAX_SLOPE 1.0f         // height difference across a quad, 45 degrees
+#define PATH_FLAT_SLOPE 0.5f        // anything gentler walks like flat ground
+#define PATH_SLOPE_COST 4.0f        // extra cost per unit of slope past PATH_FLAT_SLOPE, a cell at PATH_MAX_SLOPE costs three flat ones
+#define PATH_COST_SCALE 32.0f       // cell costs are stored as uint8 in 1 / PATH_COST_SCALE steps, flat ground is PATH_COST_SCALE
+#define PATH_HEURISTIC_WEIGHT 2.0f  // weighted A*, paths cost at most this many times the cheapest one but searches
+                                    // expand a fraction of the nodes
+#define PATH_GOAL_SEARCH_RADIUS 8   // a blocked goal moves to the closest open cell within this many cells
+#define PATH_CACHE_SLOTS 256        // direct mapped, a new path replaces whatever had the same slot
+#define PATH_FLOW_SLOTS 32          // flow fields alive at once, orders past that fall back to a path per unit
+#define PATH_FLOW_MARGIN 16         // cells a flow field reaches past the box around its goal and units, and the cost it
+                                    // spreads past the farthest unit, so units shoved off their route still find it
+#define PATH_FLOW_MAX_CELLS (256 * 256) // orders spread wider than this give every unit a route of its own instead
+#define PATH_CLUSTER_SIZE 32            // cells per side of the clusters of the hierarchical search
+#define PATH_CLUSTER_MAX_NODES 64       // entrances kept per cluster, only ground cut up cell by cell has more
+#define PATH_ENTRANCE_SPLIT 8           // open stretches of a cluster border this long get an entrance at both ends,
+                                        // shorter ones one in the middle
+#define PATH_HPA_MIN_DISTANCE 64        // goals closer than this many cells are searched on the grid directly
+#define PATH_HPA_HEURISTIC_WEIGHT 1.25f // the cluster graph is small, a lighter weight keeps routes close to the cheapest
+#define PATH_LOCAL_MARGIN 16            // cells a search for a close goal may stray outside the box around start and goal
+
+typedef struct game_path_grid_t
+{
+  int cells_x;
+  int cells_z;
+  Vector2 origin;          // world XZ of the corner of cell (0, 0)
+  uint8_t *cost;           // per cell, 0 is blocked
+  uint32_t *region;        // per cell, cells share a region when a path connects them. 0 for blocked cells, see path_grid_region
+  uint32_t *region_parent; // stb_ds array, union-find over region ids, edits merge regions without touching their cells
+  uint8_t *region_rank;    // stb_ds array
+  uint32_t *region_mark;   // per cell, scratch of the floods path_grid_update runs when an edit may split a region
+  uint32_t region_mark_base;
+  uint32_t version;        // bumped by path_grid_update, cached paths from before are dropped
+} game_path_grid_t;
+
+// one node of the open list, ties on f go to the node closer to the goal
+typedef struct game_path_open_t
+{
+  float f;
+  float h;
+  uint32_t cell;
+} game_path_open_t;
+
+// scratch of one A* search, sized to the grid on first use and reused after. a search may only be used by one thread
+// at a time, the grid can be shared. only the bitmap words a query touched are cleared after it
+typedef struct game_path_search_t
+{
+  int cell_count;
+  float *g;
+  uint32_t *parent;
+  uint64_t *opened; // bit per cell, g and parent are only valid where it is set
+  uint64_t *closed;
+  uint32_t *touched_words; // stb_ds array of opened words with bits set
+  game_path_open_t *heap;  // stb_ds array, binary min heap
+  uint32_t *cells;         // stb_ds array, the cells of the last path from start to goal
+  uint32_t expanded;       // nodes closed by the last query
+  int bounds_x0;           // cells the last query could open, inclusive. the whole grid except for flow fields
+  int bounds_z0;
+  int bounds_x1;
+  int bounds_z1;
+} game_path_search_t;
+
+typedef struct game_path_cache_entry_t
+{
+  uint64_t key; // start cell in the low half, goal cell in the high half
+  uint32_t version;
+  bool found;
+  bool exact_goal;    // false when the goal cell was blocked and the path ends next to it
+  Vector2 *waypoints; // stb_ds array
+} game_path_cache_entry_t;
+
+// cumulative counters of a cache, reset them whenever convenient
+typedef struct game_path_stats_t
+{
+  uint32_t queries;
+  uint32_t cache_hits; // includes failures the cache already knew of
+  uint32_t failed;
+  uint32_t expanded; // nodes closed by the searches the cache could not answer
+} game_path_stats_t;
+
+typedef struct game_path_cache_t
+{
+  game_path_cache_entry_t entries[PATH_CACHE_SLOTS];
+  game_path_stats_t stats;
+} game_path_cache_t;
+
+// a flow field leads every cell it reached one step closer to a goal, one Dijkstra pass serves any number of units.
+// fields are shared through 1 based ids and reference counted, 0 is no field
+typedef struct game_path_flow_t game_path_flow_t;
+
+typedef struct game_path_flows_t
+{
+  game_path_flow_t *slots[PATH_FLOW_SLOTS];
+  uint32_t built;    // fields computed since the counters were last cleared
+  uint32_t reused;   // orders that shared a field already alive for the same goal
+  uint32_t expanded; // cells settled by the fields that were built
+} game_path_flows_t;
+
+// the grid cut into PATH_CLUSTER_SIZE squares. the cells on both sides of an open stretch of a cluster border are nodes
+// of the two clusters, the nodes of one cluster are joined by the cheapest cost between them that stays inside it
+typedef struct game_path_cluster_t
+{
+  int node_count;
+  uint32_t nodes[PATH_CLUSTER_MAX_NODES]; // cells
+  uint8_t sides[PATH_CLUSTER_MAX_NODES];  // bit per border the node crosses, -x, +x, -z, +z
+  float *costs; // stb_ds array, node_count x node_count from row to column, INFINITY when the cluster does not join them
+} game_path_cluster_t;
+
+// search scratch confined to one cluster and the ring of cells around it
+typedef struct game_path_window_t game_path_window_t;
+
+typedef struct game_path_hpa_t
+{
+  int clusters_x;
+  int clusters_z;
+  game_path_cluster_t *clusters;
+  game_path_window_t *windows; // one per worker for the builds
+  uint32_t window_count;
+  uint32_t version; // bumped whenever clusters are rebuilt
+  uint32_t rebuilt; // clusters rebuilt after the grid changed since the counter was last cleared
+} game_path_hpa_t;
+
+// scratch and counters of the queries one thread runs against a shared grid and cluster graph
+typedef struct game_path_query_t
+{
+  game_path_search_t abstract; // over the cluster nodes
+  game_path_window_t *window;
+  uint32_t goal_version; // hpa version the costs from the nodes of the last goal's cluster to it were found on, the
+  uint32_t goal_cell;    // units of a group order share them
+  float goal_costs[PATH_CLUSTER_MAX_NODES];
+  uint32_t routes; // counters since they were last cleared
+  uint32_t failed;
+  uint32_t expanded; // cluster nodes closed by the route searches
+  uint32_t refined;  // route legs turned into waypoints
+} game_path_query_t;
+
+// costs and regions for every quad of the map. reads every sample, so build it before switching to a streamed map
+bool path_grid_build(game_path_grid_t *grid, const game_terrain_map_t *terrain_map);
+
+// recomputes the costs of the cells over samples inside rect and relabels the regions around them, call it for the map's
+// dirty_rects before terrain_update_mesh clears them
+void path_grid_update(game_path_grid_t *grid, const game_terrain_map_t *terrain_map, game_terrain_rect_t rect);
+
+void path_grid_free(game_path_grid_t *grid);
+
+// the region of a cell with merged regions resolved, equal for two cells exactly when a path connects them
+uint32_t path_grid_region(const game_path_grid_t *grid, uint32_t cell);
+
+// clamped cell coordinates for a world XZ position
+void path_grid_get_cell(const game_path_grid_t *grid, Vector2 position, int *cell_x, int *cell_z);
+
+// world XZ of the center of a cell
+Vector2 path_grid_cell_center(const game_path_grid_t *grid, int cell_x, int cell_z);
+
+// weighted A* from the cell under start to the cell under goal with octile moves that never cut a blocked corner.
+// blocked start or goal cells move to the closest open cell, for the goal the closest one start can reach. the path is
+// left in search->cells. false when goal can not be reached from start, without searching when their regions differ
+bool path_search(const game_path_grid_t *grid, game_path_search_t *search, Vector2 start, Vector2 goal);
+
+void path_search_free(game_path_search_t *search);
+
+// replaces out_waypoints (stb_ds array) with the turns of the path from start to goal in world XZ, ending at goal
+// itself or at the center of the cell it moved to. straight runs are merged while the line between their ends stays on
+// ground no worse than the path crossed. answered from the cache when the same cells were asked for since the grid last changed
+bool path_find(const game_path_grid_t *grid, game_path_cache_t *cache, game_path_search_t *search, Vector2 start, Vector2 goal,
+               Vector2 **out_waypoints);
+
+void path_cache_free(game_path_cache_t *cache);
+
+// a field toward goal over the box around goal and the count starts, holding a reference for every start it reached.
+// out_covered tells which those are, the rest need a path of their own. reuses a live field for the same goal cell
+// when it already covers every start. 0 when goal is unreachable, no start was reached or every slot is taken
+uint16_t path_flow_acquire(const game_path_grid_t *grid, game_path_flows_t *flows, game_path_search_t *search, Vector2 goal,
+                           const Vector2 *starts, uint32_t count, bool *out_covered);
+
+// drops one reference, safe to call from any worker while nothing acquires or evicts
+void path_flow_release(game_path_flows_t *flows, uint16_t flow);
+
+// where a unit at position should head next: the center of the next cell of the field or, inside the goal cell, the
+// goal itself. false when the field never reached the unit's cell
+bool path_flow_get_aim(const game_path_grid_t *grid, const game_path_flows_t *flows, uint16_t flow, Vector2 position,
+                       Vector2 *out_aim);
+
+// goal of a field, its own goal or the closest open spot to it when that was blocked
+Vector2 path_flow_get_goal(const game_path_flows_t *flows, uint16_t flow);
+
+// frees the fields nobody references anymore
+void path_flow_evict(game_path_flows_t *flows);
+
+void path_flows_free(game_path_flows_t *flows);
+
+// clusters, their entrances and the costs between the entrances of every cluster, clusters are split across the job pool
+bool path_hpa_build(game_path_hpa_t *hpa, const game_path_grid_t *grid);
+
+// rebuilds the clusters over samples inside rect and their neighbours, whose entrances face theirs. call it right after
+// path_grid_update with the same rect
+void path_hpa_update(game_path_hpa_t *hpa, const game_path_grid_t *grid, game_terrain_rect_t rect);
+
+void path_hpa_free(game_path_hpa_t *hpa);
+
+// replaces out_route (stb_ds array) with the entrance of every cluster a path from start to goal enters, then goal or the
+// center of the cell it moved to like path_find. only searches the cluster graph, path_hpa_refine turns the leg a unit is
+// about to walk into waypoints. the graph is only read, any number of threads may query it with a query each
+bool path_hpa_find(const game_path_grid_t *grid, const game_path_hpa_t *hpa, game_path_query_t *query, Vector2 start, Vector2 goal,
+                   Vector2 **out_route);
+
+// replaces out_waypoints (stb_ds array) with the path from from to to, searched inside a cluster and its ring of cells as
+// consecutive route points are. false when no cluster around from holds both or the path has to leave it
+bool path_hpa_refine(const game_path_grid_t *grid, const game_path_hpa_t *hpa, game_path_query_t *query, Vector2 from, Vector2 to,
+                     Vector2 **out_waypoints);
+
+// path_find for a close goal without the cache, searched inside the box around start and goal grown by PATH_LOCAL_MARGIN
+// so queries only need scratch the size of the box. false when the way there needs more room, path_hpa_find finds those
+bool path_find_local(const game_path_grid_t *grid, game_path_query_t *query, Vector2 start, Vector2 goal, Vector2 **out_waypoints);
+
+void path_query_free(game_path_query_t *query);
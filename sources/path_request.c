@@ -0,0 +1,170 @@
+#include "path_request.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stb_ds.h"
+
+#include "jobs.h"
+
+typedef struct game_path_request_job_t
+{
+  const game_path_grid_t *grid;
+  const game_path_hpa_t *hpa;
+  game_path_requests_t *requests;
+} game_path_request_job_t;
+
+uint32_t path_request_submit(game_path_requests_t *requests, const game_path_grid_t *grid, Vector2 start, Vector2 goal,
+                             game_path_priority priority)
+{
+  int start_x, start_z, goal_x, goal_z;
+  path_grid_get_cell(grid, start, &start_x, &start_z);
+  path_grid_get_cell(grid, goal, &goal_x, &goal_z);
+  int areas_x = (grid->cells_x + PATH_REQUEST_AREA - 1) / PATH_REQUEST_AREA;
+  uint64_t key = (uint64_t)(start_z / PATH_REQUEST_AREA * areas_x + start_x / PATH_REQUEST_AREA) |
+                 (uint64_t)(goal_z * grid->cells_x + goal_x) << 32;
+  for (size_t i = 0; i < arrlenu(requests->pending); i++)
+  {
+    game_path_request_t *request = &requests->pending[i];
+    if (request->key == key)
+    {
+      request->priority = priority < request->priority ? (uint8_t)priority : request->priority;
+      requests->coalesced++;
+      return request->ticket;
+    }
+  }
+  // 0 means no request to the callers
+  if (++requests->next_ticket == 0)
+  {
+    requests->next_ticket = 1;
+  }
+  game_path_request_t request = {.ticket = requests->next_ticket, .priority = (uint8_t)priority, .key = key, .start = start, .goal = goal};
+  arrput(requests->pending, request);
+  requests->submitted++;
+  return request.ticket;
+}
+
+// tickets grow with every submission, so within a priority the oldest request comes first
+static int path_request_compare_priority(const void *a, const void *b)
+{
+  const game_path_request_t *request_a = a, *request_b = b;
+  if (request_a->priority != request_b->priority)
+  {
+    return request_a->priority < request_b->priority ? -1 : 1;
+  }
+  return (request_a->ticket > request_b->ticket) - (request_a->ticket < request_b->ticket);
+}
+
+static int path_request_compare_ticket(const void *a, const void *b)
+{
+  const game_path_request_t *request_a = a, *request_b = b;
+  return (request_a->ticket > request_b->ticket) - (request_a->ticket < request_b->ticket);
+}
+
+// close goals search the box around them, whatever needs more room goes through the cluster graph
+static void path_request_serve(void *data, uint32_t job_index, uint32_t worker_index)
+{
+  game_path_request_job_t *job = data;
+  game_path_request_t *request = &job->requests->pending[job_index];
+  game_path_query_t *query = &job->requests->queries[worker_index];
+  float distance = fmaxf(fabsf(request->goal.x - request->start.x), fabsf(request->goal.y - request->start.y));
+  request->is_route = false;
+  request->found = distance <= PATH_HPA_MIN_DISTANCE && path_find_local(job->grid, query, request->start, request->goal, &request->waypoints);
+  if (!request->found)
+  {
+    request->is_route = true;
+    request->found = path_hpa_find(job->grid, job->hpa, query, request->start, request->goal, &request->waypoints);
+  }
+}
+
+void path_requests_service(game_path_requests_t *requests, const game_path_grid_t *grid, const game_path_hpa_t *hpa)
+{
+  for (size_t i = 0; i < arrlenu(requests->answered); i++)
+  {
+    arrfree(requests->answered[i].waypoints);
+  }
+  arrsetlen(requests->answered, 0);
+  size_t pending_count = arrlenu(requests->pending);
+  if (pending_count == 0)
+  {
+    return;
+  }
+  qsort(requests->pending, pending_count, sizeof(*requests->pending), path_request_compare_priority);
+  uint32_t count = pending_count < PATH_REQUEST_BUDGET ? (uint32_t)pending_count : PATH_REQUEST_BUDGET;
+  if (hpa != NULL)
+  {
+    uint32_t worker_count = jobs_get_worker_count();
+    if (requests->query_count < worker_count)
+    {
+      for (uint32_t q = 0; q < requests->query_count; q++)
+      {
+        path_query_free(&requests->queries[q]);
+      }
+      RL_FREE(requests->queries);
+      requests->queries = RL_CALLOC(worker_count, sizeof(*requests->queries));
+      requests->query_count = worker_count;
+    }
+    game_path_request_job_t job = {grid, hpa, requests};
+    jobs_parallel_for(count, path_request_serve, &job);
+    for (uint32_t q = 0; q < requests->query_count; q++)
+    {
+      requests->routes += requests->queries[q].routes;
+      requests->expanded += requests->queries[q].expanded;
+      requests->queries[q].routes = 0;
+      requests->queries[q].failed = 0;
+      requests->queries[q].expanded = 0;
+    }
+  }
+  else
+  {
+    // the cache is shared, so without the cluster graph the budget is served in order on this thread
+    for (uint32_t i = 0; i < count; i++)
+    {
+      game_path_request_t *request = &requests->pending[i];
+      request->is_route = false;
+      request->found = path_find(grid, &requests->cache, &requests->search, request->start, request->goal, &request->waypoints);
+    }
+  }
+  requests->served += count;
+  arrsetlen(requests->answered, count);
+  memcpy(requests->answered, requests->pending, sizeof(*requests->pending) * count);
+  arrdeln(requests->pending, 0, count);
+  qsort(requests->answered, count, sizeof(*requests->answered), path_request_compare_ticket);
+}
+
+const game_path_request_t *path_request_get(const game_path_requests_t *requests, uint32_t ticket)
+{
+  if (arrlenu(requests->answered) == 0)
+  {
+    return NULL;
+  }
+  game_path_request_t key = {.ticket = ticket};
+  return bsearch(&key, requests->answered, arrlenu(requests->answered), sizeof(*requests->answered), path_request_compare_ticket);
+}
+
+uint32_t path_requests_pending(const game_path_requests_t *requests)
+{
+  return (uint32_t)arrlenu(requests->pending);
+}
+
+void path_requests_free(game_path_requests_t *requests)
+{
+  for (size_t i = 0; i < arrlenu(requests->pending); i++)
+  {
+    arrfree(requests->pending[i].waypoints);
+  }
+  for (size_t i = 0; i < arrlenu(requests->answered); i++)
+  {
+    arrfree(requests->answered[i].waypoints);
+  }
+  arrfree(requests->pending);
+  arrfree(requests->answered);
+  for (uint32_t q = 0; q < requests->query_count; q++)
+  {
+    path_query_free(&requests->queries[q]);
+  }
+  RL_FREE(requests->queries);
+  path_cache_free(&requests->cache);
+  path_search_free(&requests->search);
+  memset(requests, 0, sizeof *requests);
+}
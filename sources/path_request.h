@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "raylib.h"
+
+#include "path.h"
+
+// path searches queued by the game and answered in batches across the job pool, so a burst of orders spreads over
+// several ticks instead of stalling one. the budget counts searches rather than time, a replay gets every answer on the
+// same tick whatever the machine and worker count
+#define PATH_REQUEST_BUDGET 32 // searches answered per service, the rest wait for the next one
+#define PATH_REQUEST_AREA 4    // requests that start within the same square of this many cells and aim for the same cell
+                               // share one search
+
+typedef enum game_path_priority
+{
+  GAME_PATH_PRIORITY_PLAYER = 0, // served before anything else that is waiting
+  GAME_PATH_PRIORITY_AI,
+} game_path_priority;
+
+typedef struct game_path_request_t
+{
+  uint32_t ticket;
+  uint8_t priority;
+  uint64_t key; // start area in the low half, goal cell in the high half
+  Vector2 start;
+  Vector2 goal;
+  bool found;
+  bool is_route;      // waypoints are a route of cluster entrances for path_hpa_refine instead of the whole path
+  Vector2 *waypoints; // stb_ds array
+} game_path_request_t;
+
+typedef struct game_path_requests_t
+{
+  game_path_request_t *pending;  // stb_ds array, submission order until a service sorts it by priority
+  game_path_request_t *answered; // stb_ds array sorted by ticket, what the last service answered
+  game_path_query_t *queries;    // per worker
+  uint32_t query_count;
+  game_path_cache_t cache; // whole grid searches when there is no cluster graph, run on the calling thread
+  game_path_search_t search;
+  uint32_t next_ticket;
+  uint32_t submitted; // counters since they were last cleared
+  uint32_t coalesced; // submissions that joined a request already waiting
+  uint32_t served;
+  uint32_t routes;   // answers searched on the cluster graph
+  uint32_t expanded; // cluster nodes those searches closed
+} game_path_requests_t;
+
+// queues a search from start to goal or joins one already waiting from the same area to the same cell, taking the
+// higher of both priorities. the ticket is never 0
+uint32_t path_request_submit(game_path_requests_t *requests, const game_path_grid_t *grid, Vector2 start, Vector2 goal,
+                             game_path_priority priority);
+
+// answers up to PATH_REQUEST_BUDGET waiting requests by priority and then age, and forgets what the previous service
+// answered. close goals are searched on the grid around them and far ones on hpa, which may be NULL
+void path_requests_service(game_path_requests_t *requests, const game_path_grid_t *grid, const game_path_hpa_t *hpa);
+
+// the answer the last service gave for ticket, NULL while it is still waiting or when it was answered before that
+const game_path_request_t *path_request_get(const game_path_requests_t *requests, uint32_t ticket);
+
+// requests waiting for a service
+uint32_t path_requests_pending(const game_path_requests_t *requests);
+
+void path_requests_free(game_path_requests_t *requests);
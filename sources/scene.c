@@ -1,5 +1,6 @@
 #include "scene.h"
 
+#include <math.h>
 #include <string.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -10,13 +11,78 @@
 
 #include "terrain.h"
 #include "camera.h"
-#include "models.h"
+#include "spatial.h"
+#include "bvh.h"
+#include "jobs.h"
+#include "avoid.h"
+#include "path.h"
+#include "path_request.h"
 
 #define ENT_AI_VISIBILITY_RADIUS 20.f
 #define ENT_AI_FLEE_THRESHOLD 0.3f
 
-// NOTE: change array accesses to some sort of lookup (hash maybe)
-static size_t GLOBAL_ID = 0;
+// neighbour lookups for entity_avoid, rebuilt at the start of every tick
+#define SCENE_AVOID_HORIZON 30.0f     // ticks ahead units keep clear of each other
+#define SCENE_AVOID_STOP_SPEED 0.1f   // share of move_speed below which a unit pressed against a standing one gives up
+static game_spatial_grid_t collision_grid = {0};
+static uint32_t *collision_indices = NULL;    // living entities inserted into the grid
+static float collision_max_speed = 0.0f;      // fastest living entity, bounds how far away a neighbour still matters
+static game_scene_stats_t scene_stats = {0};
+
+// entity update runs in fixed size chunks spread over the job system. chunk boundaries never depend on the worker count,
+// so anything a chunk produces can be merged back in chunk order and the tick comes out the same on any number of cores
+#define SCENE_UPDATE_CHUNK_SIZE 64
+typedef struct game_scene_chunk_t
+{
+  game_damage_event_t *damage_events; // attacks finished by entities of this chunk, in entity order
+  game_scene_stats_t stats;
+  // entities that moved this tick, snapped to the ground together once the chunk is done
+  uint32_t dirty_count;
+  uint32_t dirty_index[SCENE_UPDATE_CHUNK_SIZE];
+  Vector3 dirty_old_position[SCENE_UPDATE_CHUNK_SIZE];
+  Vector3 dirty_position[SCENE_UPDATE_CHUNK_SIZE];
+  float dirty_ground_y[SCENE_UPDATE_CHUNK_SIZE];
+} game_scene_chunk_t;
+static game_scene_chunk_t *scene_chunks = NULL;
+
+// previous tick state of everything an entity may read from another one while updating, copied before the parallel phase
+static Vector3 *read_position = NULL;
+static Vector2 *read_velocity = NULL;
+static BoundingBox *read_bbox = NULL;
+static uint8_t *read_state = NULL;
+
+typedef struct game_scene_update_t
+{
+  game_entity_store_t *entities;
+  game_terrain_map_t *terrain_map;
+  float dt;
+} game_scene_update_t;
+
+// per team index of living units, rebuilt at the start of every ai pass
+#define ENT_AI_GRID_CELL_SIZE (ENT_AI_VISIBILITY_RADIUS / 2.0f)
+static game_spatial_grid_t team_grids[GAME_TEAM_COUNT] = {0};
+static uint32_t *team_indices[GAME_TEAM_COUNT] = {0};
+
+// mouse picking over entity bboxes, items are dense entity indices. refit at the end of every tick,
+// rebuilt when the entity count changes or refitting has let the tree degrade
+static game_bvh_t pick_bvh = {0};
+static game_bvh_hit_t *pick_hits = NULL;
+static Ray *pick_rays = NULL;                       // click rays gathered from this tick's input events
+static game_entity_handle_t *pick_targets = NULL;
+static Ray *ground_rays = NULL;                     // right clicks that missed every unit, answered by the terrain
+static game_terrain_hit_t *ground_hits = NULL;
+
+// move orders queue path requests that the job pool answers at the end of the update, units get their answer at the
+// start of the next one. flow fields are acquired by group orders and released from the workers too, they are only
+// evicted once the tick's update is done. route legs are refined in the serial part of the update
+#define SCENE_PATH_TICKET_WANTED UINT32_MAX // set by ai workers, the serial part after them submits the request
+static const game_path_grid_t *path_grid = NULL;
+static const game_path_hpa_t *path_hpa = NULL;
+static game_path_requests_t path_requests = {0};
+static game_path_query_t path_query = {0};
+static game_path_search_t path_search_scratch = {0};
+static game_path_cache_t path_cache = {0};
+static game_path_flows_t path_flows = {0};
 
 
 typedef enum
@@ -27,77 +93,284 @@ typedef enum
   ROBO_MOVING = 10,
 } RobotAnims;
 
-static void entity_set_animation(game_entity_t *ent, RobotAnims anim)
+static void entity_set_animation(uint32_t index, game_entity_store_t *entities, RobotAnims anim)
 {
-  ent->anim_index = anim;
+  entities->anim_index[index] = anim;
   // prevent constant stutter stepping
   if (anim != ROBO_IDLE)
   {
-    ent->anim_current_frame = 0;
-  }
-}
-
-
-game_entity_t *entity_add(game_entity_t entities[], game_entity_create_t *entity_create)
-{
-  game_entity_t entity = (game_entity_t){
-      .position = (Vector3){entity_create->position.x, entity_create->offset_y, entity_create->position.y},
-      .offset_y = entity_create->offset_y,
-      .rotation = entity_create->rotation,
-      .dimensions = entity_create->dimensions,
-      .dimensions_offset = entity_create->dimensions_offset,
-      .scale = entity_create->scale,
-      .type = entity_create->type,
-      .id = GLOBAL_ID,
-      .move_speed = entity_create->move_speed,
-      .is_dirty = true,
-      .anim_index = ROBO_IDLE, // idle for the robot gltf
-      .anim_current_frame = (uint32_t)GetRandomValue(0, 100),
-      .attack_cooldown_max = entity_create->attack_cooldown_max,
-      .attack_radius = entity_create->attack_radius,
-      .attack_damage = entity_create->attack_damage,
-      .hit_points = entity_create->hit_points,
-      .hit_points_max = entity_create->hit_points,
-      .team = entity_create->team,
-      .target_id = -1,
-  };
-  entity.model = entity_load_model(entity_create->model_path);
-  entity.anim = LoadModelAnimations(entity_create->model_anims_path, &entity.anims_count);
-  entity.bbox = entity_bbox_derive(&entity.position, &entity.dimensions_offset, &entity.dimensions);
-  arrput(entities, entity);
-  GLOBAL_ID++;
-  return entities;
+    entities->anim_current_frame[index] = 0;
+  }
+}
+
+
+// drops the unit's waypoints, route and its share of a flow field, only touches the unit's own fields and the field's
+// reference count so workers may call it
+static void entity_clear_route(uint32_t index, game_entity_store_t *entities)
+{
+  arrsetlen(entities->path[index], 0);
+  entities->path_next[index] = 0;
+  arrsetlen(entities->route[index], 0);
+  entities->route_next[index] = 0;
+  // an answer still on its way is dropped when it arrives
+  entities->path_ticket[index] = 0;
+  path_flow_release(&path_flows, entities->flow[index]);
+  entities->flow[index] = 0;
+}
+
+game_entity_handle_t entity_add(game_entity_store_t *entities, game_entity_create_t *entity_create)
+{
+  // reuse a released slot if there is one, generation was already bumped on release
+  uint16_t slot;
+  if (arrlen(entities->slot_free) > 0)
+  {
+    slot = arrpop(entities->slot_free);
+  }
+  else if (arrlenu(entities->slot_dense) < GAME_ENTITY_MAX_SLOTS)
+  {
+    slot = (uint16_t)arrlen(entities->slot_dense);
+    arrput(entities->slot_dense, 0);
+    arrput(entities->slot_generation, 0);
+  }
+  else
+  {
+    TraceLog(LOG_WARNING, "SCENE: All %d entity slots are taken", GAME_ENTITY_MAX_SLOTS);
+    return GAME_ENTITY_HANDLE_NONE;
+  }
+  uint32_t index = entities->count++;
+  entities->slot_dense[slot] = index;
+  game_entity_handle_t handle = GAME_ENTITY_HANDLE_MAKE(slot, entities->slot_generation[slot]);
+
+#define GAME_ENTITY_FIELD_GROW(type, name) arrsetlen(entities->name, entities->count);
+  GAME_ENTITY_FIELDS(GAME_ENTITY_FIELD_GROW)
+#undef GAME_ENTITY_FIELD_GROW
+
+  Vector3 position = (Vector3){entity_create->position.x, entity_create->offset_y, entity_create->position.y};
+  // hot
+  entities->position[index] = position;
+  entities->velocity[index] = (Vector2){0};
+  entities->target_pos[index] = (Vector2){0};
+  entities->target[index] = GAME_ENTITY_HANDLE_NONE;
+  entities->state[index] = GAME_ENT_STATE_IDLE;
+  entities->is_dirty[index] = true;
+  entities->attack_cooldown[index] = 0.0f;
+  entities->anim_current_frame[index] = (uint32_t)GetRandomValue(0, 100);
+  entities->anim_index[index] = ROBO_IDLE; // idle for the robot gltf
+  entities->path_next[index] = 0;
+  entities->route_next[index] = 0;
+  entities->path[index] = NULL;
+  entities->route[index] = NULL;
+  entities->path_ticket[index] = 0;
+  entities->flow[index] = 0;
+  // warm
+  entities->bbox[index] = entity_bbox_derive(&position, &entity_create->dimensions_offset, &entity_create->dimensions);
+  entities->team[index] = entity_create->team;
+  entities->hit_points[index] = entity_create->hit_points;
+  entities->hit_points_max[index] = entity_create->hit_points;
+  entities->move_speed[index] = entity_create->move_speed;
+  entities->attack_radius[index] = entity_create->attack_radius;
+  entities->attack_damage[index] = entity_create->attack_damage;
+  entities->attack_cooldown_max[index] = entity_create->attack_cooldown_max;
+  // cold
+  entities->handle[index] = handle;
+  entities->type[index] = entity_create->type;
+  entities->asset[index] = asset_acquire(entity_create->model_path, entity_create->model_anims_path);
+  entities->transform[index] = MatrixIdentity();
+  entities->rotation[index] = entity_create->rotation;
+  entities->scale[index] = entity_create->scale;
+  entities->dimensions[index] = entity_create->dimensions;
+  entities->dimensions_offset[index] = entity_create->dimensions_offset;
+  entities->offset_y[index] = entity_create->offset_y;
+  return handle;
+}
+
+void entity_remove(game_entity_store_t *entities, game_entity_handle_t handle)
+{
+  int32_t index = entity_resolve(entities, handle);
+  if (index < 0)
+  {
+    return;
+  }
+  asset_release(entities->asset[index]);
+  entity_clear_route(index, entities);
+  arrfree(entities->path[index]);
+  arrfree(entities->route[index]);
+
+  // move the last entity into the hole so the dense arrays stay packed, then repoint its slot
+  uint32_t last = entities->count - 1;
+  if ((uint32_t)index != last)
+  {
+#define GAME_ENTITY_FIELD_MOVE(type, name) entities->name[index] = entities->name[last];
+    GAME_ENTITY_FIELDS(GAME_ENTITY_FIELD_MOVE)
+#undef GAME_ENTITY_FIELD_MOVE
+    entities->slot_dense[GAME_ENTITY_HANDLE_SLOT(entities->handle[index])] = index;
+  }
+  entities->count = last;
+#define GAME_ENTITY_FIELD_SHRINK(type, name) arrsetlen(entities->name, entities->count);
+  GAME_ENTITY_FIELDS(GAME_ENTITY_FIELD_SHRINK)
+#undef GAME_ENTITY_FIELD_SHRINK
+
+  // bumping the generation is what makes outstanding handles stale
+  uint16_t slot = GAME_ENTITY_HANDLE_SLOT(handle);
+  entities->slot_generation[slot]++;
+  if (entities->slot_generation[slot] == 0xFFFF)
+  {
+    entities->slot_generation[slot] = 0; // never hand out GAME_ENTITY_HANDLE_NONE
+  }
+  arrput(entities->slot_free, slot);
+}
+
+int32_t entity_resolve(game_entity_store_t *entities, game_entity_handle_t handle)
+{
+  uint16_t slot = GAME_ENTITY_HANDLE_SLOT(handle);
+  if (handle == GAME_ENTITY_HANDLE_NONE || slot >= arrlen(entities->slot_dense) ||
+      entities->slot_generation[slot] != GAME_ENTITY_HANDLE_GENERATION(handle))
+  {
+    return -1;
+  }
+  return (int32_t)entities->slot_dense[slot];
 }
 
 // cleanup function when program should end
-void entity_unload_all(game_entity_t entities[])
+void entity_unload_all(game_entity_store_t *entities)
 {
-  for (int i = 0; i < arrlen(entities); i++)
+  for (uint32_t i = 0; i < entities->count; i++)
+  {
+    asset_release(entities->asset[i]);
+    arrfree(entities->path[i]);
+    arrfree(entities->route[i]);
+  }
+#define GAME_ENTITY_FIELD_FREE(type, name) arrfree(entities->name);
+  GAME_ENTITY_FIELDS(GAME_ENTITY_FIELD_FREE)
+#undef GAME_ENTITY_FIELD_FREE
+  arrfree(entities->slot_dense);
+  arrfree(entities->slot_generation);
+  arrfree(entities->slot_free);
+  entities->count = 0;
+
+  spatial_grid_free(&collision_grid);
+  arrfree(collision_indices);
+  for (int c = 0; c < arrlen(scene_chunks); c++)
   {
-    UnloadModel(entities[i].model);
-    UnloadModelAnimations(entities[i].anim, entities[i].anims_count);
+    arrfree(scene_chunks[c].damage_events);
   }
-  arrfree(entities);
+  arrfree(scene_chunks);
+  arrfree(read_position);
+  arrfree(read_velocity);
+  arrfree(read_bbox);
+  arrfree(read_state);
+  for (int team = 0; team < GAME_TEAM_COUNT; team++)
+  {
+    spatial_grid_free(&team_grids[team]);
+    arrfree(team_indices[team]);
+  }
+  bvh_free(&pick_bvh);
+  arrfree(pick_hits);
+  arrfree(pick_rays);
+  arrfree(pick_targets);
+  arrfree(ground_rays);
+  arrfree(ground_hits);
+  path_search_free(&path_search_scratch);
+  path_cache_free(&path_cache);
+  path_flows_free(&path_flows);
+  path_requests_free(&path_requests);
+  path_query_free(&path_query);
+}
+
+const game_scene_stats_t *scene_get_stats(void)
+{
+  return &scene_stats;
+}
+
+void scene_set_path_grid(const game_path_grid_t *grid, const game_path_hpa_t *hpa)
+{
+  path_grid = grid;
+  path_hpa = hpa;
+  path_cache_free(&path_cache);
 }
 
-void scene_process_input(game_camera_t *camera, game_entity_t entities[], game_terrain_map_t *terrain_map, short selected[GAME_MAX_SELECTED])
+static void scene_refresh_pick_bvh(game_entity_store_t *entities)
 {
+  if (bvh_needs_rebuild(&pick_bvh, entities->count))
+  {
+    bvh_build(&pick_bvh, entities->bbox, entities->count);
+  }
+  else
+  {
+    bvh_refit(&pick_bvh, entities->bbox);
+  }
+}
+
+static void scene_build_collision_grid(game_entity_store_t *entities, game_terrain_map_t *terrain_map)
+{
+  // cells are as wide as the largest footprint, the nearest neighbour search walks outwards from there
+  float cell_size = 1.0f;
+  collision_max_speed = 0.0f;
+  arrsetlen(collision_indices, 0);
+  for (uint32_t i = 0; i < entities->count; i++)
+  {
+    if (entities->state[i] & GAME_ENT_STATE_DEAD)
+    {
+      continue;
+    }
+    BoundingBox bbox = entities->bbox[i];
+    cell_size = fmaxf(cell_size, fmaxf(bbox.max.x - bbox.min.x, bbox.max.z - bbox.min.z));
+    collision_max_speed = fmaxf(collision_max_speed, entities->move_speed[i]);
+    arrput(collision_indices, i);
+  }
+  Vector2 half_extents = (Vector2){terrain_map->max_width / 2.0f, terrain_map->max_height / 2.0f};
+  spatial_grid_init(&collision_grid, Vector2Negate(half_extents), half_extents, cell_size);
+  spatial_grid_build(&collision_grid, entities->position, collision_indices, arrlen(collision_indices));
+}
+
+void scene_process_input(game_camera_t *camera, game_entity_store_t *entities, game_terrain_map_t *terrain_map, game_entity_handle_t selected[GAME_MAX_SELECTED])
+{
+  // pick for every click in one batch, handling the events below never moves or removes units so the hits stay valid
+  arrsetlen(pick_rays, 0);
+  for (int i = 0; i < arrlen(camera->input_events); i++)
+  {
+    if (camera->input_events[i].event_type <= LEFT_CLICK_ATTACK)
+    {
+      arrput(pick_rays, camera->input_events[i].mouse_ray);
+    }
+  }
+  arrsetlen(pick_targets, arrlen(pick_rays));
+  scene_get_ids(pick_rays, (uint32_t)arrlen(pick_rays), entities, pick_targets);
+  arrsetlen(ground_rays, 0);
+  for (int i = 0, pick = 0; i < arrlen(camera->input_events); i++)
+  {
+    if (camera->input_events[i].event_type > LEFT_CLICK_ATTACK)
+    {
+      continue;
+    }
+    if (camera->input_events[i].event_type == RIGHT_CLICK && pick_targets[pick] == GAME_ENTITY_HANDLE_NONE)
+    {
+      arrput(ground_rays, camera->input_events[i].mouse_ray);
+    }
+    pick++;
+  }
+  arrsetlen(ground_hits, arrlen(ground_rays));
+  terrain_get_ray_batch(ground_rays, (uint32_t)arrlen(ground_rays), terrain_map, camera->near_plane, camera->far_plane, ground_hits);
+  int pick_cursor = 0;
+  int ground_cursor = 0;
+
     // process all input events gathered in between ticks
   for (int i = 0; i < arrlen(camera->input_events); i++)
   {
     game_input_event_t *input_event = &camera->input_events[i];
-    short target_id = -1;
+    game_entity_handle_t target = GAME_ENTITY_HANDLE_NONE;
+    int32_t target_index = -1;
     // check all input event types, note that anything related to camera control is not checked,
     // instead it's updated every frame rather than in the tick loop
     switch (input_event->event_type)
     {
       case LEFT_CLICK:
         // select an entity or deselect current  list
-        target_id = scene_get_id(input_event->mouse_ray, entities);
-        if (target_id >= 0)
+        target = pick_targets[pick_cursor++];
+        if (target != GAME_ENTITY_HANDLE_NONE)
         {
           scene_remove_selected_all(selected);
-          scene_add_selected(target_id, selected, false);
+          scene_add_selected(target, selected, false);
         }
         else
         {
@@ -106,67 +379,58 @@ void scene_process_input(game_camera_t *camera, game_entity_t entities[], game_t
         break;
       case LEFT_CLICK_ADD:
         // add or deselect entity to selected list
-        target_id = scene_get_id(input_event->mouse_ray, entities);
-        if (target_id >= 0)
+        target = pick_targets[pick_cursor++];
+        target_index = entity_resolve(entities, target);
+        if (target_index >= 0)
         {
           // don't add enemies to existing player group or vice versa
-          if (entities[target_id].team == GAME_TEAM_PLAYER && entities[selected[0]].team == GAME_TEAM_PLAYER)
+          int32_t first_index = entity_resolve(entities, selected[0]);
+          if (entities->team[target_index] == GAME_TEAM_PLAYER && (first_index < 0 || entities->team[first_index] == GAME_TEAM_PLAYER))
           {
-            scene_add_selected(target_id, selected, false);
+            scene_add_selected(target, selected, false);
           }
         }
         break;
       case LEFT_CLICK_ATTACK:
         // force attack if valid ray regardless of entity teams
-        target_id = scene_get_id(input_event->mouse_ray, entities);
-        if (target_id >= 0)
+        target = pick_targets[pick_cursor++];
+        if (target != GAME_ENTITY_HANDLE_NONE)
         {
-          entity_set_attacking(target_id, entities, selected);
+          entity_set_attacking(target, entities, selected);
         }
         break;
       case RIGHT_CLICK:
-        target_id = scene_get_id(input_event->mouse_ray, entities);
-        if (target_id >= 0)
+        target = pick_targets[pick_cursor++];
+        target_index = entity_resolve(entities, target);
+        if (target_index >= 0)
         {
-          game_entity_t *target_ent = &entities[target_id];
-          if (target_ent->team != GAME_TEAM_PLAYER)
+          if (entities->team[target_index] != GAME_TEAM_PLAYER)
           {
-            entity_set_attacking(target_id, entities, selected);
+            entity_set_attacking(target, entities, selected);
           }
           else {
-            for (int i = 0; i < GAME_MAX_SELECTED; i++)
-            {
-              if (selected[i] >= 0)
-              {
-                entity_set_moving((Vector2){target_ent->position.x, target_ent->position.z}, selected[i], entities);
-              }
-            }
+            Vector3 target_pos = entities->position[target_index];
+            entity_set_moving_group((Vector2){target_pos.x, target_pos.z}, selected, entities);
           }
         }
         else 
         {
           // no targets found, move to position instead
-          Vector3 target = terrain_get_ray(input_event->mouse_ray, terrain_map, camera->near_plane, camera->far_plane);
-          for (int i = 0; i < GAME_MAX_SELECTED; i++)
-          {
-            if (selected[i] >= 0)
-            {
-              entity_set_moving((Vector2){target.x, target.z}, selected[i], entities);
-            }
-          }
+          Vector3 target = ground_hits[ground_cursor++].position;
+          entity_set_moving_group((Vector2){target.x, target.z}, selected, entities);
         }
         break;
       case LEFT_CLICK_GROUP:
         scene_remove_selected_all(selected);
         // implicit fallthrough, 
       case LEFT_CLICK_ADD_GROUP:
-        for (int i = 0, j = 0; i < GAME_MAX_SELECTED && j < arrlen(entities); i++, j++)
+        for (uint32_t i = 0, j = 0; i < GAME_MAX_SELECTED && j < entities->count; i++, j++)
         {
-          if (entities[j].team != GAME_TEAM_PLAYER) continue; // only group select player units
-          Vector2 ent_pos = GetWorldToScreen(entities[j].position, camera->ray_view_cam);
+          if (entities->team[j] != GAME_TEAM_PLAYER) continue; // only group select player units
+          Vector2 ent_pos = GetWorldToScreen(entities->position[j], camera->ray_view_cam);
           if (CheckCollisionPointRec(ent_pos, input_event->mouse_rect) == true)
           {
-            scene_add_selected(entities[j].id, selected, true);
+            scene_add_selected(entities->handle[j], selected, true);
           }
         }
         break;
@@ -178,143 +442,385 @@ void scene_process_input(game_camera_t *camera, game_entity_t entities[], game_t
   arrsetlen(camera->input_events, 0);
 }
 
-void scene_process_ai(game_entity_t entities[])
+static void scene_build_team_grids(game_entity_store_t *entities, game_terrain_map_t *terrain_map)
 {
-  for (size_t i = 0; i < arrlen(entities); i++)
+  for (int team = 0; team < GAME_TEAM_COUNT; team++)
+  {
+    arrsetlen(team_indices[team], 0);
+  }
+  for (uint32_t i = 0; i < entities->count; i++)
   {
-    game_entity_t *ent = &entities[i];
-    if (ent->team == GAME_TEAM_AI && !(ent->state & GAME_ENT_STATE_DEAD))
+    uint8_t team = entities->team[i];
+    if (team < GAME_TEAM_COUNT && entities->hit_points[i] > 0 && !(entities->state[i] & GAME_ENT_STATE_DEAD))
     {
-      if ((ent->hit_points / ent->hit_points_max) >= ENT_AI_FLEE_THRESHOLD)
+      arrput(team_indices[team], i);
+    }
+  }
+  Vector2 half_extents = (Vector2){terrain_map->max_width / 2.0f, terrain_map->max_height / 2.0f};
+  for (int team = 0; team < GAME_TEAM_COUNT; team++)
+  {
+    spatial_grid_init(&team_grids[team], Vector2Negate(half_extents), half_extents, ENT_AI_GRID_CELL_SIZE);
+    spatial_grid_build(&team_grids[team], entities->position, team_indices[team], arrlen(team_indices[team]));
+  }
+}
+
+// every ai unit only writes its own fields and reads others through the team grids, so chunks run independently
+static void scene_process_ai_chunk(void *data, uint32_t chunk_index, uint32_t worker_index)
+{
+  (void)worker_index;
+  game_entity_store_t *entities = data;
+  const game_spatial_grid_t *enemies = &team_grids[GAME_TEAM_PLAYER];
+  uint32_t end = (chunk_index + 1) * SCENE_UPDATE_CHUNK_SIZE;
+  end = end < entities->count ? end : entities->count;
+  for (uint32_t i = chunk_index * SCENE_UPDATE_CHUNK_SIZE; i < end; i++)
+  {
+    if (entities->team[i] == GAME_TEAM_AI && !(entities->state[i] & GAME_ENT_STATE_DEAD))
+    {
+      if ((entities->hit_points[i] / entities->hit_points_max[i]) >= ENT_AI_FLEE_THRESHOLD)
       {
-        entity_attack_closest_ai(ent, entities);
+        entity_attack_closest_ai(i, entities, enemies);
       }
       else 
       {
-        entity_flee_closest_ai(ent, entities);
+        entity_flee_closest_ai(i, entities, enemies);
       }
     }
   }
 }
 
-void scene_update_entities(game_camera_t *camera, game_entity_t entities[], game_terrain_map_t *terrain_map, short selected[GAME_MAX_SELECTED], float dt)
+void scene_process_ai(game_entity_store_t *entities, game_terrain_map_t *terrain_map)
+{
+  scene_build_team_grids(entities, terrain_map);
+  uint32_t chunk_count = (entities->count + SCENE_UPDATE_CHUNK_SIZE - 1) / SCENE_UPDATE_CHUNK_SIZE;
+  jobs_parallel_for(chunk_count, scene_process_ai_chunk, entities);
+  // in entity order, so tickets and coalescing come out the same whichever worker ran which unit
+  for (uint32_t i = 0; i < entities->count; i++)
+  {
+    if (entities->path_ticket[i] == SCENE_PATH_TICKET_WANTED)
+    {
+      Vector2 start = (Vector2){entities->position[i].x, entities->position[i].z};
+      entities->path_ticket[i] = path_request_submit(&path_requests, path_grid, start, entities->target_pos[i], GAME_PATH_PRIORITY_AI);
+    }
+  }
+}
+
+// only writes fields of entity i, anything read from other entities comes from the previous tick buffers
+static void scene_update_entity(uint32_t i, game_scene_update_t *update, game_scene_chunk_t *chunk)
 {
-  // updating all entities after input is processed
-  for (size_t i = 0; i < arrlen(entities); i++)
+  game_entity_store_t *entities = update->entities;
+  // update entities here then mark dirty
+  Vector3 old_pos = entities->position[i];
+  // stays zero unless the unit moves below
+  entities->velocity[i] = (Vector2){0};
+  const ModelAnimation *anims = entities->asset[i]->anims;
+  uint8_t *state = &entities->state[i];
+  // check one-time actions first, attack will reset to idle, dead will stay on last frame of death
+  if (*state & GAME_ENT_STATE_ACTION)
   {
-    // update entities here then mark dirty
-    game_entity_t *ent = &entities[i];
-    Vector3 old_pos = ent->position;
-    // check one-time actions first, attack will reset to idle, dead will stay on last frame of death
-    if (ent->state & GAME_ENT_STATE_ACTION)
+    entities->anim_current_frame[i] = (entities->anim_current_frame[i] + 1);
+    if (*state & GAME_ENT_STATE_ATTACKING)
     {
-      ent->anim_current_frame = (ent->anim_current_frame + 1);
-      if (ent->state & GAME_ENT_STATE_ATTACKING)
+      if (entities->anim_current_frame[i] >= anims[entities->anim_index[i]].frameCount)
       {
-        if (ent->anim_current_frame >= ent->anim[ent->anim_index].frameCount)
-        {
-          ent->state ^= GAME_ENT_STATE_ACTION;
-          entity_resolve_attack(ent, entities);
-          entity_set_animation(ent, ROBO_IDLE);
-        }
+        // damage is only queued here, the target may be updating on another worker right now
+        *state ^= GAME_ENT_STATE_ACTION;
+        entities->attack_cooldown[i] = entities->attack_cooldown_max[i];
+        arrput(chunk->damage_events, ((game_damage_event_t){.source_index = i, .target = entities->target[i], .damage = entities->attack_damage[i]}));
+        entity_set_animation(i, entities, ROBO_IDLE);
       }
-      else if (ent->state & GAME_ENT_STATE_DEAD)
+    }
+    else if (*state & GAME_ENT_STATE_DEAD)
+    {
+      if (entities->anim_current_frame[i] >= anims[entities->anim_index[i]].frameCount)
+      {
+        // mark dead, removed from the store once this tick's loop is done
+        *state ^= GAME_ENT_STATE_ACTION;
+        return;
+      }
+    }
+  }
+  else
+  {
+    if (*state & GAME_ENT_STATE_DEAD)
+    {
+      return;
+    }
+    int32_t target_index = entity_resolve(entities, entities->target[i]);
+    if ((*state & GAME_ENT_STATE_ATTACKING) && target_index < 0)
+    {
+      // target was removed, stand down
+      *state = GAME_ENT_STATE_IDLE;
+      entity_set_animation(i, entities, ROBO_IDLE);
+    }
+    if (*state & GAME_ENT_STATE_ATTACKING)
+    {
+      Vector3 target_position = read_position[target_index];
+      // check if within range to attack, else keep moving towards target
+      if (entity_check_attack(i, target_position, entities))
       {
-        if (ent->anim_current_frame >= ent->anim[ent->anim_index].frameCount)
+        if (entities->attack_cooldown[i] <= 0)
         {
-          // mark dead
-          ent->state ^= GAME_ENT_STATE_ACTION;
-          memset(&ent->bbox, 0, sizeof ent->bbox); // hack to not let dead units be selected
-          continue;
+          // begin attack, stop moving target, then check when attack anim is finished to do damage
+          entities->target_pos[i] = (Vector2){target_position.x, target_position.z};
+          Vector2 move_vec = Vector2Subtract(entities->target_pos[i], (Vector2){entities->position[i].x, entities->position[i].z});
+          entities->rotation[i].y = (float)atan2(move_vec.x, move_vec.y);
+          *state = GAME_ENT_STATE_ATTACKING | GAME_ENT_STATE_ACTION;
+          entity_set_animation(i, entities, ROBO_PUNCH);
+          entities->is_dirty[i] = true;
         }
+        else
+        {
+          if (*state & GAME_ENT_STATE_MOVING) {
+            entity_set_animation(i, entities, ROBO_IDLE);
+            *state ^= GAME_ENT_STATE_MOVING;
+          }
+        }
+      }
+      else
+      {
+        if (entities->anim_index[i] != ROBO_MOVING) entities->anim_index[i] = ROBO_MOVING; // nasty patchwork
+        *state = GAME_ENT_STATE_MOVING | GAME_ENT_STATE_ATTACKING;
+        entities->target_pos[i] = (Vector2){target_position.x, target_position.z};
       }
+      entities->attack_cooldown[i] -= update->dt;
     }
-    else
+    if (*state & GAME_ENT_STATE_MOVING)
     {
-      if (ent->state & GAME_ENT_STATE_DEAD)
+      Vector2 position = (Vector2){entities->position[i].x, entities->position[i].z};
+      if (Vector2Equals(position, entities->target_pos[i]))
       {
-        continue;
+        *state ^= GAME_ENT_STATE_MOVING;
+        entity_clear_route(i, entities);
+        entity_set_animation(i, entities, ROBO_IDLE);
       }
-      if (ent->state & GAME_ENT_STATE_ATTACKING)
+      else if (entities->path_ticket[i] == 0) // units waiting for a path hold still until it arrives
       {
-        // check if within range to attack, else keep moving towards target
-        if (entity_check_attack(ent, entities))
+        
+        float adjusted_speed = entities->move_speed[i];
+        // head for the next waypoint or down the flow field, target_pos is where both end. cells the field never
+        // reached head straight for it
+        bool on_path = entities->path_next[i] < arrlenu(entities->path[i]);
+        Vector2 aim = on_path ? entities->path[i][entities->path_next[i]] : entities->target_pos[i];
+        if (entities->flow[i] != 0 && path_grid != NULL)
         {
-          if (ent->attack_cooldown <= 0)
-          {
-            // begin attack, stop moving target, then check when attack anim is finished to do damage
-            ent->target_pos = (Vector2){entities[ent->target_id].position.x, entities[ent->target_id].position.z};
-            Vector2 move_vec = Vector2Subtract(ent->target_pos, (Vector2){ent->position.x, ent->position.z});
-            ent->rotation.y = (float)atan2(move_vec.x, move_vec.y);
-            ent->state = GAME_ENT_STATE_ATTACKING | GAME_ENT_STATE_ACTION;
-            entity_set_animation(ent, ROBO_PUNCH);
-            ent->is_dirty = true;
-          }
-          else
-          {
-            if (ent->state & GAME_ENT_STATE_MOVING) {
-              entity_set_animation(ent, ROBO_IDLE);
-              ent->state ^= GAME_ENT_STATE_MOVING;
-            }
-          }
+          path_flow_get_aim(path_grid, &path_flows, entities->flow[i], position, &aim);
         }
-        else
+        Vector2 raw_dist = Vector2Subtract(aim, position);
+        Vector2 move_vec = Vector2Scale(Vector2Normalize(raw_dist), adjusted_speed);
+        float dist = Vector2Length(raw_dist);
+        if (dist < Vector2Length(move_vec))
         {
-          if (ent->anim_index != ROBO_MOVING) ent->anim_index = ROBO_MOVING; // nasty patchwork
-          ent->state = GAME_ENT_STATE_MOVING | GAME_ENT_STATE_ATTACKING;
-          ent->target_pos = (Vector2){entities[ent->target_id].position.x, entities[ent->target_id].position.z};
+          move_vec = raw_dist;
         }
-        ent->attack_cooldown -= dt;
-      }
-      if (ent->state & GAME_ENT_STATE_MOVING)
-      {
-        if (Vector2Equals((Vector2){ent->position.x, ent->position.z}, ent->target_pos))
+        if (on_path && dist <= adjusted_speed)
+        {
+          entities->path_next[i]++;
+        }
+        // steer around neighbours by their start of tick positions, keep bbox for only mouse selections
+        bool is_stopped = false;
+        Vector2 velocity = entity_avoid(i, entities, move_vec, &is_stopped, &chunk->stats);
+        if (is_stopped)
         {
-          ent->state ^= GAME_ENT_STATE_MOVING;
-          entity_set_animation(ent, ROBO_IDLE);
+          // the spot is taken, settle next to whoever stands on it instead of pushing forever
+          *state ^= GAME_ENT_STATE_MOVING;
+          entity_clear_route(i, entities);
+          entity_set_animation(i, entities, ROBO_IDLE);
         }
         else
         {
-          
-          float adjusted_speed = ent->move_speed;
-          Vector2 raw_dist = Vector2Subtract(ent->target_pos, (Vector2){ent->position.x, ent->position.z});
-          Vector2 move_vec = Vector2Scale(Vector2Normalize(raw_dist), adjusted_speed);
-          if (Vector2Length(raw_dist) < Vector2Length(move_vec))
+          // rotations not working correctly
+          if (velocity.x != 0.0f || velocity.y != 0.0f)
           {
-            move_vec = raw_dist;
+            entities->rotation[i].y = (float)atan2(velocity.x, velocity.y);
           }
-          // check collisions based purely on positions, keep bbox for only mouse selections
-          // rotations not working correctly
-          Vector3 newPos = Vector3Add((Vector3){move_vec.x, 0.0, move_vec.y}, ent->position);
-          ent->rotation.y = (float)atan2(move_vec.x, move_vec.y);
-          ent->position = newPos;
-          // position will be adjusted within EntityCheckCollision
-          entity_collision_check(ent, entities);
-          ent->is_dirty = true;
+          entities->position[i] = Vector3Add((Vector3){velocity.x, 0.0, velocity.y}, entities->position[i]);
+          entities->velocity[i] = velocity;
+          entities->is_dirty[i] = true;
         }
       }
-      ent->anim_current_frame = (ent->anim_current_frame + 1) % ent->anim[ent->anim_index].frameCount;
     }
-    if (ent->is_dirty)
+    entities->anim_current_frame[i] = (entities->anim_current_frame[i] + 1) % anims[entities->anim_index[i]].frameCount;
+  }
+  if (entities->is_dirty[i])
+  {
+    chunk->dirty_index[chunk->dirty_count] = i;
+    chunk->dirty_old_position[chunk->dirty_count] = old_pos;
+    chunk->dirty_position[chunk->dirty_count] = entities->position[i];
+    chunk->dirty_count++;
+  }
+}
+
+static void scene_update_chunk(void *data, uint32_t chunk_index, uint32_t worker_index)
+{
+  (void)worker_index;
+  game_scene_update_t *update = data;
+  game_scene_chunk_t *chunk = &scene_chunks[chunk_index];
+  memset(&chunk->stats, 0, sizeof chunk->stats);
+  arrsetlen(chunk->damage_events, 0);
+  chunk->dirty_count = 0;
+  uint32_t end = (chunk_index + 1) * SCENE_UPDATE_CHUNK_SIZE;
+  end = end < update->entities->count ? end : update->entities->count;
+  for (uint32_t i = chunk_index * SCENE_UPDATE_CHUNK_SIZE; i < end; i++)
+  {
+    scene_update_entity(i, update, chunk);
+  }
+  terrain_get_adjusted_y_batch(chunk->dirty_position, chunk->dirty_count, update->terrain_map, chunk->dirty_ground_y);
+  for (uint32_t d = 0; d < chunk->dirty_count; d++)
+  {
+    entity_dirty_update(chunk->dirty_old_position[d], chunk->dirty_index[d], update->entities, chunk->dirty_ground_y[d]);
+  }
+}
+
+// hands out what the last service answered, a route or the whole path. units whose search failed head straight for
+// their target
+static void scene_deliver_paths(game_entity_store_t *entities)
+{
+  for (uint32_t i = 0; i < entities->count; i++)
+  {
+    const game_path_request_t *request = entities->path_ticket[i] != 0 ? path_request_get(&path_requests, entities->path_ticket[i]) : NULL;
+    if (request == NULL)
+    {
+      continue;
+    }
+    entities->path_ticket[i] = 0;
+    if (!request->found)
+    {
+      continue;
+    }
+    Vector2 **waypoints = request->is_route ? &entities->route[i] : &entities->path[i];
+    size_t count = arrlenu(request->waypoints);
+    arrsetlen(*waypoints, count);
+    memcpy(*waypoints, request->waypoints, sizeof(Vector2) * count);
+    // a goal on blocked ground becomes the closest spot the path reaches
+    entities->target_pos[i] = request->waypoints[count - 1];
+  }
+}
+
+// gives units that walked the last waypoint of a leg the waypoints of the next one, before anything moves so they
+// never spend a tick aiming past it. a leg the cluster can not answer is searched on the whole grid
+static void scene_refine_routes(game_entity_store_t *entities)
+{
+  for (uint32_t i = 0; i < entities->count; i++)
+  {
+    if (!(entities->state[i] & GAME_ENT_STATE_MOVING) || entities->route_next[i] >= arrlenu(entities->route[i]) ||
+        entities->path_next[i] < arrlenu(entities->path[i]))
+    {
+      continue;
+    }
+    Vector2 from = (Vector2){entities->position[i].x, entities->position[i].z};
+    Vector2 to = entities->route[i][entities->route_next[i]++];
+    if (!path_hpa_refine(path_grid, path_hpa, &path_query, from, to, &entities->path[i]) &&
+        !path_find(path_grid, &path_cache, &path_search_scratch, from, to, &entities->path[i]))
+    {
+      arrsetlen(entities->path[i], 0);
+      arrput(entities->path[i], to);
+    }
+    entities->path_next[i] = 0;
+  }
+}
+
+void scene_update_entities(game_camera_t *camera, game_entity_store_t *entities, game_terrain_map_t *terrain_map, game_entity_handle_t selected[GAME_MAX_SELECTED], float dt)
+{
+  memset(&scene_stats, 0, sizeof scene_stats);
+  // whole grid searches happen while refining legs in the last update, flow fields while handling input right before this
+  scene_stats.path_queries = path_cache.stats.queries;
+  scene_stats.path_cache_hits = path_cache.stats.cache_hits;
+  scene_stats.path_nodes_expanded = path_cache.stats.expanded;
+  memset(&path_cache.stats, 0, sizeof path_cache.stats);
+  scene_stats.flow_fields = path_flows.built;
+  scene_stats.flow_shared = path_flows.reused;
+  scene_stats.flow_cells = path_flows.expanded;
+  path_flows.built = 0;
+  path_flows.reused = 0;
+  path_flows.expanded = 0;
+  scene_deliver_paths(entities);
+  if (path_hpa != NULL)
+  {
+    scene_refine_routes(entities);
+    scene_stats.path_refined = path_query.refined;
+    path_query.refined = 0;
+  }
+  scene_build_collision_grid(entities, terrain_map);
+
+  // snapshot what entities read from each other, the parallel phase below only writes the next tick's state
+  arrsetlen(read_position, entities->count);
+  arrsetlen(read_velocity, entities->count);
+  arrsetlen(read_bbox, entities->count);
+  arrsetlen(read_state, entities->count);
+  memcpy(read_position, entities->position, sizeof(*read_position) * entities->count);
+  memcpy(read_velocity, entities->velocity, sizeof(*read_velocity) * entities->count);
+  memcpy(read_bbox, entities->bbox, sizeof(*read_bbox) * entities->count);
+  memcpy(read_state, entities->state, sizeof(*read_state) * entities->count);
+
+  uint32_t chunk_count = (entities->count + SCENE_UPDATE_CHUNK_SIZE - 1) / SCENE_UPDATE_CHUNK_SIZE;
+  while (arrlen(scene_chunks) < chunk_count)
+  {
+    arrput(scene_chunks, (game_scene_chunk_t){0});
+  }
+  game_scene_update_t update = {.entities = entities, .terrain_map = terrain_map, .dt = dt};
+  jobs_parallel_for(chunk_count, scene_update_chunk, &update);
+
+  // merge chunks in order, damage lands in entity order whichever worker produced it
+  for (uint32_t c = 0; c < chunk_count; c++)
+  {
+    game_scene_chunk_t *chunk = &scene_chunks[c];
+    scene_stats.avoid_queries += chunk->stats.avoid_queries;
+    scene_stats.avoid_neighbors += chunk->stats.avoid_neighbors;
+    scene_stats.avoid_overlaps += chunk->stats.avoid_overlaps;
+    scene_stats.avoid_crowded += chunk->stats.avoid_crowded;
+    for (int e = 0; e < arrlen(chunk->damage_events); e++)
+    {
+      entity_resolve_attack(&chunk->damage_events[e], entities);
+    }
+  }
+
+  // reclaim units that finished dying, walking backwards so swapped in entities were already checked
+  for (uint32_t i = entities->count; i-- > 0;)
+  {
+    if (entities->state[i] == GAME_ENT_STATE_DEAD)
     {
-      entity_dirty_update(old_pos, ent, terrain_map);
+      scene_remove_selected(entities->handle[i], selected);
+      entity_remove(entities, entities->handle[i]);
     }
-    UpdateModelAnimation(ent->model, ent->anim[ent->anim_index], ent->anim_current_frame);
   }
+  path_flow_evict(&path_flows);
+  if (path_grid != NULL)
+  {
+    path_requests_service(&path_requests, path_grid, path_hpa);
+  }
+  scene_stats.path_requests = path_requests.submitted;
+  scene_stats.path_requests_shared = path_requests.coalesced;
+  scene_stats.path_requests_queued = path_requests_pending(&path_requests);
+  scene_stats.path_routes = path_requests.routes;
+  scene_stats.path_route_nodes = path_requests.expanded;
+  path_requests.submitted = 0;
+  path_requests.coalesced = 0;
+  path_requests.served = 0;
+  path_requests.routes = 0;
+  path_requests.expanded = 0;
+  scene_refresh_pick_bvh(entities);
 }
 
-void entity_dirty_update(Vector3 old_pos, game_entity_t *ent, game_terrain_map_t *terrain_map)
+void entity_dirty_update(Vector3 old_pos, uint32_t index, game_entity_store_t *entities, float ground_y)
 {
-  Vector3 adjusted_pos = (Vector3){.x = ent->position.x,
-                                   .z = ent->position.z,
-                                   .y = ent->offset_y + terrain_get_adjusted_y(ent->position, terrain_map)};
-  ent->position = adjusted_pos;
-  ent->model.transform = MatrixMultiply(MatrixRotateZYX(ent->rotation),
-                                        MatrixMultiply(MatrixTranslate(adjusted_pos.x, adjusted_pos.y, adjusted_pos.z),
-                                                       MatrixScale(ent->scale.x, ent->scale.y, ent->scale.z)));
+  Vector3 position = entities->position[index];
+  Vector3 adjusted_pos = (Vector3){.x = position.x,
+                                   .z = position.z,
+                                   .y = entities->offset_y[index] + ground_y};
+  Vector3 scale = entities->scale[index];
+  entities->position[index] = adjusted_pos;
+  entities->transform[index] = MatrixMultiply(MatrixRotateZYX(entities->rotation[index]),
+                                              MatrixMultiply(MatrixTranslate(adjusted_pos.x, adjusted_pos.y, adjusted_pos.z),
+                                                             MatrixScale(scale.x, scale.y, scale.z)));
+
+  entity_bbox_update(Vector3Subtract(adjusted_pos, old_pos), &entities->bbox[index]);
+  entities->is_dirty[index] = false;
+}
 
-  entity_bbox_update(Vector3Subtract(adjusted_pos, old_pos), &ent->bbox);
-  ent->is_dirty = false;
+Model entity_get_posed_model(uint32_t index, game_entity_store_t *entities)
+{
+  // skinning happens here instead of the tick loop since every entity shares the same mesh buffers
+  return asset_pose(entities->asset[index], entities->anim_index[index], entities->anim_current_frame[index], entities->transform[index]);
 }
 
 BoundingBox entity_bbox_derive(Vector3 *position, Vector3 *dimensions_offset, Vector3 *dimensions)
@@ -335,155 +841,193 @@ void entity_bbox_update(Vector3 position, BoundingBox *bbox)
   bbox->min = Vector3Add(bbox->min, position);
 }
 
-void entity_set_moving(Vector2 position, short entity_id, game_entity_t entities[])
+void entity_set_moving(Vector2 position, game_entity_handle_t handle, game_entity_store_t *entities)
 {
   // used purely for move orders, negates attack
-  game_entity_t *ent = &entities[entity_id];
-  ent->target_pos = position;
-  ent->state = GAME_ENT_STATE_MOVING;
-  entity_set_animation(ent, ROBO_MOVING);
+  int32_t index = entity_resolve(entities, handle);
+  if (index < 0)
+  {
+    return;
+  }
+  entities->target_pos[index] = position;
+  entities->state[index] = GAME_ENT_STATE_MOVING;
+  entity_clear_route(index, entities);
+  // the unit waits for its answer, far goals come back as a route whose legs are refined as the unit reaches them
+  if (path_grid != NULL)
+  {
+    Vector2 start = (Vector2){entities->position[index].x, entities->position[index].z};
+    entities->path_ticket[index] = path_request_submit(&path_requests, path_grid, start, position, GAME_PATH_PRIORITY_PLAYER);
+  }
+  entity_set_animation(index, entities, ROBO_MOVING);
 }
 
-void entity_set_attacking(uint16_t target_id, game_entity_t entities[], short selected[GAME_MAX_SELECTED])
+void entity_set_moving_group(Vector2 position, game_entity_handle_t selected[GAME_MAX_SELECTED], game_entity_store_t *entities)
 {
+  int32_t indices[GAME_MAX_SELECTED];
+  Vector2 starts[GAME_MAX_SELECTED];
+  uint32_t count = 0;
   for (int i = 0; i < GAME_MAX_SELECTED; i++)
   {
-    if (selected[i] != -1)
+    int32_t index = entity_resolve(entities, selected[i]);
+    if (index >= 0)
+    {
+      // let go of the old field first, the same destination clicked again shares it instead of building a copy
+      entity_clear_route(index, entities);
+      indices[count] = index;
+      starts[count++] = (Vector2){entities->position[index].x, entities->position[index].z};
+    }
+  }
+  bool covered[GAME_MAX_SELECTED] = {0};
+  uint16_t flow = 0;
+  if (path_grid != NULL && count > 1)
+  {
+    flow = path_flow_acquire(path_grid, &path_flows, &path_search_scratch, position, starts, count, covered);
+  }
+  // units the field did not reach, or all of them without one, look for their own way
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (!covered[i])
     {
-      entities[selected[i]].target_id = target_id;
-      entities[selected[i]].state = GAME_ENT_STATE_ATTACKING;
-      entity_set_animation(&entities[selected[i]], ROBO_MOVING);
+      entity_set_moving(position, entities->handle[indices[i]], entities);
+      continue;
     }
+    entities->target_pos[indices[i]] = path_flow_get_goal(&path_flows, flow);
+    entities->state[indices[i]] = GAME_ENT_STATE_MOVING;
+    entities->flow[indices[i]] = flow;
+    entity_set_animation(indices[i], entities, ROBO_MOVING);
   }
 }
 
-void entity_attack_closest_ai(game_entity_t *entity, game_entity_t entities[])
+void entity_set_attacking(game_entity_handle_t target, game_entity_store_t *entities, game_entity_handle_t selected[GAME_MAX_SELECTED])
 {
-  Vector2 source_pos = (Vector2){entity->position.x, entity->position.z};
-  float min_distance = __FLT_MAX__;
-  short closest_id = -1;
-  // iterate over entities and find closest living player to attack
-  for (size_t i = 0; i < arrlen(entities); i++)
+  for (int i = 0; i < GAME_MAX_SELECTED; i++)
   {
-    game_entity_t *target_entity = &entities[i];
-    if (target_entity == entity) continue;
-    if (target_entity->team == GAME_TEAM_PLAYER && target_entity->hit_points > 0)
+    int32_t index = entity_resolve(entities, selected[i]);
+    if (index >= 0)
     {
-      Vector2 dest_pos = (Vector2){target_entity->position.x, target_entity->position.z};
-      float current_distance = Vector2Distance(source_pos, dest_pos);
-      if (current_distance < min_distance)
-      {
-        min_distance = current_distance;
-        closest_id = i;
-      }
+      entities->target[index] = target;
+      entities->state[index] = GAME_ENT_STATE_ATTACKING;
+      entity_clear_route(index, entities);
+      entity_set_animation(index, entities, ROBO_MOVING);
     }
   }
-  if (closest_id != -1 && entity->target_id != closest_id)
+}
+
+void entity_attack_closest_ai(uint32_t index, game_entity_store_t *entities, const game_spatial_grid_t *enemies)
+{
+  Vector2 source_pos = (Vector2){entities->position[index].x, entities->position[index].z};
+  uint32_t closest_id;
+  float closest_dist_sq;
+  // find closest living enemy the unit can see to attack
+  if (spatial_grid_query_nearest(enemies, source_pos, ENT_AI_VISIBILITY_RADIUS, 1, &closest_id, &closest_dist_sq) == 0)
   {
-    entity->target_id = closest_id;
-    entity->state = GAME_ENT_STATE_ATTACKING;
-    entity_set_animation(entity, ROBO_MOVING);
+    return;
+  }
+  if (entities->target[index] != entities->handle[closest_id])
+  {
+    entities->target[index] = entities->handle[closest_id];
+    entities->state[index] = GAME_ENT_STATE_ATTACKING;
+    entity_clear_route(index, entities);
+    entity_set_animation(index, entities, ROBO_MOVING);
   }
 }
 
-void entity_flee_closest_ai(game_entity_t *entity, game_entity_t entities[])
+void entity_flee_closest_ai(uint32_t index, game_entity_store_t *entities, const game_spatial_grid_t *enemies)
 {
-  Vector2 source_pos = (Vector2){entity->position.x, entity->position.z};
-  float min_distance = __FLT_MAX__;
-  short closest_id = -1;
-  // iterate over entities and find closest living player to attack
-  for (size_t i = 0; i < arrlen(entities); i++)
+  Vector2 source_pos = (Vector2){entities->position[index].x, entities->position[index].z};
+  uint32_t closest_id;
+  float closest_dist_sq;
+  // find closest living enemy the unit can see to run away from
+  if (spatial_grid_query_nearest(enemies, source_pos, ENT_AI_VISIBILITY_RADIUS, 1, &closest_id, &closest_dist_sq) == 0)
   {
-    game_entity_t *target_entity = &entities[i];
-    if (target_entity == entity) continue;
-    if (target_entity->team == GAME_TEAM_PLAYER && target_entity->hit_points > 0)
-    {
-      Vector2 dest_pos = (Vector2){target_entity->position.x, target_entity->position.z};
-      float current_distance = Vector2Distance(source_pos, dest_pos);
-      if (current_distance < min_distance)
-      {
-        min_distance = current_distance;
-        closest_id = i;
-      }
-    }
+    return;
   }
-  if (closest_id != -1)
+  Vector2 flee_vector = Vector2Subtract(source_pos, (Vector2){entities->position[closest_id].x, entities->position[closest_id].z});
+  entities->target_pos[index] = Vector2Add(flee_vector, source_pos);
+  entities->state[index] = GAME_ENT_STATE_MOVING;
+  entity_clear_route(index, entities);
+  // runs on the ai workers, scene_process_ai queues the request once they are done
+  if (path_grid != NULL)
   {
-    Vector2 flee_vector = Vector2Subtract(source_pos, (Vector2){entities[closest_id].position.x, entities[closest_id].position.z});
-    entity->target_pos = Vector2Add(flee_vector, source_pos);
-    entity->state = GAME_ENT_STATE_MOVING;
-    entity_set_animation(entity, ROBO_MOVING);
+    entities->path_ticket[index] = SCENE_PATH_TICKET_WANTED;
   }
+  entity_set_animation(index, entities, ROBO_MOVING);
 }
 
-// at some point, integrate hashmap for proper lookups
-bool entity_check_attack(game_entity_t *ent, game_entity_t entities[])
+bool entity_check_attack(uint32_t index, Vector3 target_pos, game_entity_store_t *entities)
 {
-  game_entity_t *target_ent = &entities[ent->target_id];
-  return CheckCollisionPointCircle((Vector2){target_ent->position.x, target_ent->position.z}, (Vector2){ent->position.x, ent->position.z}, ent->attack_radius);
+  Vector3 source_pos = entities->position[index];
+  return CheckCollisionPointCircle((Vector2){target_pos.x, target_pos.z}, (Vector2){source_pos.x, source_pos.z}, entities->attack_radius[index]);
 }
 
 
-void entity_resolve_attack(game_entity_t *ent, game_entity_t entities[])
+void entity_resolve_attack(const game_damage_event_t *event, game_entity_store_t *entities)
 {
-  // NOTE: use timers, only subtract damage at end of animation resolution, separate starting attack with resolution
-  game_entity_t *target_ent = &entities[ent->target_id];
-  target_ent->hit_points -= ent->attack_damage;
-  ent->attack_cooldown = ent->attack_cooldown_max;
-  if (target_ent->hit_points <= 0 && !(target_ent->state & GAME_ENT_STATE_DEAD))
+  uint32_t index = event->source_index;
+  int32_t target_index = entity_resolve(entities, event->target);
+  if (target_index < 0)
+  {
+    // target got removed while the attack animation was playing
+    entities->state[index] = GAME_ENT_STATE_IDLE;
+    return;
+  }
+  entities->hit_points[target_index] -= event->damage;
+  if (entities->hit_points[target_index] <= 0 && !(entities->state[target_index] & GAME_ENT_STATE_DEAD))
   {
-    target_ent->state = GAME_ENT_STATE_DEAD | GAME_ENT_STATE_ACTION;
-    entity_set_animation(target_ent, ROBO_DIE);
-    // leave attacking mode
-    
+    entities->state[target_index] = GAME_ENT_STATE_DEAD | GAME_ENT_STATE_ACTION;
+    entity_set_animation(target_index, entities, ROBO_DIE);
   }
-  if (target_ent->state & GAME_ENT_STATE_DEAD)
+  // leave attacking mode
+  if (entities->state[target_index] & GAME_ENT_STATE_DEAD)
   {
-    ent->state = GAME_ENT_STATE_IDLE;
+    entities->state[index] = GAME_ENT_STATE_IDLE;
   }
 }
 
-short scene_get_id(Ray ray, game_entity_t entities[])
+game_entity_handle_t scene_get_id(Ray ray, game_entity_store_t *entities)
+{
+  game_entity_handle_t selected;
+  scene_get_ids(&ray, 1, entities, &selected);
+  return selected;
+}
+
+void scene_get_ids(const Ray *rays, uint32_t ray_count, game_entity_store_t *entities, game_entity_handle_t *out_handles)
 {
-  float closest_hit = __FLT_MAX__;
-  short selected_id = -1;
-  for (size_t i = 0; i < arrlen(entities); i++)
+  // entities added since the last tick are not in the tree yet
+  if (pick_bvh.item_count != entities->count)
   {
-    RayCollision collision = GetRayCollisionBox(ray, entities[i].bbox);
-    if (collision.hit)
-    {
-      if (collision.distance < closest_hit)
-      {
-        selected_id = i;
-        closest_hit = collision.distance;
-      }
-    }
+    bvh_build(&pick_bvh, entities->bbox, entities->count);
+  }
+  arrsetlen(pick_hits, ray_count);
+  bvh_raycast_batch(&pick_bvh, entities->bbox, rays, ray_count, pick_hits);
+  for (uint32_t i = 0; i < ray_count; i++)
+  {
+    out_handles[i] = pick_hits[i].hit ? entities->handle[pick_hits[i].item] : GAME_ENTITY_HANDLE_NONE;
   }
-  return selected_id;
 }
 
 /**
- * @brief Adds new ID to the selected array if there is space
+ * @brief Adds new handle to the selected array if there is space
  * 
- * @param selected_id ID of entity
+ * @param handle handle of entity
  * @param selected array containing selected units
  * @param is_group_selection flag for whether or not to deselect existing units or not
  */
-void scene_add_selected(short selected_id, short selected[GAME_MAX_SELECTED], bool is_group_selection)
+void scene_add_selected(game_entity_handle_t handle, game_entity_handle_t selected[GAME_MAX_SELECTED], bool is_group_selection)
 {
   short first_free_index;
   bool is_free_index_found = false;
   for (int i = 0; i < GAME_MAX_SELECTED; i++)
   {
-    if (selected[i] == selected_id)
+    if (selected[i] == handle)
     {
       if (!is_group_selection)
       {
-        selected[i] = -1; // already in, deselect
+        selected[i] = GAME_ENTITY_HANDLE_NONE; // already in, deselect
       }
       return; 
     }
-    if (!is_free_index_found && selected[i] == -1)  // get first index, then just keep checking to make sure id isn't already present
+    if (!is_free_index_found && selected[i] == GAME_ENTITY_HANDLE_NONE)  // get first index, then just keep checking to make sure handle isn't already present
     {
       first_free_index = i;
       is_free_index_found = true;
@@ -491,65 +1035,86 @@ void scene_add_selected(short selected_id, short selected[GAME_MAX_SELECTED], bo
   }
   if (is_free_index_found)
   {
-    selected[first_free_index] = selected_id;
+    selected[first_free_index] = handle;
   }
 }
 
-void scene_remove_selected_all(short selected[GAME_MAX_SELECTED])
+void scene_remove_selected_all(game_entity_handle_t selected[GAME_MAX_SELECTED])
 {
-  memset(selected, -1, sizeof(*selected * GAME_MAX_SELECTED));
+  memset(selected, -1, sizeof(*selected) * GAME_MAX_SELECTED);
 }
 
-void scene_remove_selected(short selectedId, short selected[GAME_MAX_SELECTED])
+void scene_remove_selected(game_entity_handle_t handle, game_entity_handle_t selected[GAME_MAX_SELECTED])
 {
   for (int i = 0; i < GAME_MAX_SELECTED; i++)
   {
-    if (selected[i] == selectedId)
+    if (selected[i] == handle)
     {
-      selected[i] = -1;
+      selected[i] = GAME_ENTITY_HANDLE_NONE;
       break;
     }
   }
 }
 
 /**
- * @brief Constructs 2D rectangles from entity's bounding box for collision checks
+ * @brief Picks a velocity clear of the entity's closest neighbours, each one a disc as wide as the larger side
+ * of its bbox. neighbours that move take half of the avoidance, standing ones leave all of it to this entity
  *
- * @param ent source entity to check against collisions
- * @param entities list of entities to iterate over
+ * @param index index of the moving entity
+ * @param entities entity store the neighbour grid was built from
+ * @param preferred step the entity would take without anyone in the way
  */
-void entity_collision_check(game_entity_t *ent, game_entity_t entities[])
+Vector2 entity_avoid(uint32_t index, game_entity_store_t *entities, Vector2 preferred, bool *out_is_stopped, game_scene_stats_t *stats)
 {
+  BoundingBox source_bbox = read_bbox[index];
+  float radius = fmaxf(source_bbox.max.x - source_bbox.min.x, source_bbox.max.z - source_bbox.min.z) / 2.0f;
+  float max_speed = entities->move_speed[index];
+  Vector2 position = (Vector2){read_position[index].x, read_position[index].z};
+  Vector2 velocity = read_velocity[index];
 
-  Rectangle source_rec = (Rectangle){.x = ent->bbox.min.x,
-                                     .y = ent->bbox.min.z,
-                                     .width = ent->bbox.max.x - ent->bbox.min.x,
-                                     .height = ent->bbox.max.z - ent->bbox.min.z};
+  // anyone further than both can close in over the horizon can not collide with it in time
+  float reach = radius + collision_grid.cell_size / 2.0f + (max_speed + collision_max_speed) * SCENE_AVOID_HORIZON;
+  uint32_t neighbors[AVOID_MAX_NEIGHBORS + 1];
+  float neighbor_dist_sq[AVOID_MAX_NEIGHBORS + 1];
+  int neighbor_count = spatial_grid_query_nearest(&collision_grid, position, reach, AVOID_MAX_NEIGHBORS + 1, neighbors, neighbor_dist_sq);
+  stats->avoid_queries++;
 
-  for (int i = 0; i < arrlen(entities); i++)
+  game_avoid_line_t lines[AVOID_MAX_NEIGHBORS];
+  int line_count = 0;
+  bool is_pressed = false;
+  float target_dist_sq = Vector2DistanceSqr(position, entities->target_pos[index]);
+  for (int n = 0; n < neighbor_count && line_count < AVOID_MAX_NEIGHBORS; n++)
   {
-    game_entity_t *target_ent = &entities[i];
-    if (ent->id == target_ent->id)
+    uint32_t i = neighbors[n];
+    if (i == index)
       continue;
-    Rectangle target_rec = (Rectangle){.x = target_ent->bbox.min.x,
-                                       .y = target_ent->bbox.min.z,
-                                       .width = target_ent->bbox.max.x - target_ent->bbox.min.x,
-                                       .height = target_ent->bbox.max.z - target_ent->bbox.min.z};
-    bool collision = CheckCollisionRecs(source_rec, target_rec);
-    if (collision)
+    BoundingBox target_bbox = read_bbox[i];
+    float combined_radius = radius + fmaxf(target_bbox.max.x - target_bbox.min.x, target_bbox.max.z - target_bbox.min.z) / 2.0f;
+    Vector2 other_position = (Vector2){read_position[i].x, read_position[i].z};
+    Vector2 relative_position = Vector2Subtract(other_position, position);
+    bool is_moving = read_state[i] & GAME_ENT_STATE_MOVING;
+    // units sitting exactly on top of each other split along x by index, so both sides agree on who goes where
+    Vector2 apart = (Vector2){i < index ? 1.0f : -1.0f, 0.0f};
+    lines[line_count++] = avoid_line(relative_position, velocity, read_velocity[i], combined_radius, SCENE_AVOID_HORIZON,
+                                     is_moving ? 0.5f : 1.0f, apart);
+    stats->avoid_neighbors++;
+    float contact = combined_radius + max_speed;
+    if (neighbor_dist_sq[n] < combined_radius * combined_radius)
     {
-      Rectangle collision_rec = GetCollisionRec(source_rec, target_rec);
-      // if width smaller than height, move entity on X axis (pick shortest intersection)
-      if (collision_rec.width < collision_rec.height)
-      {
-        float direction = ent->position.x < collision_rec.x ? -1 : 1;
-        ent->position.x += (collision_rec.width) * direction;
-      }
-      else
-      {
-        float direction = ent->position.z < collision_rec.y ? -1 : 1;
-        ent->position.z += (collision_rec.height) * direction;
-      }
+      stats->avoid_overlaps++;
+    }
+    if (!is_moving && neighbor_dist_sq[n] <= contact * contact &&
+        Vector2DistanceSqr(other_position, entities->target_pos[index]) < target_dist_sq)
+    {
+      is_pressed = true;
     }
   }
-}
\ No newline at end of file
+
+  Vector2 result;
+  if (!avoid_solve(lines, line_count, max_speed, preferred, &result))
+  {
+    stats->avoid_crowded++;
+  }
+  *out_is_stopped = is_pressed && Vector2LengthSqr(result) < (max_speed * SCENE_AVOID_STOP_SPEED) * (max_speed * SCENE_AVOID_STOP_SPEED);
+  return result;
+}
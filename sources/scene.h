@@ -3,11 +3,14 @@
 #include <stdint.h>
 #include "raylib.h"
 
+#include "assets.h"
+
 #define GAME_MAX_UNITS 100
 #define GAME_MAX_SELECTED 12
 
 #define GAME_TEAM_PLAYER 1
 #define GAME_TEAM_AI 2
+#define GAME_TEAM_COUNT 3 // team ids double as indices, 0 is unused
 
 typedef enum game_entity_type
 {
@@ -25,36 +28,79 @@ typedef enum game_entity_state
   GAME_ENT_STATE_ACTION = (1<<4),
 } game_entity_state;
 
-// stores model information, and all animations with count, coult later refactor into structure of arrays
-typedef struct
+// generational handle, low 16 bits are the slot, high 16 bits the generation the slot had when the handle was issued.
+// handles stay valid while entities move around the dense arrays and go stale once the entity is removed
+typedef uint32_t game_entity_handle_t;
+
+#define GAME_ENTITY_HANDLE_NONE UINT32_MAX
+#define GAME_ENTITY_MAX_SLOTS 0xFFFF // slots 0 to 0xFFFE, so no handle can alias another slot or GAME_ENTITY_HANDLE_NONE
+#define GAME_ENTITY_HANDLE_SLOT(handle) ((uint16_t)((handle) & 0xFFFF))
+#define GAME_ENTITY_HANDLE_GENERATION(handle) ((uint16_t)((handle) >> 16))
+#define GAME_ENTITY_HANDLE_MAKE(slot, generation) ((game_entity_handle_t)(slot) | ((game_entity_handle_t)(generation) << 16))
+
+// entity data is stored as a structure of arrays, one array per field, all indexed by the same entity index.
+// fields are grouped by how often the tick loops touch them so the hot loops stay cache dense
+// X(type, name) lists, used to declare the store and to grow/move every array in one place
+
+// hot: read and written by every tick. velocity is the XZ step taken last tick, what neighbours avoid. route holds the
+// cluster entrances of long orders, path the waypoints of the leg toward the next one
+#define GAME_ENTITY_HOT_FIELDS(X) \
+  X(Vector3, position)            \
+  X(Vector2, velocity)            \
+  X(Vector2, target_pos)          \
+  X(game_entity_handle_t, target)  \
+  X(uint8_t, state)               \
+  X(bool, is_dirty)               \
+  X(float, attack_cooldown)       \
+  X(uint32_t, anim_current_frame) \
+  X(uint8_t, anim_index)          \
+  X(uint32_t, path_next)          \
+  X(uint32_t, route_next)         \
+  X(Vector2 *, path)              \
+  X(Vector2 *, route)             \
+  X(uint32_t, path_ticket)        \
+  X(uint16_t, flow) // id of the flow field a group move order shares, 0 when the unit walks its own path
+
+// warm: collision, combat and ai lookups
+#define GAME_ENTITY_WARM_FIELDS(X) \
+  X(BoundingBox, bbox)             \
+  X(uint8_t, team)                 \
+  X(float, hit_points)             \
+  X(float, hit_points_max)         \
+  X(float, move_speed)             \
+  X(float, attack_radius)          \
+  X(float, attack_damage)          \
+  X(float, attack_cooldown_max)
+
+// cold: render and setup only
+#define GAME_ENTITY_COLD_FIELDS(X) \
+  X(game_entity_handle_t, handle)  \
+  X(game_entity_type, type)        \
+  X(game_asset_t *, asset)         \
+  X(Matrix, transform)             \
+  X(Vector3, rotation)             \
+  X(Vector3, scale)                \
+  X(Vector3, dimensions)           \
+  X(Vector3, dimensions_offset)    \
+  X(float, offset_y)
+
+#define GAME_ENTITY_FIELDS(X) \
+  GAME_ENTITY_HOT_FIELDS(X)   \
+  GAME_ENTITY_WARM_FIELDS(X)  \
+  GAME_ENTITY_COLD_FIELDS(X)
+
+typedef struct game_entity_store_t
 {
-  uint16_t id;
-  uint8_t team;
-  uint8_t anim_index;
-  bool is_dirty;
-  uint32_t anim_current_frame;
-  int32_t anims_count;
-  Model model;
-  ModelAnimation *anim;
-  float offset_y;
-  Vector3 scale;
-  Vector3 position;
-  Vector3 dimensions;
-  Vector3 dimensions_offset;
-  Vector3 rotation;
-  Vector2 target_pos;
-  uint16_t target_id;
-  float move_speed;
-  float attack_radius;
-  float attack_damage;
-  float attack_cooldown_max;
-  float attack_cooldown;
-  float hit_points;
-  float hit_points_max;
-  game_entity_type type;
-  BoundingBox bbox;
-  game_entity_state state;
-} game_entity_t;
+#define GAME_ENTITY_FIELD_DECLARE(type, name) type *name;
+  GAME_ENTITY_FIELDS(GAME_ENTITY_FIELD_DECLARE)
+#undef GAME_ENTITY_FIELD_DECLARE
+  uint32_t count;
+
+  // slot table, handles resolve through here to the current dense index
+  uint32_t *slot_dense;
+  uint16_t *slot_generation;
+  uint16_t *slot_free; // stack of released slots
+} game_entity_store_t;
 
 typedef struct
 {
@@ -75,44 +121,109 @@ typedef struct
   char *model_anims_path;
 } game_entity_create_t;
 
+// per tick counters, reset at the start of scene_update_entities
+typedef struct game_scene_stats_t
+{
+  uint32_t avoid_queries;        // neighbour lookups, one per moving entity
+  uint32_t avoid_neighbors;      // neighbours turned into velocity constraints
+  uint32_t avoid_overlaps;       // of those, neighbours the unit already overlapped
+  uint32_t avoid_crowded;        // solves that could not keep every neighbour clear, see avoid_solve
+  uint32_t path_queries;         // whole grid searches for legs the clusters could not answer, see path_find
+  uint32_t path_cache_hits;
+  uint32_t path_nodes_expanded;
+  uint32_t path_requests;        // path requests queued this tick, see path_request_submit
+  uint32_t path_requests_shared; // requests that joined one already waiting
+  uint32_t path_requests_queued; // left for later ticks after this one's service
+  uint32_t path_routes;          // requests answered on the cluster graph, see path_hpa_find
+  uint32_t path_route_nodes;     // cluster nodes those searches closed
+  uint32_t path_refined;         // route legs turned into waypoints this tick
+  uint32_t flow_fields;          // fields built for group orders, see path_flow_acquire
+  uint32_t flow_shared;          // group orders that reused a field already alive
+  uint32_t flow_cells;           // cells those fields settled
+} game_scene_stats_t;
+
+// damage from a finished attack, queued while entities update in parallel and applied afterwards in entity order
+typedef struct game_damage_event_t
+{
+  uint32_t source_index;
+  game_entity_handle_t target;
+  float damage;
+} game_damage_event_t;
+
 typedef struct game_camera_t game_camera_t;
 typedef struct game_terrain_map_t game_terrain_map_t;
+typedef struct game_spatial_grid_t game_spatial_grid_t;
+typedef struct game_path_grid_t game_path_grid_t;
+typedef struct game_path_hpa_t game_path_hpa_t;
 
+// GAME_ENTITY_HANDLE_NONE once every slot up to GAME_ENTITY_MAX_SLOTS is taken
+game_entity_handle_t entity_add(game_entity_store_t *entities, game_entity_create_t *entity_create);
 
-game_entity_t * entity_add(game_entity_t entities[], game_entity_create_t *entity_create);
+// swap-removes the entity from the dense arrays and invalidates every handle to it
+void entity_remove(game_entity_store_t *entities, game_entity_handle_t handle);
 
-void scene_process_input(game_camera_t *camera, game_entity_t entities[], game_terrain_map_t *terrain_map, short selected[GAME_MAX_SELECTED]);
+// returns the dense index for a handle, or -1 if the handle is stale
+int32_t entity_resolve(game_entity_store_t *entities, game_entity_handle_t handle);
 
-void scene_process_ai(game_entity_t entities[]);
+void scene_process_input(game_camera_t *camera, game_entity_store_t *entities, game_terrain_map_t *terrain_map, game_entity_handle_t selected[GAME_MAX_SELECTED]);
 
-void scene_update_entities(game_camera_t *camera, game_entity_t entities[], game_terrain_map_t *terrain_map, short selected[GAME_MAX_SELECTED], float dt);
+void scene_process_ai(game_entity_store_t *entities, game_terrain_map_t *terrain_map);
+
+void scene_update_entities(game_camera_t *camera, game_entity_store_t *entities, game_terrain_map_t *terrain_map, game_entity_handle_t selected[GAME_MAX_SELECTED], float dt);
 
 BoundingBox entity_bbox_derive(Vector3 *position, Vector3 *dimensions_offset, Vector3 *dimensions);
 
 void entity_bbox_update(Vector3 position, BoundingBox *bbox);
 
-void entity_set_moving(Vector2 position, short entity_id, game_entity_t *entities);
+// move orders walk the waypoints of a path to position when a path grid is set, otherwise head straight for it. the
+// path is requested and arrives at the start of a later update, far goals get a route through the cluster graph and only
+// the leg a unit is on is searched on the grid
+void entity_set_moving(Vector2 position, game_entity_handle_t handle, game_entity_store_t *entities);
+
+// entity_set_moving for every selected unit, a group shares one flow field instead of searching a path each
+void entity_set_moving_group(Vector2 position, game_entity_handle_t selected[GAME_MAX_SELECTED], game_entity_store_t *entities);
+
+void entity_set_attacking(game_entity_handle_t target, game_entity_store_t *entities, game_entity_handle_t selected[GAME_MAX_SELECTED]);
+
+// enemies is the spatial index of the team the unit is hostile to, only units within ENT_AI_VISIBILITY_RADIUS are considered
+void entity_attack_closest_ai(uint32_t index, game_entity_store_t *entities, const game_spatial_grid_t *enemies);
+
+void entity_flee_closest_ai(uint32_t index, game_entity_store_t *entities, const game_spatial_grid_t *enemies);
+
+// target_pos is the target's position from the start of the tick
+bool entity_check_attack(uint32_t index, Vector3 target_pos, game_entity_store_t *entities);
 
-void entity_set_attacking(uint16_t target_id, game_entity_t *entities, short selected[GAME_MAX_SELECTED]);
+// applies a queued attack to its target, only called from the serial phase after the parallel update
+void entity_resolve_attack(const game_damage_event_t *event, game_entity_store_t *entities);
 
-void entity_attack_closest_ai(game_entity_t *entity, game_entity_t entities[]);
+void scene_add_selected(game_entity_handle_t handle, game_entity_handle_t selected[GAME_MAX_SELECTED], bool is_group_selection);
 
-void entity_flee_closest_ai(game_entity_t *entity, game_entity_t entities[]);
+void scene_remove_selected_all(game_entity_handle_t selected[GAME_MAX_SELECTED]);
 
-bool entity_check_attack(game_entity_t *ent, game_entity_t entities[]);
+void scene_remove_selected(game_entity_handle_t handle, game_entity_handle_t selected[GAME_MAX_SELECTED]);
 
-void entity_resolve_attack(game_entity_t *ent, game_entity_t entities[]);
+// closest entity whose bbox the ray hits, GAME_ENTITY_HANDLE_NONE if there is none
+game_entity_handle_t scene_get_id(Ray ray, game_entity_store_t *entities);
 
-void scene_add_selected(short selected_id, short selected[GAME_MAX_SELECTED], bool is_group_selection);
+// scene_get_id for several rays at once, out_handles needs room for ray_count handles
+void scene_get_ids(const Ray *rays, uint32_t ray_count, game_entity_store_t *entities, game_entity_handle_t *out_handles);
 
-void scene_remove_selected_all(short selected[GAME_MAX_SELECTED]);
+// ground_y is the terrain height under the entity's new position, see terrain_get_adjusted_y_batch
+void entity_dirty_update(Vector3 old_pos, uint32_t index, game_entity_store_t *entities, float ground_y);
 
-void scene_remove_selected(short selected_id, short selected[GAME_MAX_SELECTED]);
+// the velocity closest to preferred that steers clear of the entity's closest neighbours, read from the start of tick
+// positions and velocities. out_is_stopped is set when it barely moves while pressed against a unit standing closer to
+// its target, stats are the chunk's counters
+Vector2 entity_avoid(uint32_t index, game_entity_store_t *entities, Vector2 preferred, bool *out_is_stopped, game_scene_stats_t *stats);
 
-short scene_get_id(Ray ray, game_entity_t entities[]);
+void entity_unload_all(game_entity_store_t *entities);
 
-void entity_dirty_update(Vector3 old_pos, game_entity_t *ent, game_terrain_map_t *terrain_map);
+const game_scene_stats_t *scene_get_stats(void);
 
-void entity_collision_check(game_entity_t *ent, game_entity_t entities[]);
+// grid the move orders are pathed over, NULL sends units straight at their target. hpa is the grid's cluster graph for
+// far goals, NULL searches them on the grid too. both have to outlive the scene or be replaced first, cached paths are
+// dropped whenever they change
+void scene_set_path_grid(const game_path_grid_t *grid, const game_path_hpa_t *hpa);
 
-void entity_unload_all(game_entity_t entities[]);
\ No newline at end of file
+// applies the entity's animation frame and transform to its shared model for drawing
+Model entity_get_posed_model(uint32_t index, game_entity_store_t *entities);
@@ -0,0 +1,192 @@
+#include "spatial.h"
+
+#include <math.h>
+#include <string.h>
+#include "stb_ds.h"
+
+#include "util.h"
+
+void spatial_grid_init(game_spatial_grid_t *grid, Vector2 min, Vector2 max, float cell_size)
+{
+  int cells_x = (int)ceilf((max.x - min.x) / cell_size);
+  int cells_z = (int)ceilf((max.y - min.y) / cell_size);
+  cells_x = cells_x < 1 ? 1 : cells_x;
+  cells_z = cells_z < 1 ? 1 : cells_z;
+
+  grid->origin = min;
+  grid->cell_size = cell_size;
+  grid->inv_cell_size = 1.0f / cell_size;
+  if (grid->cells_x != cells_x || grid->cells_z != cells_z || grid->cell_start == NULL)
+  {
+    grid->cells_x = cells_x;
+    grid->cells_z = cells_z;
+    arrsetlen(grid->cell_start, cells_x * cells_z + 1);
+  }
+}
+
+void spatial_grid_free(game_spatial_grid_t *grid)
+{
+  arrfree(grid->cell_start);
+  arrfree(grid->items);
+  arrfree(grid->item_pos);
+  arrfree(grid->item_cell);
+  memset(grid, 0, sizeof *grid);
+}
+
+void spatial_grid_get_cell(const game_spatial_grid_t *grid, Vector2 position, int *cell_x, int *cell_z)
+{
+  *cell_x = clamp_int((int)floorf((position.x - grid->origin.x) * grid->inv_cell_size), 0, grid->cells_x - 1);
+  *cell_z = clamp_int((int)floorf((position.y - grid->origin.y) * grid->inv_cell_size), 0, grid->cells_z - 1);
+}
+
+void spatial_grid_build(game_spatial_grid_t *grid, const Vector3 *positions, const uint32_t *indices, uint32_t count)
+{
+  int cell_count = grid->cells_x * grid->cells_z;
+  grid->count = count;
+  arrsetlen(grid->items, count);
+  arrsetlen(grid->item_pos, count);
+  arrsetlen(grid->item_cell, count);
+  memset(grid->cell_start, 0, sizeof(*grid->cell_start) * (cell_count + 1));
+
+  // counting sort: histogram, exclusive prefix sum, then scatter
+  for (uint32_t i = 0; i < count; i++)
+  {
+    Vector3 position = positions[indices[i]];
+    int cell_x, cell_z;
+    spatial_grid_get_cell(grid, (Vector2){position.x, position.z}, &cell_x, &cell_z);
+    grid->item_cell[i] = cell_z * grid->cells_x + cell_x;
+    grid->cell_start[grid->item_cell[i] + 1]++;
+  }
+  for (int c = 0; c < cell_count; c++)
+  {
+    grid->cell_start[c + 1] += grid->cell_start[c];
+  }
+  for (uint32_t i = 0; i < count; i++)
+  {
+    // cell_start[c] is used as the write cursor and ends up as the start of cell c + 1, shifted back below
+    uint32_t slot = grid->cell_start[grid->item_cell[i]]++;
+    Vector3 position = positions[indices[i]];
+    grid->items[slot] = indices[i];
+    grid->item_pos[slot] = (Vector2){position.x, position.z};
+  }
+  for (int c = cell_count; c > 0; c--)
+  {
+    grid->cell_start[c] = grid->cell_start[c - 1];
+  }
+  grid->cell_start[0] = 0;
+}
+
+void spatial_grid_query_rect(const game_spatial_grid_t *grid, Rectangle area, uint32_t **out)
+{
+  int min_x, min_z, max_x, max_z;
+  spatial_grid_get_cell(grid, (Vector2){area.x, area.y}, &min_x, &min_z);
+  spatial_grid_get_cell(grid, (Vector2){area.x + area.width, area.y + area.height}, &max_x, &max_z);
+  for (int z = min_z; z <= max_z; z++)
+  {
+    for (int x = min_x; x <= max_x; x++)
+    {
+      int cell = z * grid->cells_x + x;
+      for (uint32_t i = grid->cell_start[cell]; i < grid->cell_start[cell + 1]; i++)
+      {
+        arrput(*out, grid->items[i]);
+      }
+    }
+  }
+}
+
+void spatial_grid_query_radius(const game_spatial_grid_t *grid, Vector2 center, float radius, uint32_t **out)
+{
+  float radius_sq = radius * radius;
+  int min_x, min_z, max_x, max_z;
+  spatial_grid_get_cell(grid, (Vector2){center.x - radius, center.y - radius}, &min_x, &min_z);
+  spatial_grid_get_cell(grid, (Vector2){center.x + radius, center.y + radius}, &max_x, &max_z);
+  for (int z = min_z; z <= max_z; z++)
+  {
+    for (int x = min_x; x <= max_x; x++)
+    {
+      int cell = z * grid->cells_x + x;
+      for (uint32_t i = grid->cell_start[cell]; i < grid->cell_start[cell + 1]; i++)
+      {
+        float dx = grid->item_pos[i].x - center.x;
+        float dz = grid->item_pos[i].y - center.y;
+        if (dx * dx + dz * dz <= radius_sq)
+        {
+          arrput(*out, grid->items[i]);
+        }
+      }
+    }
+  }
+}
+
+// tests every item of a cell against the current k best, kept sorted by insertion since k is small
+static int spatial_grid_nearest_cell(const game_spatial_grid_t *grid, int cell, Vector2 center, float radius_sq, int k, int found, uint32_t *out_items, float *out_dist_sq)
+{
+  for (uint32_t i = grid->cell_start[cell]; i < grid->cell_start[cell + 1]; i++)
+  {
+    float dx = grid->item_pos[i].x - center.x;
+    float dz = grid->item_pos[i].y - center.y;
+    float dist_sq = dx * dx + dz * dz;
+    if (dist_sq > radius_sq || (found == k && dist_sq >= out_dist_sq[k - 1]))
+    {
+      continue;
+    }
+    int slot = found < k ? found++ : k - 1;
+    while (slot > 0 && out_dist_sq[slot - 1] > dist_sq)
+    {
+      out_items[slot] = out_items[slot - 1];
+      out_dist_sq[slot] = out_dist_sq[slot - 1];
+      slot--;
+    }
+    out_items[slot] = grid->items[i];
+    out_dist_sq[slot] = dist_sq;
+  }
+  return found;
+}
+
+int spatial_grid_query_nearest(const game_spatial_grid_t *grid, Vector2 center, float radius, int k, uint32_t *out_items, float *out_dist_sq)
+{
+  if (k <= 0 || grid->count == 0)
+  {
+    return 0;
+  }
+  float radius_sq = radius * radius;
+  int center_x, center_z;
+  spatial_grid_get_cell(grid, center, &center_x, &center_z);
+  // ring bounds are only valid when the center is inside its cell, clamped centers search every ring within radius
+  bool is_inside = center.x >= grid->origin.x && center.y >= grid->origin.y &&
+                   center.x < grid->origin.x + grid->cells_x * grid->cell_size &&
+                   center.y < grid->origin.y + grid->cells_z * grid->cell_size;
+  int max_ring = (int)ceilf(radius * grid->inv_cell_size) + 1;
+  int grid_rings = grid->cells_x > grid->cells_z ? grid->cells_x : grid->cells_z;
+  max_ring = max_ring < grid_rings ? max_ring : grid_rings;
+
+  int found = 0;
+  for (int ring = 0; ring <= max_ring; ring++)
+  {
+    if (is_inside && found == k && ring > 0)
+    {
+      // nothing in this ring can be closer than the gap between the center's cell and the ring
+      float ring_dist = (ring - 1) * grid->cell_size;
+      if (ring_dist * ring_dist > out_dist_sq[k - 1])
+      {
+        break;
+      }
+    }
+    int min_z = center_z - ring, max_z = center_z + ring;
+    int min_x = center_x - ring, max_x = center_x + ring;
+    for (int z = (min_z < 0 ? 0 : min_z); z <= max_z && z < grid->cells_z; z++)
+    {
+      bool is_edge_row = (z == min_z || z == max_z);
+      int step = is_edge_row || ring == 0 ? 1 : max_x - min_x;
+      for (int x = min_x; x <= max_x; x += step)
+      {
+        if (x < 0 || x >= grid->cells_x)
+        {
+          continue;
+        }
+        found = spatial_grid_nearest_cell(grid, z * grid->cells_x + x, center, radius_sq, k, found, out_items, out_dist_sq);
+      }
+    }
+  }
+  return found;
+}
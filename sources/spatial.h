@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "raylib.h"
+
+// uniform grid over the XZ plane, rebuilt from scratch with a counting sort whenever positions change.
+// items are entity indices bucketed by the cell their position falls in, anything outside the grid is clamped to the border cells
+typedef struct game_spatial_grid_t
+{
+  Vector2 origin; // world XZ of the corner of cell (0, 0)
+  float cell_size;
+  float inv_cell_size;
+  int cells_x;
+  int cells_z;
+  uint32_t *cell_start; // cells_x * cells_z + 1 offsets into items, cell c owns items[cell_start[c] .. cell_start[c + 1])
+  uint32_t *items;      // entity indices sorted by cell
+  Vector2 *item_pos;    // XZ positions in the same order as items, so queries never touch entity arrays
+  uint32_t *item_cell;  // scratch, cell of every inserted item in insertion order
+  uint32_t count;
+} game_spatial_grid_t;
+
+// sizes the grid to cover [min, max], only reallocates the cell table if the layout changed
+void spatial_grid_init(game_spatial_grid_t *grid, Vector2 min, Vector2 max, float cell_size);
+
+void spatial_grid_free(game_spatial_grid_t *grid);
+
+// buckets positions[indices[i]] for every i < count
+void spatial_grid_build(game_spatial_grid_t *grid, const Vector3 *positions, const uint32_t *indices, uint32_t count);
+
+// clamped cell coordinates for a world XZ position
+void spatial_grid_get_cell(const game_spatial_grid_t *grid, Vector2 position, int *cell_x, int *cell_z);
+
+// appends every item stored in a cell overlapping area (x/y of the rectangle are world X/Z) to an stb_ds array,
+// candidates still need an exact test from the caller
+void spatial_grid_query_rect(const game_spatial_grid_t *grid, Rectangle area, uint32_t **out);
+
+// appends every item whose position lies within radius of center to an stb_ds array, compares squared distances only
+void spatial_grid_query_radius(const game_spatial_grid_t *grid, Vector2 center, float radius, uint32_t **out);
+
+// finds up to k items closest to center within radius, searching outwards ring by ring and stopping once no closer item is possible.
+// results are sorted nearest first with their squared distances, returns how many were found
+int spatial_grid_query_nearest(const game_spatial_grid_t *grid, Vector2 center, float radius, int k, uint32_t *out_items, float *out_dist_sq);
@@ -1,211 +1,940 @@
+#include <float.h>
+#include <math.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include "terrain.h"
+#include "terrain_stream.h"
 #include "raymath.h"
+#include "rlgl.h"
 #include "stb_ds.h"
-// Modified version of RayLib heighmap generation
-Mesh terrain_init(Image height_image, game_terrain_map_t *terrain_map)
-{
+
+#include "jobs.h"
+#include "models.h"
+
 #define GRAY_VALUE(c) ((float)(c.r + c.g + c.b) / 3.0f)
+#define TERRAIN_HEIGHT_SCALE (TERRAIN_HEIGHT_RANGE / 255.0f)
+#define TERRAIN_MESH_ROWS_PER_JOB 16
 
-  Mesh mesh = {0};
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TERRAIN_SIMD_SSE2 1
+#else
+#define TERRAIN_SIMD_SSE2 0
+#endif
 
+bool terrain_map_init(game_terrain_map_t *terrain_map, int width, int height, game_terrain_storage storage, float height_min, float height_max)
+{
+  *terrain_map = (game_terrain_map_t){.max_width = width, .max_height = height, .storage = storage, .height_min = height_min};
+  terrain_map->tiles_x = (width + TERRAIN_TILE_SIZE - 1) >> TERRAIN_TILE_SHIFT;
+  int tiles_z = (height + TERRAIN_TILE_SIZE - 1) >> TERRAIN_TILE_SHIFT;
+  size_t sample_count = (size_t)terrain_map->tiles_x * tiles_z * TERRAIN_TILE_SIZE * TERRAIN_TILE_SIZE;
+  if (storage == GAME_TERRAIN_STORAGE_UINT16)
+  {
+    terrain_map->height_step = height_max > height_min ? (height_max - height_min) / (float)UINT16_MAX : 1.0f;
+    terrain_map->value16 = RL_CALLOC(sample_count, sizeof(*terrain_map->value16));
+  }
+  else
+  {
+    terrain_map->value = RL_MALLOC(sample_count * sizeof(*terrain_map->value));
+    for (size_t i = 0; terrain_map->value != NULL && i < sample_count; i++)
+    {
+      terrain_map->value[i] = height_min;
+    }
+  }
+  if (terrain_map->value == NULL && terrain_map->value16 == NULL)
+  {
+    TraceLog(LOG_ERROR, "TERRAIN: Failed to allocate %dx%d height samples", width, height);
+    return false;
+  }
+  return true;
+}
+
+bool terrain_load_heights(Image height_image, game_terrain_map_t *terrain_map, game_terrain_storage storage)
+{
   int mapX = height_image.width;
   int mapZ = height_image.height;
+  const float y_scale = TERRAIN_HEIGHT_SCALE;
+  if (!terrain_map_init(terrain_map, mapX, mapZ, storage, 0.0f, 255.0f * y_scale))
+  {
+    return false;
+  }
+  // the usual 8 bit layouts are averaged in place, anything else goes through a Color conversion first
+  int channels = height_image.format == PIXELFORMAT_UNCOMPRESSED_GRAYSCALE ? 1
+                 : height_image.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8  ? 3
+                 : height_image.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 ? 4
+                                                                            : 0;
+  const unsigned char *bytes = height_image.data;
+  Color *pixels = channels == 0 ? LoadImageColors(height_image) : NULL;
+  for (int z = 0; z < mapZ; z++)
+  {
+    for (int x = 0; x < mapX; x++)
+    {
+      size_t i = (size_t)z * mapX + x;
+      float gray = channels == 0   ? GRAY_VALUE(pixels[i])
+                   : channels == 1 ? (float)bytes[i]
+                                   : (float)(bytes[i * channels] + bytes[i * channels + 1] + bytes[i * channels + 2]) / 3.0f;
+      terrain_set_height(terrain_map, x, z, gray * y_scale);
+    }
+  }
+  UnloadImageColors(pixels);
+  terrain_build_pyramid(terrain_map);
+  return true;
+}
+
+static void terrain_free_pyramid(game_terrain_map_t *terrain_map)
+{
+  for (int level = 0; level < terrain_map->pyramid_levels; level++)
+  {
+    RL_FREE(terrain_map->pyramid[level]);
+    terrain_map->pyramid[level] = NULL;
+  }
+  terrain_map->pyramid_levels = 0;
+}
+
+// range of the four samples around quad (x, z)
+static game_terrain_height_range_t terrain_quad_range(const game_terrain_map_t *terrain_map, int x, int z)
+{
+  float h00 = terrain_get_height(terrain_map, x, z), h10 = terrain_get_height(terrain_map, x + 1, z);
+  float h01 = terrain_get_height(terrain_map, x, z + 1), h11 = terrain_get_height(terrain_map, x + 1, z + 1);
+  return (game_terrain_height_range_t){fminf(fminf(h00, h10), fminf(h01, h11)), fmaxf(fmaxf(h00, h10), fmaxf(h01, h11))};
+}
+
+// union of the up to four cells below cell (x, z) of level
+static game_terrain_height_range_t terrain_merge_range(const game_terrain_map_t *terrain_map, int level, int x, int z)
+{
+  const game_terrain_height_range_t *below = terrain_map->pyramid[level - 1];
+  int below_width = terrain_map->pyramid_width[level - 1], below_height = terrain_map->pyramid_height[level - 1];
+  game_terrain_height_range_t range = below[(z * 2) * below_width + x * 2];
+  for (int child = 1; child < 4; child++)
+  {
+    int child_x = x * 2 + (child & 1), child_z = z * 2 + (child >> 1);
+    if (child_x < below_width && child_z < below_height)
+    {
+      range.min = fminf(range.min, below[child_z * below_width + child_x].min);
+      range.max = fmaxf(range.max, below[child_z * below_width + child_x].max);
+    }
+  }
+  return range;
+}
+
+void terrain_build_pyramid(game_terrain_map_t *terrain_map)
+{
+  terrain_free_pyramid(terrain_map);
+  int width = terrain_map->max_width - 1;
+  int height = terrain_map->max_height - 1;
+  if (width < 1 || height < 1)
+  {
+    return;
+  }
+
+  game_terrain_height_range_t *cells;
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_STREAMED)
+  {
+    // evicted tiles answer from the overview, only the ranges written with the tiles bound what they will hold
+    const game_terrain_stream_t *stream = terrain_map->stream;
+    terrain_map->pyramid_shift = TERRAIN_STREAM_OVERVIEW_SHIFT;
+    width = stream->header.overview_width - 1;
+    height = stream->header.overview_height - 1;
+    cells = RL_MALLOC(width * height * sizeof(*cells));
+    memcpy(cells, stream->file.data + stream->header.ranges_offset, width * height * sizeof(*cells));
+  }
+  else
+  {
+    terrain_map->pyramid_shift = 0;
+    cells = RL_MALLOC(width * height * sizeof(*cells));
+    for (int z = 0; z < height; z++)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        cells[z * width + x] = terrain_quad_range(terrain_map, x, z);
+      }
+    }
+  }
+  terrain_map->pyramid[0] = cells;
+  terrain_map->pyramid_width[0] = width;
+  terrain_map->pyramid_height[0] = height;
+  terrain_map->pyramid_levels = 1;
+
+  while ((width > 1 || height > 1) && terrain_map->pyramid_levels < TERRAIN_PYRAMID_MAX_LEVELS)
+  {
+    int level = terrain_map->pyramid_levels;
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+    cells = RL_MALLOC(width * height * sizeof(*cells));
+    terrain_map->pyramid[level] = cells;
+    terrain_map->pyramid_width[level] = width;
+    terrain_map->pyramid_height[level] = height;
+    for (int z = 0; z < height; z++)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        cells[z * width + x] = terrain_merge_range(terrain_map, level, x, z);
+      }
+    }
+    terrain_map->pyramid_levels++;
+  }
+}
+
+void terrain_update_pyramid(game_terrain_map_t *terrain_map, game_terrain_rect_t rect)
+{
+  if (terrain_map->pyramid_levels == 0 || terrain_map->pyramid_shift != 0)
+  {
+    return;
+  }
+  // every quad with a corner inside the rect, then their ancestors
+  int x0 = rect.x0 > 0 ? rect.x0 - 1 : 0, z0 = rect.z0 > 0 ? rect.z0 - 1 : 0;
+  int x1 = rect.x1 < terrain_map->pyramid_width[0] - 1 ? rect.x1 : terrain_map->pyramid_width[0] - 1;
+  int z1 = rect.z1 < terrain_map->pyramid_height[0] - 1 ? rect.z1 : terrain_map->pyramid_height[0] - 1;
+  for (int z = z0; z <= z1; z++)
+  {
+    for (int x = x0; x <= x1; x++)
+    {
+      terrain_map->pyramid[0][z * terrain_map->pyramid_width[0] + x] = terrain_quad_range(terrain_map, x, z);
+    }
+  }
+  for (int level = 1; level < terrain_map->pyramid_levels; level++)
+  {
+    x0 >>= 1;
+    z0 >>= 1;
+    x1 >>= 1;
+    z1 >>= 1;
+    for (int z = z0; z <= z1; z++)
+    {
+      for (int x = x0; x <= x1; x++)
+      {
+        terrain_map->pyramid[level][z * terrain_map->pyramid_width[level] + x] = terrain_merge_range(terrain_map, level, x, z);
+      }
+    }
+  }
+}
+
+void terrain_map_unload(game_terrain_map_t *terrain_map)
+{
+  terrain_free_pyramid(terrain_map);
+  RL_FREE(terrain_map->value);
+  RL_FREE(terrain_map->value16);
+  terrain_stream_close(terrain_map->stream);
+  arrfree(terrain_map->dirty_rects);
+  terrain_map->value = NULL;
+  terrain_map->value16 = NULL;
+  terrain_map->stream = NULL;
+}
+
+enum
+{
+  TERRAIN_STITCH_X_NEG = 1 << 0,
+  TERRAIN_STITCH_X_POS = 1 << 1,
+  TERRAIN_STITCH_Z_NEG = 1 << 2,
+  TERRAIN_STITCH_Z_POS = 1 << 3,
+};
+
+// vertex (x, z) of a patch drawn every step samples. odd vertices on an edge that faces a coarser neighbour snap back
+// onto the previous even one, the triangles that collapse are skipped and the rest fan out to match the neighbour
+static uint32_t terrain_pattern_index(int x, int z, int step, int mask, int stride)
+{
+  if (((mask & TERRAIN_STITCH_Z_NEG) && z == 0) || ((mask & TERRAIN_STITCH_Z_POS) && z == TERRAIN_PATCH_QUADS))
+  {
+    x &= ~1;
+  }
+  if (((mask & TERRAIN_STITCH_X_NEG) && x == 0) || ((mask & TERRAIN_STITCH_X_POS) && x == TERRAIN_PATCH_QUADS))
+  {
+    z &= ~1;
+  }
+  return (uint32_t)(z * step * stride + x * step);
+}
+
+static void terrain_put_triangle(uint32_t **indices, uint32_t a, uint32_t b, uint32_t c)
+{
+  if (a == b || b == c || a == c)
+  {
+    return;
+  }
+  arrput(*indices, a);
+  arrput(*indices, b);
+  arrput(*indices, c);
+}
 
-  const float y_scale = 32.0f / 256.0f;
+static game_terrain_node_t *terrain_get_node(game_terrain_mesh_t *terrain_mesh, int level, int x, int z)
+{
+  return &terrain_mesh->nodes[terrain_mesh->level_first[level] + z * terrain_mesh->level_width[level] + x];
+}
 
-  Color *pixels = LoadImageColors(height_image);
+// shared by the jobs of terrain_build_mesh
+typedef struct game_terrain_build_t
+{
+  game_terrain_mesh_t *terrain_mesh;
+  game_terrain_map_t *terrain_map;
+  int cell_row_first[TERRAIN_LOD_LEVELS]; // job index of the first row of cells of every level above the leaves
+  float *cell_row_errors;                 // per row of cells, the error under every node along it
+} game_terrain_build_t;
 
-  // NOTE: One vertex per pixel
-  mesh.triangleCount =
-      (mapX - 1) * (mapZ - 1) * 2; // One quad every four pixels
+// height of vertex (x, z), the vertices past the map edge repeat the last sample
+static float terrain_vertex_y(const game_terrain_map_t *terrain_map, int x, int z)
+{
+  return terrain_get_height(terrain_map, x < terrain_map->max_width ? x : terrain_map->max_width - 1,
+                            z < terrain_map->max_height ? z : terrain_map->max_height - 1);
+}
 
-  mesh.vertexCount = mesh.triangleCount * 3;
+// normal of the vertex at h[1][i] from the rows above, at and below it: the unnormalized face normals of the up to six
+// triangles around it added up, which weighs them by area. quad (qx, qz) has the triangles (v00, v01, v10) with normal
+// (h00 - h10, 1, h00 - h01) and (v10, v01, v11) with normal (h01 - h11, 1, h10 - h11)
+static Vector3 terrain_vertex_normal(float *const h[3], int i, bool has_left, bool has_right, bool has_up, bool has_down)
+{
+  Vector3 normal = {0.0f, 0.0f, 0.0f};
+  if (has_left && has_up) // the vertex is v11 of the quad behind on both axes
+  {
+    normal = Vector3Add(normal, (Vector3){h[1][i - 1] - h[1][i], 1.0f, h[0][i] - h[1][i]});
+  }
+  if (has_right && has_up) // v01 of the quad behind on z
+  {
+    normal = Vector3Add(normal, (Vector3){h[0][i] - h[0][i + 1], 1.0f, h[0][i] - h[1][i]});
+    normal = Vector3Add(normal, (Vector3){h[1][i] - h[1][i + 1], 1.0f, h[0][i + 1] - h[1][i + 1]});
+  }
+  if (has_left && has_down) // v10 of the quad behind on x
+  {
+    normal = Vector3Add(normal, (Vector3){h[1][i - 1] - h[1][i], 1.0f, h[1][i - 1] - h[2][i - 1]});
+    normal = Vector3Add(normal, (Vector3){h[2][i - 1] - h[2][i], 1.0f, h[1][i] - h[2][i]});
+  }
+  if (has_right && has_down) // v00 of its own quad
+  {
+    normal = Vector3Add(normal, (Vector3){h[1][i] - h[1][i + 1], 1.0f, h[1][i] - h[2][i]});
+  }
+  return Vector3Normalize(normal);
+}
 
-  mesh.vertices = RL_MALLOC(mesh.vertexCount * 3 * sizeof(float));
-  mesh.normals = RL_MALLOC(mesh.vertexCount * 3 * sizeof(float));
-  mesh.texcoords = RL_MALLOC(mesh.vertexCount * 2 * sizeof(float));
-  mesh.colors = NULL;
+// positions and smooth normals of vertices x0 to x1 of row z. same split and winding as the patterns,
+// terrain_get_adjusted_y relies on the split
+static void terrain_build_vertex_row(const game_terrain_mesh_t *terrain_mesh, const game_terrain_map_t *terrain_map, int z, int x0,
+                                     int x1, float *positions, float *normals)
+{
+  int last_x = terrain_mesh->vertices_x - 1, last_z = terrain_mesh->vertices_z - 1;
+  // rows z - 1, z and z + 1 from x0 - 1 to x1 + 1, read once. samples off the grid repeat the edge and are never used
+  int count = x1 - x0 + 3;
+  float *rows = RL_MALLOC(3 * count * sizeof(float));
+  float *h[3] = {rows, rows + count, rows + 2 * count};
+  for (int dz = 0; dz < 3; dz++)
+  {
+    int sample_z = z + dz - 1;
+    sample_z = sample_z < 0 ? 0 : (sample_z > last_z ? last_z : sample_z);
+    for (int i = 0; i < count; i++)
+    {
+      int sample_x = x0 + i - 1;
+      sample_x = sample_x < 0 ? 0 : (sample_x > last_x ? last_x : sample_x);
+      h[dz][i] = terrain_vertex_y(terrain_map, sample_x, sample_z);
+    }
+  }
 
-  int vCounter = 0;  // Used to count vertices float by float
-  int tcCounter = 0; // Used to count texcoords float by float
-  int nCounter = 0;  // Used to count normals float by float
+  for (int x = x0; x <= x1;)
+  {
+    int i = x - x0 + 1, v = x - x0;
+#if TERRAIN_SIMD_SSE2
+    // four vertices at once where all six triangles exist, adding the same terms in the same order as
+    // terrain_vertex_normal and Vector3Normalize so both paths give the same bits
+    if (x > 0 && x + 3 < last_x && x + 3 <= x1 && z > 0 && z < last_z)
+    {
+      __m128 up = _mm_loadu_ps(&h[0][i]), up_right = _mm_loadu_ps(&h[0][i + 1]);
+      __m128 left = _mm_loadu_ps(&h[1][i - 1]), center = _mm_loadu_ps(&h[1][i]), right = _mm_loadu_ps(&h[1][i + 1]);
+      __m128 down_left = _mm_loadu_ps(&h[2][i - 1]), down = _mm_loadu_ps(&h[2][i]);
+      __m128 normal_x = _mm_add_ps(_mm_setzero_ps(), _mm_sub_ps(left, center));
+      normal_x = _mm_add_ps(normal_x, _mm_sub_ps(up, up_right));
+      normal_x = _mm_add_ps(normal_x, _mm_sub_ps(center, right));
+      normal_x = _mm_add_ps(normal_x, _mm_sub_ps(left, center));
+      normal_x = _mm_add_ps(normal_x, _mm_sub_ps(down_left, down));
+      normal_x = _mm_add_ps(normal_x, _mm_sub_ps(center, right));
+      __m128 normal_z = _mm_add_ps(_mm_setzero_ps(), _mm_sub_ps(up, center));
+      normal_z = _mm_add_ps(normal_z, _mm_sub_ps(up, center));
+      normal_z = _mm_add_ps(normal_z, _mm_sub_ps(up_right, right));
+      normal_z = _mm_add_ps(normal_z, _mm_sub_ps(left, down_left));
+      normal_z = _mm_add_ps(normal_z, _mm_sub_ps(center, down));
+      normal_z = _mm_add_ps(normal_z, _mm_sub_ps(center, down));
+      __m128 normal_y = _mm_set1_ps(6.0f);
+      __m128 length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal_x, normal_x), _mm_mul_ps(normal_y, normal_y)),
+                                         _mm_mul_ps(normal_z, normal_z));
+      __m128 inv_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_squared));
+      float lanes[3][4], heights[4];
+      _mm_storeu_ps(lanes[0], _mm_mul_ps(normal_x, inv_length));
+      _mm_storeu_ps(lanes[1], _mm_mul_ps(normal_y, inv_length));
+      _mm_storeu_ps(lanes[2], _mm_mul_ps(normal_z, inv_length));
+      _mm_storeu_ps(heights, center);
+      for (int lane = 0; lane < 4; lane++)
+      {
+        positions[(v + lane) * 3] = (float)(x + lane);
+        positions[(v + lane) * 3 + 1] = heights[lane];
+        positions[(v + lane) * 3 + 2] = (float)z;
+        normals[(v + lane) * 3] = lanes[0][lane];
+        normals[(v + lane) * 3 + 1] = lanes[1][lane];
+        normals[(v + lane) * 3 + 2] = lanes[2][lane];
+      }
+      x += 4;
+      continue;
+    }
+#endif
+    Vector3 normal = terrain_vertex_normal(h, i, x > 0, x < last_x, z > 0, z < last_z);
+    positions[v * 3] = (float)x;
+    positions[v * 3 + 1] = h[1][i];
+    positions[v * 3 + 2] = (float)z;
+    normals[v * 3] = normal.x;
+    normals[v * 3 + 1] = normal.y;
+    normals[v * 3 + 2] = normal.z;
+    x++;
+  }
+  RL_FREE(rows);
+}
 
-  Vector3 vA = {0};
-  Vector3 vB = {0};
-  Vector3 vC = {0};
-  Vector3 vN = {0};
+static void terrain_build_vertex_rows(void *data, uint32_t job_index, uint32_t worker_index)
+{
+  (void)worker_index;
+  game_terrain_build_t *build = data;
+  game_terrain_mesh_t *terrain_mesh = build->terrain_mesh;
+  Mesh *mesh = &terrain_mesh->mesh;
+  int mapX = build->terrain_map->max_width;
+  int mapZ = build->terrain_map->max_height;
+  int z_first = (int)job_index * TERRAIN_MESH_ROWS_PER_JOB;
+  int z_end = z_first + TERRAIN_MESH_ROWS_PER_JOB < terrain_mesh->vertices_z ? z_first + TERRAIN_MESH_ROWS_PER_JOB : terrain_mesh->vertices_z;
+  for (int z = z_first; z < z_end; z++)
+  {
+    size_t row = (size_t)z * terrain_mesh->vertices_x;
+    terrain_build_vertex_row(terrain_mesh, build->terrain_map, z, 0, terrain_mesh->vertices_x - 1, &mesh->vertices[row * 3],
+                             &mesh->normals[row * 3]);
+    for (int x = 0; x < terrain_mesh->vertices_x; x++)
+    {
+      int sample_x = x < mapX ? x : mapX - 1;
+      int sample_z = z < mapZ ? z : mapZ - 1;
+      mesh->texcoords[(row + x) * 2] = (float)sample_x / (mapX - 1);
+      mesh->texcoords[(row + x) * 2 + 1] = (float)sample_z / (mapZ - 1);
+    }
+  }
+}
 
-  for (int z = 0; z < mapZ - 1; z++)
+// largest distance between the full resolution samples under cells x0 to x1 and z0 to z1 (inclusive) of a level and
+// the surface its step draws over them, using the same split as the triangles
+static float terrain_cells_error(const game_terrain_map_t *terrain_map, int level, int cell_x0, int cell_z0, int cell_x1, int cell_z1)
+{
+  int step = 1 << level;
+  float error = 0.0f;
+  for (int cz = cell_z0; cz <= cell_z1; cz++)
   {
-    for (int x = 0; x < mapX - 1; x++)
+    for (int cx = cell_x0; cx <= cell_x1; cx++)
     {
-      // Fill vertices array with data
-      //----------------------------------------------------------
-
-      // one triangle - 3 vertex
-      mesh.vertices[vCounter] = (float)x;
-      mesh.vertices[vCounter + 1] = GRAY_VALUE(pixels[x + z * mapX]) * y_scale;
-      mesh.vertices[vCounter + 2] = (float)z;
-
-      mesh.vertices[vCounter + 3] = (float)x;
-      mesh.vertices[vCounter + 4] =
-          GRAY_VALUE(pixels[x + (z + 1) * mapX]) * y_scale;
-      mesh.vertices[vCounter + 5] = (float)(z + 1);
-
-      mesh.vertices[vCounter + 6] = (float)(x + 1);
-      mesh.vertices[vCounter + 7] =
-          GRAY_VALUE(pixels[(x + 1) + z * mapX]) * y_scale;
-      mesh.vertices[vCounter + 8] = (float)z;
-      
-      // populate heightMap
-      terrain_map->value[x * terrain_map->max_width + z] = GRAY_VALUE(pixels[x + z * mapX]) * y_scale;
-      terrain_map->value[x * terrain_map->max_width + (z + 1)] = GRAY_VALUE(pixels[x + (z + 1) * mapX]) * y_scale;
-      terrain_map->value[(x + 1) * terrain_map->max_width + z] = GRAY_VALUE(pixels[(x + 1) + z * mapX]) * y_scale;
-      terrain_map->value[(x + 1) * terrain_map->max_width + (z + 1)] = GRAY_VALUE(pixels[(x + 1) + (z + 1) * mapX]) * y_scale;
-
-      // Another triangle - 3 vertex
-      mesh.vertices[vCounter + 9] = mesh.vertices[vCounter + 6];
-      mesh.vertices[vCounter + 10] = mesh.vertices[vCounter + 7];
-      mesh.vertices[vCounter + 11] = mesh.vertices[vCounter + 8];
-
-      mesh.vertices[vCounter + 12] = mesh.vertices[vCounter + 3];
-      mesh.vertices[vCounter + 13] = mesh.vertices[vCounter + 4];
-      mesh.vertices[vCounter + 14] = mesh.vertices[vCounter + 5];
-
-      mesh.vertices[vCounter + 15] = (float)(x + 1);
-      mesh.vertices[vCounter + 16] = GRAY_VALUE(pixels[(x + 1) + (z + 1) * mapX]) * y_scale;
-      mesh.vertices[vCounter + 17] = (float)(z + 1);
-      vCounter += 18; // 6 vertex, 18 floats
-
-      // Fill texcoords array with data
-      //--------------------------------------------------------------
-      mesh.texcoords[tcCounter] = (float)x / (mapX - 1);
-      mesh.texcoords[tcCounter + 1] = (float)z / (mapZ - 1);
-
-      mesh.texcoords[tcCounter + 2] = (float)x / (mapX - 1);
-      mesh.texcoords[tcCounter + 3] = (float)(z + 1) / (mapZ - 1);
-
-      mesh.texcoords[tcCounter + 4] = (float)(x + 1) / (mapX - 1);
-      mesh.texcoords[tcCounter + 5] = (float)z / (mapZ - 1);
-
-      mesh.texcoords[tcCounter + 6] = mesh.texcoords[tcCounter + 4];
-      mesh.texcoords[tcCounter + 7] = mesh.texcoords[tcCounter + 5];
-
-      mesh.texcoords[tcCounter + 8] = mesh.texcoords[tcCounter + 2];
-      mesh.texcoords[tcCounter + 9] = mesh.texcoords[tcCounter + 3];
-
-      mesh.texcoords[tcCounter + 10] = (float)(x + 1) / (mapX - 1);
-      mesh.texcoords[tcCounter + 11] = (float)(z + 1) / (mapZ - 1);
-      tcCounter += 12; // 6 texcoords, 12 floats
-
-      // Fill normals array with data
-      //--------------------------------------------------------------
-      #if 1
-      for (int i = 0; i < 18; i += 9)
+      int x0 = cx * step, z0 = cz * step;
+      float h00 = terrain_vertex_y(terrain_map, x0, z0);
+      float h10 = terrain_vertex_y(terrain_map, x0 + step, z0);
+      float h01 = terrain_vertex_y(terrain_map, x0, z0 + step);
+      float h11 = terrain_vertex_y(terrain_map, x0 + step, z0 + step);
+      for (int dz = 0; dz <= step; dz++)
       {
-        vA.x = mesh.vertices[nCounter + i];
-        vA.y = mesh.vertices[nCounter + i + 1];
-        vA.z = mesh.vertices[nCounter + i + 2];
+        for (int dx = 0; dx <= step; dx++)
+        {
+          float fx = (float)dx / step, fz = (float)dz / step;
+          float coarse = fx + fz <= 1.0f ? h00 + fx * (h10 - h00) + fz * (h01 - h00)
+                                         : h11 + (1.0f - fx) * (h01 - h11) + (1.0f - fz) * (h10 - h11);
+          float difference = fabsf(terrain_vertex_y(terrain_map, x0 + dx, z0 + dz) - coarse);
+          error = difference > error ? difference : error;
+        }
+      }
+    }
+  }
+  return error;
+}
 
-        vB.x = mesh.vertices[nCounter + i + 3];
-        vB.y = mesh.vertices[nCounter + i + 4];
-        vB.z = mesh.vertices[nCounter + i + 5];
+// bounds of leaf (x, z) from its samples
+static void terrain_build_leaf(game_terrain_mesh_t *terrain_mesh, game_terrain_map_t *terrain_map, int x, int z)
+{
+  int x0 = x * TERRAIN_PATCH_QUADS, z0 = z * TERRAIN_PATCH_QUADS;
+  float min_y = terrain_vertex_y(terrain_map, x0, z0);
+  float max_y = min_y;
+  for (int vz = z0; vz <= z0 + TERRAIN_PATCH_QUADS; vz++)
+  {
+    for (int vx = x0; vx <= x0 + TERRAIN_PATCH_QUADS; vx++)
+    {
+      float y = terrain_vertex_y(terrain_map, vx, vz);
+      min_y = y < min_y ? y : min_y;
+      max_y = y > max_y ? y : max_y;
+    }
+  }
+  game_terrain_node_t *node = terrain_get_node(terrain_mesh, 0, x, z);
+  node->error = 0.0f;
+  node->bounds = (BoundingBox){
+      terrain_convert_to_world_pos((Vector3){(float)x0, min_y, (float)z0}, terrain_map),
+      terrain_convert_to_world_pos((Vector3){(float)(x0 + TERRAIN_PATCH_QUADS), max_y, (float)(z0 + TERRAIN_PATCH_QUADS)}, terrain_map)};
+}
 
-        vC.x = mesh.vertices[nCounter + i + 6];
-        vC.y = mesh.vertices[nCounter + i + 7];
-        vC.z = mesh.vertices[nCounter + i + 8];
+// bounds of node (x, z) become the union of its children, its error grows to the largest of theirs
+static void terrain_merge_children(game_terrain_mesh_t *terrain_mesh, int level, int x, int z)
+{
+  game_terrain_node_t *node = terrain_get_node(terrain_mesh, level, x, z);
+  node->bounds = terrain_get_node(terrain_mesh, level - 1, x * 2, z * 2)->bounds;
+  for (int child = 0; child < 4; child++)
+  {
+    game_terrain_node_t *child_node = terrain_get_node(terrain_mesh, level - 1, x * 2 + (child & 1), z * 2 + (child >> 1));
+    node->bounds.min = Vector3Min(node->bounds.min, child_node->bounds.min);
+    node->bounds.max = Vector3Max(node->bounds.max, child_node->bounds.max);
+    node->error = child_node->error > node->error ? child_node->error : node->error;
+  }
+}
+
+static void terrain_build_leaf_row(void *data, uint32_t job_index, uint32_t worker_index)
+{
+  (void)worker_index;
+  game_terrain_build_t *build = data;
+  for (int x = 0; x < build->terrain_mesh->level_width[0]; x++)
+  {
+    terrain_build_leaf(build->terrain_mesh, build->terrain_map, x, (int)job_index);
+  }
+}
 
-        vN = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(vB, vA),
-                                                  Vector3Subtract(vC, vA)));
+// error of one row of cells of a level under every node along it. a single node of the top level covers as many cells
+// as all nodes of a level further down, so rows of cells rather than nodes are what spreads evenly over the workers
+static void terrain_build_cell_row_errors(void *data, uint32_t job_index, uint32_t worker_index)
+{
+  (void)worker_index;
+  game_terrain_build_t *build = data;
+  game_terrain_mesh_t *terrain_mesh = build->terrain_mesh;
+  int level = 1;
+  while (level + 1 < terrain_mesh->level_count && (int)job_index >= build->cell_row_first[level + 1])
+  {
+    level++;
+  }
+  int cell_z = (int)job_index - build->cell_row_first[level];
+  float *errors = &build->cell_row_errors[(size_t)job_index * terrain_mesh->level_width[1]];
+  for (int x = 0; x < terrain_mesh->level_width[level]; x++)
+  {
+    errors[x] = terrain_cells_error(build->terrain_map, level, x * TERRAIN_PATCH_QUADS, cell_z, (x + 1) * TERRAIN_PATCH_QUADS - 1, cell_z);
+  }
+}
 
-        mesh.normals[nCounter + i] = vN.x;
-        mesh.normals[nCounter + i + 1] = vN.y;
-        mesh.normals[nCounter + i + 2] = vN.z;
+// leaf bounds from the samples, every level above takes the union of its four children. errors only grow going up
+// so a node never looks better than one of its children. leaves and the errors of the cells under every level are
+// measured across the job pool, the merges going up are cheap and stay on this thread
+static void terrain_build_nodes(game_terrain_mesh_t *terrain_mesh, game_terrain_map_t *terrain_map)
+{
+  terrain_mesh->nodes = RL_MALLOC(terrain_mesh->node_count * sizeof(*terrain_mesh->nodes));
+  game_terrain_build_t build = {.terrain_mesh = terrain_mesh, .terrain_map = terrain_map};
+  jobs_parallel_for((uint32_t)terrain_mesh->level_height[0], terrain_build_leaf_row, &build);
+  if (terrain_mesh->level_count < 2)
+  {
+    return;
+  }
 
-        mesh.normals[nCounter + i + 3] = vN.x;
-        mesh.normals[nCounter + i + 4] = vN.y;
-        mesh.normals[nCounter + i + 5] = vN.z;
+  int cell_row_count = 0;
+  for (int level = 1; level < terrain_mesh->level_count; level++)
+  {
+    build.cell_row_first[level] = cell_row_count;
+    cell_row_count += terrain_mesh->level_height[level] * TERRAIN_PATCH_QUADS;
+  }
+  // level 1 has the most nodes in a row, every row of cells gets that many slots
+  build.cell_row_errors = RL_MALLOC((size_t)cell_row_count * terrain_mesh->level_width[1] * sizeof(float));
+  jobs_parallel_for((uint32_t)cell_row_count, terrain_build_cell_row_errors, &build);
 
-        mesh.normals[nCounter + i + 6] = vN.x;
-        mesh.normals[nCounter + i + 7] = vN.y;
-        mesh.normals[nCounter + i + 8] = vN.z;
+  for (int level = 1; level < terrain_mesh->level_count; level++)
+  {
+    for (int z = 0; z < terrain_mesh->level_height[level]; z++)
+    {
+      for (int x = 0; x < terrain_mesh->level_width[level]; x++)
+      {
+        game_terrain_node_t *node = terrain_get_node(terrain_mesh, level, x, z);
+        node->error = 0.0f;
+        for (int cell_z = z * TERRAIN_PATCH_QUADS; cell_z < (z + 1) * TERRAIN_PATCH_QUADS; cell_z++)
+        {
+          size_t row = (size_t)(build.cell_row_first[level] + cell_z) * terrain_mesh->level_width[1];
+          node->error = fmaxf(node->error, build.cell_row_errors[row + x]);
+        }
+        terrain_merge_children(terrain_mesh, level, x, z);
       }
-      #endif
-      nCounter += 18; // 6 vertex, 18 floats
     }
   }
-  #if 0
-  typedef struct {
-      Vector3 v1;
-      Vector3 v2;
-      Vector3 v3;
-    } Triangle;
-  Triangle *triList = NULL;
-  Vector3 *normalList = NULL;
-  const float smoothAngle = 90.f;
-  for (int i = 0; i < mesh.vertexCount; i++)
-  {
-    Vector3 target_vertex = (Vector3){mesh.vertices[i * 3], mesh.vertices[i * 3 + 1], mesh.vertices[i * 3 + 2]};
-    // add triangle that shares vertex to list
-    // only get adjacent triangles
-    int row = i / mapX / 3;
-    int col = i % mapX;
-    int n = row * mapX + (col * 3);
-
-    for (int j = i ; j < mesh.triangleCount && j <= n; j++)
+  RL_FREE(build.cell_row_errors);
+}
+
+void terrain_mesh_layout(game_terrain_mesh_t *terrain_mesh, int width, int height)
+{
+  // whole leaf patches only, so every node can use the same patterns. the padding repeats the last sample
+  int leaves_x = (width - 1 + TERRAIN_PATCH_QUADS - 1) / TERRAIN_PATCH_QUADS;
+  int leaves_z = (height - 1 + TERRAIN_PATCH_QUADS - 1) / TERRAIN_PATCH_QUADS;
+  terrain_mesh->vertices_x = leaves_x * TERRAIN_PATCH_QUADS + 1;
+  terrain_mesh->vertices_z = leaves_z * TERRAIN_PATCH_QUADS + 1;
+  terrain_mesh->mesh.vertexCount = terrain_mesh->vertices_x * terrain_mesh->vertices_z;
+  terrain_mesh->mesh.triangleCount = (terrain_mesh->vertices_x - 1) * (terrain_mesh->vertices_z - 1) * 2; // One quad every four pixels
+
+  // as many levels as fit a whole node on both axes, nodes past the last full one on either side stay roots
+  // of their own smaller trees
+  terrain_mesh->level_count = 1;
+  while (terrain_mesh->level_count < TERRAIN_LOD_LEVELS && (leaves_x >> terrain_mesh->level_count) > 0 &&
+         (leaves_z >> terrain_mesh->level_count) > 0)
+  {
+    terrain_mesh->level_count++;
+  }
+  terrain_mesh->node_count = 0;
+  for (int level = 0; level < terrain_mesh->level_count; level++)
+  {
+    terrain_mesh->level_first[level] = terrain_mesh->node_count;
+    terrain_mesh->level_width[level] = leaves_x >> level;
+    terrain_mesh->level_height[level] = leaves_z >> level;
+    terrain_mesh->node_count += terrain_mesh->level_width[level] * terrain_mesh->level_height[level];
+  }
+}
+
+// one vertex per heightmap sample, patches of every level index into the same vertices through the shared patterns
+uint32_t *terrain_build_mesh(game_terrain_mesh_t *terrain_mesh, game_terrain_map_t *terrain_map)
+{
+  Mesh *mesh = &terrain_mesh->mesh;
+  int mapX = terrain_map->max_width;
+  int mapZ = terrain_map->max_height;
+  terrain_mesh_layout(terrain_mesh, mapX, mapZ);
+  terrain_mesh->max_pixel_error = TERRAIN_LOD_PIXEL_ERROR;
+
+  mesh->vertices = RL_MALLOC(mesh->vertexCount * 3 * sizeof(float));
+  mesh->normals = RL_MALLOC(mesh->vertexCount * 3 * sizeof(float));
+  mesh->texcoords = RL_MALLOC(mesh->vertexCount * 2 * sizeof(float));
+  mesh->colors = NULL;
+
+  // every row only writes its own vertices, so they can go to any worker
+  game_terrain_build_t build = {.terrain_mesh = terrain_mesh, .terrain_map = terrain_map};
+  uint32_t job_count = (uint32_t)(terrain_mesh->vertices_z + TERRAIN_MESH_ROWS_PER_JOB - 1) / TERRAIN_MESH_ROWS_PER_JOB;
+  jobs_parallel_for(job_count, terrain_build_vertex_rows, &build);
+
+  terrain_build_nodes(terrain_mesh, terrain_map);
+
+  uint32_t *indices = NULL;
+  for (int level = 0; level < terrain_mesh->level_count; level++)
+  {
+    for (int mask = 0; mask < TERRAIN_STITCH_MASKS; mask++)
     {
-      int index1 = j * 3 * 3;
-      int index2 = index1 + 3;
-      int index3 = index2 + 3;
-      Vector3 vA = (Vector3){mesh.vertices[index1], mesh.vertices[index1 + 1], mesh.vertices[index1 + 2]};
-      Vector3 vB = (Vector3){mesh.vertices[index2], mesh.vertices[index2 + 1], mesh.vertices[index2 + 2]};
-      Vector3 vC = (Vector3){mesh.vertices[index3], mesh.vertices[index3 + 1], mesh.vertices[index3 + 2]};
-      // does triangle share the target vertex?
-      // can't use indices, need to compare each vertex manually
-      if (Vector3Equals(target_vertex, vA) || Vector3Equals(target_vertex, vB) || Vector3Equals(target_vertex, vC))
+      game_draw_range_t *pattern = &terrain_mesh->patterns[level][mask];
+      pattern->first = (uint32_t)arrlen(indices);
+      for (int z = 0; z < TERRAIN_PATCH_QUADS; z++)
       {
-        arrput(triList, ((Triangle){vA, vB, vC}));
+        for (int x = 0; x < TERRAIN_PATCH_QUADS; x++)
+        {
+          uint32_t v00 = terrain_pattern_index(x, z, 1 << level, mask, terrain_mesh->vertices_x);
+          uint32_t v10 = terrain_pattern_index(x + 1, z, 1 << level, mask, terrain_mesh->vertices_x);
+          uint32_t v01 = terrain_pattern_index(x, z + 1, 1 << level, mask, terrain_mesh->vertices_x);
+          uint32_t v11 = terrain_pattern_index(x + 1, z + 1, 1 << level, mask, terrain_mesh->vertices_x);
+          terrain_put_triangle(&indices, v00, v01, v10);
+          terrain_put_triangle(&indices, v10, v01, v11);
+        }
       }
+      pattern->count = (uint32_t)arrlen(indices) - pattern->first;
     }
-    // go through every triangle in the list and calculate its normal
-    for (int j = 0; j < arrlen(triList); j++)
+  }
+
+  return indices;
+}
+
+void terrain_upload_mesh(game_terrain_mesh_t *terrain_mesh, const uint32_t *indices, int index_count, bool is_owned)
+{
+  Mesh *mesh = &terrain_mesh->mesh;
+  terrain_mesh->leaf_levels = RL_MALLOC(terrain_mesh->level_width[0] * terrain_mesh->level_height[0] * sizeof(*terrain_mesh->leaf_levels));
+  // dynamic, terrain_update_mesh rewrites rows of the positions and normals after edits. Mesh only carries 16 bit
+  // indices and patterns of large maps reach past them, the 32 bit buffer goes into the slot UploadMesh leaves empty
+  // so UnloadMesh still frees it
+  UploadMesh(mesh, true);
+  rlEnableVertexArray(mesh->vaoId);
+  mesh->vboId[6] = rlLoadVertexBufferElement(indices, index_count * (int)sizeof(uint32_t), false);
+  rlDisableVertexArray();
+  // the heights stay in terrain_map, nothing reads the vertex arrays back
+  if (is_owned)
+  {
+    RL_FREE(mesh->vertices);
+    RL_FREE(mesh->normals);
+    RL_FREE(mesh->texcoords);
+  }
+  mesh->vertices = NULL;
+  mesh->normals = NULL;
+  mesh->texcoords = NULL;
+}
+
+game_terrain_mesh_t terrain_init(game_terrain_map_t *terrain_map)
+{
+  game_terrain_mesh_t terrain_mesh = {0};
+  uint32_t *indices = terrain_build_mesh(&terrain_mesh, terrain_map);
+  terrain_upload_mesh(&terrain_mesh, indices, (int)arrlen(indices), true);
+  arrfree(indices);
+  return terrain_mesh;
+}
+
+// first and last cell of size step whose span [c * step, (c + 1) * step] touches vertices v0 to v1
+static void terrain_cells_touching(int v0, int v1, int step, int *first, int *last)
+{
+  *first = v0 > 0 ? (v0 - 1) / step : 0;
+  *last = v1 / step;
+}
+
+// overlapping or adjacent rects become one so no row is uploaded twice
+static void terrain_merge_dirty_rects(game_terrain_map_t *terrain_map)
+{
+  for (ptrdiff_t i = 0; i < arrlen(terrain_map->dirty_rects); i++)
+  {
+    for (ptrdiff_t j = i + 1; j < arrlen(terrain_map->dirty_rects);)
     {
-      Triangle tri = triList[j];
-      Vector3 normal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(tri.v2, tri.v1), Vector3Subtract(tri.v3, tri.v1)));
-      arrput(normalList, normal);
+      game_terrain_rect_t *rect = &terrain_map->dirty_rects[i];
+      game_terrain_rect_t other = terrain_map->dirty_rects[j];
+      if (other.x0 > rect->x1 + 1 || other.x1 < rect->x0 - 1 || other.z0 > rect->z1 + 1 || other.z1 < rect->z0 - 1)
+      {
+        j++;
+        continue;
+      }
+      rect->x0 = other.x0 < rect->x0 ? other.x0 : rect->x0;
+      rect->z0 = other.z0 < rect->z0 ? other.z0 : rect->z0;
+      rect->x1 = other.x1 > rect->x1 ? other.x1 : rect->x1;
+      rect->z1 = other.z1 > rect->z1 ? other.z1 : rect->z1;
+      arrdelswap(terrain_map->dirty_rects, j);
+      // the grown rect may reach ones it was checked against already
+      j = i + 1;
     }
-    Vector3 source_normal = normalList[0];
-    Vector3 dest_normal = source_normal;
-    for (int j = 1; j < arrlen(normalList); j++)
+  }
+}
+
+void terrain_update_mesh(game_terrain_mesh_t *terrain_mesh, game_terrain_map_t *terrain_map)
+{
+  if (arrlen(terrain_map->dirty_rects) == 0)
+  {
+    return;
+  }
+  terrain_merge_dirty_rects(terrain_map);
+  int last_x = terrain_mesh->vertices_x - 1, last_z = terrain_mesh->vertices_z - 1;
+  float *positions = RL_MALLOC(terrain_mesh->vertices_x * 3 * sizeof(float));
+  float *normals = RL_MALLOC(terrain_mesh->vertices_x * 3 * sizeof(float));
+  for (ptrdiff_t i = 0; i < arrlen(terrain_map->dirty_rects); i++)
+  {
+    // vertices whose height changed, including the padding when the rect reaches the last sample
+    game_terrain_rect_t rect = terrain_map->dirty_rects[i];
+    rect.x1 = rect.x1 < terrain_map->max_width - 1 ? rect.x1 : last_x;
+    rect.z1 = rect.z1 < terrain_map->max_height - 1 ? rect.z1 : last_z;
+
+    // normals also change one vertex further out
+    int x0 = rect.x0 > 0 ? rect.x0 - 1 : 0, x1 = rect.x1 < last_x ? rect.x1 + 1 : last_x;
+    int z0 = rect.z0 > 0 ? rect.z0 - 1 : 0, z1 = rect.z1 < last_z ? rect.z1 + 1 : last_z;
+    int row_size = (x1 - x0 + 1) * 3 * (int)sizeof(float);
+    for (int z = z0; z <= z1; z++)
+    {
+      int offset = (z * terrain_mesh->vertices_x + x0) * 3 * (int)sizeof(float);
+      // a mesh that was built but never uploaded, like the headless one, keeps its rows in the vertex arrays
+      if (terrain_mesh->mesh.vboId == NULL)
+      {
+        terrain_build_vertex_row(terrain_mesh, terrain_map, z, x0, x1, (float *)((char *)terrain_mesh->mesh.vertices + offset),
+                                 (float *)((char *)terrain_mesh->mesh.normals + offset));
+        continue;
+      }
+      terrain_build_vertex_row(terrain_mesh, terrain_map, z, x0, x1, positions, normals);
+      rlUpdateVertexBuffer(terrain_mesh->mesh.vboId[0], positions, row_size, offset);
+      rlUpdateVertexBuffer(terrain_mesh->mesh.vboId[2], normals, row_size, offset);
+    }
+
+    int first_x, first_z, end_x, end_z;
+    terrain_cells_touching(rect.x0, rect.x1, TERRAIN_PATCH_QUADS, &first_x, &end_x);
+    terrain_cells_touching(rect.z0, rect.z1, TERRAIN_PATCH_QUADS, &first_z, &end_z);
+    end_x = end_x < terrain_mesh->level_width[0] - 1 ? end_x : terrain_mesh->level_width[0] - 1;
+    end_z = end_z < terrain_mesh->level_height[0] - 1 ? end_z : terrain_mesh->level_height[0] - 1;
+    for (int z = first_z; z <= end_z; z++)
+    {
+      for (int x = first_x; x <= end_x; x++)
+      {
+        terrain_build_leaf(terrain_mesh, terrain_map, x, z);
+      }
+    }
+    // only the cells of each level that touch the rect are measured again, the rest of a node kept its error
+    for (int level = 1; level < terrain_mesh->level_count; level++)
     {
-      for (int n = j + 1; n < arrlen(normalList); n++)
+      terrain_cells_touching(rect.x0, rect.x1, 1 << level, &first_x, &end_x);
+      terrain_cells_touching(rect.z0, rect.z1, 1 << level, &first_z, &end_z);
+      int cells_x = terrain_mesh->level_width[level] * TERRAIN_PATCH_QUADS;
+      int cells_z = terrain_mesh->level_height[level] * TERRAIN_PATCH_QUADS;
+      end_x = end_x < cells_x - 1 ? end_x : cells_x - 1;
+      end_z = end_z < cells_z - 1 ? end_z : cells_z - 1;
+      for (int node_z = first_z / TERRAIN_PATCH_QUADS; node_z <= end_z / TERRAIN_PATCH_QUADS && first_z <= end_z; node_z++)
       {
-        Vector3 target_normal = normalList[n];
-        if (Vector3DotProduct(source_normal, target_normal) < cosf(smoothAngle * DEG2RAD))
+        for (int node_x = first_x / TERRAIN_PATCH_QUADS; node_x <= end_x / TERRAIN_PATCH_QUADS && first_x <= end_x; node_x++)
         {
-          dest_normal = Vector3Add(dest_normal, target_normal);
+          int cell_x0 = first_x > node_x * TERRAIN_PATCH_QUADS ? first_x : node_x * TERRAIN_PATCH_QUADS;
+          int cell_z0 = first_z > node_z * TERRAIN_PATCH_QUADS ? first_z : node_z * TERRAIN_PATCH_QUADS;
+          int cell_x1 = end_x < (node_x + 1) * TERRAIN_PATCH_QUADS - 1 ? end_x : (node_x + 1) * TERRAIN_PATCH_QUADS - 1;
+          int cell_z1 = end_z < (node_z + 1) * TERRAIN_PATCH_QUADS - 1 ? end_z : (node_z + 1) * TERRAIN_PATCH_QUADS - 1;
+          game_terrain_node_t *node = terrain_get_node(terrain_mesh, level, node_x, node_z);
+          node->error = fmaxf(node->error, terrain_cells_error(terrain_map, level, cell_x0, cell_z0, cell_x1, cell_z1));
+          terrain_merge_children(terrain_mesh, level, node_x, node_z);
         }
       }
     }
-    Vector3Normalize(dest_normal);
-    // add mesh normals here
-    mesh.normals[i * 3] = dest_normal.x;
-    mesh.normals[i * 3 + 1] = dest_normal.y;
-    mesh.normals[i * 3 + 2] = dest_normal.z;
-    arrsetlen(triList, 0);
-    arrsetlen(normalList, 0);
   }
-  arrfree(triList);
-  arrfree(normalList);
-  #endif
+  RL_FREE(positions);
+  RL_FREE(normals);
+  arrsetlen(terrain_map->dirty_rects, 0);
+}
 
-  UnloadImageColors(pixels); // Unload pixels color data
+// how many pixels the node's error covers on screen
+static float terrain_node_pixel_error(const game_terrain_node_t *node, const game_terrain_view_t *view)
+{
+  if (view->orthographic || node->error <= 0.0f)
+  {
+    return node->error * view->pixels_per_unit;
+  }
+  // distance to the closest point of the bounds, zero from inside them
+  float dx = fmaxf(fmaxf(node->bounds.min.x - view->eye.x, view->eye.x - node->bounds.max.x), 0.0f);
+  float dy = fmaxf(fmaxf(node->bounds.min.y - view->eye.y, view->eye.y - node->bounds.max.y), 0.0f);
+  float dz = fmaxf(fmaxf(node->bounds.min.z - view->eye.z, view->eye.z - node->bounds.max.z), 0.0f);
+  float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+  return distance > 0.0f ? node->error * view->pixels_per_unit / distance : FLT_MAX;
+}
 
-  // Upload vertex data to GPU (static mesh)
-  UploadMesh(&mesh, false);
+static void terrain_set_leaf_levels(game_terrain_mesh_t *terrain_mesh, game_terrain_patch_t patch, int8_t value)
+{
+  int size = 1 << patch.level;
+  for (int z = patch.z * size; z < (patch.z + 1) * size; z++)
+  {
+    for (int x = patch.x * size; x < (patch.x + 1) * size; x++)
+    {
+      terrain_mesh->leaf_levels[z * terrain_mesh->level_width[0] + x] = value;
+    }
+  }
+}
+
+static bool terrain_patch_is_visible(game_terrain_mesh_t *terrain_mesh, game_terrain_patch_t patch, const game_terrain_view_t *view)
+{
+  return view == NULL || frustum_check_box(&view->frustum, terrain_get_node(terrain_mesh, patch.level, patch.x, patch.z)->bounds);
+}
+
+static void terrain_select_node(game_terrain_mesh_t *terrain_mesh, game_terrain_patch_t patch, const game_terrain_view_t *view)
+{
+  if (!terrain_patch_is_visible(terrain_mesh, patch, view))
+  {
+    return;
+  }
+  game_terrain_node_t *node = terrain_get_node(terrain_mesh, patch.level, patch.x, patch.z);
+  if (patch.level == 0 || (view != NULL && terrain_node_pixel_error(node, view) <= terrain_mesh->max_pixel_error))
+  {
+    arrput(terrain_mesh->patches, patch);
+    terrain_set_leaf_levels(terrain_mesh, patch, (int8_t)patch.level);
+    return;
+  }
+  for (int child = 0; child < 4; child++)
+  {
+    terrain_select_node(terrain_mesh,
+                        (game_terrain_patch_t){.level = patch.level - 1, .x = patch.x * 2 + (child & 1), .z = patch.z * 2 + (child >> 1)},
+                        view);
+  }
+}
+
+// level of the selected leaf at (x, z), -1 outside the map or where nothing is drawn
+static int terrain_get_leaf_level(game_terrain_mesh_t *terrain_mesh, int x, int z)
+{
+  if (x < 0 || z < 0 || x >= terrain_mesh->level_width[0] || z >= terrain_mesh->level_height[0])
+  {
+    return -1;
+  }
+  return terrain_mesh->leaf_levels[z * terrain_mesh->level_width[0] + x];
+}
 
-  return mesh;
+// stitching only bridges one level, a patch with a neighbour two or more levels finer has to split
+static bool terrain_patch_needs_split(game_terrain_mesh_t *terrain_mesh, game_terrain_patch_t patch)
+{
+  int size = 1 << patch.level;
+  int x0 = patch.x * size, z0 = patch.z * size;
+  for (int n = 0; n < size; n++)
+  {
+    int neighbours[4] = {terrain_get_leaf_level(terrain_mesh, x0 - 1, z0 + n), terrain_get_leaf_level(terrain_mesh, x0 + size, z0 + n),
+                         terrain_get_leaf_level(terrain_mesh, x0 + n, z0 - 1), terrain_get_leaf_level(terrain_mesh, x0 + n, z0 + size)};
+    for (int i = 0; i < 4; i++)
+    {
+      if (neighbours[i] >= 0 && neighbours[i] < patch.level - 1)
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// a coarser neighbour is aligned to its own larger size, so it spans the whole edge and one leaf per edge is enough
+static int terrain_patch_stitch_mask(game_terrain_mesh_t *terrain_mesh, game_terrain_patch_t patch)
+{
+  int size = 1 << patch.level;
+  int x0 = patch.x * size, z0 = patch.z * size;
+  int mask = 0;
+  mask |= terrain_get_leaf_level(terrain_mesh, x0 - 1, z0) > patch.level ? TERRAIN_STITCH_X_NEG : 0;
+  mask |= terrain_get_leaf_level(terrain_mesh, x0 + size, z0) > patch.level ? TERRAIN_STITCH_X_POS : 0;
+  mask |= terrain_get_leaf_level(terrain_mesh, x0, z0 - 1) > patch.level ? TERRAIN_STITCH_Z_NEG : 0;
+  mask |= terrain_get_leaf_level(terrain_mesh, x0, z0 + size) > patch.level ? TERRAIN_STITCH_Z_POS : 0;
+  return mask;
+}
+
+void terrain_draw(game_terrain_mesh_t *terrain_mesh, Material material, Matrix transform, const game_terrain_view_t *view)
+{
+  arrsetlen(terrain_mesh->patches, 0);
+  memset(terrain_mesh->leaf_levels, -1, terrain_mesh->level_width[0] * terrain_mesh->level_height[0] * sizeof(*terrain_mesh->leaf_levels));
+
+  // roots are the nodes without a parent, the top level and whatever sticks out past it
+  for (int level = terrain_mesh->level_count - 1; level >= 0; level--)
+  {
+    bool is_top = level == terrain_mesh->level_count - 1;
+    for (int z = 0; z < terrain_mesh->level_height[level]; z++)
+    {
+      for (int x = 0; x < terrain_mesh->level_width[level]; x++)
+      {
+        if (is_top || x / 2 >= terrain_mesh->level_width[level + 1] || z / 2 >= terrain_mesh->level_height[level + 1])
+        {
+          terrain_select_node(terrain_mesh, (game_terrain_patch_t){.level = level, .x = x, .z = z}, view);
+        }
+      }
+    }
+  }
+
+  // splitting refines the neighbourhood of the split patch, so repeat until a pass changes nothing
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (ptrdiff_t i = 0; i < arrlen(terrain_mesh->patches);)
+    {
+      game_terrain_patch_t patch = terrain_mesh->patches[i];
+      if (!terrain_patch_needs_split(terrain_mesh, patch))
+      {
+        i++;
+        continue;
+      }
+      arrdelswap(terrain_mesh->patches, i);
+      terrain_set_leaf_levels(terrain_mesh, patch, -1);
+      for (int child = 0; child < 4; child++)
+      {
+        game_terrain_patch_t child_patch = {.level = patch.level - 1, .x = patch.x * 2 + (child & 1), .z = patch.z * 2 + (child >> 1)};
+        if (terrain_patch_is_visible(terrain_mesh, child_patch, view))
+        {
+          arrput(terrain_mesh->patches, child_patch);
+          terrain_set_leaf_levels(terrain_mesh, child_patch, (int8_t)child_patch.level);
+        }
+      }
+      changed = true;
+    }
+  }
+
+  game_terrain_draw_stats_t *stats = &terrain_mesh->stats;
+  *stats = (game_terrain_draw_stats_t){0};
+  arrsetlen(terrain_mesh->draw_ranges, 0);
+  for (ptrdiff_t i = 0; i < arrlen(terrain_mesh->patches); i++)
+  {
+    game_terrain_patch_t patch = terrain_mesh->patches[i];
+    int size = 1 << patch.level;
+    game_draw_range_t range = terrain_mesh->patterns[patch.level][terrain_patch_stitch_mask(terrain_mesh, patch)];
+    range.base_vertex = patch.z * size * TERRAIN_PATCH_QUADS * terrain_mesh->vertices_x + patch.x * size * TERRAIN_PATCH_QUADS;
+    arrput(terrain_mesh->draw_ranges, range);
+    stats->patches++;
+    stats->patches_full += size * size;
+    stats->triangles += range.count / 3;
+    stats->triangles_full += size * size * TERRAIN_PATCH_QUADS * TERRAIN_PATCH_QUADS * 2;
+  }
+  entity_draw_mesh_ranges(terrain_mesh->mesh, terrain_mesh->draw_ranges, (int)arrlen(terrain_mesh->draw_ranges), true,
+                          material, transform);
+}
+
+void terrain_unload(game_terrain_mesh_t *terrain_mesh)
+{
+  UnloadMesh(terrain_mesh->mesh);
+  RL_FREE(terrain_mesh->nodes);
+  RL_FREE(terrain_mesh->leaf_levels);
+  arrfree(terrain_mesh->patches);
+  arrfree(terrain_mesh->draw_ranges);
+  *terrain_mesh = (game_terrain_mesh_t){0};
 }
 
 Vector3 terrain_convert_from_world_pos(Vector3 world_pos, game_terrain_map_t *terrain_map)
@@ -227,66 +956,263 @@ float terrain_get_adjusted_y(Vector3 world_pos, game_terrain_map_t *terrain_map)
   Vector3 terrain_pos = terrain_convert_from_world_pos(world_pos, terrain_map);
   int index_x = floor(terrain_pos.x);
   int index_z = floor(terrain_pos.z);
-  if (index_x >= terrain_map->max_width || index_z >= terrain_map->max_height)
+  // the sample reads index + 1 on both axes
+  if (index_x < 0 || index_z < 0 || index_x >= terrain_map->max_width - 1 || index_z >= terrain_map->max_height - 1)
   {
     // we are out of bounds
     return 0.0f;
   }
   float xCoord = (terrain_pos.x - index_x);
   float zCoord = (terrain_pos.z - index_z);
-  Vector3 a, b, c;    // three vectors constructed around oldPos
-  Vector3 barycenter; // u, v, w calculated from a, b, c
-  float answer;
-  if (xCoord <= 1 - zCoord)
+  return terrain_interpolate(xCoord, zCoord, terrain_get_height(terrain_map, index_x, index_z),
+                             terrain_get_height(terrain_map, index_x + 1, index_z), terrain_get_height(terrain_map, index_x, index_z + 1),
+                             terrain_get_height(terrain_map, index_x + 1, index_z + 1));
+}
+
+void terrain_get_adjusted_y_batch(const Vector3 *world_positions, uint32_t count, game_terrain_map_t *terrain_map, float *out_y)
+{
+  uint32_t i = 0;
+#if TERRAIN_SIMD_SSE2
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 half_width = _mm_set1_ps(terrain_map->max_width / 2.0f);
+  const __m128 half_height = _mm_set1_ps(terrain_map->max_height / 2.0f);
+  const __m128i last_x = _mm_set1_epi32(terrain_map->max_width - 1);
+  const __m128i last_z = _mm_set1_epi32(terrain_map->max_height - 1);
+  for (; i + 4 <= count; i += 4)
   {
-    a = (Vector3){0, terrain_map->value[index_x * terrain_map->max_width + index_z], 0}; // maxWidth used as a stride offset
-    b = (Vector3){1, terrain_map->value[(index_x + 1) * terrain_map->max_width + index_z], 0};
-    c = (Vector3){0, terrain_map->value[index_x * terrain_map->max_width + (index_z + 1)], 1};
+    const Vector3 *p = &world_positions[i];
+    __m128 terrain_x = _mm_add_ps(_mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x), half_width);
+    __m128 terrain_z = _mm_add_ps(_mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z), half_height);
+    // truncation equals floor for everything that passes the >= 0 test
+    __m128i index_x = _mm_cvttps_epi32(terrain_x);
+    __m128i index_z = _mm_cvttps_epi32(terrain_z);
+    __m128 inside = _mm_and_ps(_mm_cmpge_ps(terrain_x, _mm_setzero_ps()), _mm_cmpge_ps(terrain_z, _mm_setzero_ps()));
+    inside = _mm_and_ps(inside, _mm_castsi128_ps(_mm_and_si128(_mm_cmplt_epi32(index_x, last_x), _mm_cmplt_epi32(index_z, last_z))));
+    __m128 fx = _mm_sub_ps(terrain_x, _mm_cvtepi32_ps(index_x));
+    __m128 fz = _mm_sub_ps(terrain_z, _mm_cvtepi32_ps(index_z));
+
+    // the gather stays scalar, SSE2 has no gather instruction
+    int32_t lanes_x[4], lanes_z[4];
+    int lanes_inside = _mm_movemask_ps(inside);
+    _mm_storeu_si128((__m128i *)lanes_x, index_x);
+    _mm_storeu_si128((__m128i *)lanes_z, index_z);
+    float h[4][4] = {0}; // corner, lane
+    for (int lane = 0; lane < 4; lane++)
+    {
+      if (lanes_inside & (1 << lane))
+      {
+        h[0][lane] = terrain_get_height(terrain_map, lanes_x[lane], lanes_z[lane]);
+        h[1][lane] = terrain_get_height(terrain_map, lanes_x[lane] + 1, lanes_z[lane]);
+        h[2][lane] = terrain_get_height(terrain_map, lanes_x[lane], lanes_z[lane] + 1);
+        h[3][lane] = terrain_get_height(terrain_map, lanes_x[lane] + 1, lanes_z[lane] + 1);
+      }
+    }
+    __m128 h00 = _mm_loadu_ps(h[0]), h10 = _mm_loadu_ps(h[1]), h01 = _mm_loadu_ps(h[2]), h11 = _mm_loadu_ps(h[3]);
+    // same operations in the same order as terrain_interpolate, so both give the same bits
+    __m128 lower = _mm_add_ps(_mm_add_ps(h00, _mm_mul_ps(fx, _mm_sub_ps(h10, h00))), _mm_mul_ps(fz, _mm_sub_ps(h01, h00)));
+    __m128 upper = _mm_add_ps(_mm_add_ps(h11, _mm_mul_ps(_mm_sub_ps(one, fx), _mm_sub_ps(h01, h11))),
+                              _mm_mul_ps(_mm_sub_ps(one, fz), _mm_sub_ps(h10, h11)));
+    __m128 is_lower = _mm_cmple_ps(fx, _mm_sub_ps(one, fz));
+    __m128 result = _mm_or_ps(_mm_and_ps(is_lower, lower), _mm_andnot_ps(is_lower, upper));
+    _mm_storeu_ps(&out_y[i], _mm_and_ps(inside, result));
   }
-  else
+#endif
+  for (; i < count; i++)
   {
-    a = (Vector3){1, terrain_map->value[(index_x + 1) * terrain_map->max_width + (index_z)], 0};
-    b = (Vector3){1, terrain_map->value[(index_x + 1) * terrain_map->max_width + (index_z + 1)], 1};
-    c = (Vector3){0, terrain_map->value[(index_x) * terrain_map->max_width + (index_z + 1)], 1};
+    out_y[i] = terrain_get_adjusted_y(world_positions[i], terrain_map);
   }
-  barycenter = Vector3Barycenter((Vector3){xCoord, terrain_pos.y, zCoord}, a, b, c);
-  answer = barycenter.x * a.y + barycenter.y * b.y + barycenter.z * c.y;
+}
 
-  return answer;
+// ray in terrain coordinates while it walks the pyramid
+typedef struct game_terrain_ray_t
+{
+  Vector3 origin;
+  Vector3 dir;
+  Vector3 inv_dir;
+  float t_min;
+  float t_max; // z_far until the first hit, then the closest hit so far
+  bool hit;
+} game_terrain_ray_t;
+
+typedef struct game_terrain_ray_walk_t
+{
+  const game_terrain_map_t *terrain_map;
+  game_terrain_ray_t *rays;
+  uint32_t ray_count;
+  uint32_t *active; // one list of ray indices per level, ray_count entries each
+} game_terrain_ray_walk_t;
+
+// slab test against a cell's quads and height range, false when the ray misses it before its current t_max
+static bool terrain_ray_cell(const game_terrain_ray_t *ray, float x0, float x1, float z0, float z1, game_terrain_height_range_t range)
+{
+  float t1 = (x0 - ray->origin.x) * ray->inv_dir.x;
+  float t2 = (x1 - ray->origin.x) * ray->inv_dir.x;
+  float t_min = fminf(t1, t2), t_max = fmaxf(t1, t2);
+  t1 = (range.min - ray->origin.y) * ray->inv_dir.y;
+  t2 = (range.max - ray->origin.y) * ray->inv_dir.y;
+  t_min = fmaxf(t_min, fminf(t1, t2));
+  t_max = fminf(t_max, fmaxf(t1, t2));
+  t1 = (z0 - ray->origin.z) * ray->inv_dir.z;
+  t2 = (z1 - ray->origin.z) * ray->inv_dir.z;
+  t_min = fmaxf(t_min, fminf(t1, t2));
+  t_max = fminf(t_max, fmaxf(t1, t2));
+  return fmaxf(t_min, ray->t_min) <= fminf(t_max, ray->t_max);
 }
 
-// Get collision info between ray and terrain
-// sourced from  https://iquilezles.org/articles/terrainmarching/
-Vector3 terrain_get_ray(Ray ray, game_terrain_map_t *terrain_map, float z_near, float z_far)
+// both triangles of the quad at (x, z), split the same way as terrain_get_adjusted_y and the mesh
+static void terrain_ray_quad(const game_terrain_map_t *terrain_map, game_terrain_ray_t *ray, int x, int z)
 {
-  // calculations will be done using terrain coordinates until testing collision
-  Vector3 ray_pos = terrain_convert_from_world_pos(ray.position, terrain_map);
+  const float epsilon = 1e-4f;
+  float h00 = terrain_get_height(terrain_map, x, z), h10 = terrain_get_height(terrain_map, x + 1, z);
+  float h01 = terrain_get_height(terrain_map, x, z + 1), h11 = terrain_get_height(terrain_map, x + 1, z + 1);
+  float local_x = ray->origin.x - x, local_z = ray->origin.z - z;
 
-  // change in direction in 3 axes
-  float t_delta = 1.f;
-  Vector3 p;
-  bool intersection = false;
-  for (float t = z_near; t < z_far; t += t_delta)
+  // x + z <= 1 half: y = h00 + fx * (h10 - h00) + fz * (h01 - h00)
+  float slope_x = h10 - h00, slope_z = h01 - h00;
+  float denominator = ray->dir.y - ray->dir.x * slope_x - ray->dir.z * slope_z;
+  if (fabsf(denominator) > 1e-12f)
   {
-    p = Vector3Add(ray_pos, Vector3Scale(ray.direction, t));
-    // check to ensure no segfaults
-    if (p.x < 0 || p.z < 0 || p.x > terrain_map->max_width - 1 || p.z > terrain_map->max_height - 1) {
-      return (Vector3){0};
+    float t = (h00 + local_x * slope_x + local_z * slope_z - ray->origin.y) / denominator;
+    float fx = local_x + ray->dir.x * t, fz = local_z + ray->dir.z * t;
+    if (t >= ray->t_min && t < ray->t_max && fx >= -epsilon && fz >= -epsilon && fx + fz <= 1.0f + epsilon)
+    {
+      ray->t_max = t;
+      ray->hit = true;
     }
-    float heightY = terrain_map->value[(int)floor(p.x) * terrain_map->max_width + (int)floor(p.z)];
-    if (p.y < heightY)
+  }
+  // x + z >= 1 half: y = h11 + (fx - 1) * (h11 - h01) + (fz - 1) * (h11 - h10)
+  slope_x = h11 - h01;
+  slope_z = h11 - h10;
+  denominator = ray->dir.y - ray->dir.x * slope_x - ray->dir.z * slope_z;
+  if (fabsf(denominator) > 1e-12f)
+  {
+    float t = (h11 + (local_x - 1.0f) * slope_x + (local_z - 1.0f) * slope_z - ray->origin.y) / denominator;
+    float fx = local_x + ray->dir.x * t, fz = local_z + ray->dir.z * t;
+    if (t >= ray->t_min && t < ray->t_max && fx <= 1.0f + epsilon && fz <= 1.0f + epsilon && fx + fz >= 1.0f - epsilon)
     {
-      if (!intersection)
-      {
-        t -= 1.f;
-        t_delta = 0.1f;
-        intersection = true;
-      }
-      else 
+      ray->t_max = t;
+      ray->hit = true;
+    }
+  }
+}
+
+// rays in parent_active that reach the cell go down to its children, nearest child first for the first of them.
+// the other rays may prefer another order, they still get the right hit because t_max only ever shrinks
+static void terrain_ray_walk(game_terrain_ray_walk_t *walk, const uint32_t *parent_active, uint32_t parent_count, int level, int x, int z)
+{
+  const game_terrain_map_t *terrain_map = walk->terrain_map;
+  int size = 1 << (level + terrain_map->pyramid_shift);
+  float x0 = (float)(x * size), z0 = (float)(z * size);
+  float x1 = fminf((float)((x + 1) * size), (float)(terrain_map->max_width - 1));
+  float z1 = fminf((float)((z + 1) * size), (float)(terrain_map->max_height - 1));
+  game_terrain_height_range_t range = terrain_map->pyramid[level][z * terrain_map->pyramid_width[level] + x];
+
+  uint32_t *active = walk->active + (size_t)level * walk->ray_count;
+  uint32_t active_count = 0;
+  for (uint32_t i = 0; i < parent_count; i++)
+  {
+    if (terrain_ray_cell(&walk->rays[parent_active[i]], x0, x1, z0, z1, range))
+    {
+      active[active_count++] = parent_active[i];
+    }
+  }
+  if (active_count == 0)
+  {
+    return;
+  }
+  if (level == 0)
+  {
+    for (int quad_z = (int)z0; quad_z < (int)z1; quad_z++)
+    {
+      for (int quad_x = (int)x0; quad_x < (int)x1; quad_x++)
       {
-        return terrain_convert_to_world_pos(p, terrain_map);
+        for (uint32_t i = 0; i < active_count; i++)
+        {
+          terrain_ray_quad(terrain_map, &walk->rays[active[i]], quad_x, quad_z);
+        }
       }
     }
+    return;
+  }
+
+  const game_terrain_ray_t *lead = &walk->rays[active[0]];
+  int near = (lead->dir.x < 0.0f ? 1 : 0) | (lead->dir.z < 0.0f ? 2 : 0);
+  int far_first = fabsf(lead->dir.x) >= fabsf(lead->dir.z) ? 1 : 2; // neighbour across the axis the ray moves along most
+  int order[4] = {near, near ^ far_first, near ^ (3 ^ far_first), near ^ 3};
+  for (int n = 0; n < 4; n++)
+  {
+    int child_x = x * 2 + (order[n] & 1), child_z = z * 2 + (order[n] >> 1);
+    if (child_x < terrain_map->pyramid_width[level - 1] && child_z < terrain_map->pyramid_height[level - 1])
+    {
+      terrain_ray_walk(walk, active, active_count, level - 1, child_x, child_z);
+    }
+  }
+}
+
+void terrain_get_ray_batch(const Ray *rays, uint32_t ray_count, game_terrain_map_t *terrain_map, float z_near, float z_far, game_terrain_hit_t *out_hits)
+{
+  if (ray_count == 0)
+  {
+    return;
+  }
+  if (terrain_map->pyramid_levels == 0)
+  {
+    memset(out_hits, 0, ray_count * sizeof(*out_hits));
+    return;
+  }
+  // a single ray needs no heap
+  game_terrain_ray_t single_ray;
+  uint32_t single_active[TERRAIN_PYRAMID_MAX_LEVELS + 1];
+  game_terrain_ray_walk_t walk = {.terrain_map = terrain_map, .rays = &single_ray, .ray_count = ray_count, .active = single_active};
+  if (ray_count > 1)
+  {
+    walk.rays = RL_MALLOC(ray_count * sizeof(*walk.rays));
+    walk.active = RL_MALLOC((size_t)(terrain_map->pyramid_levels + 1) * ray_count * sizeof(*walk.active));
+  }
+
+  uint32_t *all = walk.active + (size_t)terrain_map->pyramid_levels * ray_count;
+  for (uint32_t i = 0; i < ray_count; i++)
+  {
+    Vector3 dir = rays[i].direction;
+    walk.rays[i] = (game_terrain_ray_t){.origin = terrain_convert_from_world_pos(rays[i].position, terrain_map),
+                                        .dir = dir,
+                                        .inv_dir = (Vector3){1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z},
+                                        .t_min = z_near,
+                                        .t_max = z_far};
+    all[i] = i;
+  }
+
+  int top = terrain_map->pyramid_levels - 1;
+  for (int z = 0; z < terrain_map->pyramid_height[top]; z++)
+  {
+    for (int x = 0; x < terrain_map->pyramid_width[top]; x++)
+    {
+      terrain_ray_walk(&walk, all, ray_count, top, x, z);
+    }
+  }
+
+  for (uint32_t i = 0; i < ray_count; i++)
+  {
+    game_terrain_ray_t *ray = &walk.rays[i];
+    out_hits[i] = (game_terrain_hit_t){0};
+    if (ray->hit)
+    {
+      out_hits[i] = (game_terrain_hit_t){
+          .hit = true,
+          .position = terrain_convert_to_world_pos(Vector3Add(ray->origin, Vector3Scale(ray->dir, ray->t_max)), terrain_map),
+          .distance = ray->t_max};
+    }
+  }
+  if (ray_count > 1)
+  {
+    RL_FREE(walk.rays);
+    RL_FREE(walk.active);
   }
-  return (Vector3){0};
-}
\ No newline at end of file
+}
+
+Vector3 terrain_get_ray(Ray ray, game_terrain_map_t *terrain_map, float z_near, float z_far)
+{
+  game_terrain_hit_t hit;
+  terrain_get_ray_batch(&ray, 1, terrain_map, z_near, z_far, &hit);
+  return hit.position;
+}
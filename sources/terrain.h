@@ -1,17 +1,190 @@
 #pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "raylib.h"
+#include "frustum.h"
+#include "models.h"
 
 // intended for all terrain code, everything outside this module should rely on
 // world coordinates
 
+#define TERRAIN_PYRAMID_MAX_LEVELS 16 // a single top cell for maps up to 32768 quads a side
+#define TERRAIN_HEIGHT_RANGE 31.875f  // height of the brightest sample of an integer heightmap, 8 bit maps step by 1/8
+
+typedef struct game_terrain_height_range_t
+{
+  float min;
+  float max;
+} game_terrain_height_range_t;
+
+#define TERRAIN_TILE_SHIFT 3 // heights are stored in 8x8 tiles so the four samples under a point share a cache line
+#define TERRAIN_TILE_SIZE (1 << TERRAIN_TILE_SHIFT)
+
+typedef enum game_terrain_storage
+{
+  GAME_TERRAIN_STORAGE_FLOAT32 = 0,
+  GAME_TERRAIN_STORAGE_UINT16,   // 65536 steps between height_min and height_max, half the memory
+  GAME_TERRAIN_STORAGE_STREAMED, // read only, tiles paged in from a file around a focus point, see terrain_stream.h
+} game_terrain_storage;
+
+typedef struct game_terrain_stream_t game_terrain_stream_t;
+
+// samples x0 to x1 and z0 to z1, inclusive. empty when x0 > x1
+typedef struct game_terrain_rect_t
+{
+  int x0;
+  int z0;
+  int x1;
+  int z1;
+} game_terrain_rect_t;
+
 typedef struct game_terrain_map_t
 {
-  int max_width;
-  int max_height;
-  float *value; // treat as 2d array, may convert to struct later
+  int max_width;  // samples along x
+  int max_height; // samples along z
+  game_terrain_storage storage;
+  int tiles_x;     // tiles per row of tiles
+  float *value;    // GAME_TERRAIN_STORAGE_FLOAT32, tiled, go through terrain_get_height and terrain_set_height
+  uint16_t *value16; // GAME_TERRAIN_STORAGE_UINT16, same layout
+  float height_min;
+  float height_step; // height of one uint16 step
+  game_terrain_stream_t *stream; // GAME_TERRAIN_STORAGE_STREAMED
+  // min/max heights over blocks of quads for ray queries. level 0 holds one cell per quad, every level above halves
+  // both sides (rounding up) until one cell covers the map. built by terrain_build_pyramid
+  int pyramid_levels;
+  int pyramid_shift; // level 0 cells span 1 << pyramid_shift quads a side
+  int pyramid_width[TERRAIN_PYRAMID_MAX_LEVELS];
+  int pyramid_height[TERRAIN_PYRAMID_MAX_LEVELS];
+  game_terrain_height_range_t *pyramid[TERRAIN_PYRAMID_MAX_LEVELS];
+  // stb_ds array of the rects terrain_edit_* changed since the last terrain_update_mesh, anything else that caches
+  // heights reads them before it
+  game_terrain_rect_t *dirty_rects;
 } game_terrain_map_t;
 
+// offset of sample (x, z): tiles row by row, samples row by row inside a tile
+static inline size_t terrain_sample_index(const game_terrain_map_t *terrain_map, int x, int z)
+{
+  size_t tile = (size_t)(z >> TERRAIN_TILE_SHIFT) * terrain_map->tiles_x + (x >> TERRAIN_TILE_SHIFT);
+  return (tile << (2 * TERRAIN_TILE_SHIFT)) + ((z & (TERRAIN_TILE_SIZE - 1)) << TERRAIN_TILE_SHIFT) + (x & (TERRAIN_TILE_SIZE - 1));
+}
+
+// defined in terrain_stream.c, exact inside resident tiles and interpolated from the overview elsewhere
+float terrain_stream_get_height(const game_terrain_stream_t *stream, int x, int z);
+
+static inline float terrain_get_height(const game_terrain_map_t *terrain_map, int x, int z)
+{
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_STREAMED)
+  {
+    return terrain_stream_get_height(terrain_map->stream, x, z);
+  }
+  size_t index = terrain_sample_index(terrain_map, x, z);
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_UINT16)
+  {
+    return terrain_map->height_min + terrain_map->value16[index] * terrain_map->height_step;
+  }
+  return terrain_map->value[index];
+}
+
+// uint16 storage rounds to the nearest step and clamps to the range given to terrain_map_init, streamed maps
+// ignore writes
+static inline void terrain_set_height(game_terrain_map_t *terrain_map, int x, int z, float height)
+{
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_STREAMED)
+  {
+    return;
+  }
+  size_t index = terrain_sample_index(terrain_map, x, z);
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_UINT16)
+  {
+    float step = (height - terrain_map->height_min) / terrain_map->height_step + 0.5f;
+    terrain_map->value16[index] = (uint16_t)(step < 0.0f ? 0.0f : (step > (float)UINT16_MAX ? (float)UINT16_MAX : step));
+    return;
+  }
+  terrain_map->value[index] = height;
+}
+
+// planar interpolation over the triangle of the quad that holds (fx, fz), split the same way as the mesh
+static inline float terrain_interpolate(float fx, float fz, float h00, float h10, float h01, float h11)
+{
+  if (fx <= 1.0f - fz)
+  {
+    return h00 + fx * (h10 - h00) + fz * (h01 - h00);
+  }
+  return h11 + (1.0f - fx) * (h01 - h11) + (1.0f - fz) * (h10 - h11);
+}
+
+typedef struct game_terrain_hit_t
+{
+  bool hit;
+  Vector3 position; // world space, zero on a miss
+  float distance;   // along the ray direction
+} game_terrain_hit_t;
+
+#define TERRAIN_PATCH_QUADS 32   // leaf patch edge length in heightmap quads, nodes of every level draw this many per edge
+#define TERRAIN_LOD_LEVELS 8     // a node at level k spans TERRAIN_PATCH_QUADS << k quads with a vertex every 1 << k samples
+#define TERRAIN_STITCH_MASKS 16  // one bit per edge that has to match a coarser neighbour
+#define TERRAIN_LOD_PIXEL_ERROR 2.0f // default max_pixel_error
+
+// node of the level of detail pyramid, level 0 nodes are the leaf patches
+typedef struct game_terrain_node_t
+{
+  BoundingBox bounds; // world space, heights from the node's own min and max sample
+  float error;        // largest height difference between the node drawn at its own step and the full resolution surface
+} game_terrain_node_t;
+
+// a node picked for drawing, x and z count nodes of its level
+typedef struct game_terrain_patch_t
+{
+  int level;
+  int x;
+  int z;
+} game_terrain_patch_t;
+
+// what terrain_draw needs to know about the camera to cull and pick detail levels
+typedef struct game_terrain_view_t
+{
+  game_frustum_t frustum;
+  Vector3 eye;           // world space camera position
+  float pixels_per_unit; // screen pixels covered by one world unit at distance 1, at any distance when orthographic
+  bool orthographic;
+} game_terrain_view_t;
+
+// counters of the last terrain_draw
+typedef struct game_terrain_draw_stats_t
+{
+  uint32_t patches;        // one draw each
+  uint32_t patches_full;   // leaf patches the view would have needed without level of detail
+  uint32_t triangles;
+  uint32_t triangles_full;
+} game_terrain_draw_stats_t;
+
+typedef struct game_terrain_mesh_t
+{
+  // one vertex per heightmap sample, padded to whole leaf patches by repeating the last row and column. the buffers hold
+  // the only copy once uploaded, the vertex, normal and texcoord arrays are NULL
+  Mesh mesh;
+  int vertices_x; // vertex grid size, vertices_x is the row stride the patterns are built for
+  int vertices_z;
+  // node pyramid, level k holds level_width[k] * level_height[k] nodes row by row starting at nodes[level_first[k]]
+  int level_count;
+  int level_first[TERRAIN_LOD_LEVELS];
+  int level_width[TERRAIN_LOD_LEVELS];
+  int level_height[TERRAIN_LOD_LEVELS];
+  int node_count;
+  game_terrain_node_t *nodes;
+  // index ranges of one patch per level and stitch mask, relative to the patch's first vertex. they live in
+  // mesh.vboId[6] as 32 bit indices, mesh.indices stays NULL
+  game_draw_range_t patterns[TERRAIN_LOD_LEVELS][TERRAIN_STITCH_MASKS];
+  float max_pixel_error; // nodes are split while their error covers more screen pixels than this
+  // scratch, rebuilt by every terrain_draw
+  game_terrain_patch_t *patches;
+  int8_t *leaf_levels; // level of the patch covering each leaf, -1 where nothing was selected
+  game_draw_range_t *draw_ranges;
+  game_terrain_draw_stats_t stats;
+} game_terrain_mesh_t;
+
 // modifies X and Z world coordinates to match indices of terrain map lookups
 Vector3 terrain_convert_from_world_pos(Vector3 world_pos, game_terrain_map_t *terrain_map);
 
@@ -20,7 +193,57 @@ Vector3 terrain_convert_to_world_pos(Vector3 terrain_pos, game_terrain_map_t *te
 // takes in world coordinates and gives an approximation of the height using barycentric coordinates
 float terrain_get_adjusted_y(Vector3 world_pos, game_terrain_map_t *terrain_map);
 
-// raylib mesh generation, while also populating an array of floats for future lookups
-Mesh terrain_init(Image height_image, game_terrain_map_t *terrain_map);
+// terrain_get_adjusted_y for every position, four at a time with SSE2 where available. same results bit for bit
+void terrain_get_adjusted_y_batch(const Vector3 *world_positions, uint32_t count, game_terrain_map_t *terrain_map, float *out_y);
+
+// allocates width * height samples (rounded up to whole tiles) set to height_min. height_min and height_max only
+// matter for uint16 storage
+bool terrain_map_init(game_terrain_map_t *terrain_map, int width, int height, game_terrain_storage storage, float height_min, float height_max);
+
+// initializes terrain_map to the image's size and fills it without touching the GPU, then builds the pyramid. the
+// channels are averaged to 8 bits, terrain_heightmap.h reads 16 bit and float heightmaps at full precision
+bool terrain_load_heights(Image height_image, game_terrain_map_t *terrain_map, game_terrain_storage storage);
+
+// (re)builds the min/max pyramid from the samples, or from the cell ranges of the tile file for streamed maps
+void terrain_build_pyramid(game_terrain_map_t *terrain_map);
+
+// refreshes the pyramid cells over the quads that touch rect and their ancestors, after the samples inside it changed
+void terrain_update_pyramid(game_terrain_map_t *terrain_map, game_terrain_rect_t rect);
+
+// frees the samples and the pyramid, closes the stream of streamed maps
+void terrain_map_unload(game_terrain_map_t *terrain_map);
+
+// indexed raylib mesh generation plus the level of detail pyramid from an already loaded map. reads every sample,
+// so build it before switching to a streamed map
+game_terrain_mesh_t terrain_init(game_terrain_map_t *terrain_map);
+
+// sizes the vertex grid and the node pyramid for a map of width x height samples, allocates nothing
+void terrain_mesh_layout(game_terrain_mesh_t *terrain_mesh, int width, int height);
+
+// the cpu half of terrain_init: vertex arrays, nodes and patterns. returns the 32 bit pattern indices as an stb_ds
+// array for terrain_upload_mesh
+uint32_t *terrain_build_mesh(game_terrain_mesh_t *terrain_mesh, game_terrain_map_t *terrain_map);
+
+// the gpu half of terrain_init: uploads the vertex arrays and pattern indices and allocates what terrain_draw needs.
+// the vertex arrays are set to NULL afterwards and only freed when is_owned, cooked loads point them into a mapping
+void terrain_upload_mesh(game_terrain_mesh_t *terrain_mesh, const uint32_t *indices, int index_count, bool is_owned);
+
+// draws the coarsest nodes that stay within max_pixel_error for the view and whose bounds touch its frustum,
+// everything at full resolution when view is NULL. neighbours differ by at most one level and the finer side
+// stitches its edge, so there are no cracks. transform has to be the translation by half the map size that
+// terrain_convert_to_world_pos applies, node bounds are in world space
+void terrain_draw(game_terrain_mesh_t *terrain_mesh, Material material, Matrix transform, const game_terrain_view_t *view);
+
+// rewrites the vertices, normals and nodes over the map's dirty rects and clears them. only the rows inside each rect
+// go to the gpu, or to the vertex arrays of a mesh terrain_upload_mesh never took. node errors are raised to cover the
+// edited cells but never lowered, which can only cost detail
+void terrain_update_mesh(game_terrain_mesh_t *terrain_mesh, game_terrain_map_t *terrain_map);
+
+void terrain_unload(game_terrain_mesh_t *terrain_mesh);
+
+// first point where the ray meets the terrain between z_near and z_far along it, zero when it doesn't
+Vector3 terrain_get_ray(Ray ray, game_terrain_map_t *terrain_map, float z_near, float z_far);
 
-Vector3 terrain_get_ray(Ray ray, game_terrain_map_t *terrain_map, float z_near, float z_far);
\ No newline at end of file
+// terrain_get_ray for several rays in one walk of the pyramid, a cell is tested once for every ray still in it so
+// rays that start close together (box selection, fog probes) share most of the work
+void terrain_get_ray_batch(const Ray *rays, uint32_t ray_count, game_terrain_map_t *terrain_map, float z_near, float z_far, game_terrain_hit_t *out_hits);
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "terrain_cooked.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "mapped_file.h"
+#include "stb_ds.h"
+#include "terrain_heightmap.h"
+#include "terrain_stream.h"
+
+static uint64_t terrain_cooked_align(uint64_t offset)
+{
+  return (offset + TERRAIN_COOKED_ALIGNMENT - 1) / TERRAIN_COOKED_ALIGNMENT * TERRAIN_COOKED_ALIGNMENT;
+}
+
+static size_t terrain_cooked_sample_count(int width, int height)
+{
+  size_t tiles_x = (width + TERRAIN_TILE_SIZE - 1) >> TERRAIN_TILE_SHIFT;
+  size_t tiles_z = (height + TERRAIN_TILE_SIZE - 1) >> TERRAIN_TILE_SHIFT;
+  return tiles_x * tiles_z * TERRAIN_TILE_SIZE * TERRAIN_TILE_SIZE;
+}
+
+static size_t terrain_cooked_sample_size(int32_t storage)
+{
+  return storage == GAME_TERRAIN_STORAGE_UINT16 ? sizeof(uint16_t) : sizeof(float);
+}
+
+// section offsets from the sizes in the header, the same for the writer and the check
+static void terrain_cooked_layout(game_terrain_cooked_header_t *header)
+{
+  game_terrain_mesh_t shape = {0};
+  terrain_mesh_layout(&shape, header->width, header->height);
+  uint64_t pyramid_cells = 0;
+  for (int level = 0; level < header->pyramid_levels; level++)
+  {
+    pyramid_cells += (uint64_t)header->pyramid_width[level] * header->pyramid_height[level];
+  }
+  header->heights_offset = terrain_cooked_align(sizeof(*header));
+  header->pyramid_offset = terrain_cooked_align(header->heights_offset + terrain_cooked_sample_count(header->width, header->height) *
+                                                                          terrain_cooked_sample_size(header->storage));
+  header->vertices_offset = terrain_cooked_align(header->pyramid_offset + pyramid_cells * sizeof(game_terrain_height_range_t));
+  header->normals_offset = terrain_cooked_align(header->vertices_offset + (uint64_t)shape.mesh.vertexCount * 3 * sizeof(float));
+  header->texcoords_offset = terrain_cooked_align(header->normals_offset + (uint64_t)shape.mesh.vertexCount * 3 * sizeof(float));
+  header->nodes_offset = terrain_cooked_align(header->texcoords_offset + (uint64_t)shape.mesh.vertexCount * 2 * sizeof(float));
+  header->indices_offset = terrain_cooked_align(header->nodes_offset + (uint64_t)header->node_count * sizeof(game_terrain_node_t));
+  header->file_size = header->indices_offset + (uint64_t)header->index_count * sizeof(uint32_t);
+}
+
+uint64_t terrain_cooked_hash_file(const char *path)
+{
+  game_mapped_file_t file;
+  if (!mapped_file_open(path, &file))
+  {
+    return 0;
+  }
+  mapped_file_will_need(&file, 0, file.size);
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < file.size; i++)
+  {
+    hash = (hash ^ file.data[i]) * 0x100000001b3ull;
+  }
+  mapped_file_close(&file);
+  return hash;
+}
+
+// zero padding up to offset, then the section
+static bool terrain_cooked_put(FILE *file, uint64_t *position, uint64_t offset, const void *data, size_t size)
+{
+  static const uint8_t zeros[TERRAIN_COOKED_ALIGNMENT] = {0};
+  bool is_written = true;
+  while (*position < offset)
+  {
+    size_t padding = offset - *position < sizeof(zeros) ? (size_t)(offset - *position) : sizeof(zeros);
+    is_written &= fwrite(zeros, 1, padding, file) == padding;
+    *position += padding;
+  }
+  is_written &= size == 0 || fwrite(data, size, 1, file) == 1;
+  *position += size;
+  return is_written;
+}
+
+bool terrain_cooked_write(const char *path, uint64_t source_hash, const game_terrain_map_t *terrain_map,
+                          const game_terrain_mesh_t *terrain_mesh, const uint32_t *indices, uint32_t index_count)
+{
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_STREAMED || terrain_mesh->mesh.vertices == NULL)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Only in memory maps with their vertex arrays can be cooked");
+    return false;
+  }
+  FILE *file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Failed to open %s for writing", path);
+    return false;
+  }
+  game_terrain_cooked_header_t header = {.magic = TERRAIN_COOKED_MAGIC,
+                                         .version = TERRAIN_COOKED_VERSION,
+                                         .source_hash = source_hash,
+                                         .map_hash = terrain_stream_hash(terrain_map),
+                                         .width = terrain_map->max_width,
+                                         .height = terrain_map->max_height,
+                                         .storage = terrain_map->storage,
+                                         .height_min = terrain_map->height_min,
+                                         .height_step = terrain_map->height_step,
+                                         .patch_quads = TERRAIN_PATCH_QUADS,
+                                         .pyramid_levels = terrain_map->pyramid_levels,
+                                         .node_count = terrain_mesh->node_count,
+                                         .index_count = index_count};
+  memcpy(header.pyramid_width, terrain_map->pyramid_width, sizeof(header.pyramid_width));
+  memcpy(header.pyramid_height, terrain_map->pyramid_height, sizeof(header.pyramid_height));
+  memcpy(header.patterns, terrain_mesh->patterns, sizeof(header.patterns));
+  terrain_cooked_layout(&header);
+
+  const Mesh *mesh = &terrain_mesh->mesh;
+  const void *samples = terrain_map->storage == GAME_TERRAIN_STORAGE_UINT16 ? (const void *)terrain_map->value16 : (const void *)terrain_map->value;
+  uint64_t position = 0;
+  bool is_written = terrain_cooked_put(file, &position, 0, &header, sizeof(header));
+  is_written &= terrain_cooked_put(file, &position, header.heights_offset, samples,
+                                   terrain_cooked_sample_count(header.width, header.height) * terrain_cooked_sample_size(header.storage));
+  uint64_t pyramid_position = header.pyramid_offset;
+  for (int level = 0; level < terrain_map->pyramid_levels; level++)
+  {
+    size_t size = (size_t)terrain_map->pyramid_width[level] * terrain_map->pyramid_height[level] * sizeof(game_terrain_height_range_t);
+    is_written &= terrain_cooked_put(file, &position, pyramid_position, terrain_map->pyramid[level], size);
+    pyramid_position += size;
+  }
+  is_written &= terrain_cooked_put(file, &position, header.vertices_offset, mesh->vertices, (size_t)mesh->vertexCount * 3 * sizeof(float));
+  is_written &= terrain_cooked_put(file, &position, header.normals_offset, mesh->normals, (size_t)mesh->vertexCount * 3 * sizeof(float));
+  is_written &= terrain_cooked_put(file, &position, header.texcoords_offset, mesh->texcoords, (size_t)mesh->vertexCount * 2 * sizeof(float));
+  is_written &= terrain_cooked_put(file, &position, header.nodes_offset, terrain_mesh->nodes,
+                                   (size_t)terrain_mesh->node_count * sizeof(*terrain_mesh->nodes));
+  is_written &= terrain_cooked_put(file, &position, header.indices_offset, indices, (size_t)index_count * sizeof(*indices));
+  is_written &= fclose(file) == 0;
+  if (!is_written)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Failed to write %s", path);
+    remove(path);
+  }
+  return is_written;
+}
+
+// checks the header against the layout its sizes imply and against the file size
+static bool terrain_cooked_check_header(const game_terrain_cooked_header_t *header, size_t file_size, const char *path)
+{
+  if (file_size < sizeof(*header) || header->magic != TERRAIN_COOKED_MAGIC)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s is not a cooked terrain", path);
+    return false;
+  }
+  if (header->version != TERRAIN_COOKED_VERSION || header->patch_quads != TERRAIN_PATCH_QUADS)
+  {
+    TraceLog(LOG_INFO, "TERRAIN: %s was cooked by another version", path);
+    return false;
+  }
+  // the size cap keeps every count below in range, a single top pyramid cell covers it
+  int max_size = (1 << (TERRAIN_PYRAMID_MAX_LEVELS - 1)) + 1;
+  bool is_valid = header->width >= 2 && header->height >= 2 && header->width <= max_size && header->height <= max_size &&
+                  (header->storage == GAME_TERRAIN_STORAGE_FLOAT32 || header->storage == GAME_TERRAIN_STORAGE_UINT16) &&
+                  header->pyramid_levels >= 1 && header->pyramid_levels <= TERRAIN_PYRAMID_MAX_LEVELS;
+  // the pyramid halves from one cell per quad the way terrain_build_pyramid does
+  for (int level = 0; is_valid && level < header->pyramid_levels; level++)
+  {
+    int width = level == 0 ? header->width - 1 : (header->pyramid_width[level - 1] + 1) / 2;
+    int height = level == 0 ? header->height - 1 : (header->pyramid_height[level - 1] + 1) / 2;
+    is_valid = header->pyramid_width[level] == width && header->pyramid_height[level] == height;
+  }
+  game_terrain_mesh_t shape = {0};
+  if (is_valid)
+  {
+    terrain_mesh_layout(&shape, header->width, header->height);
+    is_valid = header->node_count == shape.node_count;
+  }
+  for (int level = 0; is_valid && level < shape.level_count; level++)
+  {
+    for (int mask = 0; mask < TERRAIN_STITCH_MASKS; mask++)
+    {
+      const game_draw_range_t *pattern = &header->patterns[level][mask];
+      is_valid &= (uint64_t)pattern->first + pattern->count <= header->index_count;
+    }
+  }
+  if (is_valid)
+  {
+    game_terrain_cooked_header_t expected = *header;
+    terrain_cooked_layout(&expected);
+    is_valid = header->heights_offset == expected.heights_offset && header->pyramid_offset == expected.pyramid_offset &&
+               header->vertices_offset == expected.vertices_offset && header->normals_offset == expected.normals_offset &&
+               header->texcoords_offset == expected.texcoords_offset && header->nodes_offset == expected.nodes_offset &&
+               header->indices_offset == expected.indices_offset && header->file_size == expected.file_size &&
+               header->file_size == file_size;
+  }
+  if (!is_valid)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s is truncated or malformed", path);
+  }
+  return is_valid;
+}
+
+bool terrain_cooked_load(const char *path, uint64_t source_hash, game_terrain_storage storage, game_terrain_map_t *terrain_map,
+                         game_terrain_mesh_t *terrain_mesh, uint64_t *map_hash)
+{
+  game_mapped_file_t file;
+  if (!mapped_file_open(path, &file))
+  {
+    return false;
+  }
+  game_terrain_cooked_header_t header = {0};
+  memcpy(&header, file.data, file.size < sizeof(header) ? file.size : sizeof(header));
+  if (!terrain_cooked_check_header(&header, file.size, path))
+  {
+    mapped_file_close(&file);
+    return false;
+  }
+  if (header.source_hash != source_hash || header.storage != (int32_t)storage)
+  {
+    TraceLog(LOG_INFO, "TERRAIN: %s was cooked from another source", path);
+    mapped_file_close(&file);
+    return false;
+  }
+  // everything past the header is read exactly once, front to back
+  mapped_file_will_need(&file, 0, file.size);
+
+  game_terrain_map_t map;
+  if (!terrain_map_init(&map, header.width, header.height, storage, header.height_min, header.height_min))
+  {
+    mapped_file_close(&file);
+    return false;
+  }
+  map.height_step = header.height_step;
+  memcpy(storage == GAME_TERRAIN_STORAGE_UINT16 ? (void *)map.value16 : (void *)map.value, file.data + header.heights_offset,
+         terrain_cooked_sample_count(header.width, header.height) * terrain_cooked_sample_size(storage));
+  const game_terrain_height_range_t *cells = (const game_terrain_height_range_t *)(file.data + header.pyramid_offset);
+  map.pyramid_levels = header.pyramid_levels;
+  for (int level = 0; level < header.pyramid_levels; level++)
+  {
+    size_t cell_count = (size_t)header.pyramid_width[level] * header.pyramid_height[level];
+    map.pyramid_width[level] = header.pyramid_width[level];
+    map.pyramid_height[level] = header.pyramid_height[level];
+    map.pyramid[level] = RL_MALLOC(cell_count * sizeof(*cells));
+    memcpy(map.pyramid[level], cells, cell_count * sizeof(*cells));
+    cells += cell_count;
+  }
+
+  game_terrain_mesh_t mesh = {0};
+  terrain_mesh_layout(&mesh, header.width, header.height);
+  mesh.max_pixel_error = TERRAIN_LOD_PIXEL_ERROR;
+  memcpy(mesh.patterns, header.patterns, sizeof(mesh.patterns));
+  mesh.nodes = RL_MALLOC(mesh.node_count * sizeof(*mesh.nodes));
+  memcpy(mesh.nodes, file.data + header.nodes_offset, mesh.node_count * sizeof(*mesh.nodes));
+  // UploadMesh only reads the arrays, the driver copies them straight out of the page cache
+  mesh.mesh.vertices = (float *)(file.data + header.vertices_offset);
+  mesh.mesh.normals = (float *)(file.data + header.normals_offset);
+  mesh.mesh.texcoords = (float *)(file.data + header.texcoords_offset);
+  terrain_upload_mesh(&mesh, (const uint32_t *)(file.data + header.indices_offset), (int)header.index_count, false);
+  mapped_file_close(&file);
+
+  *terrain_map = map;
+  *terrain_mesh = mesh;
+  if (map_hash != NULL)
+  {
+    *map_hash = header.map_hash;
+  }
+  return true;
+}
+
+bool terrain_cooked_load_or_cook(const char *cooked_path, const char *image_path, game_terrain_storage storage,
+                                 game_terrain_map_t *terrain_map, game_terrain_mesh_t *terrain_mesh, uint64_t *map_hash)
+{
+  uint64_t source_hash = terrain_cooked_hash_file(image_path);
+  if (source_hash != 0 && terrain_cooked_load(cooked_path, source_hash, storage, terrain_map, terrain_mesh, map_hash))
+  {
+    return true;
+  }
+
+  if (!terrain_load_heightmap(image_path, terrain_map, storage))
+  {
+    return false;
+  }
+  TraceLog(LOG_INFO, "TERRAIN: Cooking %s into %s", image_path, cooked_path);
+  *terrain_mesh = (game_terrain_mesh_t){0};
+  uint32_t *indices = terrain_build_mesh(terrain_mesh, terrain_map);
+  terrain_cooked_write(cooked_path, source_hash, terrain_map, terrain_mesh, indices, (uint32_t)arrlen(indices));
+  terrain_upload_mesh(terrain_mesh, indices, (int)arrlen(indices), true);
+  arrfree(indices);
+  if (map_hash != NULL)
+  {
+    *map_hash = terrain_stream_hash(terrain_map);
+  }
+  return true;
+}
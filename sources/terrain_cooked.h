@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "raylib.h"
+
+#include "models.h"
+#include "terrain.h"
+
+// cooked file layout: the header, then TERRAIN_COOKED_ALIGNMENT aligned sections in this order: the tiled height
+// samples as terrain_map holds them, every pyramid level, vertices, normals, texcoords, nodes and the 32 bit pattern
+// indices. everything is written in the layout the runtime uses, so loading is copies and uploads straight out of the
+// mapping. bump the version whenever terrain.c changes how any of it is derived
+#define TERRAIN_COOKED_MAGIC 0x4B4F4354u // "TCOK"
+#define TERRAIN_COOKED_VERSION 1
+#define TERRAIN_COOKED_ALIGNMENT 64
+
+typedef struct game_terrain_cooked_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash; // terrain_cooked_hash_file of the height image the file was cooked from
+  uint64_t map_hash;    // terrain_stream_hash of the cooked map, saves hashing every sample again
+  int32_t width;        // samples along x
+  int32_t height;       // samples along z
+  int32_t storage;      // GAME_TERRAIN_STORAGE_FLOAT32 or GAME_TERRAIN_STORAGE_UINT16
+  float height_min;
+  float height_step;
+  int32_t patch_quads; // TERRAIN_PATCH_QUADS the mesh was cooked with
+  int32_t pyramid_levels;
+  int32_t pyramid_width[TERRAIN_PYRAMID_MAX_LEVELS];
+  int32_t pyramid_height[TERRAIN_PYRAMID_MAX_LEVELS];
+  int32_t node_count;
+  uint32_t index_count;
+  game_draw_range_t patterns[TERRAIN_LOD_LEVELS][TERRAIN_STITCH_MASKS];
+  uint32_t reserved;
+  uint64_t heights_offset;
+  uint64_t pyramid_offset;
+  uint64_t vertices_offset;
+  uint64_t normals_offset;
+  uint64_t texcoords_offset;
+  uint64_t nodes_offset;
+  uint64_t indices_offset;
+  uint64_t file_size;
+} game_terrain_cooked_header_t;
+
+// FNV-1a over the bytes of the file at path, 0 when it can not be read
+uint64_t terrain_cooked_hash_file(const char *path);
+
+// writes terrain_map with its pyramid and the cpu side of a mesh built by terrain_build_mesh, false when the file could
+// not be written
+bool terrain_cooked_write(const char *path, uint64_t source_hash, const game_terrain_map_t *terrain_map,
+                          const game_terrain_mesh_t *terrain_mesh, const uint32_t *indices, uint32_t index_count);
+
+// maps the cooked file, copies the heights and pyramid into terrain_map and uploads the mesh straight from the mapping.
+// fails without touching either when the file is missing, malformed, cooked from another source or for another
+// storage. map_hash may be NULL
+bool terrain_cooked_load(const char *path, uint64_t source_hash, game_terrain_storage storage, game_terrain_map_t *terrain_map,
+                         game_terrain_mesh_t *terrain_mesh, uint64_t *map_hash);
+
+// terrain_cooked_load of cooked_path when it was cooked from the current heightmap at image_path, otherwise loads it
+// with terrain_load_heightmap, builds the mesh the slow way and cooks both for the next start
+bool terrain_cooked_load_or_cook(const char *cooked_path, const char *image_path, game_terrain_storage storage,
+                                 game_terrain_map_t *terrain_map, game_terrain_mesh_t *terrain_mesh, uint64_t *map_hash);
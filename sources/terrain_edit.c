@@ -0,0 +1,118 @@
+#include "terrain_edit.h"
+
+#include <math.h>
+#include "stb_ds.h"
+
+typedef struct game_terrain_edit_t
+{
+  Vector3 center; // terrain space
+  Vector3 min;    // terrain space
+  Vector3 max;
+  float radius;
+  float height;
+  float amount; // depth, strength or margin
+} game_terrain_edit_t;
+
+// new height of sample (x, z), terrain space
+typedef float (*game_terrain_edit_fn)(const game_terrain_edit_t *edit, float x, float z, float height);
+
+static float terrain_edit_smoothstep(float edge0, float edge1, float value)
+{
+  float t = (value - edge0) / (edge1 - edge0);
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  return t * t * (3.0f - 2.0f * t);
+}
+
+// runs fn over every sample between min and max (terrain space, clamped to the map) and records the rect
+static game_terrain_rect_t terrain_edit_apply(game_terrain_map_t *terrain_map, Vector3 min, Vector3 max, game_terrain_edit_fn fn,
+                                              const game_terrain_edit_t *edit)
+{
+  game_terrain_rect_t rect = {(int)ceilf(min.x), (int)ceilf(min.z), (int)floorf(max.x), (int)floorf(max.z)};
+  rect.x0 = rect.x0 > 0 ? rect.x0 : 0;
+  rect.z0 = rect.z0 > 0 ? rect.z0 : 0;
+  rect.x1 = rect.x1 < terrain_map->max_width - 1 ? rect.x1 : terrain_map->max_width - 1;
+  rect.z1 = rect.z1 < terrain_map->max_height - 1 ? rect.z1 : terrain_map->max_height - 1;
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_STREAMED || rect.x0 > rect.x1 || rect.z0 > rect.z1)
+  {
+    return (game_terrain_rect_t){0, 0, -1, -1};
+  }
+  for (int z = rect.z0; z <= rect.z1; z++)
+  {
+    for (int x = rect.x0; x <= rect.x1; x++)
+    {
+      float height = terrain_get_height(terrain_map, x, z);
+      float edited = fn(edit, (float)x, (float)z, height);
+      if (edited != height)
+      {
+        terrain_set_height(terrain_map, x, z, edited);
+      }
+    }
+  }
+  terrain_update_pyramid(terrain_map, rect);
+  arrput(terrain_map->dirty_rects, rect);
+  return rect;
+}
+
+static float terrain_edit_crater_height(const game_terrain_edit_t *edit, float x, float z, float height)
+{
+  float dx = x - edit->center.x, dz = z - edit->center.z;
+  float t = (dx * dx + dz * dz) / (edit->radius * edit->radius);
+  if (t >= 1.0f)
+  {
+    return height;
+  }
+  // (1 - t)^2 of the squared distance has no slope at the rim, so the bowl meets the terrain without a crease
+  return height - edit->amount * (1.0f - t) * (1.0f - t);
+}
+
+game_terrain_rect_t terrain_edit_crater(game_terrain_map_t *terrain_map, Vector3 world_center, float radius, float depth)
+{
+  if (radius <= 0.0f)
+  {
+    return (game_terrain_rect_t){0, 0, -1, -1};
+  }
+  game_terrain_edit_t edit = {.center = terrain_convert_from_world_pos(world_center, terrain_map), .radius = radius, .amount = depth};
+  Vector3 min = {edit.center.x - radius, 0.0f, edit.center.z - radius};
+  Vector3 max = {edit.center.x + radius, 0.0f, edit.center.z + radius};
+  return terrain_edit_apply(terrain_map, min, max, terrain_edit_crater_height, &edit);
+}
+
+static float terrain_edit_flatten_height(const game_terrain_edit_t *edit, float x, float z, float height)
+{
+  float distance = sqrtf((x - edit->center.x) * (x - edit->center.x) + (z - edit->center.z) * (z - edit->center.z));
+  float weight = 1.0f - terrain_edit_smoothstep(0.5f * edit->radius, edit->radius, distance);
+  return height + (edit->height - height) * weight * edit->amount;
+}
+
+game_terrain_rect_t terrain_edit_flatten(game_terrain_map_t *terrain_map, Vector3 world_center, float radius, float height, float strength)
+{
+  if (radius <= 0.0f)
+  {
+    return (game_terrain_rect_t){0, 0, -1, -1};
+  }
+  game_terrain_edit_t edit = {
+      .center = terrain_convert_from_world_pos(world_center, terrain_map), .radius = radius, .height = height, .amount = strength};
+  Vector3 min = {edit.center.x - radius, 0.0f, edit.center.z - radius};
+  Vector3 max = {edit.center.x + radius, 0.0f, edit.center.z + radius};
+  return terrain_edit_apply(terrain_map, min, max, terrain_edit_flatten_height, &edit);
+}
+
+static float terrain_edit_pad_height(const game_terrain_edit_t *edit, float x, float z, float height)
+{
+  float dx = fmaxf(fmaxf(edit->min.x - x, x - edit->max.x), 0.0f);
+  float dz = fmaxf(fmaxf(edit->min.z - z, z - edit->max.z), 0.0f);
+  float distance = sqrtf(dx * dx + dz * dz);
+  float weight = edit->amount > 0.0f ? 1.0f - terrain_edit_smoothstep(0.0f, edit->amount, distance) : (distance > 0.0f ? 0.0f : 1.0f);
+  return height + (edit->height - height) * weight;
+}
+
+game_terrain_rect_t terrain_edit_pad(game_terrain_map_t *terrain_map, Vector3 world_min, Vector3 world_max, float height, float margin)
+{
+  game_terrain_edit_t edit = {.min = terrain_convert_from_world_pos(world_min, terrain_map),
+                              .max = terrain_convert_from_world_pos(world_max, terrain_map),
+                              .height = height,
+                              .amount = margin};
+  Vector3 min = {edit.min.x - margin, 0.0f, edit.min.z - margin};
+  Vector3 max = {edit.max.x + margin, 0.0f, edit.max.z + margin};
+  return terrain_edit_apply(terrain_map, min, max, terrain_edit_pad_height, &edit);
+}
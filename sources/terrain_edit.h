@@ -0,0 +1,20 @@
+#pragma once
+
+#include "raylib.h"
+
+#include "terrain.h"
+
+// edits change the samples of an in memory map right away, refresh the pyramid under them and queue the rect they
+// touched in dirty_rects for terrain_update_mesh. they return that rect, empty when nothing was inside the map.
+// streamed maps are read only and ignore them. sizes and heights are in world units
+
+// lowers a bowl depth deep at world_center that eases out to nothing at radius
+game_terrain_rect_t terrain_edit_crater(game_terrain_map_t *terrain_map, Vector3 world_center, float radius, float depth);
+
+// moves the heights within radius of world_center towards height by strength (0 to 1), fully inside half the radius
+// and fading out past it
+game_terrain_rect_t terrain_edit_flatten(game_terrain_map_t *terrain_map, Vector3 world_center, float radius, float height, float strength);
+
+// levels the rectangle between world_min and world_max to height and blends it back into the terrain over margin
+// around it, for build pads. y of the corners is ignored
+game_terrain_rect_t terrain_edit_pad(game_terrain_map_t *terrain_map, Vector3 world_min, Vector3 world_max, float height, float margin);
@@ -0,0 +1,365 @@
+#include "terrain_heightmap.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mapped_file.h"
+
+static uint32_t terrain_heightmap_be32(const uint8_t *bytes)
+{
+  return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+static float terrain_heightmap_le_float(const uint8_t *bytes)
+{
+  uint32_t bits = (uint32_t)bytes[3] << 24 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[1] << 8 | bytes[0];
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// integer sample (x, z) of a heightmap whose brightest value is max_value
+static void terrain_heightmap_put(game_terrain_map_t *terrain_map, int x, int z, uint32_t value, uint32_t max_value)
+{
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_UINT16 && max_value == UINT16_MAX)
+  {
+    terrain_map->value16[terrain_sample_index(terrain_map, x, z)] = (uint16_t)value;
+    return;
+  }
+  terrain_set_height(terrain_map, x, z, (float)value * (TERRAIN_HEIGHT_RANGE / (float)max_value));
+}
+
+// size of a 16 bit greyscale, non interlaced png from its IHDR chunk, false for any other png or file
+static bool terrain_heightmap_png16_size(const game_mapped_file_t *file, int *width, int *height)
+{
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  // signature, then IHDR always comes first: length, type, width, height, depth, colour type, compression, filter,
+  // interlace
+  if (file->size < 33 || memcmp(file->data, signature, sizeof(signature)) != 0 || memcmp(file->data + 12, "IHDR", 4) != 0)
+  {
+    return false;
+  }
+  const uint8_t *ihdr = file->data + 16;
+  *width = (int)terrain_heightmap_be32(ihdr);
+  *height = (int)terrain_heightmap_be32(ihdr + 4);
+  return *width >= 2 && *height >= 2 && ihdr[8] == 16 && ihdr[9] == 0 && ihdr[10] == 0 && ihdr[11] == 0 && ihdr[12] == 0;
+}
+
+static uint8_t terrain_heightmap_paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+  int p = a + b - c;
+  int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+}
+
+// undoes the png filter of one row in place, previous is the unfiltered row above or NULL for the first one
+static bool terrain_heightmap_unfilter(uint8_t filter, uint8_t *row, const uint8_t *previous, size_t size, size_t pixel_size)
+{
+  if (filter == 0 || filter > 4)
+  {
+    return filter == 0;
+  }
+  for (size_t i = 0; i < size; i++)
+  {
+    uint8_t left = i >= pixel_size ? row[i - pixel_size] : 0;
+    uint8_t up = previous != NULL ? previous[i] : 0;
+    uint8_t up_left = i >= pixel_size && previous != NULL ? previous[i - pixel_size] : 0;
+    switch (filter)
+    {
+    case 1:
+      row[i] += left;
+      break;
+    case 2:
+      row[i] += up;
+      break;
+    case 3:
+      row[i] += (uint8_t)((left + up) / 2);
+      break;
+    default:
+      row[i] += terrain_heightmap_paeth(left, up, up_left);
+      break;
+    }
+  }
+  return true;
+}
+
+static bool terrain_heightmap_read_png16(const game_mapped_file_t *file, const char *path, game_terrain_map_t *terrain_map,
+                                         game_terrain_storage storage)
+{
+  int width, height;
+  if (!terrain_heightmap_png16_size(file, &width, &height))
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s is not a 16 bit greyscale png", path);
+    return false;
+  }
+  // DecompressData would allocate its whole buffer only to hand back a truncated image
+  size_t row_size = (size_t)width * 2;
+  if ((row_size + 1) * height > TERRAIN_HEIGHTMAP_PNG16_MAX_INFLATED)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s is %dx%d, more than the %d MiB raylib inflates a png to. Convert it to pgm or r16", path, width,
+             height, TERRAIN_HEIGHTMAP_PNG16_MAX_INFLATED / (1024 * 1024));
+    return false;
+  }
+  // the image data is one zlib stream split over the IDAT chunks
+  size_t compressed_size = 0;
+  for (size_t offset = 8; offset + 12 <= file->size;)
+  {
+    size_t length = terrain_heightmap_be32(file->data + offset);
+    if (length > file->size - offset - 12)
+    {
+      break;
+    }
+    compressed_size += memcmp(file->data + offset + 4, "IDAT", 4) == 0 ? length : 0;
+    offset += length + 12;
+  }
+  uint8_t *compressed = RL_MALLOC(compressed_size > 0 ? compressed_size : 1);
+  size_t position = 0;
+  for (size_t offset = 8; offset + 12 <= file->size && position < compressed_size;)
+  {
+    size_t length = terrain_heightmap_be32(file->data + offset);
+    if (length > file->size - offset - 12)
+    {
+      break;
+    }
+    if (memcmp(file->data + offset + 4, "IDAT", 4) == 0)
+    {
+      memcpy(compressed + position, file->data + offset + 8, length);
+      position += length;
+    }
+    offset += length + 12;
+  }
+  // DecompressData inflates raw deflate, so the two byte zlib header goes. png never sets a preset dictionary
+  int pixels_size = 0;
+  uint8_t *pixels = NULL;
+  if (compressed_size > 2 && (compressed[0] & 0x0f) == 8 && (compressed[0] * 256 + compressed[1]) % 31 == 0 && !(compressed[1] & 0x20))
+  {
+    pixels = DecompressData(compressed + 2, (int)(compressed_size - 2), &pixels_size);
+  }
+  RL_FREE(compressed);
+  if (pixels == NULL || pixels_size < 0 || (size_t)pixels_size < (row_size + 1) * height)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Failed to inflate %s", path);
+    MemFree(pixels);
+    return false;
+  }
+
+  bool is_loaded = terrain_map_init(terrain_map, width, height, storage, 0.0f, TERRAIN_HEIGHT_RANGE);
+  const uint8_t *previous = NULL;
+  for (int z = 0; is_loaded && z < height; z++)
+  {
+    // every row starts with its filter byte
+    uint8_t *row = pixels + (row_size + 1) * z;
+    is_loaded = terrain_heightmap_unfilter(row[0], row + 1, previous, row_size, 2);
+    for (int x = 0; is_loaded && x < width; x++)
+    {
+      terrain_heightmap_put(terrain_map, x, z, (uint32_t)row[1 + x * 2] << 8 | row[2 + x * 2], UINT16_MAX);
+    }
+    previous = row + 1;
+  }
+  MemFree(pixels);
+  if (!is_loaded && (terrain_map->value != NULL || terrain_map->value16 != NULL))
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s has an unknown row filter", path);
+    terrain_map_unload(terrain_map);
+  }
+  return is_loaded;
+}
+
+// next decimal number of a pgm header, skipping whitespace and comments
+static bool terrain_heightmap_pgm_number(const game_mapped_file_t *file, size_t *offset, int *value)
+{
+  while (*offset < file->size && (strchr(" \t\r\n", file->data[*offset]) != NULL || file->data[*offset] == '#'))
+  {
+    if (file->data[*offset] == '#')
+    {
+      while (*offset < file->size && file->data[*offset] != '\n')
+      {
+        (*offset)++;
+      }
+      continue;
+    }
+    (*offset)++;
+  }
+  int64_t number = 0;
+  size_t first = *offset;
+  while (*offset < file->size && file->data[*offset] >= '0' && file->data[*offset] <= '9' && number <= INT32_MAX)
+  {
+    number = number * 10 + (file->data[*offset] - '0');
+    (*offset)++;
+  }
+  *value = (int)number;
+  return *offset > first && number <= INT32_MAX;
+}
+
+static bool terrain_heightmap_read_pgm(const game_mapped_file_t *file, const char *path, game_terrain_map_t *terrain_map,
+                                       game_terrain_storage storage)
+{
+  int width = 0, height = 0, max_value = 0;
+  size_t offset = 2;
+  bool is_valid = file->size > 2 && file->data[0] == 'P' && file->data[1] == '5' &&
+                  terrain_heightmap_pgm_number(file, &offset, &width) && terrain_heightmap_pgm_number(file, &offset, &height) &&
+                  terrain_heightmap_pgm_number(file, &offset, &max_value) && width >= 2 && height >= 2 && max_value >= 1 &&
+                  max_value <= UINT16_MAX;
+  // a single whitespace character ends the header, samples wider than a byte are big endian
+  size_t sample_size = max_value < 256 ? 1 : 2;
+  offset++;
+  if (!is_valid || offset > file->size || (file->size - offset) / sample_size / width < (size_t)height)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s is not a binary pgm or is truncated", path);
+    return false;
+  }
+  if (!terrain_map_init(terrain_map, width, height, storage, 0.0f, TERRAIN_HEIGHT_RANGE))
+  {
+    return false;
+  }
+  for (int z = 0; z < height; z++)
+  {
+    const uint8_t *row = file->data + offset + (size_t)z * width * sample_size;
+    for (int x = 0; x < width; x++)
+    {
+      uint32_t value = sample_size == 1 ? row[x] : (uint32_t)row[x * 2] << 8 | row[x * 2 + 1];
+      terrain_heightmap_put(terrain_map, x, z, value < (uint32_t)max_value ? value : (uint32_t)max_value, (uint32_t)max_value);
+    }
+  }
+  return true;
+}
+
+static bool terrain_heightmap_read_raw(const game_mapped_file_t *file, const char *path, int width, int height,
+                                       game_terrain_heightmap_format format, game_terrain_map_t *terrain_map, game_terrain_storage storage)
+{
+  size_t sample_size = format == GAME_TERRAIN_HEIGHTMAP_RAW32 ? sizeof(float) : sizeof(uint16_t);
+  if ((format != GAME_TERRAIN_HEIGHTMAP_RAW16 && format != GAME_TERRAIN_HEIGHTMAP_RAW32) || width < 2 || height < 2 ||
+      file->size / sample_size / width != (size_t)height || file->size % (sample_size * width) != 0)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s does not hold %dx%d raw samples", path, width, height);
+    return false;
+  }
+  size_t sample_count = (size_t)width * height;
+  float height_min = 0.0f, height_max = TERRAIN_HEIGHT_RANGE;
+  if (format == GAME_TERRAIN_HEIGHTMAP_RAW32)
+  {
+    // uint16 storage spreads its steps over the range the file actually uses
+    height_min = INFINITY;
+    height_max = -INFINITY;
+    for (size_t i = 0; i < sample_count; i++)
+    {
+      float value = terrain_heightmap_le_float(file->data + i * sizeof(float));
+      height_min = fminf(height_min, value);
+      height_max = fmaxf(height_max, value);
+    }
+    if (!isfinite(height_min) || !isfinite(height_max))
+    {
+      TraceLog(LOG_WARNING, "TERRAIN: %s holds samples that are not finite", path);
+      return false;
+    }
+  }
+  if (!terrain_map_init(terrain_map, width, height, storage, height_min, height_max))
+  {
+    return false;
+  }
+  for (int z = 0; z < height; z++)
+  {
+    const uint8_t *row = file->data + (size_t)z * width * sample_size;
+    for (int x = 0; x < width; x++)
+    {
+      if (format == GAME_TERRAIN_HEIGHTMAP_RAW32)
+      {
+        terrain_set_height(terrain_map, x, z, terrain_heightmap_le_float(row + x * sizeof(float)));
+      }
+      else
+      {
+        terrain_heightmap_put(terrain_map, x, z, (uint32_t)row[x * 2 + 1] << 8 | row[x * 2], UINT16_MAX);
+      }
+    }
+  }
+  return true;
+}
+
+game_terrain_heightmap_format terrain_heightmap_format(const char *path)
+{
+  if (IsFileExtension(path, ".pgm"))
+  {
+    return GAME_TERRAIN_HEIGHTMAP_PGM;
+  }
+  if (IsFileExtension(path, ".r16;.raw"))
+  {
+    return GAME_TERRAIN_HEIGHTMAP_RAW16;
+  }
+  if (IsFileExtension(path, ".r32"))
+  {
+    return GAME_TERRAIN_HEIGHTMAP_RAW32;
+  }
+  game_mapped_file_t file;
+  if (IsFileExtension(path, ".png") && mapped_file_open(path, &file))
+  {
+    int width, height;
+    bool is_png16 = terrain_heightmap_png16_size(&file, &width, &height);
+    mapped_file_close(&file);
+    return is_png16 ? GAME_TERRAIN_HEIGHTMAP_PNG16 : GAME_TERRAIN_HEIGHTMAP_IMAGE;
+  }
+  return GAME_TERRAIN_HEIGHTMAP_IMAGE;
+}
+
+bool terrain_load_heightmap(const char *path, game_terrain_map_t *terrain_map, game_terrain_storage storage)
+{
+  game_terrain_heightmap_format format = terrain_heightmap_format(path);
+  if (format == GAME_TERRAIN_HEIGHTMAP_IMAGE)
+  {
+    Image height_image = LoadImage(path);
+    if (height_image.data == NULL)
+    {
+      return false;
+    }
+    bool is_loaded = terrain_load_heights(height_image, terrain_map, storage);
+    UnloadImage(height_image);
+    return is_loaded;
+  }
+
+  game_mapped_file_t file;
+  if (!mapped_file_open(path, &file))
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Failed to open %s", path);
+    return false;
+  }
+  bool is_loaded = false;
+  if (format == GAME_TERRAIN_HEIGHTMAP_PNG16)
+  {
+    is_loaded = terrain_heightmap_read_png16(&file, path, terrain_map, storage);
+  }
+  else if (format == GAME_TERRAIN_HEIGHTMAP_PGM)
+  {
+    is_loaded = terrain_heightmap_read_pgm(&file, path, terrain_map, storage);
+  }
+  else
+  {
+    // raw files carry no size, only square ones can be loaded without being told
+    size_t sample_count = file.size / (format == GAME_TERRAIN_HEIGHTMAP_RAW32 ? sizeof(float) : sizeof(uint16_t));
+    int side = (int)sqrt((double)sample_count);
+    is_loaded = terrain_heightmap_read_raw(&file, path, side, side, format, terrain_map, storage);
+  }
+  mapped_file_close(&file);
+  if (is_loaded)
+  {
+    terrain_build_pyramid(terrain_map);
+  }
+  return is_loaded;
+}
+
+bool terrain_load_raw_heightmap(const char *path, int width, int height, game_terrain_heightmap_format format,
+                                game_terrain_map_t *terrain_map, game_terrain_storage storage)
+{
+  game_mapped_file_t file;
+  if (!mapped_file_open(path, &file))
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Failed to open %s", path);
+    return false;
+  }
+  bool is_loaded = terrain_heightmap_read_raw(&file, path, width, height, format, terrain_map, storage);
+  mapped_file_close(&file);
+  if (is_loaded)
+  {
+    terrain_build_pyramid(terrain_map);
+  }
+  return is_loaded;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include "raylib.h"
+
+#include "terrain.h"
+
+// heightmap loaders that read the file through a mapping and write rows straight into the map, with no Image or Color
+// array in between. integer samples span 0 to TERRAIN_HEIGHT_RANGE whatever their bit depth, so a 16 bit map of the
+// same terrain comes out at the same heights as its 8 bit version with 256 times finer steps. float samples are
+// heights in world units. uint16 storage takes 16 bit samples as they are, without rounding them twice
+
+// raylib's DecompressData inflates into a fixed 64 MiB buffer. a 16 bit png inflates to 2 * width + 1 bytes a row, so
+// the largest square one that fits is 5792x5792. larger maps have to come as pgm or raw files, which are read in place
+#define TERRAIN_HEIGHTMAP_PNG16_MAX_INFLATED (64 * 1024 * 1024)
+
+typedef enum game_terrain_heightmap_format
+{
+  GAME_TERRAIN_HEIGHTMAP_IMAGE = 0, // anything LoadImage reads, averaged to 8 bits by terrain_load_heights
+  GAME_TERRAIN_HEIGHTMAP_PNG16,     // 16 bit greyscale png, not interlaced, see TERRAIN_HEIGHTMAP_PNG16_MAX_INFLATED
+  GAME_TERRAIN_HEIGHTMAP_PGM,       // binary (P5) pgm, 8 or 16 bits
+  GAME_TERRAIN_HEIGHTMAP_RAW16,     // headerless little endian uint16 samples row by row, .r16 or .raw
+  GAME_TERRAIN_HEIGHTMAP_RAW32,     // headerless little endian float32 samples row by row, .r32
+} game_terrain_heightmap_format;
+
+// picks the loader from the extension, pngs only count as GAME_TERRAIN_HEIGHTMAP_PNG16 when their header says so
+game_terrain_heightmap_format terrain_heightmap_format(const char *path);
+
+// loads any heightmap terrain_heightmap_format knows, raw files have to be square. builds the pyramid
+bool terrain_load_heightmap(const char *path, game_terrain_map_t *terrain_map, game_terrain_storage storage);
+
+// loads a raw heightmap of width x height samples, GAME_TERRAIN_HEIGHTMAP_RAW16 or GAME_TERRAIN_HEIGHTMAP_RAW32
+bool terrain_load_raw_heightmap(const char *path, int width, int height, game_terrain_heightmap_format format,
+                                game_terrain_map_t *terrain_map, game_terrain_storage storage);
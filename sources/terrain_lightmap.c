@@ -0,0 +1,176 @@
+#include "terrain_lightmap.h"
+
+#include <math.h>
+#include <string.h>
+#include "jobs.h"
+
+#define TERRAIN_LIGHTMAP_ROWS_PER_JOB 8
+#define TERRAIN_LIGHTMAP_SUN_BIAS 0.05f // lifts sun rays off the surface so they do not hit the triangles they start on
+
+typedef struct game_terrain_lightmap_bake_t
+{
+  game_terrain_map_t *terrain_map;
+  Vector3 to_sun;
+  float sun_far;
+  float height_max; // highest sample of the map
+  // horizon search steps rounded to whole samples, so every step reads a single height
+  int ao_offset_x[TERRAIN_LIGHTMAP_AO_DIRECTIONS][TERRAIN_LIGHTMAP_AO_STEPS];
+  int ao_offset_z[TERRAIN_LIGHTMAP_AO_DIRECTIONS][TERRAIN_LIGHTMAP_AO_STEPS];
+  float ao_inv_distance[TERRAIN_LIGHTMAP_AO_DIRECTIONS][TERRAIN_LIGHTMAP_AO_STEPS];
+  uint8_t *texels;
+} game_terrain_lightmap_bake_t;
+
+static uint64_t terrain_lightmap_hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+uint64_t terrain_lightmap_key(uint64_t map_hash, Vector3 sun_dir)
+{
+  int32_t settings[3] = {TERRAIN_LIGHTMAP_VERSION, TERRAIN_LIGHTMAP_AO_DIRECTIONS, TERRAIN_LIGHTMAP_AO_STEPS};
+  float radius = TERRAIN_LIGHTMAP_AO_RADIUS;
+  uint64_t hash = terrain_lightmap_hash_bytes(0xcbf29ce484222325ull, &map_hash, sizeof(map_hash));
+  hash = terrain_lightmap_hash_bytes(hash, &sun_dir, sizeof(sun_dir));
+  hash = terrain_lightmap_hash_bytes(hash, settings, sizeof(settings));
+  return terrain_lightmap_hash_bytes(hash, &radius, sizeof(radius));
+}
+
+// sky visibility from the highest horizon along each direction, a sample in a pit sees little of the sky
+static float terrain_lightmap_sky(const game_terrain_lightmap_bake_t *bake, int x, int z)
+{
+  const game_terrain_map_t *terrain_map = bake->terrain_map;
+  int last_x = terrain_map->max_width - 1, last_z = terrain_map->max_height - 1;
+  float height = terrain_get_height(terrain_map, x, z);
+  float headroom = bake->height_max - height;
+  float occlusion = 0.0f;
+  for (int d = 0; d < TERRAIN_LIGHTMAP_AO_DIRECTIONS; d++)
+  {
+    float max_slope = 0.0f;
+    // steps only get further away, once even the highest sample could not raise the horizon nothing further out can
+    for (int s = 0; s < TERRAIN_LIGHTMAP_AO_STEPS && headroom * bake->ao_inv_distance[d][s] > max_slope; s++)
+    {
+      // past the edge the map continues at the height of the edge
+      int sample_x = x + bake->ao_offset_x[d][s], sample_z = z + bake->ao_offset_z[d][s];
+      sample_x = sample_x < 0 ? 0 : (sample_x > last_x ? last_x : sample_x);
+      sample_z = sample_z < 0 ? 0 : (sample_z > last_z ? last_z : sample_z);
+      max_slope = fmaxf(max_slope, (terrain_get_height(terrain_map, sample_x, sample_z) - height) * bake->ao_inv_distance[d][s]);
+    }
+    // sine of the horizon angle
+    occlusion += max_slope / sqrtf(1.0f + max_slope * max_slope);
+  }
+  return 1.0f - occlusion / TERRAIN_LIGHTMAP_AO_DIRECTIONS;
+}
+
+// every texel only depends on the map, so rows can go to any worker and the result is the same
+static void terrain_lightmap_bake_rows(void *data, uint32_t job_index, uint32_t worker_index)
+{
+  (void)worker_index;
+  game_terrain_lightmap_bake_t *bake = data;
+  game_terrain_map_t *terrain_map = bake->terrain_map;
+  int width = terrain_map->max_width;
+  int z_first = (int)job_index * TERRAIN_LIGHTMAP_ROWS_PER_JOB;
+  int z_end = z_first + TERRAIN_LIGHTMAP_ROWS_PER_JOB < terrain_map->max_height ? z_first + TERRAIN_LIGHTMAP_ROWS_PER_JOB : terrain_map->max_height;
+
+  // a row of parallel sun rays goes through the ray pyramid as one batch
+  Ray *rays = RL_MALLOC(width * sizeof(*rays));
+  game_terrain_hit_t *hits = RL_MALLOC(width * sizeof(*hits));
+  for (int z = z_first; z < z_end; z++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      Vector3 origin = {(float)x, terrain_get_height(terrain_map, x, z) + TERRAIN_LIGHTMAP_SUN_BIAS, (float)z};
+      rays[x] = (Ray){terrain_convert_to_world_pos(origin, terrain_map), bake->to_sun};
+    }
+    terrain_get_ray_batch(rays, (uint32_t)width, terrain_map, 0.0f, bake->sun_far, hits);
+    for (int x = 0; x < width; x++)
+    {
+      uint8_t *texel = &bake->texels[((size_t)z * width + x) * 2];
+      texel[0] = hits[x].hit ? 0 : 255;
+      texel[1] = (uint8_t)(terrain_lightmap_sky(bake, x, z) * 255.0f + 0.5f);
+    }
+  }
+  RL_FREE(rays);
+  RL_FREE(hits);
+}
+
+Image terrain_lightmap_bake(game_terrain_map_t *terrain_map, Vector3 sun_dir)
+{
+  float length = sqrtf(sun_dir.x * sun_dir.x + sun_dir.y * sun_dir.y + sun_dir.z * sun_dir.z);
+  game_terrain_lightmap_bake_t bake = {
+      .terrain_map = terrain_map,
+      .to_sun = (Vector3){-sun_dir.x / length, -sun_dir.y / length, -sun_dir.z / length},
+      .sun_far = 2.0f * (float)(terrain_map->max_width + terrain_map->max_height),
+      .height_max = terrain_map->pyramid_levels > 0 ? terrain_map->pyramid[terrain_map->pyramid_levels - 1][0].max : INFINITY,
+      .texels = RL_MALLOC((size_t)terrain_map->max_width * terrain_map->max_height * 2)};
+  for (int d = 0; d < TERRAIN_LIGHTMAP_AO_DIRECTIONS; d++)
+  {
+    float angle = 2.0f * PI * (d + 0.5f) / TERRAIN_LIGHTMAP_AO_DIRECTIONS;
+    for (int s = 0; s < TERRAIN_LIGHTMAP_AO_STEPS; s++)
+    {
+      float distance = powf(TERRAIN_LIGHTMAP_AO_RADIUS, (s + 1.0f) / TERRAIN_LIGHTMAP_AO_STEPS);
+      int offset_x = (int)lroundf(cosf(angle) * distance), offset_z = (int)lroundf(sinf(angle) * distance);
+      // the first steps may round onto the sample itself, push them out to its neighbour
+      if (offset_x == 0 && offset_z == 0)
+      {
+        offset_x = fabsf(cosf(angle)) >= fabsf(sinf(angle)) ? (cosf(angle) > 0.0f ? 1 : -1) : 0;
+        offset_z = offset_x == 0 ? (sinf(angle) > 0.0f ? 1 : -1) : 0;
+      }
+      bake.ao_offset_x[d][s] = offset_x;
+      bake.ao_offset_z[d][s] = offset_z;
+      bake.ao_inv_distance[d][s] = 1.0f / sqrtf((float)(offset_x * offset_x + offset_z * offset_z));
+    }
+  }
+
+  uint32_t job_count = (terrain_map->max_height + TERRAIN_LIGHTMAP_ROWS_PER_JOB - 1) / TERRAIN_LIGHTMAP_ROWS_PER_JOB;
+  jobs_parallel_for(job_count, terrain_lightmap_bake_rows, &bake);
+  return (Image){.data = bake.texels,
+                 .width = terrain_map->max_width,
+                 .height = terrain_map->max_height,
+                 .mipmaps = 1,
+                 .format = PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA};
+}
+
+Image terrain_lightmap_load(const char *path, game_terrain_map_t *terrain_map, uint64_t map_hash, Vector3 sun_dir)
+{
+  uint64_t key = terrain_lightmap_key(map_hash, sun_dir);
+  size_t texel_size = (size_t)terrain_map->max_width * terrain_map->max_height * 2;
+  game_terrain_lightmap_header_t header = {0};
+  int data_size = 0;
+  unsigned char *data = FileExists(path) ? LoadFileData(path, &data_size) : NULL;
+  if (data != NULL && (size_t)data_size == sizeof(header) + texel_size)
+  {
+    memcpy(&header, data, sizeof(header));
+  }
+  if (header.magic == TERRAIN_LIGHTMAP_MAGIC && header.version == TERRAIN_LIGHTMAP_VERSION && header.key == key &&
+      header.width == terrain_map->max_width && header.height == terrain_map->max_height)
+  {
+    Image image = {.data = RL_MALLOC(texel_size),
+                   .width = terrain_map->max_width,
+                   .height = terrain_map->max_height,
+                   .mipmaps = 1,
+                   .format = PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA};
+    memcpy(image.data, data + sizeof(header), texel_size);
+    UnloadFileData(data);
+    return image;
+  }
+  UnloadFileData(data);
+
+  TraceLog(LOG_INFO, "TERRAIN: Baking lightmap into %s", path);
+  Image image = terrain_lightmap_bake(terrain_map, sun_dir);
+  header = (game_terrain_lightmap_header_t){.magic = TERRAIN_LIGHTMAP_MAGIC,
+                                            .version = TERRAIN_LIGHTMAP_VERSION,
+                                            .width = image.width,
+                                            .height = image.height,
+                                            .key = key};
+  unsigned char *file = RL_MALLOC(sizeof(header) + texel_size);
+  memcpy(file, &header, sizeof(header));
+  memcpy(file + sizeof(header), image.data, texel_size);
+  SaveFileData(path, file, (int)(sizeof(header) + texel_size));
+  RL_FREE(file);
+  return image;
+}
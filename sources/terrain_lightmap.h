@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include "raylib.h"
+
+#include "terrain.h"
+
+// one texel per height sample, PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA: gray is sun visibility, alpha is the fraction of
+// the sky each sample sees. shaders read them as .r and .a
+#define TERRAIN_LIGHTMAP_MAGIC 0x504D4C54u // "TLMP"
+#define TERRAIN_LIGHTMAP_VERSION 1
+#define TERRAIN_LIGHTMAP_AO_DIRECTIONS 16 // horizon searches per sample
+#define TERRAIN_LIGHTMAP_AO_STEPS 12      // samples along each search, spaced further apart the further out they go
+#define TERRAIN_LIGHTMAP_AO_RADIUS 64.0f  // in quads
+
+typedef struct game_terrain_lightmap_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  uint64_t key; // terrain_lightmap_key of the inputs the texels were baked from
+} game_terrain_lightmap_header_t;
+
+// identifies a bake, map_hash comes from terrain_stream_hash. sun_dir points from the sun towards the terrain
+uint64_t terrain_lightmap_key(uint64_t map_hash, Vector3 sun_dir);
+
+// marches towards the sun and along the horizon around every sample, rows are split across the job pool
+Image terrain_lightmap_bake(game_terrain_map_t *terrain_map, Vector3 sun_dir);
+
+// the lightmap cached at path when it was baked from the same map and sun, otherwise bakes it and rewrites the cache
+Image terrain_lightmap_load(const char *path, game_terrain_map_t *terrain_map, uint64_t map_hash, Vector3 sun_dir);
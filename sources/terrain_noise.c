@@ -0,0 +1,127 @@
+#include "terrain_noise.h"
+
+#include <math.h>
+#include "jobs.h"
+
+#define TERRAIN_NOISE_SCALE 1.41421356f // gradient noise peaks at half the square root of two, this stretches it to -1 to 1
+#define TERRAIN_NOISE_RIDGE_SHARPNESS 2.0f // how strongly a low ridge mutes the finer octaves on top of it
+
+typedef struct game_terrain_noise_job_t
+{
+  game_terrain_map_t *terrain_map;
+  const game_terrain_noise_t *noise;
+} game_terrain_noise_job_t;
+
+// integer lattice hash, avalanches every input bit so neighbouring points and seeds get unrelated gradients
+static uint32_t terrain_noise_hash(int32_t x, int32_t z, uint32_t seed)
+{
+  uint32_t hash = (uint32_t)x * 0x8da6b343u ^ (uint32_t)z * 0xd8163841u ^ seed * 0xcb1ab31fu;
+  hash ^= hash >> 16;
+  hash *= 0x7feb352du;
+  hash ^= hash >> 15;
+  hash *= 0x846ca68bu;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+// dot product of the gradient picked for lattice point (x, z) with the offset (dx, dz) from it
+static float terrain_noise_corner(int32_t x, int32_t z, uint32_t seed, float dx, float dz)
+{
+  static const float gradients[8][2] = {
+      {1.0f, 0.0f},           {-1.0f, 0.0f},           {0.0f, 1.0f},           {0.0f, -1.0f},
+      {0.707107f, 0.707107f}, {-0.707107f, 0.707107f}, {0.707107f, -0.707107f}, {-0.707107f, -0.707107f}};
+  const float *gradient = gradients[terrain_noise_hash(x, z, seed) & 7];
+  return gradient[0] * dx + gradient[1] * dz;
+}
+
+static float terrain_noise_fade(float t)
+{
+  return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// gradient noise, -1 to 1 and 0 on every lattice point
+static float terrain_noise_gradient(float x, float z, uint32_t seed)
+{
+  float floor_x = floorf(x), floor_z = floorf(z);
+  int32_t ix = (int32_t)floor_x, iz = (int32_t)floor_z;
+  float fx = x - floor_x, fz = z - floor_z;
+  float d00 = terrain_noise_corner(ix, iz, seed, fx, fz);
+  float d10 = terrain_noise_corner(ix + 1, iz, seed, fx - 1.0f, fz);
+  float d01 = terrain_noise_corner(ix, iz + 1, seed, fx, fz - 1.0f);
+  float d11 = terrain_noise_corner(ix + 1, iz + 1, seed, fx - 1.0f, fz - 1.0f);
+  float u = terrain_noise_fade(fx), v = terrain_noise_fade(fz);
+  float d0 = d00 + (d10 - d00) * u;
+  float d1 = d01 + (d11 - d01) * u;
+  return (d0 + (d1 - d0) * v) * TERRAIN_NOISE_SCALE;
+}
+
+game_terrain_noise_t terrain_noise_default(game_terrain_noise_kind kind, uint32_t seed)
+{
+  return (game_terrain_noise_t){.kind = kind,
+                                .seed = seed,
+                                .octaves = 6,
+                                .feature_size = 192.0f,
+                                .lacunarity = 2.0f,
+                                .gain = 0.5f,
+                                .height = TERRAIN_HEIGHT_RANGE};
+}
+
+float terrain_noise_sample(const game_terrain_noise_t *noise, float x, float z)
+{
+  float frequency = 1.0f / noise->feature_size;
+  float amplitude = 1.0f;
+  float total = 0.0f, sum = 0.0f;
+  float weight = 1.0f;
+  for (int octave = 0; octave < noise->octaves; octave++)
+  {
+    // every octave gets its own lattice so their zeros do not line up
+    float value = terrain_noise_gradient(x * frequency, z * frequency, noise->seed + (uint32_t)octave * 0x9e3779b9u);
+    if (noise->kind == GAME_TERRAIN_NOISE_RIDGED)
+    {
+      float ridge = 1.0f - fabsf(value);
+      ridge *= ridge * weight;
+      weight = fminf(fmaxf(ridge * TERRAIN_NOISE_RIDGE_SHARPNESS, 0.0f), 1.0f);
+      value = ridge;
+    }
+    sum += value * amplitude;
+    total += amplitude;
+    frequency *= noise->lacunarity;
+    amplitude *= noise->gain;
+  }
+  float unit = total > 0.0f ? sum / total : 0.0f;
+  if (noise->kind == GAME_TERRAIN_NOISE_FBM)
+  {
+    unit = 0.5f + 0.5f * unit;
+  }
+  return fminf(fmaxf(unit, 0.0f), 1.0f) * noise->height;
+}
+
+// one row of tiles per job, so no two workers write into the same tile
+static void terrain_noise_generate_rows(void *data, uint32_t job_index, uint32_t worker_index)
+{
+  (void)worker_index;
+  game_terrain_noise_job_t *job = data;
+  game_terrain_map_t *terrain_map = job->terrain_map;
+  int z_first = (int)job_index * TERRAIN_TILE_SIZE;
+  int z_end = z_first + TERRAIN_TILE_SIZE < terrain_map->max_height ? z_first + TERRAIN_TILE_SIZE : terrain_map->max_height;
+  for (int z = z_first; z < z_end; z++)
+  {
+    for (int x = 0; x < terrain_map->max_width; x++)
+    {
+      terrain_set_height(terrain_map, x, z, terrain_noise_sample(job->noise, (float)x, (float)z));
+    }
+  }
+}
+
+bool terrain_generate_heights(game_terrain_map_t *terrain_map, int width, int height, game_terrain_storage storage,
+                              const game_terrain_noise_t *noise)
+{
+  if (width < 2 || height < 2 || !terrain_map_init(terrain_map, width, height, storage, 0.0f, noise->height))
+  {
+    return false;
+  }
+  game_terrain_noise_job_t job = {terrain_map, noise};
+  jobs_parallel_for((uint32_t)(height + TERRAIN_TILE_SIZE - 1) / TERRAIN_TILE_SIZE, terrain_noise_generate_rows, &job);
+  terrain_build_pyramid(terrain_map);
+  return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "terrain.h"
+
+// procedural heightmaps for maps of any size. every sample only depends on its coordinates and the settings, so a
+// seed gives the same map whatever the worker count and a larger map is a larger piece of the same landscape
+
+typedef enum game_terrain_noise_kind
+{
+  GAME_TERRAIN_NOISE_FBM = 0, // rolling hills, octaves of gradient noise added up
+  GAME_TERRAIN_NOISE_RIDGED,  // sharp crests and smooth valleys, folded octaves weighted by the ones before
+} game_terrain_noise_kind;
+
+typedef struct game_terrain_noise_t
+{
+  game_terrain_noise_kind kind;
+  uint32_t seed;
+  int octaves;        // layers of detail, each lacunarity times finer and gain times fainter than the last
+  float feature_size; // wavelength of the first octave in samples
+  float lacunarity;
+  float gain;
+  float height; // heights span 0 to height
+} game_terrain_noise_t;
+
+// settings that give hills of roughly the size and steepness of discmap.BMP
+game_terrain_noise_t terrain_noise_default(game_terrain_noise_kind kind, uint32_t seed);
+
+// height of the noise at sample (x, z), 0 to noise->height
+float terrain_noise_sample(const game_terrain_noise_t *noise, float x, float z);
+
+// initializes terrain_map to width x height samples of the noise, rows of tiles are split across the job pool. builds
+// the pyramid
+bool terrain_generate_heights(game_terrain_map_t *terrain_map, int width, int height, game_terrain_storage storage,
+                              const game_terrain_noise_t *noise);
@@ -0,0 +1,390 @@
+#include "terrain_stream.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "stb_ds.h"
+
+#define TERRAIN_STREAM_POLL_BATCH 64
+
+static uint64_t terrain_stream_align(uint64_t offset)
+{
+  return (offset + TERRAIN_STREAM_ALIGNMENT - 1) / TERRAIN_STREAM_ALIGNMENT * TERRAIN_STREAM_ALIGNMENT;
+}
+
+static size_t terrain_stream_sample_size(int32_t storage)
+{
+  return storage == GAME_TERRAIN_STORAGE_UINT16 ? sizeof(uint16_t) : sizeof(float);
+}
+
+// overview sample i sits at sample i * step, the last one at the map edge even when the step does not divide it
+static int terrain_stream_overview_x(const game_terrain_stream_header_t *header, int i)
+{
+  int x = i << TERRAIN_STREAM_OVERVIEW_SHIFT;
+  return x < header->width - 1 ? x : header->width - 1;
+}
+
+static int terrain_stream_overview_z(const game_terrain_stream_header_t *header, int i)
+{
+  int z = i << TERRAIN_STREAM_OVERVIEW_SHIFT;
+  return z < header->height - 1 ? z : header->height - 1;
+}
+
+static game_terrain_stream_header_t terrain_stream_make_header(const game_terrain_map_t *terrain_map)
+{
+  game_terrain_stream_header_t header = {
+      .magic = TERRAIN_STREAM_MAGIC,
+      .version = TERRAIN_STREAM_VERSION,
+      .width = terrain_map->max_width,
+      .height = terrain_map->max_height,
+      .storage = terrain_map->storage,
+      .height_min = terrain_map->height_min,
+      .height_step = terrain_map->height_step,
+      .tiles_x = (terrain_map->max_width - 1 + TERRAIN_STREAM_TILE_QUADS - 1) / TERRAIN_STREAM_TILE_QUADS,
+      .tiles_z = (terrain_map->max_height - 1 + TERRAIN_STREAM_TILE_QUADS - 1) / TERRAIN_STREAM_TILE_QUADS,
+      .overview_width = (terrain_map->max_width - 1 + TERRAIN_STREAM_OVERVIEW_STEP - 1) / TERRAIN_STREAM_OVERVIEW_STEP + 1,
+      .overview_height = (terrain_map->max_height - 1 + TERRAIN_STREAM_OVERVIEW_STEP - 1) / TERRAIN_STREAM_OVERVIEW_STEP + 1};
+  size_t tile_samples = (TERRAIN_STREAM_TILE_QUADS + 1) * (TERRAIN_STREAM_TILE_QUADS + 1);
+  header.overview_offset = sizeof(header);
+  header.ranges_offset = header.overview_offset + (uint64_t)header.overview_width * header.overview_height * sizeof(float);
+  header.tiles_offset = terrain_stream_align(header.ranges_offset + (uint64_t)(header.overview_width - 1) * (header.overview_height - 1) *
+                                                                       sizeof(game_terrain_height_range_t));
+  header.tile_stride = terrain_stream_align(tile_samples * terrain_stream_sample_size(header.storage));
+  return header;
+}
+
+uint64_t terrain_stream_hash(const game_terrain_map_t *terrain_map)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  int32_t size[2] = {terrain_map->max_width, terrain_map->max_height};
+  const uint8_t *bytes = (const uint8_t *)size;
+  for (size_t i = 0; i < sizeof(size); i++)
+  {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  for (int z = 0; z < terrain_map->max_height; z++)
+  {
+    for (int x = 0; x < terrain_map->max_width; x++)
+    {
+      float height = terrain_get_height(terrain_map, x, z);
+      bytes = (const uint8_t *)&height;
+      for (size_t i = 0; i < sizeof(height); i++)
+      {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+      }
+    }
+  }
+  return hash;
+}
+
+bool terrain_stream_write(const game_terrain_map_t *terrain_map, const char *path)
+{
+  if (terrain_map->storage == GAME_TERRAIN_STORAGE_STREAMED || terrain_map->max_width < 2 || terrain_map->max_height < 2)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Only in memory maps of at least 2x2 samples can be written as tiles");
+    return false;
+  }
+  FILE *file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Failed to open %s for writing", path);
+    return false;
+  }
+  game_terrain_stream_header_t header = terrain_stream_make_header(terrain_map);
+  header.source_hash = terrain_stream_hash(terrain_map);
+  bool is_written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  for (int oz = 0; oz < header.overview_height; oz++)
+  {
+    for (int ox = 0; ox < header.overview_width; ox++)
+    {
+      float height = terrain_get_height(terrain_map, terrain_stream_overview_x(&header, ox), terrain_stream_overview_z(&header, oz));
+      is_written &= fwrite(&height, sizeof(height), 1, file) == 1;
+    }
+  }
+  for (int oz = 0; oz < header.overview_height - 1; oz++)
+  {
+    for (int ox = 0; ox < header.overview_width - 1; ox++)
+    {
+      game_terrain_height_range_t range = {INFINITY, -INFINITY};
+      for (int z = terrain_stream_overview_z(&header, oz); z <= terrain_stream_overview_z(&header, oz + 1); z++)
+      {
+        for (int x = terrain_stream_overview_x(&header, ox); x <= terrain_stream_overview_x(&header, ox + 1); x++)
+        {
+          float height = terrain_get_height(terrain_map, x, z);
+          range.min = fminf(range.min, height);
+          range.max = fmaxf(range.max, height);
+        }
+      }
+      is_written &= fwrite(&range, sizeof(range), 1, file) == 1;
+    }
+  }
+
+  // samples past the map edge repeat the last one, uint16 maps are copied as they are so nothing is quantised twice
+  // the padding up to the first tile is shorter than a tile, the still zeroed tile buffer covers it
+  uint8_t *tile = RL_CALLOC(header.tile_stride, 1);
+  size_t padding = (size_t)(header.tiles_offset - header.ranges_offset) -
+                   (size_t)(header.overview_width - 1) * (header.overview_height - 1) * sizeof(game_terrain_height_range_t);
+  is_written &= fwrite(tile, 1, padding, file) == padding;
+  for (int tz = 0; tz < header.tiles_z; tz++)
+  {
+    for (int tx = 0; tx < header.tiles_x; tx++)
+    {
+      for (int z = 0; z <= TERRAIN_STREAM_TILE_QUADS; z++)
+      {
+        for (int x = 0; x <= TERRAIN_STREAM_TILE_QUADS; x++)
+        {
+          int sample_x = tx * TERRAIN_STREAM_TILE_QUADS + x, sample_z = tz * TERRAIN_STREAM_TILE_QUADS + z;
+          sample_x = sample_x < header.width ? sample_x : header.width - 1;
+          sample_z = sample_z < header.height ? sample_z : header.height - 1;
+          size_t sample = (size_t)z * (TERRAIN_STREAM_TILE_QUADS + 1) + x;
+          if (header.storage == GAME_TERRAIN_STORAGE_UINT16)
+          {
+            ((uint16_t *)tile)[sample] = terrain_map->value16[terrain_sample_index(terrain_map, sample_x, sample_z)];
+          }
+          else
+          {
+            ((float *)tile)[sample] = terrain_map->value[terrain_sample_index(terrain_map, sample_x, sample_z)];
+          }
+        }
+      }
+      is_written &= fwrite(tile, header.tile_stride, 1, file) == 1;
+    }
+  }
+  RL_FREE(tile);
+  is_written &= fclose(file) == 0;
+  if (!is_written)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: Failed to write %s", path);
+    remove(path);
+  }
+  return is_written;
+}
+
+// checks the header against the layout its size implies and against the file size
+static bool terrain_stream_check_header(const game_terrain_stream_t *stream, const char *path)
+{
+  const game_terrain_stream_header_t *header = &stream->header;
+  if (stream->file.size < sizeof(*header) || header->magic != TERRAIN_STREAM_MAGIC)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s is not a tile file", path);
+    return false;
+  }
+  if (header->version != TERRAIN_STREAM_VERSION)
+  {
+    TraceLog(LOG_INFO, "TERRAIN: %s has version %u, expected %u", path, header->version, TERRAIN_STREAM_VERSION);
+    return false;
+  }
+  bool is_valid = header->width >= 2 && header->height >= 2 &&
+                  (header->storage == GAME_TERRAIN_STORAGE_FLOAT32 || header->storage == GAME_TERRAIN_STORAGE_UINT16);
+  if (is_valid)
+  {
+    // everything derived from the size has to match what terrain_stream_write would have written
+    game_terrain_map_t shape = {.max_width = header->width, .max_height = header->height, .storage = header->storage};
+    game_terrain_stream_header_t expected = terrain_stream_make_header(&shape);
+    is_valid = header->tiles_x == expected.tiles_x && header->tiles_z == expected.tiles_z &&
+               header->overview_width == expected.overview_width && header->overview_height == expected.overview_height &&
+               header->overview_offset == expected.overview_offset && header->ranges_offset == expected.ranges_offset &&
+               header->tiles_offset == expected.tiles_offset && header->tile_stride == expected.tile_stride &&
+               header->tiles_offset + (uint64_t)header->tiles_x * header->tiles_z * header->tile_stride <= stream->file.size;
+  }
+  if (!is_valid)
+  {
+    TraceLog(LOG_WARNING, "TERRAIN: %s is truncated or malformed", path);
+  }
+  return is_valid;
+}
+
+// runs on the loader thread, reads every page of the tile so the first query after it turns resident does not fault
+static void terrain_stream_load_tile(void *data, void *item)
+{
+  game_terrain_stream_t *stream = data;
+  uint32_t tile = *(uint32_t *)item;
+  size_t offset = stream->header.tiles_offset + (size_t)tile * stream->header.tile_stride;
+  mapped_file_will_need(&stream->file, offset, stream->header.tile_stride);
+  volatile uint8_t sink = 0;
+  for (size_t i = 0; i < stream->header.tile_stride; i += TERRAIN_STREAM_ALIGNMENT)
+  {
+    sink ^= stream->file.data[offset + i];
+  }
+  (void)sink;
+}
+
+bool terrain_stream_open(const char *path, uint64_t source_hash, int radius, game_terrain_map_t *terrain_map)
+{
+  game_terrain_stream_t *stream = RL_CALLOC(1, sizeof(*stream));
+  if (!mapped_file_open(path, &stream->file))
+  {
+    RL_FREE(stream);
+    return false;
+  }
+  if (stream->file.size >= sizeof(stream->header))
+  {
+    memcpy(&stream->header, stream->file.data, sizeof(stream->header));
+  }
+  if (!terrain_stream_check_header(stream, path) || (source_hash != 0 && stream->header.source_hash != source_hash))
+  {
+    mapped_file_close(&stream->file);
+    RL_FREE(stream);
+    return false;
+  }
+  const game_terrain_stream_header_t *header = &stream->header;
+  size_t overview_size = (size_t)header->overview_width * header->overview_height * sizeof(float);
+  stream->overview = RL_MALLOC(overview_size);
+  memcpy(stream->overview, stream->file.data + header->overview_offset, overview_size);
+  stream->tiles = stream->file.data + header->tiles_offset;
+  stream->tile_state = RL_CALLOC((size_t)header->tiles_x * header->tiles_z, sizeof(*stream->tile_state));
+  stream->radius = radius;
+  stream->focus_x = -1;
+  stream->focus_z = -1;
+  stream->loader = jobs_queue_create(terrain_stream_load_tile, stream, sizeof(uint32_t));
+
+  *terrain_map = (game_terrain_map_t){.max_width = header->width,
+                                      .max_height = header->height,
+                                      .storage = GAME_TERRAIN_STORAGE_STREAMED,
+                                      .height_min = header->height_min,
+                                      .height_step = header->height_step,
+                                      .stream = stream};
+  terrain_build_pyramid(terrain_map);
+  return true;
+}
+
+float terrain_stream_get_height(const game_terrain_stream_t *stream, int x, int z)
+{
+  const game_terrain_stream_header_t *header = &stream->header;
+  // the last sample row belongs to the tile before it when the tile size divides the map
+  int tile_x = x / TERRAIN_STREAM_TILE_QUADS, tile_z = z / TERRAIN_STREAM_TILE_QUADS;
+  tile_x = tile_x < header->tiles_x ? tile_x : header->tiles_x - 1;
+  tile_z = tile_z < header->tiles_z ? tile_z : header->tiles_z - 1;
+  size_t tile = (size_t)tile_z * header->tiles_x + tile_x;
+  if (stream->tile_state[tile] == GAME_TERRAIN_TILE_RESIDENT)
+  {
+    const uint8_t *samples = stream->tiles + tile * header->tile_stride;
+    size_t sample = (size_t)(z - tile_z * TERRAIN_STREAM_TILE_QUADS) * (TERRAIN_STREAM_TILE_QUADS + 1) + (x - tile_x * TERRAIN_STREAM_TILE_QUADS);
+    if (header->storage == GAME_TERRAIN_STORAGE_UINT16)
+    {
+      return header->height_min + ((const uint16_t *)samples)[sample] * header->height_step;
+    }
+    return ((const float *)samples)[sample];
+  }
+
+  // stays within the cell's range from the file, so the ray pyramid still bounds it
+  int cell_x = x >> TERRAIN_STREAM_OVERVIEW_SHIFT, cell_z = z >> TERRAIN_STREAM_OVERVIEW_SHIFT;
+  cell_x = cell_x < header->overview_width - 1 ? cell_x : header->overview_width - 2;
+  cell_z = cell_z < header->overview_height - 1 ? cell_z : header->overview_height - 2;
+  int x0 = terrain_stream_overview_x(header, cell_x), x1 = terrain_stream_overview_x(header, cell_x + 1);
+  int z0 = terrain_stream_overview_z(header, cell_z), z1 = terrain_stream_overview_z(header, cell_z + 1);
+  const float *row = stream->overview + (size_t)cell_z * header->overview_width + cell_x;
+  return terrain_interpolate((float)(x - x0) / (float)(x1 - x0), (float)(z - z0) / (float)(z1 - z0), row[0], row[1],
+                             row[header->overview_width], row[header->overview_width + 1]);
+}
+
+static void terrain_stream_apply_loads(game_terrain_stream_t *stream)
+{
+  uint32_t finished[TERRAIN_STREAM_POLL_BATCH];
+  uint32_t count;
+  while ((count = jobs_queue_poll(stream->loader, finished, TERRAIN_STREAM_POLL_BATCH)) > 0)
+  {
+    for (uint32_t i = 0; i < count; i++)
+    {
+      stream->tile_state[finished[i]] = GAME_TERRAIN_TILE_RESIDENT;
+      stream->stats.loading--;
+      stream->stats.resident++;
+      stream->stats.loads++;
+    }
+  }
+}
+
+static bool terrain_stream_in_range(const game_terrain_stream_t *stream, int tile_x, int tile_z)
+{
+  return abs(tile_x - stream->focus_x) <= stream->radius && abs(tile_z - stream->focus_z) <= stream->radius;
+}
+
+void terrain_stream_update(game_terrain_map_t *terrain_map, Vector3 world_focus)
+{
+  if (terrain_map->storage != GAME_TERRAIN_STORAGE_STREAMED)
+  {
+    return;
+  }
+  game_terrain_stream_t *stream = terrain_map->stream;
+  const game_terrain_stream_header_t *header = &stream->header;
+  terrain_stream_apply_loads(stream);
+
+  Vector3 focus = terrain_convert_from_world_pos(world_focus, terrain_map);
+  int focus_x = (int)floorf(focus.x / TERRAIN_STREAM_TILE_QUADS), focus_z = (int)floorf(focus.z / TERRAIN_STREAM_TILE_QUADS);
+  focus_x = focus_x < 0 ? 0 : (focus_x >= header->tiles_x ? header->tiles_x - 1 : focus_x);
+  focus_z = focus_z < 0 ? 0 : (focus_z >= header->tiles_z ? header->tiles_z - 1 : focus_z);
+  bool is_moved = focus_x != stream->focus_x || focus_z != stream->focus_z;
+  stream->focus_x = focus_x;
+  stream->focus_z = focus_z;
+
+  // loading tiles that fell out of range finish first, the next update evicts them
+  for (ptrdiff_t i = 0; i < arrlen(stream->live_tiles);)
+  {
+    uint32_t tile = stream->live_tiles[i];
+    if (stream->tile_state[tile] != GAME_TERRAIN_TILE_RESIDENT ||
+        terrain_stream_in_range(stream, (int)(tile % header->tiles_x), (int)(tile / header->tiles_x)))
+    {
+      i++;
+      continue;
+    }
+    stream->tile_state[tile] = GAME_TERRAIN_TILE_EVICTED;
+    mapped_file_dont_need(&stream->file, header->tiles_offset + (size_t)tile * header->tile_stride, header->tile_stride);
+    arrdelswap(stream->live_tiles, i);
+    stream->stats.resident--;
+    stream->stats.evictions++;
+  }
+  if (!is_moved)
+  {
+    return;
+  }
+
+  // ring by ring so the tiles under the focus arrive first
+  for (int ring = 0; ring <= stream->radius; ring++)
+  {
+    for (int tile_z = focus_z - ring; tile_z <= focus_z + ring; tile_z++)
+    {
+      for (int tile_x = focus_x - ring; tile_x <= focus_x + ring; tile_x++)
+      {
+        bool is_on_ring = abs(tile_x - focus_x) == ring || abs(tile_z - focus_z) == ring;
+        if (!is_on_ring || tile_x < 0 || tile_z < 0 || tile_x >= header->tiles_x || tile_z >= header->tiles_z)
+        {
+          continue;
+        }
+        uint32_t tile = (uint32_t)(tile_z * header->tiles_x + tile_x);
+        if (stream->tile_state[tile] == GAME_TERRAIN_TILE_EVICTED)
+        {
+          stream->tile_state[tile] = GAME_TERRAIN_TILE_LOADING;
+          arrput(stream->live_tiles, tile);
+          stream->stats.loading++;
+          jobs_queue_push(stream->loader, &tile);
+        }
+      }
+    }
+  }
+}
+
+void terrain_stream_flush(game_terrain_map_t *terrain_map)
+{
+  if (terrain_map->storage != GAME_TERRAIN_STORAGE_STREAMED)
+  {
+    return;
+  }
+  jobs_queue_wait(terrain_map->stream->loader);
+  terrain_stream_apply_loads(terrain_map->stream);
+}
+
+void terrain_stream_close(game_terrain_stream_t *stream)
+{
+  if (stream == NULL)
+  {
+    return;
+  }
+  // the loader reads the mapping, it has to stop first
+  jobs_queue_destroy(stream->loader);
+  mapped_file_close(&stream->file);
+  RL_FREE(stream->overview);
+  RL_FREE(stream->tile_state);
+  arrfree(stream->live_tiles);
+  RL_FREE(stream);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "raylib.h"
+
+#include "jobs.h"
+#include "mapped_file.h"
+#include "terrain.h"
+
+// tile file layout: the header, an overview holding every TERRAIN_STREAM_OVERVIEW_STEP-th sample along both axes
+// (plus the last one), the height range of every overview cell, then one TERRAIN_STREAM_ALIGNMENT aligned block per
+// tile with its (TERRAIN_STREAM_TILE_QUADS + 1)^2 samples row by row. tiles repeat their shared edge samples so a
+// quad never needs two of them
+#define TERRAIN_STREAM_MAGIC 0x4C495454u // "TTIL"
+#define TERRAIN_STREAM_VERSION 1
+#define TERRAIN_STREAM_TILE_QUADS 128
+#define TERRAIN_STREAM_OVERVIEW_SHIFT 4
+#define TERRAIN_STREAM_OVERVIEW_STEP (1 << TERRAIN_STREAM_OVERVIEW_SHIFT)
+#define TERRAIN_STREAM_ALIGNMENT 4096 // tiles start on their own pages so they can be handed back one by one
+#define TERRAIN_STREAM_RADIUS 4       // default number of tiles kept resident on every side of the focus tile
+
+typedef struct game_terrain_stream_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t width;   // samples along x
+  int32_t height;  // samples along z
+  int32_t storage; // GAME_TERRAIN_STORAGE_FLOAT32 or GAME_TERRAIN_STORAGE_UINT16, how the tiles hold their samples
+  float height_min;
+  float height_step;
+  int32_t tiles_x;
+  int32_t tiles_z;
+  int32_t overview_width;
+  int32_t overview_height;
+  uint32_t reserved;
+  uint64_t source_hash; // terrain_stream_hash of the map the file was written from
+  uint64_t overview_offset;
+  uint64_t ranges_offset;
+  uint64_t tiles_offset;
+  uint64_t tile_stride;
+} game_terrain_stream_header_t;
+
+typedef enum game_terrain_tile_state
+{
+  GAME_TERRAIN_TILE_EVICTED = 0, // queries use the overview
+  GAME_TERRAIN_TILE_LOADING,     // queued on the loader thread, queries still use the overview
+  GAME_TERRAIN_TILE_RESIDENT,    // pages touched, queries read the tile
+} game_terrain_tile_state;
+
+typedef struct game_terrain_stream_stats_t
+{
+  uint32_t resident;
+  uint32_t loading;
+  uint32_t loads;     // since the stream was opened
+  uint32_t evictions; // since the stream was opened
+} game_terrain_stream_stats_t;
+
+struct game_terrain_stream_t
+{
+  game_mapped_file_t file;
+  game_terrain_stream_header_t header;
+  const uint8_t *tiles;      // first tile inside the mapping
+  float *overview;           // copied out of the mapping so it never faults
+  uint8_t *tile_state;       // game_terrain_tile_state per tile, only changed by terrain_stream_update
+  uint32_t *live_tiles;      // stb_ds array of the tiles that are loading or resident
+  game_job_queue_t *loader;  // touches the pages of requested tiles off the main thread
+  int radius;
+  int focus_x;               // focus tile, -1 before the first update
+  int focus_z;
+  game_terrain_stream_stats_t stats;
+};
+
+// FNV-1a over the size and every height, identifies the map a tile file was written from
+uint64_t terrain_stream_hash(const game_terrain_map_t *terrain_map);
+
+// writes terrain_map (float32 or uint16 storage) as a tile file, false when the file could not be written
+bool terrain_stream_write(const game_terrain_map_t *terrain_map, const char *path);
+
+// maps the tile file and turns terrain_map into a streamed map with nothing resident yet. fails when the file is
+// missing, malformed or, unless source_hash is 0, written from another map. radius is in tiles
+bool terrain_stream_open(const char *path, uint64_t source_hash, int radius, game_terrain_map_t *terrain_map);
+
+// hands the loaded tiles to queries, evicts tiles out of range of world_focus and queues the missing ones nearest
+// first. call between frames, never while jobs may be reading heights. does nothing for maps that are not streamed
+void terrain_stream_update(game_terrain_map_t *terrain_map, Vector3 world_focus);
+
+// waits for every queued tile and hands them to queries, for a start up without coarse heights or deterministic runs
+void terrain_stream_flush(game_terrain_map_t *terrain_map);
+
+// called by terrain_map_unload
+void terrain_stream_close(game_terrain_stream_t *stream);
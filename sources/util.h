@@ -1,11 +1,11 @@
 #pragma once
 
-inline float clamp_float (float value, float min, float max) {
+static inline float clamp_float (float value, float min, float max) {
     float result  = value < min ? min : value;
     return result > max ? max : result;
 }
 
-inline int clamp_int (int value, int min, int max)
+static inline int clamp_int (int value, int min, int max)
 {
     int result  = value < min ? min : value;
     return result > max ? max : result;